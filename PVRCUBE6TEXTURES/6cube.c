@@ -35,9 +35,11 @@
 #include <dc/pvr.h> /* PVR library headers for PowerVR graphics chip functions */
 #include <kos.h> /* Includes necessary KallistiOS (KOS) headers for Dreamcast development */
 #include <math.h> /* Standard slower math library headers for mathematical functions */
-#include <png/png.h> /* PNG library headers for handling PNG images */
 #include <stdio.h> /* Standard I/O library headers for input and output functions */
 #include <stdlib.h> /* Standard library headers for general-purpose functions, including abs() */
+#include "../mesh.h" /* Indexed strip meshes, mapped straight from the romdisk */
+#include "../fixedstep.h" /* Fixed timestep updates, drawn between the last two steps */
+#include "../pvrtex.h" /* .dt textures, in the format the build picked for each */
 
 extern uint8 romdisk[];
 KOS_INIT_FLAGS(INIT_DEFAULT | INIT_MALLOCSTATS);
@@ -45,16 +47,22 @@ KOS_INIT_ROMDISK(romdisk);
 
 #define NUM_TEXTURES 6
 
-typedef struct {
-    pvr_ptr_t ptr;
-    int w, h;
-    uint32 fmt;
-} kos_texture_t;
+dttex_info_t textures[NUM_TEXTURES];
 
-kos_texture_t* textures[NUM_TEXTURES] = {NULL};
+/* The cube from romdisk/mesh/cube.msh, one group of strips per face. Each
+   shared corner is transformed once a frame into cube_screen. */
+mesh_t cube_mesh;
+float (*cube_screen)[3] = NULL;
 
 float cube_x = 0.0f, cube_y = 0.0f, cube_z = -0.0f;
 float xrot = 0.0f, yrot = 0.0f, xspeed = 0.0f, yspeed = 0.0f;
+
+/* Speeds, friction and the controls are per step of a fixed 60Hz clock, so
+   the cube moves the same at any frame rate. The previous step's pose is
+   kept to draw in between. */
+#define SIM_HZ 60
+fixedstep_t sim_clock;
+float prev_x = 0.0f, prev_y = 0.0f, prev_z = -0.0f, prev_xrot = 0.0f, prev_yrot = 0.0f;
 /*  Ian Michael
  * This needed alignment as it worked on DC emulators. They all allow
  non-aligned
@@ -86,69 +94,41 @@ static inline float max_float(float a, float b) { return a > b ? a : b; }
  * This method goes beyond the usual static texture loading. Typically, setting
  * a 512x512 PNG, even if it's just 10 KB, forces it to occupy a static 512 KB
  * in VRAM. Here, however, we dynamically read the image size, ensuring it only
- * uses the actual size in KB. This approach supports KMG format too, providing
- * additional savings.
+ * uses the actual size in KB.
  *
  * While this might seem straightforward, existing examples mostly stick to
  * static file sizes, like 512x512, leading to inefficient use of VRAM. Nearly
  * all examples, including homebrew projects, follow this inefficient practice.
+ *
+ * The faces are no longer decoded from PNG here: the build converts each one
+ * to the smallest format that holds it (tools/texpick, VQ for these), so it
+ * is read straight into texture memory at about a seventh of the ARGB4444 size.
  */
-kos_texture_t *load_png_texture(const char *filename) {
-  kos_texture_t *texture;
-  kos_img_t img;
-
-  if (png_to_img(filename, PNG_FULL_ALPHA, &img) < 0) {
-    return NULL;
-  }
-
-  texture = (kos_texture_t *)malloc(sizeof(kos_texture_t));
-  if (!texture) {
-    kos_img_free(&img, 0);
-    return NULL;
-  }
-
-  texture->ptr = pvr_mem_malloc(img.byte_count);
-  if (!texture->ptr) {
-    free(texture);
-    kos_img_free(&img, 0);
-    return NULL;
-  }
-
-  texture->w = img.w;
-  texture->h = img.h;
-  texture->fmt = PVR_TXRFMT_ARGB4444;
-
-  pvr_txr_load_kimg(&img, texture->ptr, 0);
-  kos_img_free(&img, 0);
-
-  return texture;
-}
+int load_cube_textures() {
+  const char *texture_names[NUM_TEXTURES] = {"face1", "face2", "face3",
+                                             "face4", "face5", "face6"};
+  uint64 load_us = timer_us_gettime64();
+  uint32 bytes = 0;
 
-void load_cube_textures() {
-    const char* texture_files[NUM_TEXTURES] = {
-        "/rd/face1.png",
-        "/rd/face2.png",
-        "/rd/face3.png",
-        "/rd/face4.png",
-        "/rd/face5.png",
-        "/rd/face6.png"
-    };
-
-    for (int i = 0; i < NUM_TEXTURES; i++) {
-        textures[i] = load_png_texture(texture_files[i]);
-        if (!textures[i]) {
-            printf("Failed to load texture %s.\n", texture_files[i]);
-        }
+  for (int i = 0; i < NUM_TEXTURES; i++) {
+    if (!pvrtex_load_named("/rd/texture/textures.txt", texture_names[i],
+                           &textures[i])) {
+      printf("Failed to load texture %s.\n", texture_names[i]);
+      return 0;
     }
+    bytes += textures[i].size;
+  }
+  printf("textures: %d, %u KB texture memory in %u us\n", NUM_TEXTURES,
+         (unsigned)(bytes / 1024), (unsigned)(timer_us_gettime64() - load_us));
+  return 1;
 }
 void init_poly_context(pvr_poly_cxt_t *cxt, int texture_index) {
-  pvr_poly_cxt_txr(cxt, PVR_LIST_OP_POLY, PVR_TXRFMT_ARGB4444,
-                   textures[texture_index]->w, textures[texture_index]->h,
-                   textures[texture_index]->ptr, PVR_FILTER_BILINEAR);
+  pvrtex_poly_cxt(cxt, PVR_LIST_OP_POLY, &textures[texture_index],
+                  PVR_FILTER_BILINEAR);
   cxt->gen.culling = PVR_CULLING_CCW;
 }
 
-void render_cube(void) {
+void render_cube(float alpha) {
   pvr_poly_cxt_t cxt;
   pvr_poly_hdr_t hdr;
   pvr_vertex_t *vert;
@@ -164,70 +144,111 @@ void render_cube(void) {
   vector_t up = {0, 1, 0};
   mat_lookat(&eye, &center, &up);
 
-  float zoom_scale = 100.0f / (-cube_z);
+  float zoom_scale = 100.0f / (-fixedstep_lerp(prev_z, cube_z, alpha));
 
   mat_identity();
-  mat_translate(cube_x, cube_y, cube_z);
-  mat_rotate_x(xrot);
-  mat_rotate_y(yrot);
+  mat_translate(fixedstep_lerp(prev_x, cube_x, alpha), fixedstep_lerp(prev_y, cube_y, alpha),
+                fixedstep_lerp(prev_z, cube_z, alpha));
+  mat_rotate_x(fixedstep_lerp(prev_xrot, xrot, alpha));
+  mat_rotate_y(fixedstep_lerp(prev_yrot, yrot, alpha));
   mat_scale(scale * zoom_scale, scale * zoom_scale, scale * zoom_scale);
   mat_store(&model_view_matrix);
 
-  float vertices[24][3] = {{-scale, -scale, +scale}, {+scale, -scale, +scale},
-                           {-scale, +scale, +scale}, {+scale, +scale, +scale},
-                           {+scale, -scale, +scale}, {+scale, -scale, -scale},
-                           {+scale, +scale, +scale}, {+scale, +scale, -scale},
-                           {+scale, -scale, -scale}, {-scale, -scale, -scale},
-                           {+scale, +scale, -scale}, {-scale, +scale, -scale},
-                           {-scale, -scale, -scale}, {-scale, -scale, +scale},
-                           {-scale, +scale, -scale}, {-scale, +scale, +scale},
-                           {-scale, +scale, +scale}, {+scale, +scale, +scale},
-                           {-scale, +scale, -scale}, {+scale, +scale, -scale},
-                           {-scale, -scale, -scale}, {+scale, -scale, -scale},
-                           {-scale, -scale, +scale}, {+scale, -scale, +scale}};
-
-  float tex_coords[4][2] = {{0, 1}, {1, 1}, {0, 0}, {1, 0}};
+  for (int i = 0; i < cube_mesh.vert_count; i++) {
+    vec3f_t v = {cube_mesh.x[i] * scale, cube_mesh.y[i] * scale,
+                 cube_mesh.z[i] * scale};
+    mat_trans_single(v.x, v.y, v.z);
+
+    cube_screen[i][0] = v.x + 320.0f;
+    cube_screen[i][1] = v.y + 240.0f;
+    cube_screen[i][2] = min_float(65535.0f,
+                                  max_float(0.0f, (v.z + 10.0f) / 20.0f * 65535.0f));
+  }
 
   pvr_dr_init(dr_state);
 
-  for (int i = 0; i < 6; i++) {
+  for (int i = 0; i < 6 && i < cube_mesh.group_count; i++) {
     init_poly_context(&cxt, i);
     pvr_poly_compile(&hdr, &cxt);
     pvr_prim(&hdr, sizeof(hdr));
 
-    for (int j = 0; j < 4; j++) {
-      int idx = i * 4 + j;
-      float x = vertices[idx][0];
-      float y = vertices[idx][1];
-      float z = vertices[idx][2];
-
-      vec3f_t v = {x, y, z};
-      mat_trans_single(v.x, v.y, v.z);
-
-      vert = pvr_dr_target(dr_state);
-      vert->flags = (j == 3) ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
-      vert->x = v.x + 320.0f;
-      vert->y = v.y + 240.0f;
-      vert->z = min_float(65535.0f,
-                          max_float(0.0f, (v.z + 10.0f) / 20.0f * 65535.0f));
-      vert->u = tex_coords[j][0];
-      vert->v = tex_coords[j][1];
-      vert->argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
-      vert->oargb = 0;
-      pvr_dr_commit(vert);
+    for (uint32 s = cube_mesh.group_first[i]; s < cube_mesh.group_first[i + 1]; s++) {
+      uint32 first = cube_mesh.strip_first[s], last = cube_mesh.strip_first[s + 1] - 1;
+
+      for (uint32 j = first; j <= last; j++) {
+        int idx = cube_mesh.index[j];
+
+        vert = pvr_dr_target(dr_state);
+        vert->flags = (j == last) ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
+        vert->x = cube_screen[idx][0];
+        vert->y = cube_screen[idx][1];
+        vert->z = cube_screen[idx][2];
+        vert->u = cube_mesh.u[idx];
+        vert->v = cube_mesh.v[idx];
+        vert->argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
+        vert->oargb = 0;
+        pvr_dr_commit(vert);
+      }
     }
   }
 
   mat_load(&model_view_matrix);
 }
 
-void cleanup() {
-  for (int i = 0; i < NUM_TEXTURES; i++) {
-    if (textures[i]) {
-      pvr_mem_free(textures[i]->ptr);
-      free(textures[i]);
-    }
+/* One simulation step with the buttons and sticks last read */
+void update_cube(const cont_state_t *state) {
+  prev_x = cube_x;
+  prev_y = cube_y;
+  prev_z = cube_z;
+  prev_xrot = xrot;
+  prev_yrot = yrot;
+
+  xrot += xspeed;
+  yrot += yspeed;
+
+  xspeed *= 0.99f;
+  yspeed *= 0.99f;
+
+  if (fabs(xspeed) < 0.0001f)
+    xspeed = 0;
+  if (fabs(yspeed) < 0.0001f)
+    yspeed = 0;
+
+  if (abs(state->joyx) > 16) {
+    cube_x += (state->joyx / 32768.0f) * 1000.5f;
   }
+  if (abs(state->joyy) > 16) {
+    cube_y -= (state->joyy / 32768.0f) * 1000.5f;
+  }
+
+  float ZOOM_SPEED = 0.30f;
+  if (state->ltrig > 16) {
+    cube_z -= (state->ltrig / 255.0f) * ZOOM_SPEED;
+  }
+  if (state->rtrig > 16) {
+    cube_z += (state->rtrig / 255.0f) * ZOOM_SPEED;
+  }
+
+  if (cube_z < -10.0f)
+    cube_z = -10.0f;
+  if (cube_z > -0.5f)
+    cube_z = -0.5f;
+
+  if (state->buttons & CONT_X)
+    xspeed += 0.001f;
+  if (state->buttons & CONT_Y)
+    xspeed -= 0.001f;
+  if (state->buttons & CONT_A)
+    yspeed += 0.001f;
+  if (state->buttons & CONT_B)
+    yspeed -= 0.001f;
+}
+
+void cleanup() {
+  for (int i = 0; i < NUM_TEXTURES; i++)
+    pvrtex_unload(&textures[i]);
+  free(cube_screen);
+  mesh_unload(&cube_mesh);
   pvr_shutdown();
   vid_shutdown();
 }
@@ -240,62 +261,45 @@ int main(int argc, char *argv[]) {
   pvr_init(&params);
   pvr_set_bg_color(0.0f, 0.0f, 0.0f);
 
-  load_cube_textures();
+  if (!load_cube_textures()) {
+    cleanup();
+    return 1;
+  }
+
+  uint64 load_us = timer_us_gettime64();
+  if (!mesh_load("/rd/mesh/cube.msh", &cube_mesh)) {
+    cleanup();
+    return 1;
+  }
+  printf("mesh: %d vertices, %d strips, %d indices in %u us\n",
+         cube_mesh.vert_count, cube_mesh.strip_count, cube_mesh.index_count,
+         (unsigned)(timer_us_gettime64() - load_us));
+  cube_screen = malloc(cube_mesh.vert_count * sizeof(*cube_screen));
+
+  cont_state_t pad;
+  fixedstep_init(&sim_clock, SIM_HZ, timer_us_gettime64());
 
   while (1) {
     pvr_wait_ready();
     pvr_scene_begin();
     pvr_list_begin(PVR_LIST_OP_POLY);
 
-    render_cube();
+    render_cube(fixedstep_alpha(&sim_clock));
 
     pvr_list_finish();
     pvr_scene_finish();
 
-    xrot += xspeed;
-    yrot += yspeed;
-
-    xspeed *= 0.99f;
-    yspeed *= 0.99f;
-
-    if (fabs(xspeed) < 0.0001f)
-      xspeed = 0;
-    if (fabs(yspeed) < 0.0001f)
-      yspeed = 0;
-
+    memset(&pad, 0, sizeof(pad)); // No controller, no input
     MAPLE_FOREACH_BEGIN(MAPLE_FUNC_CONTROLLER, cont_state_t, state)
     if (state->buttons & CONT_START)
       goto out;
-
-    if (abs(state->joyx) > 16) {
-      cube_x += (state->joyx / 32768.0f) * 1000.5f;
-    }
-    if (abs(state->joyy) > 16) {
-      cube_y -= (state->joyy / 32768.0f) * 1000.5f;
-    }
-
-    float ZOOM_SPEED = 0.30f;
-    if (state->ltrig > 16) {
-      cube_z -= (state->ltrig / 255.0f) * ZOOM_SPEED;
-    }
-    if (state->rtrig > 16) {
-      cube_z += (state->rtrig / 255.0f) * ZOOM_SPEED;
-    }
-
-    if (cube_z < -10.0f)
-      cube_z = -10.0f;
-    if (cube_z > -0.5f)
-      cube_z = -0.5f;
-
-    if (state->buttons & CONT_X)
-      xspeed += 0.001f;
-    if (state->buttons & CONT_Y)
-      xspeed -= 0.001f;
-    if (state->buttons & CONT_A)
-      yspeed += 0.001f;
-    if (state->buttons & CONT_B)
-      yspeed -= 0.001f;
+    pad = *state;
     MAPLE_FOREACH_END()
+
+    // As many steps as the time since the last frame holds, maybe none
+    int steps = fixedstep_advance(&sim_clock, timer_us_gettime64());
+    while (steps--)
+      update_cube(&pad);
   }
 
 out:
@@ -42,32 +42,31 @@
 #include <dc/pvr.h>    /* PVR library for PowerVR graphics chip functions                   */
 #include <kos.h>       /* KallistiOS (KOS) headers for Dreamcast development                */
 #include <math.h>      /* Standard math library for general mathematical functions          */
-#include <png/png.h>   /* PNG library for handling PNG images                               */
 #include <stdio.h>     /* Standard I/O library for input and output functions               */
 #include <stdlib.h>    /* Standard library for general-purpose functions, including abs()   */
 #include "perlin.h"    /* Perlin noise header                                               */
+#include "vcache.h"    /* Batched transform, shared between passes in a frame              */
+#include "framesched.h" /* Builds the next frame while the PVR renders, texture fences     */
+#include "../fixedstep.h" /* Fixed timestep updates, drawn between the last two steps    */
+#include "../mesh.h"  /* Indexed strip meshes, mapped straight from the romdisk          */
+#include "../pvrtex.h" /* .dt textures, in the format the build picked for each           */
 
-/********************************************************************************************/
-/* LibADX (c) 2012 Josh PH3NOM Pearson                                                      */
-/* Decoder algorithm based on adx2wav (c) BERO 2001                                         */
-/*                                                                                          */
-/* LibADX is a library for decoding ADX audio files using the                                */
-/* KallistiOS development environment, intended for use only                                */
-/* on the Sega Dreamcast game console.                                                      */
-/*                                                                                          */
-/* Features:                                                                                 */
-/*   - Full implementation of the ADX looping function.                                     */
-/*   - Functions include play, pause, stop, restart.                                        */
-/*                                                                                          */
-/* This library is completely free to modify and/or redistribute.                           */
-/********************************************************************************************/
-
-#include "LibADX/libadx.h" /* ADX Decoder Library */
-#include "LibADX/snddrv.h" /* Direct Access to Sound Driver */
+/* Audio: adxmix decodes and mixes the ADX voices into one AICA stream, see adxmix.h */
+#include <dc/sound/stream.h> /* AICA streaming, fed by the mixer */
+#include "adxmix.h"  /* ADX decoder and mixer: music plus ambience in one thread     */
+#include "iosched.h" /* Read-ahead ring buffer between the GD-ROM and the decoder */
 
 #define NUM_TEXTURES 6
 #define PERLIN_TEXTURE_SIZE 16
 
+/* 1 sends the faces under one header as a single strip joined through
+   degenerate triangles. tools/stripcheck on this cube: one EOL instead of
+   six, 34 vertices instead of 24 and the same TA bin entries, as a face of
+   two triangles plus a join of four fills one six triangle run either way. */
+#ifndef CUBE_STITCH
+#define CUBE_STITCH 0
+#endif
+
 extern uint8 romdisk[];
 KOS_INIT_FLAGS(INIT_DEFAULT | INIT_MALLOCSTATS);
 KOS_INIT_ROMDISK(romdisk);
@@ -95,18 +94,25 @@ PerlinParams perlin_params = {
     .metallic_hue = 0.0f
 };
 
-typedef struct {
-    pvr_ptr_t ptr;
-    int w, h;
-    uint32 fmt;
-} kos_texture_t;
+dttex_info_t textures[NUM_TEXTURES];
 
-kos_texture_t* textures[NUM_TEXTURES] = {NULL};
-pvr_ptr_t perlin_texture = NULL;
+// The perlin texture changes every frame while the PVR may still be reading
+// the last one: two copies, the scene reads one while the other is rewritten
+static framesched_t *sched;
+static framesched_ring_t perlin_ring = { 2, -1, { 0 }, { NULL } };
+static int perlin_dirty = 1;
 
 float cube_x = 0.0f, cube_y = 0.0f, cube_z = -5.0f;
 float xrot = 0.0f, yrot = 0.0f;
 
+// The stick, triggers, noise controls and scroll are per step of a fixed
+// 60Hz clock, so they run the same at any frame rate. The previous step's
+// pose is kept to draw in between.
+#define SIM_HZ 60
+#define ROTATION_SPEED 0.05f
+static fixedstep_t sim_clock;
+static float prev_z = -5.0f, prev_xrot = 0.0f, prev_yrot = 0.0f;
+
 static matrix_t _perspective_mtrx __attribute__((aligned(32)));
 
 void mat_perspective_fov(float fov, float aspect, float zNear, float zFar) {
@@ -121,54 +127,69 @@ void mat_perspective_fov(float fov, float aspect, float zNear, float zFar) {
     mat_load(&_perspective_mtrx);
 }
 
-static inline float min_float(float a, float b) { return a < b ? a : b; }
-static inline float max_float(float a, float b) { return a > b ? a : b; }
-
-kos_texture_t* load_png_texture(const char *filename) {
-    kos_texture_t* texture;
-    kos_img_t img;
-
-    if (png_to_img(filename, PNG_FULL_ALPHA, &img) < 0) {
-        return NULL;
-    }
-
-    texture = (kos_texture_t *)malloc(sizeof(kos_texture_t));
-    if (!texture) {
-        kos_img_free(&img, 0);
-        return NULL;
-    }
-
-    texture->ptr = pvr_mem_malloc(img.byte_count);
-    if (!texture->ptr) {
-        free(texture);
-        kos_img_free(&img, 0);
-        return NULL;
+/* The cube from romdisk/mesh/cube.msh (assets/mesh/cube.obj through
+   tools/meshconv): one group of strips per face, 20 shared vertices */
+static mesh_t cube_mesh = { .fd = -1 };
+
+/* Transformed cube, shared by every pass in a frame */
+static vcache_t cube_cache;
+
+static int load_cube_mesh(iosched_t *io) {
+    const char *filename = "/rd/mesh/cube.msh";
+    size_t size;
+    uint8 *mem;
+
+    if (io == NULL)
+        return mesh_load(filename, &cube_mesh);
+    memset(&cube_mesh, 0, sizeof(cube_mesh));
+    cube_mesh.fd = -1;
+    mem = iosched_load(io, filename, MESH_ALIGN, &size);
+    if (mem == NULL)
+        return 0;
+    if (!mesh_bind(&cube_mesh, mem, size)) {
+        printf("Error: mesh %s is not a " MESH_FOURCC " file\n", filename);
+        free(mem);
+        return 0;
     }
+    cube_mesh.mem = mem;
+    return 1;
+}
 
-    texture->w = img.w;
-    texture->h = img.h;
-    texture->fmt = PVR_TXRFMT_ARGB4444;
-
-    pvr_txr_load_kimg(&img, texture->ptr, 0);
-    kos_img_free(&img, 0);
-
-    return texture;
+/* Screen space as the renderers always had it: the matrices work in
+   pixels around the centre, depth is (1/w + 10) / 20 of the 16 bit range */
+static void init_cube_cache(void) {
+    vcache_init(&cube_cache);
+    cube_cache.view.sx = 1.0f;
+    cube_cache.view.sy = 1.0f;
+    cube_cache.view.ox = 320.0f;
+    cube_cache.view.oy = 240.0f;
+    cube_cache.view.zscale = 65535.0f / 20.0f;
+    cube_cache.view.zbias = 10.0f * 65535.0f / 20.0f;
+    cube_cache.view.zmax = 65535.0f;
 }
 
-void load_cube_textures() {
-    const char* texture_files[NUM_TEXTURES] = {
-        "/rd/face1.png", "/rd/face2.png", "/rd/face3.png",
-        "/rd/face4.png", "/rd/face5.png", "/rd/face6.png"
+/* The faces come converted by the build, tools/texpick picks each one's
+   format, so they go straight into texture memory with no PNG decode */
+int load_cube_textures() {
+    const char* texture_names[NUM_TEXTURES] = {
+        "face1", "face2", "face3", "face4", "face5", "face6"
     };
+    uint64 load_us = timer_us_gettime64();
+    uint32 bytes = 0;
+
     for (int i = 0; i < NUM_TEXTURES; i++) {
-        textures[i] = load_png_texture(texture_files[i]);
-        if (!textures[i]) {
-            printf("Failed to load texture %s.\n", texture_files[i]);
-        } else {
-           printf("Loaded texture %s: %dx%d, format: %lu\n", 
-       texture_files[i], textures[i]->w, textures[i]->h, (unsigned long)textures[i]->fmt);
+        if (!pvrtex_load_named("/rd/texture/textures.txt", texture_names[i], &textures[i])) {
+            printf("Failed to load texture %s.\n", texture_names[i]);
+            return 0;
         }
+        printf("Loaded texture %s: %dx%d, format: %lu, %lu bytes\n", texture_names[i],
+               textures[i].width, textures[i].height, (unsigned long)textures[i].pvrformat,
+               (unsigned long)textures[i].size);
+        bytes += textures[i].size;
     }
+    printf("textures: %d, %u KB texture memory in %u us\n", NUM_TEXTURES,
+           (unsigned)(bytes / 1024), (unsigned)(timer_us_gettime64() - load_us));
+    return 1;
 }
 
 uint16 hsv_to_rgb565(float h, float s, float v) {
@@ -194,11 +215,11 @@ uint16 hsv_to_rgb565(float h, float s, float v) {
 
     return (r16 << 11) | (g16 << 5) | b16;
 }
+/* Regenerate into a copy no frame in flight reads and make it current */
 void create_perlin_texture() {
-    if (perlin_texture != NULL) {
-        pvr_mem_free(perlin_texture);
-    }
-    
+    int slot = framesched_ring_acquire(sched, &perlin_ring);
+    framesched_phase(sched, "texture");
+
     uint16 *texture_data = (uint16 *)memalign(32, PERLIN_TEXTURE_SIZE * PERLIN_TEXTURE_SIZE * 2);
     
     for (int y = 0; y < PERLIN_TEXTURE_SIZE; y++) {
@@ -248,19 +269,20 @@ void create_perlin_texture() {
         }
     }
     
-    perlin_texture = pvr_mem_malloc(PERLIN_TEXTURE_SIZE * PERLIN_TEXTURE_SIZE * 2);
-    pvr_txr_load_ex(texture_data, perlin_texture, PERLIN_TEXTURE_SIZE, PERLIN_TEXTURE_SIZE, PVR_TXRLOAD_16BPP);
+    pvr_txr_load_ex(texture_data, perlin_ring.slot[slot], PERLIN_TEXTURE_SIZE, PERLIN_TEXTURE_SIZE, PVR_TXRLOAD_16BPP);
+    framesched_ring_publish(&perlin_ring, slot);
+    perlin_dirty = 0;
     
     free(texture_data);
 }
 
-void render_png_cube(void) {
-    pvr_poly_cxt_t cxt;
-    pvr_poly_hdr_t hdr;
-    pvr_vertex_t *vert;
-    pvr_dr_state_t dr_state;
+/* Load the cube's matrix, store it in model_view_matrix and return the
+   cube in screen space. Only the first pass in a frame transforms, the
+   rest get the same vertices back from the cache. alpha is how far the
+   frame is between the last two steps. */
+static const vertpipe_t *cube_screen(matrix_t *model_view_matrix, float alpha) {
+    float z = fixedstep_lerp(prev_z, cube_z, alpha);
     float scale = 1.0f;
-    matrix_t model_view_matrix __attribute__((aligned(32)));
 
     mat_identity();
     mat_perspective_fov(45.0f, 640.0f / 480.0f, 0.1f, 100.0f);
@@ -270,98 +292,70 @@ void render_png_cube(void) {
     vector_t up = {0, 1, 0, 0};
     mat_lookat(&eye, &center, &up);
 
-    float zoom_scale = 300.0f / (-cube_z);
+    float zoom_scale = 300.0f / (-z);
 
     mat_identity();
-    mat_translate(cube_x, cube_y, cube_z);
-    mat_rotate_x(xrot);
-    mat_rotate_y(yrot);
+    mat_translate(cube_x, cube_y, z);
+    mat_rotate_x(fixedstep_lerp(prev_xrot, xrot, alpha));
+    mat_rotate_y(fixedstep_lerp(prev_yrot, yrot, alpha));
     mat_scale(scale * zoom_scale, scale * zoom_scale, scale * zoom_scale);
-    mat_store(&model_view_matrix);
-
-    float vertices[24][3] = {
-        {-scale, -scale, +scale}, {+scale, -scale, +scale}, {-scale, +scale, +scale}, {+scale, +scale, +scale},
-        {+scale, -scale, +scale}, {+scale, -scale, -scale}, {+scale, +scale, +scale}, {+scale, +scale, -scale},
-        {+scale, -scale, -scale}, {-scale, -scale, -scale}, {+scale, +scale, -scale}, {-scale, +scale, -scale},
-        {-scale, -scale, -scale}, {-scale, -scale, +scale}, {-scale, +scale, -scale}, {-scale, +scale, +scale},
-        {-scale, +scale, +scale}, {+scale, +scale, +scale}, {-scale, +scale, -scale}, {+scale, +scale, -scale},
-        {-scale, -scale, -scale}, {+scale, -scale, -scale}, {-scale, -scale, +scale}, {+scale, -scale, +scale}
-    };
+    mat_store(model_view_matrix);
+
+    vecsoa3_t pos = {cube_mesh.x, cube_mesh.y, cube_mesh.z};
+    return vcache_get(&cube_cache, &pos, cube_mesh.vert_count);
+}
 
-    float tex_coords[4][2] = {{0, 1}, {1, 1}, {0, 0}, {1, 0}};
+/* The strips of groups first to last - 1, joined into one with CUBE_STITCH */
+static void emit_groups(const vertpipe_t *cube, pvr_dr_state_t *dr, int first, int last,
+                        uint32 argb) {
+    uint32 s0 = cube_mesh.group_first[first], s1 = cube_mesh.group_first[last];
+#if CUBE_STITCH
+    vertpipe_emit_strips(cube, dr, cube_mesh.index, cube_mesh.strip_first, s0, s1,
+                         cube_mesh.u, cube_mesh.v, argb);
+#else
+    for (uint32 s = s0; s < s1; s++) {
+        uint32 i = cube_mesh.strip_first[s];
+        vertpipe_emit_indexed(cube, dr, cube_mesh.index + i, cube_mesh.strip_first[s + 1] - i,
+                              cube_mesh.u, cube_mesh.v, argb);
+    }
+#endif
+}
 
+void render_png_cube(float alpha) {
+    pvr_poly_cxt_t cxt;
+    pvr_poly_hdr_t hdr;
+    pvr_dr_state_t dr_state;
+    matrix_t model_view_matrix __attribute__((aligned(32)));
+    const vertpipe_t *cube = cube_screen(&model_view_matrix, alpha);
+
+    if (cube == NULL)
+        return;
     pvr_dr_init(dr_state);
 
-    for (int i = 0; i < 6; i++) {
-        pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY, PVR_TXRFMT_ARGB4444,
-                         textures[i]->w, textures[i]->h,
-                         textures[i]->ptr, PVR_FILTER_BILINEAR);
+    for (int i = 0; i < 6 && i < cube_mesh.group_count; i++) {
+        pvrtex_poly_cxt(&cxt, PVR_LIST_OP_POLY, &textures[i], PVR_FILTER_BILINEAR);
         cxt.gen.culling = PVR_CULLING_CCW;
         
         pvr_poly_compile(&hdr, &cxt);
         pvr_prim(&hdr, sizeof(hdr));
 
-        for (int j = 0; j < 4; j++) {
-            int idx = i * 4 + j;
-            float x = vertices[idx][0];
-            float y = vertices[idx][1];
-            float z = vertices[idx][2];
-
-            vec3f_t v = {x, y, z};
-            mat_trans_single(v.x, v.y, v.z);
-
-            vert = pvr_dr_target(dr_state);
-            vert->flags = (j == 3) ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
-            vert->x = v.x + 320.0f;
-            vert->y = v.y + 240.0f;
-            vert->z = min_float(65535.0f, max_float(0.0f, (v.z + 10.0f) / 20.0f * 65535.0f));
-            vert->u = tex_coords[j][0];
-            vert->v = tex_coords[j][1];
-            vert->argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
-            vert->oargb = 0;
-            pvr_dr_commit(vert);
-        }
+        emit_groups(cube, &dr_state, i, i + 1, PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f));
     }
 
     mat_load(&model_view_matrix);
 }
 
-void render_perlin_cube(void) {
+void render_perlin_cube(float alpha) {
     pvr_poly_cxt_t cxt;
     pvr_poly_hdr_t hdr;
-    pvr_vertex_t *vert;
     pvr_dr_state_t dr_state;
-    float scale = 1.0f;
     matrix_t model_view_matrix __attribute__((aligned(32)));
+    const vertpipe_t *cube = cube_screen(&model_view_matrix, alpha);
+    // Fences the copy with this frame until the PVR has rendered it
+    pvr_ptr_t perlin_texture = framesched_ring_use(sched, &perlin_ring);
 
-    mat_identity();
-    mat_perspective_fov(45.0f, 640.0f / 480.0f, 0.1f, 100.0f);
-
-    point_t eye = {0, 0, 0, 1};
-    point_t center = {0, 0, -1, 1};
-    vector_t up = {0, 1, 0, 0};
-    mat_lookat(&eye, &center, &up);
-
-    float zoom_scale = 300.0f / (-cube_z);
-
-    mat_identity();
-    mat_translate(cube_x, cube_y, cube_z);
-    mat_rotate_x(xrot);
-    mat_rotate_y(yrot);
-    mat_scale(scale * zoom_scale, scale * zoom_scale, scale * zoom_scale);
-    mat_store(&model_view_matrix);
-
-    float vertices[24][3] = {
-        {-scale, -scale, +scale}, {+scale, -scale, +scale}, {-scale, +scale, +scale}, {+scale, +scale, +scale},
-        {+scale, -scale, +scale}, {+scale, -scale, -scale}, {+scale, +scale, +scale}, {+scale, +scale, -scale},
-        {+scale, -scale, -scale}, {-scale, -scale, -scale}, {+scale, +scale, -scale}, {-scale, +scale, -scale},
-        {-scale, -scale, -scale}, {-scale, -scale, +scale}, {-scale, +scale, -scale}, {-scale, +scale, +scale},
-        {-scale, +scale, +scale}, {+scale, +scale, +scale}, {-scale, +scale, -scale}, {+scale, +scale, -scale},
-        {-scale, -scale, -scale}, {+scale, -scale, -scale}, {-scale, -scale, +scale}, {+scale, -scale, +scale}
-    };
-
-    float tex_coords[4][2] = {{0, 1}, {1, 1}, {0, 0}, {1, 0}};
-
+    if (cube == NULL || perlin_texture == NULL)
+        return;
     pvr_dr_init(dr_state);
 
     pvr_poly_cxt_txr(&cxt, PVR_LIST_TR_POLY, PVR_TXRFMT_RGB565,
@@ -374,42 +368,122 @@ void render_perlin_cube(void) {
     pvr_poly_compile(&hdr, &cxt);
     pvr_prim(&hdr, sizeof(hdr));
 
-    for (int i = 0; i < 6; i++) {
-        for (int j = 0; j < 4; j++) {
-            int idx = i * 4 + j;
-            float x = vertices[idx][0];
-            float y = vertices[idx][1];
-            float z = vertices[idx][2];
-
-            vec3f_t v = {x, y, z};
-            mat_trans_single(v.x, v.y, v.z);
-
-            vert = pvr_dr_target(dr_state);
-            vert->flags = (j == 3) ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
-            vert->x = v.x + 320.0f;
-            vert->y = v.y + 240.0f;
-            vert->z = min_float(65535.0f, max_float(0.0f, (v.z + 10.0f) / 20.0f * 65535.0f));
-            vert->u = tex_coords[j][0];
-            vert->v = tex_coords[j][1];
-            vert->argb = PVR_PACK_COLOR(0.5f, 1.0f, 1.0f, 1.0f);  // Adjust alpha for blend strength
-            vert->oargb = 0;
-            pvr_dr_commit(vert);
-        }
-    }
+    // Every face under one header, alpha sets the blend strength
+    emit_groups(cube, &dr_state, 0, cube_mesh.group_count,
+                PVR_PACK_COLOR(0.5f, 1.0f, 1.0f, 1.0f));
 
     mat_load(&model_view_matrix);
 }
 
-void cleanup() {
-    for (int i = 0; i < NUM_TEXTURES; i++) {
-        if (textures[i]) {
-            pvr_mem_free(textures[i]->ptr);
-            free(textures[i]);
+/* One simulation step: scroll the noise, then apply the controls last read */
+static void step_scene(const cont_state_t *state) {
+    prev_z = cube_z;
+    prev_xrot = xrot;
+    prev_yrot = yrot;
+
+    perlin_params.offset_y += 0.01f;
+    perlin_dirty = 1;
+
+    // Enhanced analog stick control for rotation
+    if (abs(state->joyx) > 16 || abs(state->joyy) > 16) {
+        float angle_x = (state->joyy / 128.0f) * ROTATION_SPEED;
+        float angle_y = (state->joyx / 128.0f) * ROTATION_SPEED;
+
+        xrot += angle_x;
+        yrot += angle_y;
+
+        // Wrap the previous pose with it, or the frame between spins back
+        while (xrot > 2*F_PI) { xrot -= 2*F_PI; prev_xrot -= 2*F_PI; }
+        while (xrot < -2*F_PI) { xrot += 2*F_PI; prev_xrot += 2*F_PI; }
+        while (yrot > 2*F_PI) { yrot -= 2*F_PI; prev_yrot -= 2*F_PI; }
+        while (yrot < -2*F_PI) { yrot += 2*F_PI; prev_yrot += 2*F_PI; }
+    }
+
+    // Zoom functionality with triggers
+    float ZOOM_SPEED = 0.10f;
+    if (state->ltrig > 16) {
+        cube_z -= (state->ltrig / 255.0f) * ZOOM_SPEED;
+    }
+    if (state->rtrig > 16) {
+        cube_z += (state->rtrig / 255.0f) * ZOOM_SPEED;
+    }
+
+    if (cube_z < -10.0f) cube_z = -10.0f;
+    if (cube_z > -0.5f) cube_z = -0.5f;
+
+    // Perlin noise parameter controls
+    if (state->buttons & CONT_DPAD_UP) {
+        perlin_params.scale *= 1.1f;
+        perlin_dirty = 1;
+    }
+    if (state->buttons & CONT_DPAD_DOWN) {
+        perlin_params.scale *= 0.9f;
+        perlin_dirty = 1;
+    }
+    if (state->buttons & CONT_DPAD_LEFT) {
+        perlin_params.persistence = fmaxf(perlin_params.persistence - 0.05f, 0.1f);
+        perlin_dirty = 1;
+    }
+    if (state->buttons & CONT_DPAD_RIGHT) {
+        perlin_params.persistence = fminf(perlin_params.persistence + 0.05f, 1.0f);
+        perlin_dirty = 1;
+    }
+
+    // Lacunarity adjustment
+    if ((state->buttons & CONT_A) && (state->buttons & CONT_X)) {
+        perlin_params.lacunarity = fminf(perlin_params.lacunarity * 1.1f, 4.0f);
+        perlin_dirty = 1;
+    }
+    if ((state->buttons & CONT_A) && (state->buttons & CONT_Y)) {
+        perlin_params.lacunarity = fmaxf(perlin_params.lacunarity * 0.9f, 1.0f);
+        perlin_dirty = 1;
+    }
+
+    // Octaves adjustment
+    if ((state->buttons & CONT_B) && (state->buttons & CONT_X)) {
+        perlin_params.octaves = fminf(perlin_params.octaves + 1, 8);
+        perlin_dirty = 1;
+    }
+    if ((state->buttons & CONT_B) && (state->buttons & CONT_Y)) {
+        perlin_params.octaves = fmaxf(perlin_params.octaves - 1, 1);
+        perlin_dirty = 1;
+    }
+
+    // Color mode toggle
+    static int color_mode_cooldown = 0;
+    if ((state->buttons & CONT_A) && (state->buttons & CONT_B) && color_mode_cooldown == 0) {
+        perlin_params.color_mode = (perlin_params.color_mode + 1) % 3;
+        perlin_dirty = 1;
+        color_mode_cooldown = 15;
+    }
+    if (color_mode_cooldown > 0) color_mode_cooldown--;
+
+    // Metallic hue adjustment (only affects metallic mode)
+    if (perlin_params.color_mode == 2) {
+        if (state->buttons & CONT_X) {
+            perlin_params.metallic_hue = fmodf(perlin_params.metallic_hue + 0.02f, 1.0f);
+            perlin_dirty = 1;
+        }
+        if (state->buttons & CONT_Y) {
+            perlin_params.metallic_hue = fmodf(perlin_params.metallic_hue - 0.02f, 1.0f);
+            perlin_dirty = 1;
         }
     }
-    if (perlin_texture) {
-        pvr_mem_free(perlin_texture);
+}
+
+/* Frees whatever got loaded, so every exit from main() goes through here */
+void cleanup() {
+    for (int i = 0; i < NUM_TEXTURES; i++)
+        pvrtex_unload(&textures[i]);
+    for (int i = 0; i < perlin_ring.count; i++) {
+        if (perlin_ring.slot[i])
+            pvr_mem_free(perlin_ring.slot[i]);
+        perlin_ring.slot[i] = NULL;
     }
+    framesched_destroy(sched);
+    sched = NULL;
+    vcache_free(&cube_cache);
+    mesh_unload(&cube_mesh);
     pvr_shutdown();
 }
 
@@ -426,126 +500,169 @@ pvr_init_params_t params = {
     pvr_init(&params);
     pvr_set_bg_color(0.0f, 0.0f, 0.1f);
 
-    load_cube_textures();
+    if (!load_cube_textures()) {
+        cleanup();
+        return 1;
+    }
+    sched = framesched_create(&framesched_backend_pvr, 256);
+    if (sched == NULL) {
+        cleanup();
+        return 1;
+    }
+    for (int i = 0; i < perlin_ring.count; i++) {
+        perlin_ring.slot[i] = pvr_mem_malloc(PERLIN_TEXTURE_SIZE * PERLIN_TEXTURE_SIZE * 2);
+        if (perlin_ring.slot[i] == NULL) {
+            printf("Error: no texture memory for Perlin slot %d\n", i);
+            cleanup();
+            return 1;
+        }
+    }
     create_perlin_texture();
 
-    float rotation_speed = 0.05f;
-    
-     adx_dec( "/cd/sample.adx", 1 );
+    // Stream the ADX through the read-ahead scheduler so other reads on the
+    // drive can't starve the decoder. The I/O thread runs above the main loop.
+    // Only kept with /ios mounted and the thread running, so io says both.
+    iosched_t *io = iosched_create(&iosched_backend_fs, NULL);
+    if (io) {
+        int mounted = iosched_vfs_init(io);
+        if (!mounted || !iosched_start(io, PRIO_DEFAULT - 2)) {
+            if (mounted)
+                iosched_vfs_shutdown();
+            iosched_destroy(io);
+            io = NULL;
+        }
+    }
+    const char *music = io ? "/ios/cd/sample.adx" : "/cd/sample.adx";
+
+    // The mesh comes in through the bulk queue, as level data off the disc
+    // would while music plays, mapped from the romdisk without a scheduler
+    uint64 load_us = timer_us_gettime64();
+    if (!load_cube_mesh(io)) {
+        if (io) {
+            iosched_vfs_shutdown();
+            iosched_destroy(io);
+        }
+        cleanup();
+        return 1;
+    }
+    printf("mesh: %d vertices, %d strips, %d indices in %u us\n",
+           cube_mesh.vert_count, cube_mesh.strip_count, cube_mesh.index_count,
+           (unsigned)(timer_us_gettime64() - load_us));
+    init_cube_cache();
+
+    uint32 last_underruns = 0;
+
+    // One decoder thread for every ADX voice. 300ms of output buffering is
+    // what tools/pcmsim found safe; the mixer may use a quarter of the CPU
+    // and drops ambience before music when it can't keep up. Without sound
+    // the demo runs silent.
+    adxmix_t *mix = NULL;
+    int sound = snd_stream_init() >= 0;
+    if (!sound)
+        printf("Error: snd_stream_init failed, running without sound\n");
+    else if ((mix = adxmix_create(44100, 300, 25.0f)) != NULL) {
+        if (adxmix_play(mix, music, 1, ADXMIX_PRIO_MUSIC, 1.0f, 0.0f) < 0 ||
+            !adxmix_start(mix, PRIO_DEFAULT - 1)) {
+            printf("Error: %s did not start, running without sound\n", music);
+            adxmix_destroy(mix);
+            mix = NULL;
+        }
+    }
     
+    cont_state_t pad;
+    fixedstep_init(&sim_clock, SIM_HZ, timer_us_gettime64());
+
     while (1) {
-        pvr_wait_ready();
-        pvr_scene_begin();
+        float alpha = fixedstep_alpha(&sim_clock);
+
+        framesched_begin(sched);
+        vcache_begin_frame(&cube_cache);
 
         pvr_list_begin(PVR_LIST_OP_POLY);
-        render_png_cube();
+        render_png_cube(alpha);
         pvr_list_finish();
 
         pvr_list_begin(PVR_LIST_TR_POLY);
-        render_perlin_cube();
+        render_perlin_cube(alpha);
         pvr_list_finish();
 
-        pvr_scene_finish();
+        framesched_submit(sched);
+
+        // Everything from here overlaps the PVR rendering this frame
+        framesched_phase(sched, "sim");
 
-        perlin_params.offset_y += 0.01f;
-        create_perlin_texture();
+        // Report read-ahead starvation as it happens
+        if (io) {
+            iosched_stats_t st;
+            iosched_get_stats(io, &st);
+            if (st.underruns != last_underruns) {
+                printf("iosched: %u underruns (%u bytes short), fill %d/%d, min %d\n",
+                       (unsigned)st.underruns, (unsigned)st.underrun_bytes,
+                       st.fill, st.size, st.fill_min);
+                last_underruns = st.underruns;
+            }
+        }
 
+        // No controller reads as no input, the clock keeps running
+        memset(&pad, 0, sizeof(pad));
         MAPLE_FOREACH_BEGIN(MAPLE_FUNC_CONTROLLER, cont_state_t, state)
             if (state->buttons & CONT_START)
                 goto out;
+            pad = *state;
+        MAPLE_FOREACH_END()
 
-            // Enhanced analog stick control for rotation
-            if (abs(state->joyx) > 16 || abs(state->joyy) > 16) {
-                float angle_x = (state->joyy / 128.0f) * rotation_speed;
-                float angle_y = (state->joyx / 128.0f) * rotation_speed;
-
-                xrot += angle_x;
-                yrot += angle_y;
-
-                while (xrot > 2*F_PI) xrot -= 2*F_PI;
-                while (xrot < -2*F_PI) xrot += 2*F_PI;
-                while (yrot > 2*F_PI) yrot -= 2*F_PI;
-                while (yrot < -2*F_PI) yrot += 2*F_PI;
-            }
-
-            // Zoom functionality with triggers
-            float ZOOM_SPEED = 0.10f;
-            if (state->ltrig > 16) {
-                cube_z -= (state->ltrig / 255.0f) * ZOOM_SPEED;
-            }
-            if (state->rtrig > 16) {
-                cube_z += (state->rtrig / 255.0f) * ZOOM_SPEED;
-            }
-
-            if (cube_z < -10.0f) cube_z = -10.0f;
-            if (cube_z > -0.5f) cube_z = -0.5f;
-
-            // Perlin noise parameter controls
-            if (state->buttons & CONT_DPAD_UP) {
-                perlin_params.scale *= 1.1f;
-                create_perlin_texture();
-            }
-            if (state->buttons & CONT_DPAD_DOWN) {
-                perlin_params.scale *= 0.9f;
-                create_perlin_texture();
-            }
-            if (state->buttons & CONT_DPAD_LEFT) {
-                perlin_params.persistence = fmaxf(perlin_params.persistence - 0.05f, 0.1f);
-                create_perlin_texture();
-            }
-            if (state->buttons & CONT_DPAD_RIGHT) {
-                perlin_params.persistence = fminf(perlin_params.persistence + 0.05f, 1.0f);
-                create_perlin_texture();
-            }
-
-            // Lacunarity adjustment
-            if ((state->buttons & CONT_A) && (state->buttons & CONT_X)) {
-                perlin_params.lacunarity = fminf(perlin_params.lacunarity * 1.1f, 4.0f);
-                create_perlin_texture();
-            }
-            if ((state->buttons & CONT_A) && (state->buttons & CONT_Y)) {
-                perlin_params.lacunarity = fmaxf(perlin_params.lacunarity * 0.9f, 1.0f);
-                create_perlin_texture();
-            }
-
-            // Octaves adjustment
-            if ((state->buttons & CONT_B) && (state->buttons & CONT_X)) {
-                perlin_params.octaves = fminf(perlin_params.octaves + 1, 8);
-                create_perlin_texture();
-            }
-            if ((state->buttons & CONT_B) && (state->buttons & CONT_Y)) {
-                perlin_params.octaves = fmaxf(perlin_params.octaves - 1, 1);
-                create_perlin_texture();
-            }
-
-            // Color mode toggle
-            static int color_mode_cooldown = 0;
-            if ((state->buttons & CONT_A) && (state->buttons & CONT_B) && color_mode_cooldown == 0) {
-                perlin_params.color_mode = (perlin_params.color_mode + 1) % 3;
-                create_perlin_texture();
-                color_mode_cooldown = 15;
-            }
-            if (color_mode_cooldown > 0) color_mode_cooldown--;
-
-            // Metallic hue adjustment (only affects metallic mode)
-            if (perlin_params.color_mode == 2) {
-                if (state->buttons & CONT_X) {
-                    perlin_params.metallic_hue = fmodf(perlin_params.metallic_hue + 0.02f, 1.0f);
-                    create_perlin_texture();
-                }
-                if (state->buttons & CONT_Y) {
-                    perlin_params.metallic_hue = fmodf(perlin_params.metallic_hue - 0.02f, 1.0f);
-                    create_perlin_texture();
-                }
-            }
+        // As many steps as the time since the last frame holds, maybe none
+        int steps = fixedstep_advance(&sim_clock, timer_us_gettime64());
+        while (steps--)
+            step_scene(&pad);
 
-        MAPLE_FOREACH_END()
+        // Once a frame, however many controls changed it
+        if (perlin_dirty)
+            create_perlin_texture();
     }
 
 out:
-	snddrv_exit();
-	thd_sleep(20);
-	pvr_shutdown();
+	if (mix) {
+		adxmix_stats_t ms;
+		adxmix_get_stats(mix, &ms);
+		printf("adxmix: %u chunks, %u us/chunk of %u budget, %u voices dropped, "
+		       "ring underruns %u\n",
+		       (unsigned)ms.chunks, (unsigned)ms.chunk_us, (unsigned)ms.budget_us,
+		       (unsigned)ms.dropped, (unsigned)adxmix_ring(mix)->underruns);
+		adxmix_destroy(mix);
+	}
+	if (sound)
+		snd_stream_shutdown();
+	if (io) {
+		iosched_stats_t st;
+		iosched_get_stats(io, &st);
+		printf("iosched: audio %u reads %u bytes, bulk %u reads %u bytes, "
+		       "%u preempted, %u underruns, min fill %d/%d\n",
+		       (unsigned)st.audio_reads, (unsigned)st.audio_bytes,
+		       (unsigned)st.bulk_reads, (unsigned)st.bulk_bytes,
+		       (unsigned)st.bulk_preempted, (unsigned)st.underruns,
+		       st.fill_min, st.size);
+		iosched_vfs_shutdown();
+		iosched_destroy(io);
+	}
+	{
+		vcache_stats_t vs;
+		vcache_get_stats(&cube_cache, &vs);
+		printf("vcache: %u lookups, %u transforms, %u reuses (%u vertices transformed, "
+		       "%u reused)\n", (unsigned)vs.lookups, (unsigned)vs.transforms,
+		       (unsigned)vs.reuses, (unsigned)vs.verts_transformed,
+		       (unsigned)vs.verts_reused);
+	}
+	{
+		framesched_stats_t fst;
+		framesched_get_stats(sched, &fst);
+		printf("framesched: %u frames, cpu busy %u us/frame, waiting for the PVR %u us/frame, "
+		       "%u texture fence waits (%u us)\n", (unsigned)fst.frames,
+		       (unsigned)(fst.busy_us / fst.frames), (unsigned)(fst.ready_wait_us / fst.frames),
+		       (unsigned)fst.fence_waits, (unsigned)fst.fence_wait_us);
+		framesched_trace_print(sched, stdout, 4, 500);
+	}
+	cleanup();
     vid_shutdown();
     return 0;
 }
\ No newline at end of file
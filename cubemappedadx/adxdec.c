@@ -0,0 +1,150 @@
+/********************************************************************************************/
+/* Name:     adxdec.c                                                                       */
+/* Title:    CRI ADX header parsing and reference ADPCM decoder                             */
+/* Platform: Dreamcast | KallistiOS:2.0 | host                                              */
+/*                                                                                          */
+/* Description: Decoder algorithm based on adx2wav (c) BERO 2001, see adxdec.h.             */
+/********************************************************************************************/
+#include <math.h>
+#include "adxdec.h"
+
+#define ADX_SIG        0x8000
+#define ADX_ENC_ADX    3
+
+static inline int be16(const uint8_t *p) {
+  return (p[0] << 8) | p[1];
+}
+
+static inline int be32(const uint8_t *p) {
+  return (int)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]);
+}
+
+void adxdec_coefs(int rate, int highpass, int *coef1, int *coef2) {
+  // Single precision on purpose: that is what double is on the SH4 with
+  // -m4-single-only, and the host has to come up with the same integers
+  float a = 1.41421356f - cosf(2.0f * 3.14159265f * (float)highpass / (float)rate);
+  float b = 1.41421356f - 1.0f;
+  float c = (a - sqrtf((a + b) * (a - b))) / b;
+
+  *coef1 = (int)floorf(c * 8192.0f);
+  *coef2 = (int)floorf(c * c * -4096.0f);
+}
+
+int adxdec_parse_header(const uint8_t *buf, int len, adxdec_header_t *h) {
+  int loop_at;
+
+  if (len < 0x14 || be16(buf) != ADX_SIG)
+    return 0;
+  h->data_offset = be16(buf + 2) + 4;
+  if (h->data_offset > len || buf[4] != ADX_ENC_ADX || buf[6] != 4)
+    return 0;
+
+  h->frame_bytes = buf[5];
+  h->channels = buf[7];
+  h->rate = be32(buf + 8);
+  h->samples = be32(buf + 12);
+  h->highpass = be16(buf + 16);
+  if (h->frame_bytes != 18 || h->channels < 1 || h->channels > ADXDEC_MAX_CHANNELS ||
+      h->rate <= 0)
+    return 0;
+  adxdec_coefs(h->rate, h->highpass, &h->coef1, &h->coef2);
+
+  // Version 3 keeps the loop at 0x18 (ADX_ADDR_LOOP in adx.h), version 4 0xc later
+  loop_at = buf[0x12] == 4 ? 0x24 : 0x18;
+  h->loop = 0;
+  h->loop_start = 0;
+  h->loop_end = h->samples;
+  if (h->data_offset >= loop_at + 0x14 && be32(buf + loop_at) != 0) {
+    h->loop = 1;
+    h->loop_start = be32(buf + loop_at + 4);
+    h->loop_end = be32(buf + loop_at + 12);
+    if (h->loop_end > h->samples || h->loop_start >= h->loop_end) {
+      h->loop_start = 0;
+      h->loop_end = h->samples;
+    }
+  }
+  return 1;
+}
+
+void adxdec_frame_ref(const uint8_t *in, int16_t *out, int stride, adxdec_hist_t *h,
+                      int coef1, int coef2) {
+  int scale = be16(in);
+  int s1 = h->s1, s2 = h->s2;
+  int i, d, s0;
+
+  in += 2;
+  for (i = 0; i < ADXDEC_SAMPLES_PER_FRAME; i++) {
+    d = (i & 1) ? (in[i >> 1] & 15) : (in[i >> 1] >> 4);
+    if (d & 8)
+      d -= 16;
+    s0 = d * scale + ((coef1 * s1 + coef2 * s2) >> 12);
+    if (s0 > 32767)
+      s0 = 32767;
+    else if (s0 < -32768)
+      s0 = -32768;
+    *out = s0;
+    out += stride;
+    s2 = s1;
+    s1 = s0;
+  }
+  h->s1 = s1;
+  h->s2 = s2;
+}
+
+/* Saturate to 16 bits without a branch. s never gets near the int limits:
+   8 * 0x7fff plus a prediction of at most about 2 * 32768. */
+static inline int clamp16(int s) {
+  int hi = (32767 - s) >> 31;       // all ones above the range
+  int lo = (s + 32768) >> 31;       // all ones below it
+  return (s & ~(hi | lo)) | (32767 & hi) | (-32768 & lo);
+}
+
+/* Signed high and low nibble of a byte, by shifting through int8_t */
+#define NIB_HI(b) ((int8_t)(b) >> 4)
+#define NIB_LO(b) ((int8_t)((b) << 4) >> 4)
+
+#define PREDICT(s1, s2) ((coef1 * (s1) + coef2 * (s2)) >> 12)
+
+void adxdec_block(const adxdec_header_t *hdr, const uint8_t *in, int16_t *out,
+                  adxdec_hist_t *hist) {
+  const int coef1 = hdr->coef1, coef2 = hdr->coef2;
+  int i;
+
+  if (hdr->channels == 2) {
+    const uint8_t *l = in + 2, *r = in + 18 + 2;
+    int lscale = be16(in), rscale = be16(in + 18);
+    int l1 = hist[0].s1, l2 = hist[0].s2;
+    int r1 = hist[1].s1, r2 = hist[1].s2;
+
+    for (i = 0; i < 16; i++, out += 4) {
+      int lb = l[i], rb = r[i];
+      l2 = clamp16(NIB_HI(lb) * lscale + PREDICT(l1, l2));
+      r2 = clamp16(NIB_HI(rb) * rscale + PREDICT(r1, r2));
+      out[0] = l2;
+      out[1] = r2;
+      l1 = clamp16(NIB_LO(lb) * lscale + PREDICT(l2, l1));
+      r1 = clamp16(NIB_LO(rb) * rscale + PREDICT(r2, r1));
+      out[2] = l1;
+      out[3] = r1;
+    }
+    hist[0].s1 = l1;
+    hist[0].s2 = l2;
+    hist[1].s1 = r1;
+    hist[1].s2 = r2;
+  } else {
+    const uint8_t *p = in + 2;
+    int scale = be16(in);
+    int s1 = hist->s1, s2 = hist->s2;
+
+    // The history registers swap roles every sample instead of shuffling
+    for (i = 0; i < 16; i++, out += 2) {
+      int b = p[i];
+      s2 = clamp16(NIB_HI(b) * scale + PREDICT(s1, s2));
+      out[0] = s2;
+      s1 = clamp16(NIB_LO(b) * scale + PREDICT(s2, s1));
+      out[1] = s1;
+    }
+    hist->s1 = s1;
+    hist->s2 = s2;
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef ADXDEC_H
+#define ADXDEC_H
+
+#include <stdint.h>
+
+/**  CRI ADX header parsing and ADPCM frame decoding.
+
+     An ADX stream is a header followed by frames of 18 bytes per channel:
+     a big endian 16 bit scale and 32 signed 4 bit deltas. Channels are
+     interleaved frame by frame. Each sample is predicted from the two before
+     it with a pair of coefficients derived from the stream's rate and
+     high-pass cutoff:
+
+         s = delta * scale + ((coef1 * s1 + coef2 * s2) >> 12)
+
+     adxdec_frame_ref() is the straightforward one sample at a time version
+     of BERO's adx2wav loop that LibADX uses, but with per-stream
+     coefficients instead of the 44.1kHz constants so 22kHz ambients decode
+     correctly too. adxdec_block() is the one to use: it decodes a whole
+     frame for every channel per call with the same results, bit for bit.
+     tools/adxdecbench checks that and times both.                         */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADXDEC_SAMPLES_PER_FRAME 32
+#define ADXDEC_MAX_CHANNELS      2
+#define ADXDEC_MAX_HEADER        0x800
+
+typedef struct {
+  int s1, s2;                 // last two decoded samples, like PREV in adx.h
+} adxdec_hist_t;
+
+typedef struct {
+  int data_offset;            // first frame
+  int frame_bytes;            // per channel, 18 for standard ADX
+  int channels;
+  int rate;
+  int samples;                // per channel
+  int highpass;               // Hz
+  int coef1, coef2;           // 4.12 fixed point prediction coefficients
+  int loop;                   // header carries a loop
+  int loop_start;             // samples
+  int loop_end;
+} adxdec_header_t;
+
+/**
+ * @brief Parse an ADX header
+ *
+ * @param buf Start of the file
+ * @param len Bytes available, ADXDEC_MAX_HEADER is always enough
+ * @param h Filled in on success
+ * @return int 1 on success, 0 if this is not a stream we can play
+ */
+int adxdec_parse_header(const uint8_t *buf, int len, adxdec_header_t *h);
+
+/**
+ * @brief Prediction coefficients for a rate and high-pass cutoff
+ */
+void adxdec_coefs(int rate, int highpass, int *coef1, int *coef2);
+
+/**
+ * @brief Reference decoder: one channel of one frame, one sample at a time
+ *
+ * @param in 18 byte frame
+ * @param out First output sample
+ * @param stride Distance between output samples, 2 for interleaved stereo
+ * @param h Channel history
+ */
+void adxdec_frame_ref(const uint8_t *in, int16_t *out, int stride, adxdec_hist_t *h,
+                      int coef1, int coef2);
+
+/**
+ * @brief Block decoder: one frame of every channel
+ *
+ * Two nibbles per byte and, for stereo, both channels in the same loop so
+ * the two prediction chains overlap in the pipeline. The clamp is done with
+ * masks, the SH4 has no conditional move and every branch it takes costs.
+ *
+ * @param hdr Stream header, for channels and coefficients
+ * @param in hdr->channels frames of 18 bytes
+ * @param out 32 * hdr->channels interleaved samples
+ * @param hist One history per channel
+ */
+void adxdec_block(const adxdec_header_t *hdr, const uint8_t *in, int16_t *out,
+                  adxdec_hist_t *hist);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // ADXDEC_H
@@ -0,0 +1,467 @@
+/********************************************************************************************/
+/* Name:     adxmix.c                                                                       */
+/* Title:    Multi-stream ADX mixer with per-voice gain, pan and priority                   */
+/* Platform: Dreamcast | KallistiOS:2.0 | host (benchmark)                                  */
+/*                                                                                          */
+/* Description: Decodes several ADX files in one thread into a shared stereo pcmring. See   */
+/* adxmix.h.                                                                                */
+/********************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adxdec.h"
+#include "adxmix.h"
+
+#ifdef _arch_dreamcast
+#include <arch/timer.h>
+#include <kos/mutex.h>
+#include <kos/thread.h>
+#include <dc/sound/stream.h>
+typedef mutex_t mix_lock_t;
+#define mix_lock_init(l)    mutex_init(l, MUTEX_TYPE_NORMAL)
+#define mix_lock_destroy(l) mutex_destroy(l)
+#define mix_lock(l)         mutex_lock(l)
+#define mix_unlock(l)       mutex_unlock(l)
+#define mix_now_ns()        timer_ns_gettime64()
+#else
+#include <pthread.h>
+#include <time.h>
+typedef pthread_mutex_t mix_lock_t;
+#define mix_lock_init(l)    pthread_mutex_init(l, NULL)
+#define mix_lock_destroy(l) pthread_mutex_destroy(l)
+#define mix_lock(l)         pthread_mutex_lock(l)
+#define mix_unlock(l)       pthread_mutex_unlock(l)
+static uint64_t mix_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+#define MIX_BLOCK      512              // frames mixed per pass
+#define MIX_IO_FRAMES  64               // ADX frames read per fread
+#define MIX_IO_BYTES   (MIX_IO_FRAMES * 18 * ADXDEC_MAX_CHANNELS)
+
+#define VOICE_FREE    0
+#define VOICE_PLAYING 1
+#define VOICE_PAUSED  2
+
+/* A handle is gen * ADXMIX_MAX_VOICES + slot, gen counts plays on the slot */
+#define VOICE_GEN_MASK 0xffffff
+
+typedef struct {
+  int state;
+  unsigned gen;
+  FILE *fp;
+  adxdec_header_t hdr;
+  adxdec_hist_t hist[ADXDEC_MAX_CHANNELS];
+  int loop;
+  int prio;
+  int gain_l, gain_r;          // 2.14 fixed point
+  uint32_t step;               // 16.16 source samples per output frame
+  uint32_t frac;
+  int cur[2], next[2];         // resampler taps
+  int16_t pcm[ADXDEC_SAMPLES_PER_FRAME * ADXDEC_MAX_CHANNELS];
+  int pcm_pos, pcm_len;
+  int frame;                   // next ADX frame to decode
+  uint8_t io[MIX_IO_BYTES];
+  int io_pos, io_len;
+  float cost;                  // average ns per output frame
+} voice_t;
+
+struct adxmix {
+  int rate;
+  float budget_ns;             // per MIX_BLOCK, 0 for no limit
+  pcmring_t ring;
+  voice_t voices[ADXMIX_MAX_VOICES];
+  int32_t acc[MIX_BLOCK * 2];
+  adxmix_stats_t stats;
+  mix_lock_t lock;
+#ifdef _arch_dreamcast
+  snd_stream_hnd_t hnd;
+  kthread_t *thread;
+  volatile int quit;
+#endif
+};
+
+/* Voices ------------------------------------------------------------------- */
+
+/* The voice a handle names, NULL once it ended or the slot was reused.
+   Caller holds the lock. */
+static voice_t *voice_get(adxmix_t *m, int voice) {
+  voice_t *v;
+
+  if (voice < 0)
+    return NULL;
+  v = &m->voices[voice % ADXMIX_MAX_VOICES];
+  if (v->state == VOICE_FREE || v->gen != (unsigned)voice / ADXMIX_MAX_VOICES)
+    return NULL;
+  return v;
+}
+
+static void voice_close(voice_t *v) {
+  if (v->fp)
+    fclose(v->fp);
+  v->fp = NULL;
+  v->state = VOICE_FREE;
+}
+
+/* Position the file at the frame holding sample, the caller skips the rest */
+static int voice_seek(voice_t *v, int sample) {
+  int frame_bytes = v->hdr.frame_bytes * v->hdr.channels;
+
+  v->frame = sample / ADXDEC_SAMPLES_PER_FRAME;
+  v->io_pos = v->io_len = 0;
+  return fseek(v->fp, v->hdr.data_offset + v->frame * frame_bytes, SEEK_SET) == 0;
+}
+
+/* Decode the next ADX frame into v->pcm, handling the loop. 0 at the end. */
+static int voice_decode_frame(voice_t *v) {
+  int frame_bytes = v->hdr.frame_bytes * v->hdr.channels;
+  int end = v->loop ? v->hdr.loop_end : v->hdr.samples;
+  int first = v->frame * ADXDEC_SAMPLES_PER_FRAME;
+  int skip = 0;
+
+  if (first >= end) {
+    if (!v->loop || !voice_seek(v, v->hdr.loop_start))
+      return 0;
+    first = v->frame * ADXDEC_SAMPLES_PER_FRAME;
+    skip = v->hdr.loop_start - first;
+  }
+
+  if (v->io_len - v->io_pos < frame_bytes) {
+    int keep = v->io_len - v->io_pos;
+    memmove(v->io, v->io + v->io_pos, keep);
+    v->io_len = keep + fread(v->io + keep, 1, (MIX_IO_BYTES / frame_bytes) * frame_bytes - keep, v->fp);
+    v->io_pos = 0;
+    if (v->io_len < frame_bytes)
+      return 0;
+  }
+
+  adxdec_block(&v->hdr, v->io + v->io_pos, v->pcm, v->hist);
+  v->io_pos += frame_bytes;
+  v->frame++;
+
+  v->pcm_pos = skip;
+  v->pcm_len = end - first < ADXDEC_SAMPLES_PER_FRAME ? end - first : ADXDEC_SAMPLES_PER_FRAME;
+  return 1;
+}
+
+static int voice_pull(voice_t *v, int *s) {
+  if (v->pcm_pos >= v->pcm_len && !voice_decode_frame(v))
+    return 0;
+  if (v->hdr.channels == 2) {
+    s[0] = v->pcm[v->pcm_pos * 2];
+    s[1] = v->pcm[v->pcm_pos * 2 + 1];
+  } else {
+    s[0] = s[1] = v->pcm[v->pcm_pos];
+  }
+  v->pcm_pos++;
+  return 1;
+}
+
+static void voice_gain(voice_t *v, float gain, float pan) {
+  float l = pan > 0.0f ? 1.0f - pan : 1.0f;
+  float r = pan < 0.0f ? 1.0f + pan : 1.0f;
+
+  if (gain < 0.0f)
+    gain = 0.0f;
+  if (gain > 1.0f)
+    gain = 1.0f;
+  v->gain_l = (int)(gain * l * 16384.0f);
+  v->gain_r = (int)(gain * r * 16384.0f);
+}
+
+/* Resample with linear interpolation and add into acc. 0 once the voice ended. */
+static int voice_mix(voice_t *v, int32_t *acc, int frames) {
+  int i;
+
+  for (i = 0; i < frames; i++) {
+    int f = v->frac >> 4;  // 12 bits keeps (next - cur) * f inside 32 bits
+    int l = v->cur[0] + (((v->next[0] - v->cur[0]) * f) >> 12);
+    int r = v->cur[1] + (((v->next[1] - v->cur[1]) * f) >> 12);
+    acc[i * 2] += (l * v->gain_l) >> 14;
+    acc[i * 2 + 1] += (r * v->gain_r) >> 14;
+
+    v->frac += v->step;
+    while (v->frac >= 0x10000) {
+      v->frac -= 0x10000;
+      v->cur[0] = v->next[0];
+      v->cur[1] = v->next[1];
+      if (!voice_pull(v, v->next))
+        return 0;
+    }
+  }
+  return 1;
+}
+
+/* Mixer -------------------------------------------------------------------- */
+
+adxmix_t *adxmix_create(int rate, int ring_ms, float budget_pct) {
+  adxmix_t *m = calloc(1, sizeof(adxmix_t));
+
+  if (m == NULL) {
+    printf("Error: adxmix_create out of memory\n");
+    return NULL;
+  }
+  if (!pcmring_init(&m->ring, rate, 2, ring_ms, MIX_BLOCK)) {
+    free(m);
+    return NULL;
+  }
+  m->rate = rate;
+  if (budget_pct > 0.0f) {
+    m->budget_ns = (float)MIX_BLOCK * 1e9f / rate * budget_pct / 100.0f;
+    m->stats.budget_us = (uint32_t)(m->budget_ns / 1000.0f);
+  }
+  mix_lock_init(&m->lock);
+#ifdef _arch_dreamcast
+  m->hnd = SND_STREAM_INVALID;
+#endif
+  return m;
+}
+
+void adxmix_destroy(adxmix_t *m) {
+  int i;
+
+#ifdef _arch_dreamcast
+  m->quit = 1;
+  if (m->thread)
+    thd_join(m->thread, NULL);
+  if (m->hnd != SND_STREAM_INVALID) {
+    snd_stream_stop(m->hnd);
+    pcmring_stream_destroy(m->hnd);
+  }
+#endif
+  for (i = 0; i < ADXMIX_MAX_VOICES; i++)
+    voice_close(&m->voices[i]);
+  pcmring_free(&m->ring);
+  mix_lock_destroy(&m->lock);
+  free(m);
+}
+
+int adxmix_play(adxmix_t *m, const char *path, int loop, int prio, float gain, float pan) {
+  uint8_t hdr[ADXDEC_MAX_HEADER];
+  voice_t *nv, *v = NULL;
+  FILE *fp;
+  int i, len;
+
+  fp = fopen(path, "rb");
+  if (fp == NULL) {
+    printf("Error: adxmix can't open %s\n", path);
+    return -1;
+  }
+  nv = calloc(1, sizeof(voice_t));
+  if (nv == NULL) {
+    printf("Error: adxmix_play out of memory\n");
+    fclose(fp);
+    return -1;
+  }
+  len = fread(hdr, 1, sizeof(hdr), fp);
+  if (!adxdec_parse_header(hdr, len, &nv->hdr)) {
+    printf("Error: %s is not a supported ADX stream\n", path);
+    fclose(fp);
+    free(nv);
+    return -1;
+  }
+
+  // Open and decode the first frame before taking the lock, the mixer
+  // thread only waits for the copy into the slot
+  nv->fp = fp;
+  nv->loop = loop;
+  if (loop && !nv->hdr.loop) {
+    nv->hdr.loop_start = 0;
+    nv->hdr.loop_end = nv->hdr.samples;
+  }
+  nv->prio = prio;
+  nv->step = (uint32_t)(((uint64_t)nv->hdr.rate << 16) / m->rate);
+  voice_gain(nv, gain, pan);
+  if (!voice_seek(nv, 0) || !voice_pull(nv, nv->next)) {
+    printf("Error: %s has no audio\n", path);
+    voice_close(nv);
+    free(nv);
+    return -1;
+  }
+  nv->cur[0] = nv->next[0];
+  nv->cur[1] = nv->next[1];
+  nv->state = VOICE_PLAYING;
+
+  mix_lock(&m->lock);
+  for (i = 0; i < ADXMIX_MAX_VOICES; i++) {
+    if (m->voices[i].state == VOICE_FREE) {
+      v = &m->voices[i];
+      break;
+    }
+  }
+  if (v != NULL) {
+    nv->gen = (v->gen + 1) & VOICE_GEN_MASK;
+    *v = *nv;
+  }
+  mix_unlock(&m->lock);
+
+  if (v == NULL) {
+    printf("Error: adxmix has no free voice for %s\n", path);
+    voice_close(nv);
+    free(nv);
+    return -1;
+  }
+  free(nv);
+  return (int)(v->gen * ADXMIX_MAX_VOICES) + i;
+}
+
+void adxmix_stop(adxmix_t *m, int voice) {
+  voice_t *v;
+
+  mix_lock(&m->lock);
+  if ((v = voice_get(m, voice)) != NULL)
+    voice_close(v);
+  mix_unlock(&m->lock);
+}
+
+void adxmix_set_gain(adxmix_t *m, int voice, float gain, float pan) {
+  voice_t *v;
+
+  mix_lock(&m->lock);
+  if ((v = voice_get(m, voice)) != NULL)
+    voice_gain(v, gain, pan);
+  mix_unlock(&m->lock);
+}
+
+void adxmix_pause(adxmix_t *m, int voice, int paused) {
+  voice_t *v;
+
+  mix_lock(&m->lock);
+  if ((v = voice_get(m, voice)) != NULL)
+    v->state = paused ? VOICE_PAUSED : VOICE_PLAYING;
+  mix_unlock(&m->lock);
+}
+
+int adxmix_voice_active(adxmix_t *m, int voice) {
+  int active;
+
+  mix_lock(&m->lock);
+  active = voice_get(m, voice) != NULL;
+  mix_unlock(&m->lock);
+  return active;
+}
+
+/* One block, caller holds the lock */
+static void render_block(adxmix_t *m, int16_t *out, int frames) {
+  int order[ADXMIX_MAX_VOICES];
+  int n = 0, i, j, active = 0;
+  float planned = 0.0f;
+  float budget = m->budget_ns * frames / MIX_BLOCK;
+  uint64_t start = mix_now_ns();
+
+  // Highest priority first, insertion sort is plenty for 8 voices
+  for (i = 0; i < ADXMIX_MAX_VOICES; i++) {
+    if (m->voices[i].state != VOICE_PLAYING)
+      continue;
+    for (j = n; j > 0 && m->voices[order[j - 1]].prio < m->voices[i].prio; j--)
+      order[j] = order[j - 1];
+    order[j] = i;
+    n++;
+  }
+
+  memset(m->acc, 0, frames * 2 * sizeof(int32_t));
+  for (i = 0; i < n; i++) {
+    voice_t *v = &m->voices[order[i]];
+    float want = v->cost * frames;
+    uint64_t t0;
+
+    // Drop what the budget can't cover, from the bottom of the priority list
+    if (budget > 0.0f && planned > 0.0f && planned + want > budget) {
+      voice_close(v);
+      m->stats.dropped++;
+      m->stats.voice_us[order[i]] = 0;
+      continue;
+    }
+    planned += want;
+
+    t0 = mix_now_ns();
+    if (!voice_mix(v, m->acc, frames))
+      voice_close(v);
+    else
+      active++;
+    t0 = mix_now_ns() - t0;
+    v->cost = v->cost == 0.0f ? (float)t0 / frames : v->cost * 0.9f + (float)t0 / frames * 0.1f;
+    m->stats.voice_us[order[i]] = (uint32_t)(v->cost * MIX_BLOCK / 1000.0f);
+  }
+
+  for (i = 0; i < frames * 2; i++) {
+    int32_t s = m->acc[i];
+    out[i] = s > 32767 ? 32767 : s < -32768 ? -32768 : s;
+  }
+
+  m->stats.active = active;
+  m->stats.chunks++;
+  m->stats.chunk_us = (m->stats.chunk_us * 7 + (uint32_t)((mix_now_ns() - start) / 1000)) / 8;
+}
+
+int adxmix_render(adxmix_t *m, int16_t *out, int frames) {
+  int done = 0;
+
+  mix_lock(&m->lock);
+  while (done < frames) {
+    int n = frames - done < MIX_BLOCK ? frames - done : MIX_BLOCK;
+    render_block(m, out + done * 2, n);
+    done += n;
+  }
+  mix_unlock(&m->lock);
+  return done;
+}
+
+int adxmix_update(adxmix_t *m) {
+  int chunks = 0;
+
+  // The ring is whole chunks and only ever written a chunk at a time, so a
+  // reservation is always one contiguous chunk
+  while (pcmring_space(&m->ring) >= MIX_BLOCK) {
+    int frames = MIX_BLOCK;
+    int16_t *dst = pcmring_reserve(&m->ring, &frames);
+    adxmix_render(m, dst, frames);
+    pcmring_commit(&m->ring, frames);
+    chunks++;
+  }
+  return chunks;
+}
+
+pcmring_t *adxmix_ring(adxmix_t *m) {
+  return &m->ring;
+}
+
+void adxmix_get_stats(adxmix_t *m, adxmix_stats_t *out) {
+  mix_lock(&m->lock);
+  *out = m->stats;
+  mix_unlock(&m->lock);
+}
+
+#ifdef _arch_dreamcast
+static void *adxmix_thread(void *param) {
+  adxmix_t *m = (adxmix_t *)param;
+
+  while (!m->quit) {
+    adxmix_update(m);
+    snd_stream_poll(m->hnd);
+    thd_sleep(5);
+  }
+  return NULL;
+}
+
+int adxmix_start(adxmix_t *m, int prio) {
+  m->hnd = pcmring_stream_alloc(&m->ring);
+  if (m->hnd == SND_STREAM_INVALID)
+    return 0;
+  adxmix_update(m);  // prebuffer
+  snd_stream_start(m->hnd, m->rate, 1);
+  m->thread = thd_create(0, adxmix_thread, m);
+  if (m->thread == NULL) {
+    printf("Error: adxmix thread create failed\n");
+    snd_stream_stop(m->hnd);
+    pcmring_stream_destroy(m->hnd);
+    m->hnd = SND_STREAM_INVALID;
+    return 0;
+  }
+  thd_set_prio(m->thread, prio);
+  return 1;
+}
+#endif
@@ -0,0 +1,106 @@
+#ifndef ADXMIX_H
+#define ADXMIX_H
+
+#include <stdint.h>
+#include "pcmring.h"
+
+/**  Multi-stream ADX mixer.
+
+     LibADX plays exactly one stream with its own decoder thread. The mixer
+     decodes up to ADXMIX_MAX_VOICES ADX files in a single thread, resamples
+     each to the output rate, applies per-voice gain and pan and writes the
+     sum as 16 bit stereo into a pcmring that feeds the AICA.
+
+     Every voice has a priority. The mixer keeps a running average of what
+     each voice costs to decode and mix, and when the voices would take more
+     than budget_pct of the real time a chunk represents, the lowest
+     priority voices are dropped before any work is done on them. The highest
+     priority voice always plays.
+
+     Files are read with stdio, so a path under /ios goes through the
+     read-ahead scheduler in iosched.h.                                     */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADXMIX_MAX_VOICES 8
+
+/* Suggested priorities, higher wins */
+#define ADXMIX_PRIO_MUSIC   100
+#define ADXMIX_PRIO_AMBIENT 50
+#define ADXMIX_PRIO_SFX     25
+
+typedef struct adxmix adxmix_t;
+
+typedef struct {
+  uint32_t chunks;            // chunks mixed
+  uint32_t dropped;           // voices dropped for the CPU budget
+  uint32_t voice_us[ADXMIX_MAX_VOICES];  // average decode+mix cost per chunk
+  uint32_t chunk_us;          // average total cost per chunk
+  uint32_t budget_us;         // allowed per chunk, 0 for no limit
+  int active;                 // voices playing
+} adxmix_stats_t;
+
+/**
+ * @brief Create a mixer and its output ring
+ *
+ * @param rate Output rate in Hz
+ * @param ring_ms Output ring capacity, see tools/pcmsim for sizing
+ * @param budget_pct Share of real time the mixer may use, 0 for no limit
+ * @return adxmix_t* NULL on failure
+ */
+adxmix_t *adxmix_create(int rate, int ring_ms, float budget_pct);
+void adxmix_destroy(adxmix_t *m);
+
+/**
+ * @brief Start an ADX file on a free voice
+ *
+ * @param path File to stream
+ * @param loop Loop at the header's loop points, or the whole file
+ * @param prio Priority, see ADXMIX_PRIO_*
+ * @param gain 0.0 to 1.0
+ * @param pan -1.0 left to 1.0 right
+ * @return int voice handle, -1 on failure
+ */
+int adxmix_play(adxmix_t *m, const char *path, int loop, int prio, float gain, float pan);
+
+/* A handle stays with its voice: once the voice ends, is stopped or is
+   dropped for the budget these do nothing, even after the slot plays
+   something else */
+void adxmix_stop(adxmix_t *m, int voice);
+void adxmix_set_gain(adxmix_t *m, int voice, float gain, float pan);
+void adxmix_pause(adxmix_t *m, int voice, int paused);
+int adxmix_voice_active(adxmix_t *m, int voice);
+
+/**
+ * @brief Mix frames of stereo output, used directly by the host bench
+ *
+ * @return int frames written, always frames
+ */
+int adxmix_render(adxmix_t *m, int16_t *out, int frames);
+
+/**
+ * @brief Top up the output ring, one chunk at a time
+ *
+ * @return int chunks mixed
+ */
+int adxmix_update(adxmix_t *m);
+
+pcmring_t *adxmix_ring(adxmix_t *m);
+void adxmix_get_stats(adxmix_t *m, adxmix_stats_t *out);
+
+#ifdef _arch_dreamcast
+/**
+ * @brief Run adxmix_update() and the AICA stream in one thread
+ *
+ * snd_stream_init() must have been called.
+ */
+int adxmix_start(adxmix_t *m, int prio);
+#endif
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // ADXMIX_H
@@ -0,0 +1,295 @@
+/********************************************************************************************/
+/* Name:     framesched.c                                                                   */
+/* Title:    Frame pipelining with texture fences and a timeline trace                      */
+/* Platform: Dreamcast | KallistiOS:2.0 | host (simulation)                                 */
+/*                                                                                          */
+/* Description: Numbers scenes, tracks which the PVR has finished and hands out texture    */
+/* copies no frame in flight reads, timing every phase on the way. See framesched.h.       */
+/********************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "framesched.h"
+
+#ifdef _arch_dreamcast
+#include <arch/timer.h>
+#include <dc/pvr.h>
+#include <kos/thread.h>
+
+static void pvr_be_wait_ready(void *ctx) {
+  (void)ctx;
+  pvr_wait_ready();
+}
+static void pvr_be_scene_begin(void *ctx) {
+  (void)ctx;
+  pvr_scene_begin();
+}
+static void pvr_be_scene_finish(void *ctx) {
+  (void)ctx;
+  pvr_scene_finish();
+}
+static uint32_t pvr_be_frames_done(void *ctx) {
+  pvr_stats_t st;
+  (void)ctx;
+  // Counted at the flip after each render, so a little late, never early
+  pvr_get_stats(&st);
+  return (uint32_t)st.frame_count;
+}
+static uint64_t pvr_be_now_us(void *ctx) {
+  (void)ctx;
+  return timer_us_gettime64();
+}
+static void pvr_be_idle(void *ctx) {
+  (void)ctx;
+  thd_pass();
+}
+
+const framesched_backend_t framesched_backend_pvr = {
+  pvr_be_wait_ready, pvr_be_scene_begin, pvr_be_scene_finish, pvr_be_frames_done,
+  pvr_be_now_us, pvr_be_idle, NULL
+};
+#endif
+
+#define LANE_CPU 0
+#define LANE_PVR 1
+#define SUBMITS  16          // frames in flight remembered, far more than ever happen
+
+typedef struct {
+  uint32_t frame;
+  int lane;
+  const char *what;
+  uint64_t begin, end;
+} fs_event_t;
+
+struct framesched {
+  framesched_backend_t be;
+  uint32_t frame;            // last scene begun
+  uint32_t submitted;        // last scene finished on the CPU side
+  uint32_t completed;        // last scene seen rendered
+  uint32_t base;             // frames_done() at create
+  uint64_t submit_us[SUBMITS];
+  const char *phase;         // open CPU phase, NULL for none
+  uint64_t phase_start;
+  fs_event_t *trace;
+  int trace_cap, trace_len, trace_next;
+  framesched_stats_t stats;
+};
+
+static void record(framesched_t *fs, uint32_t frame, int lane, const char *what,
+                   uint64_t begin, uint64_t end) {
+  fs_event_t *e;
+
+  if (fs->trace_cap == 0)
+    return;
+  e = &fs->trace[fs->trace_next];
+  e->frame = frame;
+  e->lane = lane;
+  e->what = what;
+  e->begin = begin;
+  e->end = end;
+  fs->trace_next = (fs->trace_next + 1) % fs->trace_cap;
+  if (fs->trace_len < fs->trace_cap)
+    fs->trace_len++;
+}
+
+static void end_phase(framesched_t *fs, uint64_t now) {
+  if (fs->phase == NULL)
+    return;
+  record(fs, fs->frame, LANE_CPU, fs->phase, fs->phase_start, now);
+  fs->stats.busy_us += now - fs->phase_start;
+  fs->phase = NULL;
+}
+
+static void start_phase(framesched_t *fs, const char *what, uint64_t now) {
+  fs->phase = what;
+  fs->phase_start = now;
+}
+
+/* Pick up renders that finished since we last looked */
+static void collect(framesched_t *fs) {
+  uint32_t done = fs->be.frames_done(fs->be.ctx) - fs->base;
+  uint64_t now;
+
+  if (done <= fs->completed)
+    return;
+  if (done > fs->frame)
+    done = fs->frame;
+  now = fs->be.now_us(fs->be.ctx);
+  for (uint32_t f = fs->completed + 1; f <= done; f++)
+    record(fs, f, LANE_PVR, "render", fs->submit_us[f % SUBMITS], now);
+  fs->completed = done;
+}
+
+framesched_t *framesched_create(const framesched_backend_t *backend, int trace_events) {
+  framesched_t *fs = calloc(1, sizeof(framesched_t));
+
+  if (fs == NULL) {
+    printf("Error: framesched_create out of memory\n");
+    return NULL;
+  }
+  fs->be = *backend;
+  fs->base = fs->be.frames_done(fs->be.ctx);
+  if (trace_events > 0) {
+    fs->trace = calloc(trace_events, sizeof(fs_event_t));
+    fs->trace_cap = fs->trace ? trace_events : 0;
+  }
+  return fs;
+}
+
+void framesched_destroy(framesched_t *fs) {
+  if (fs == NULL)
+    return;
+  free(fs->trace);
+  free(fs);
+}
+
+uint32_t framesched_begin(framesched_t *fs) {
+  uint64_t t0 = fs->be.now_us(fs->be.ctx), t1;
+
+  end_phase(fs, t0);
+  fs->be.wait_ready(fs->be.ctx);
+  t1 = fs->be.now_us(fs->be.ctx);
+  fs->frame++;
+  fs->stats.frames++;
+  fs->stats.ready_wait_us += t1 - t0;
+  record(fs, fs->frame, LANE_CPU, "wait", t0, t1);
+  collect(fs);
+  fs->be.scene_begin(fs->be.ctx);
+  start_phase(fs, "build", t1);
+  return fs->frame;
+}
+
+void framesched_submit(framesched_t *fs) {
+  uint64_t now;
+
+  fs->be.scene_finish(fs->be.ctx);
+  now = fs->be.now_us(fs->be.ctx);
+  fs->submit_us[fs->frame % SUBMITS] = now;
+  fs->submitted = fs->frame;
+  end_phase(fs, now);
+  start_phase(fs, "cpu", now);
+  collect(fs);
+}
+
+void framesched_phase(framesched_t *fs, const char *what) {
+  uint64_t now = fs->be.now_us(fs->be.ctx);
+  end_phase(fs, now);
+  start_phase(fs, what, now);
+  // Every look narrows the render spans in the trace
+  collect(fs);
+}
+
+int framesched_done(framesched_t *fs, uint32_t frame) {
+  if (frame <= fs->completed)
+    return 1;
+  collect(fs);
+  return frame <= fs->completed;
+}
+
+void framesched_wait(framesched_t *fs, uint32_t frame) {
+  const char *phase = fs->phase;
+  uint64_t t0, t1;
+
+  if (framesched_done(fs, frame))
+    return;
+  t0 = fs->be.now_us(fs->be.ctx);
+  end_phase(fs, t0);
+  while (!framesched_done(fs, frame))
+    fs->be.idle(fs->be.ctx);
+  t1 = fs->be.now_us(fs->be.ctx);
+  record(fs, fs->frame, LANE_CPU, "fence", t0, t1);
+  fs->stats.fence_wait_us += t1 - t0;
+  fs->stats.fence_waits++;
+  if (phase)
+    start_phase(fs, phase, t1);
+}
+
+void *framesched_ring_use(framesched_t *fs, framesched_ring_t *r) {
+  if (r->current < 0)
+    return NULL;
+  r->fence[r->current] = fs->frame;
+  return r->slot[r->current];
+}
+
+int framesched_ring_acquire(framesched_t *fs, framesched_ring_t *r) {
+  int oldest = -1;
+
+  for (int i = 0; i < r->count; i++) {
+    if (i == r->current && r->count > 1)
+      continue;
+    if (framesched_done(fs, r->fence[i]))
+      return i;
+    if (oldest < 0 || r->fence[i] < r->fence[oldest])
+      oldest = i;
+  }
+  // Every copy is still being read: wait for the one that frees first
+  framesched_wait(fs, r->fence[oldest]);
+  return oldest;
+}
+
+void framesched_ring_publish(framesched_ring_t *r, int slot) {
+  r->current = slot;
+}
+
+void framesched_get_stats(framesched_t *fs, framesched_stats_t *out) {
+  *out = fs->stats;
+}
+
+void framesched_reset_stats(framesched_t *fs) {
+  memset(&fs->stats, 0, sizeof(fs->stats));
+}
+
+void framesched_trace_print(framesched_t *fs, FILE *out, int frames, int us_per_char) {
+  char lane[2][201];
+  uint32_t first = fs->frame > (uint32_t)frames ? fs->frame - frames + 1 : 1;
+  uint64_t t0 = UINT64_MAX, t1 = 0;
+  int width;
+
+  collect(fs);
+  for (int i = 0; i < fs->trace_len; i++) {
+    const fs_event_t *e = &fs->trace[i];
+    if (e->frame < first)
+      continue;
+    if (e->begin < t0)
+      t0 = e->begin;
+    if (e->end > t1)
+      t1 = e->end;
+  }
+  if (t1 <= t0 || us_per_char <= 0)
+    return;
+  width = (int)((t1 - t0) / us_per_char) + 1;
+  if (width > 200)
+    width = 200;
+  memset(lane, ' ', sizeof(lane));
+  lane[0][width] = lane[1][width] = '\0';
+
+  for (int i = 0; i < fs->trace_len; i++) {
+    const fs_event_t *e = &fs->trace[i];
+    int a, b;
+    if (e->frame < first)
+      continue;
+    a = (int)((e->begin - t0) / us_per_char);
+    b = (int)((e->end - t0) / us_per_char);
+    for (int c = a; c <= b && c < width; c++) {
+      // Waits are dots so the overlap stands out, phases their initial
+      if (e->lane == LANE_PVR)
+        lane[1][c] = '0' + e->frame % 10;
+      else if (!strcmp(e->what, "wait") || !strcmp(e->what, "fence"))
+        lane[0][c] = e->what[0] == 'w' ? '.' : '!';
+      else
+        lane[0][c] = e->what[0];
+    }
+  }
+  // Still rendering when the trace ends
+  for (uint32_t f = fs->completed + 1; f <= fs->submitted; f++) {
+    uint64_t b = fs->submit_us[f % SUBMITS];
+    for (int c = b > t0 ? (int)((b - t0) / us_per_char) : 0; c < width; c++)
+      lane[1][c] = '0' + f % 10;
+  }
+  fprintf(out, "frames %u-%u, %d us per column\n", (unsigned)first, (unsigned)fs->frame,
+          us_per_char);
+  fprintf(out, "  cpu |%s|\n", lane[0]);
+  fprintf(out, "  pvr |%s|\n", lane[1]);
+  fprintf(out, "  cpu: . waiting for the PVR, ! waiting on a texture fence, letters are "
+               "phases (b build, c after submit, ...)\n");
+  fprintf(out, "  pvr: frame number while it renders\n");
+}
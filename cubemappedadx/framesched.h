@@ -0,0 +1,142 @@
+#ifndef FRAMESCHED_H
+#define FRAMESCHED_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**  Frame scheduler: build frame N+1 on the CPU while the PVR renders N.
+
+     pvr_scene_finish() only hands a scene over; the PVR renders it while
+     the CPU goes on. Whatever runs after it (input, simulation, texture
+     generation) already overlaps that render, but anything that writes a
+     texture the scene reads races with it. The main loops either did that
+     (6cube2 freed and rebuilt the perlin texture straight after finishing
+     the scene) or would have to wait for the render to end first.
+
+     This gives every scene a frame number and lets the CPU ask whether the
+     PVR is done with a given frame (a fence), so the loop becomes
+
+       framesched_begin()    wait until the PVR takes a new scene
+       ... build scene N, framesched_ring_use() for dynamic textures
+       framesched_submit()   scene N is in flight
+       ... input and simulation for N+1
+       framesched_ring_acquire() / _publish()   write a texture N is not
+                             reading, wait only if every copy is in use
+
+     A ring of two textures is enough for one frame in flight.
+
+     Every wait and every named phase is timed into a trace, with the PVR's
+     render spans next to them; framesched_trace_print() draws the last few
+     frames as a timeline. A render's end is when the CPU first saw it
+     finished, so the PVR spans are upper bounds.
+
+     The PVR side is a backend table, pvr_*() on the Dreamcast, a simulated
+     PVR in tools/framesim.                                                */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAMESCHED_MAX_SLOTS 4
+
+typedef struct framesched_backend {
+  void (*wait_ready)(void *ctx);       // until a new scene may begin
+  void (*scene_begin)(void *ctx);
+  void (*scene_finish)(void *ctx);
+  uint32_t (*frames_done)(void *ctx);  // scenes fully rendered, counting up
+  uint64_t (*now_us)(void *ctx);
+  void (*idle)(void *ctx);             // nothing to do but wait for the PVR
+  void *ctx;
+} framesched_backend_t;
+
+#ifdef _arch_dreamcast
+/* pvr_wait_ready(), pvr_scene_*(), pvr_get_stats() frame_count, timer_us,
+   thd_pass() */
+extern const framesched_backend_t framesched_backend_pvr;
+#endif
+
+/* Copies of one dynamic texture; slots are whatever the caller uses */
+typedef struct {
+  int count;                            // copies, at most FRAMESCHED_MAX_SLOTS
+  int current;                          // the copy scenes read, -1 for none yet
+  uint32_t fence[FRAMESCHED_MAX_SLOTS]; // last frame that read each copy, 0 never
+  void *slot[FRAMESCHED_MAX_SLOTS];
+} framesched_ring_t;
+
+typedef struct {
+  uint32_t frames;
+  uint64_t busy_us;         // CPU time in frames outside the waits
+  uint64_t ready_wait_us;   // in framesched_begin() waiting for the PVR
+  uint64_t fence_wait_us;   // waiting for a texture the PVR was reading
+  uint32_t fence_waits;
+} framesched_stats_t;
+
+typedef struct framesched framesched_t;
+
+/**
+ * @brief Create a scheduler
+ *
+ * @param backend PVR backend, copied
+ * @param trace_events Events kept for the timeline, 0 for no trace
+ * @return framesched_t* NULL on failure
+ */
+framesched_t *framesched_create(const framesched_backend_t *backend, int trace_events);
+void framesched_destroy(framesched_t *fs);
+
+/**
+ * @brief Wait for the PVR to take a scene and begin it
+ *
+ * Also starts the "build" phase.
+ *
+ * @return uint32_t The new frame's number, from 1
+ */
+uint32_t framesched_begin(framesched_t *fs);
+
+/* Finish the scene; the frame is now in flight */
+void framesched_submit(framesched_t *fs);
+
+/* Start a named CPU phase, ending the one before; what must stay valid */
+void framesched_phase(framesched_t *fs, const char *what);
+
+/* Has the PVR finished rendering frame? */
+int framesched_done(framesched_t *fs, uint32_t frame);
+
+/* Until it has */
+void framesched_wait(framesched_t *fs, uint32_t frame);
+
+/**
+ * @brief The copy the scene being built should read
+ *
+ * Fences it with the current frame. NULL until something is published.
+ */
+void *framesched_ring_use(framesched_t *fs, framesched_ring_t *r);
+
+/**
+ * @brief A copy that no frame in flight reads, to write the next version to
+ *
+ * Never the current copy. Waits for the oldest fence when every other copy
+ * is still being read.
+ *
+ * @return int Slot index
+ */
+int framesched_ring_acquire(framesched_t *fs, framesched_ring_t *r);
+
+/* Scenes from now on read slot */
+void framesched_ring_publish(framesched_ring_t *r, int slot);
+
+void framesched_get_stats(framesched_t *fs, framesched_stats_t *out);
+void framesched_reset_stats(framesched_t *fs);
+
+/**
+ * @brief Draw the last frames of the trace as CPU and PVR lanes
+ *
+ * @param frames How many frames back
+ * @param us_per_char Time per column
+ */
+void framesched_trace_print(framesched_t *fs, FILE *out, int frames, int us_per_char);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // FRAMESCHED_H
@@ -0,0 +1,602 @@
+/********************************************************************************************/
+/* Name:     iosched.c                                                                      */
+/* Title:    Read-ahead I/O scheduler for ADX streaming                                     */
+/* Platform: Dreamcast | KallistiOS:2.0 | host (simulation)                                 */
+/*                                                                                          */
+/* Description: Keeps audio ring buffers between watermarks and splits bulk reads into      */
+/* chunks so texture loads on the same drive cannot starve the ADX decoder. See iosched.h.  */
+/********************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iosched.h"
+
+#ifdef _arch_dreamcast
+#include <kos/fs.h>
+#include <kos/mutex.h>
+#include <kos/cond.h>
+#include <kos/thread.h>
+#include <malloc.h>
+typedef mutex_t ios_lock_t;
+typedef condvar_t ios_cond_t;
+#define ios_lock_init(l)    mutex_init(l, MUTEX_TYPE_NORMAL)
+#define ios_lock_destroy(l) mutex_destroy(l)
+#define ios_lock(l)         mutex_lock(l)
+#define ios_unlock(l)       mutex_unlock(l)
+#define ios_cond_init(c)    cond_init(c)
+#define ios_cond_destroy(c) cond_destroy(c)
+#define ios_cond_wait(c, l) cond_wait(c, l)
+#define ios_cond_wait_ms(c, l, ms) cond_wait_timed(c, l, ms)
+#define ios_cond_wake(c)    cond_broadcast(c)
+#else
+#include <pthread.h>
+typedef pthread_mutex_t ios_lock_t;
+typedef pthread_cond_t ios_cond_t;
+#define ios_lock_init(l)    pthread_mutex_init(l, NULL)
+#define ios_lock_destroy(l) pthread_mutex_destroy(l)
+#define ios_lock(l)         pthread_mutex_lock(l)
+#define ios_unlock(l)       pthread_mutex_unlock(l)
+#define ios_cond_init(c)    pthread_cond_init(c, NULL)
+#define ios_cond_destroy(c) pthread_cond_destroy(c)
+#define ios_cond_wait(c, l) pthread_cond_wait(c, l)
+#define ios_cond_wake(c)    pthread_cond_broadcast(c)
+#endif
+
+struct iosched_stream {
+  iosched_t *s;
+  void *fh;
+  uint8_t *ring;
+  int head;            // next byte the I/O thread writes
+  int tail;            // next byte the consumer reads
+  int fill;
+  off_t file_pos;      // file offset of ring[head]
+  off_t read_pos;      // file offset of ring[tail]
+  off_t total;
+  int eof;
+  int need_seek;
+  int busy;            // a backend read into the ring is in flight
+  int urgent;          // fell below low_wm, refill to high_wm before bulk runs
+  unsigned gen;        // bumped by seek, stale reads are dropped
+  int closing;         // no new reads, close is waiting for busy
+  int used;
+};
+
+struct iosched {
+  iosched_backend_t be;
+  iosched_config_t cfg;
+  ios_lock_t lock;
+  ios_cond_t data_cv;  // consumers and bulk waiters
+  ios_cond_t work_cv;  // the I/O thread
+  iosched_stream_t streams[IOSCHED_MAX_STREAMS];
+  iosched_req_t *bulk_head;
+  iosched_req_t *bulk_tail;
+  iosched_stats_t stats;
+  volatile int quit;
+#ifdef _arch_dreamcast
+  kthread_t *thread;
+#endif
+};
+
+/* Backend over the platform file API --------------------------------------- */
+
+#ifdef _arch_dreamcast
+/* file_t 0 is a valid handle, store it off by one so NULL means failure */
+static void *fs_be_open(void *ctx, const char *path) {
+  file_t f = fs_open(path, O_RDONLY);
+  (void)ctx;
+  return f == FILEHND_INVALID ? NULL : (void *)(intptr_t)(f + 1);
+}
+static ssize_t fs_be_read(void *ctx, void *fh, void *buf, size_t len) {
+  (void)ctx;
+  return fs_read((file_t)(intptr_t)fh - 1, buf, len);
+}
+static off_t fs_be_seek(void *ctx, void *fh, off_t offset) {
+  (void)ctx;
+  return fs_seek((file_t)(intptr_t)fh - 1, offset, SEEK_SET);
+}
+static off_t fs_be_total(void *ctx, void *fh) {
+  (void)ctx;
+  return fs_total((file_t)(intptr_t)fh - 1);
+}
+static void fs_be_close(void *ctx, void *fh) {
+  (void)ctx;
+  fs_close((file_t)(intptr_t)fh - 1);
+}
+#else
+static void *fs_be_open(void *ctx, const char *path) {
+  (void)ctx;
+  return fopen(path, "rb");
+}
+static ssize_t fs_be_read(void *ctx, void *fh, void *buf, size_t len) {
+  (void)ctx;
+  return fread(buf, 1, len, (FILE *)fh);
+}
+static off_t fs_be_seek(void *ctx, void *fh, off_t offset) {
+  (void)ctx;
+  return fseek((FILE *)fh, offset, SEEK_SET) == 0 ? offset : -1;
+}
+static off_t fs_be_total(void *ctx, void *fh) {
+  long here = ftell((FILE *)fh), end;
+  (void)ctx;
+  fseek((FILE *)fh, 0, SEEK_END);
+  end = ftell((FILE *)fh);
+  fseek((FILE *)fh, here, SEEK_SET);
+  return end;
+}
+static void fs_be_close(void *ctx, void *fh) {
+  (void)ctx;
+  fclose((FILE *)fh);
+}
+#endif
+
+const iosched_backend_t iosched_backend_fs = {
+  fs_be_open, fs_be_read, fs_be_seek, fs_be_total, fs_be_close, NULL
+};
+
+/* Scheduler ---------------------------------------------------------------- */
+
+iosched_t *iosched_create(const iosched_backend_t *backend, const iosched_config_t *cfg) {
+  iosched_t *s = calloc(1, sizeof(iosched_t));
+  if (s == NULL) {
+    printf("Error: iosched_create out of memory\n");
+    return NULL;
+  }
+  s->be = *backend;
+  if (cfg) {
+    s->cfg = *cfg;
+  } else {
+    s->cfg.ring_size = IOSCHED_DEFAULT_RING;
+    s->cfg.low_wm = IOSCHED_DEFAULT_LOW_WM;
+    s->cfg.high_wm = IOSCHED_DEFAULT_HIGH_WM;
+    s->cfg.chunk = IOSCHED_DEFAULT_CHUNK;
+  }
+  if (s->cfg.high_wm > s->cfg.ring_size)
+    s->cfg.high_wm = s->cfg.ring_size;
+  if (s->cfg.low_wm > s->cfg.high_wm)
+    s->cfg.low_wm = s->cfg.high_wm;
+
+  ios_lock_init(&s->lock);
+  ios_cond_init(&s->data_cv);
+  ios_cond_init(&s->work_cv);
+  iosched_reset_stats(s);
+  return s;
+}
+
+void iosched_destroy(iosched_t *s) {
+  int i;
+
+  ios_lock(&s->lock);
+  s->quit = 1;
+  ios_cond_wake(&s->work_cv);
+  ios_cond_wake(&s->data_cv);
+  ios_unlock(&s->lock);
+#ifdef _arch_dreamcast
+  if (s->thread)
+    thd_join(s->thread, NULL);
+#endif
+  for (i = 0; i < IOSCHED_MAX_STREAMS; i++)
+    if (s->streams[i].used)
+      iosched_stream_close(&s->streams[i]);
+
+  ios_cond_destroy(&s->work_cv);
+  ios_cond_destroy(&s->data_cv);
+  ios_lock_destroy(&s->lock);
+  free(s);
+}
+
+/* Stream to refill next: urgent ones first, then the emptiest. Caller holds
+   the lock. */
+static iosched_stream_t *neediest_stream(iosched_t *s) {
+  iosched_stream_t *best = NULL;
+  int i;
+
+  for (i = 0; i < IOSCHED_MAX_STREAMS; i++) {
+    iosched_stream_t *st = &s->streams[i];
+    if (!st->used || st->closing || st->eof || st->busy || st->fill >= s->cfg.high_wm)
+      continue;
+    if (st->fill < s->cfg.low_wm)
+      st->urgent = 1;
+    if (best == NULL || st->urgent > best->urgent ||
+        (st->urgent == best->urgent && st->fill < best->fill))
+      best = st;
+  }
+  return best;
+}
+
+static void pump_audio(iosched_t *s, iosched_stream_t *st) {
+  int len, do_seek;
+  off_t pos;
+  uint8_t *dst;
+  ssize_t n;
+  unsigned gen;
+
+  len = s->cfg.chunk;
+  if (len > s->cfg.ring_size - st->fill)
+    len = s->cfg.ring_size - st->fill;
+  if (len > s->cfg.ring_size - st->head)
+    len = s->cfg.ring_size - st->head;
+  dst = st->ring + st->head;
+  do_seek = st->need_seek;
+  pos = st->file_pos;
+  gen = st->gen;
+  st->need_seek = 0;
+  st->busy = 1;
+  ios_unlock(&s->lock);
+
+  // Only this thread writes ring[head..], the consumer never looks past fill
+  if (do_seek)
+    s->be.seek(s->be.ctx, st->fh, pos);
+  n = s->be.read(s->be.ctx, st->fh, dst, len);
+
+  ios_lock(&s->lock);
+  st->busy = 0;
+  if (gen == st->gen) {
+    if (n <= 0) {
+      st->eof = 1;
+      st->urgent = 0;
+    } else {
+      st->head = (st->head + n) % s->cfg.ring_size;
+      st->fill += n;
+      st->file_pos += n;
+      // The last chunk ends the file, don't wait for a read of 0 to say so
+      if (st->file_pos >= st->total)
+        st->eof = 1;
+      if (st->fill >= s->cfg.high_wm || st->eof)
+        st->urgent = 0;
+      s->stats.audio_reads++;
+      s->stats.audio_bytes += n;
+    }
+  }
+  ios_cond_wake(&s->data_cv);
+}
+
+static void pump_bulk(iosched_t *s, iosched_req_t *req) {
+  size_t len = req->len - req->done;
+  ssize_t n;
+
+  if (len > (size_t)s->cfg.chunk)
+    len = s->cfg.chunk;
+  ios_unlock(&s->lock);
+
+  s->be.seek(s->be.ctx, req->fh, req->offset + req->done);
+  n = s->be.read(s->be.ctx, req->fh, req->dst + req->done, len);
+
+  ios_lock(&s->lock);
+  if (n > 0) {
+    req->done += n;
+    s->stats.bulk_reads++;
+    s->stats.bulk_bytes += n;
+  }
+  if (n <= 0 || req->done == req->len) {
+    s->bulk_head = req->next;
+    if (s->bulk_head == NULL)
+      s->bulk_tail = NULL;
+    req->status = n <= 0 ? IOSCHED_REQ_ERROR : IOSCHED_REQ_DONE;
+  }
+  ios_cond_wake(&s->data_cv);
+}
+
+int iosched_pump(iosched_t *s) {
+  iosched_stream_t *st;
+  iosched_req_t *req;
+  int did = 1;
+
+  ios_lock(&s->lock);
+  st = neediest_stream(s);
+  req = s->bulk_head;
+  if (st && st->urgent) {
+    // Audio ran low, bulk reads wait until it is back at high_wm. Refilling
+    // all the way keeps the drive from seeking back and forth every chunk.
+    if (req)
+      s->stats.bulk_preempted++;
+    pump_audio(s, st);
+  } else if (req) {
+    pump_bulk(s, req);
+  } else if (st) {
+    pump_audio(s, st);
+  } else {
+    did = 0;
+  }
+  ios_unlock(&s->lock);
+  return did;
+}
+
+/* Audio streams ------------------------------------------------------------ */
+
+iosched_stream_t *iosched_stream_open(iosched_t *s, const char *path) {
+  iosched_stream_t *st = NULL;
+  void *fh;
+  uint8_t *ring;
+  int i;
+
+  fh = s->be.open(s->be.ctx, path);
+  if (fh == NULL) {
+    printf("Error: iosched can't open %s\n", path);
+    return NULL;
+  }
+  ring = malloc(s->cfg.ring_size);
+  if (ring == NULL) {
+    printf("Error: iosched ring out of memory\n");
+    s->be.close(s->be.ctx, fh);
+    return NULL;
+  }
+
+  ios_lock(&s->lock);
+  for (i = 0; i < IOSCHED_MAX_STREAMS; i++) {
+    if (!s->streams[i].used) {
+      st = &s->streams[i];
+      memset(st, 0, sizeof(*st));
+      st->s = s;
+      st->fh = fh;
+      st->ring = ring;
+      st->total = s->be.total(s->be.ctx, fh);
+      st->used = 1;
+      break;
+    }
+  }
+  ios_cond_wake(&s->work_cv);
+  ios_unlock(&s->lock);
+
+  if (st == NULL) {
+    printf("Error: iosched has no free stream for %s\n", path);
+    free(ring);
+    s->be.close(s->be.ctx, fh);
+  }
+  return st;
+}
+
+void iosched_stream_close(iosched_stream_t *st) {
+  iosched_t *s = st->s;
+  void *fh;
+  uint8_t *ring;
+
+  // The slot stays used until the I/O thread is out of it, so a stream
+  // opened meanwhile can't be handed the fh and ring closed below
+  ios_lock(&s->lock);
+  st->closing = 1;
+  while (st->busy)
+    ios_cond_wait(&s->data_cv, &s->lock);
+  fh = st->fh;
+  ring = st->ring;
+  st->fh = NULL;
+  st->ring = NULL;
+  st->used = 0;
+  ios_unlock(&s->lock);
+  s->be.close(s->be.ctx, fh);
+  free(ring);
+}
+
+ssize_t iosched_stream_read(iosched_stream_t *st, void *buf, size_t len, int block) {
+  iosched_t *s = st->s;
+  size_t n, first, want;
+
+  ios_lock(&s->lock);
+  // Asking past the end of the file only wants what is left of it
+  want = len;
+  if (st->total - st->read_pos < (off_t)want)
+    want = st->total > st->read_pos ? (size_t)(st->total - st->read_pos) : 0;
+  if ((size_t)st->fill < want && !st->eof) {
+    s->stats.underruns++;
+    s->stats.underrun_bytes += want - st->fill;
+    ios_cond_wake(&s->work_cv);
+    while (block && (size_t)st->fill < want && !st->eof && !s->quit)
+      ios_cond_wait(&s->data_cv, &s->lock);
+  }
+
+  n = len < (size_t)st->fill ? len : (size_t)st->fill;
+  first = s->cfg.ring_size - st->tail;
+  if (first > n)
+    first = n;
+  memcpy(buf, st->ring + st->tail, first);
+  memcpy((uint8_t *)buf + first, st->ring, n - first);
+  st->tail = (st->tail + n) % s->cfg.ring_size;
+  st->fill -= n;
+  st->read_pos += n;
+
+  if (!st->eof && st->fill < s->stats.fill_min)
+    s->stats.fill_min = st->fill;
+  if (st->fill < s->cfg.low_wm)
+    ios_cond_wake(&s->work_cv);
+  ios_unlock(&s->lock);
+  return n;
+}
+
+off_t iosched_stream_seek(iosched_stream_t *st, off_t offset) {
+  iosched_t *s = st->s;
+
+  if (offset < 0)
+    offset = 0;
+  if (offset > st->total)
+    offset = st->total;
+  ios_lock(&s->lock);
+  st->gen++;
+  st->head = st->tail = st->fill = 0;
+  st->file_pos = st->read_pos = offset;
+  st->eof = 0;
+  st->need_seek = 1;
+  ios_cond_wake(&s->work_cv);
+  ios_unlock(&s->lock);
+  return offset;
+}
+
+off_t iosched_stream_tell(iosched_stream_t *st) {
+  return st->read_pos;
+}
+
+off_t iosched_stream_total(iosched_stream_t *st) {
+  return st->total;
+}
+
+/* Bulk reads --------------------------------------------------------------- */
+
+void iosched_submit(iosched_t *s, iosched_req_t *req) {
+  req->done = 0;
+  req->status = IOSCHED_REQ_PENDING;
+  req->next = NULL;
+
+  ios_lock(&s->lock);
+  if (s->bulk_tail)
+    s->bulk_tail->next = req;
+  else
+    s->bulk_head = req;
+  s->bulk_tail = req;
+  ios_cond_wake(&s->work_cv);
+  ios_unlock(&s->lock);
+}
+
+int iosched_wait(iosched_t *s, iosched_req_t *req) {
+  ios_lock(&s->lock);
+  while (req->status == IOSCHED_REQ_PENDING && !s->quit)
+    ios_cond_wait(&s->data_cv, &s->lock);
+  ios_unlock(&s->lock);
+  return req->status == IOSCHED_REQ_DONE;
+}
+
+/* Telemetry ---------------------------------------------------------------- */
+
+void iosched_get_stats(iosched_t *s, iosched_stats_t *out) {
+  int i;
+
+  ios_lock(&s->lock);
+  *out = s->stats;
+  out->fill = s->cfg.ring_size;
+  for (i = 0; i < IOSCHED_MAX_STREAMS; i++) {
+    iosched_stream_t *st = &s->streams[i];
+    if (st->used && !st->eof && st->fill < out->fill)
+      out->fill = st->fill;
+  }
+  ios_unlock(&s->lock);
+}
+
+void iosched_reset_stats(iosched_t *s) {
+  memset(&s->stats, 0, sizeof(s->stats));
+  s->stats.size = s->cfg.ring_size;
+  s->stats.fill_min = s->cfg.ring_size;
+}
+
+/* Dreamcast: I/O thread and the /ios VFS ----------------------------------- */
+
+#ifdef _arch_dreamcast
+static void *iosched_thread(void *param) {
+  iosched_t *s = (iosched_t *)param;
+
+  while (!s->quit) {
+    if (!iosched_pump(s)) {
+      ios_lock(&s->lock);
+      if (!s->quit)
+        ios_cond_wait_ms(&s->work_cv, &s->lock, 20);
+      ios_unlock(&s->lock);
+    }
+  }
+  return NULL;
+}
+
+int iosched_start(iosched_t *s, int prio) {
+  s->thread = thd_create(0, iosched_thread, s);
+  if (s->thread == NULL) {
+    printf("Error: iosched thread create failed\n");
+    return 0;
+  }
+  thd_set_prio(s->thread, prio);
+  return 1;
+}
+
+void *iosched_load(iosched_t *s, const char *path, size_t align, size_t *size) {
+  iosched_req_t req;
+  off_t total;
+  int ok;
+
+  memset(&req, 0, sizeof(req));
+  req.fh = s->be.open(s->be.ctx, path);
+  if (req.fh == NULL) {
+    printf("Error: can't open %s\n", path);
+    return NULL;
+  }
+  total = s->be.total(s->be.ctx, req.fh);
+  req.len = total > 0 ? (size_t)total : 0;
+  req.dst = req.len ? memalign(align, req.len) : NULL;
+  if (req.dst == NULL) {
+    printf("Error: can't load %s\n", path);
+    s->be.close(s->be.ctx, req.fh);
+    free(req.dst);
+    return NULL;
+  }
+  iosched_submit(s, &req);
+  ok = iosched_wait(s, &req);
+  s->be.close(s->be.ctx, req.fh);
+  if (!ok) {
+    printf("Error: reading %s failed\n", path);
+    free(req.dst);
+    return NULL;
+  }
+  *size = req.len;
+  return req.dst;
+}
+
+static iosched_t *vfs_sched;
+
+static void *ios_vfs_open(vfs_handler_t *vfs, const char *fn, int mode) {
+  (void)vfs;
+  if ((mode & O_MODE_MASK) != O_RDONLY || (mode & O_DIR))
+    return NULL;
+  return iosched_stream_open(vfs_sched, fn);
+}
+
+static int ios_vfs_close(void *hnd) {
+  iosched_stream_close((iosched_stream_t *)hnd);
+  return 0;
+}
+
+static ssize_t ios_vfs_read(void *hnd, void *buf, size_t cnt) {
+  return iosched_stream_read((iosched_stream_t *)hnd, buf, cnt, 1);
+}
+
+static off_t ios_vfs_seek(void *hnd, off_t offset, int whence) {
+  iosched_stream_t *st = (iosched_stream_t *)hnd;
+
+  if (whence == SEEK_CUR)
+    offset += iosched_stream_tell(st);
+  else if (whence == SEEK_END)
+    offset += iosched_stream_total(st);
+  return iosched_stream_seek(st, offset);
+}
+
+static off_t ios_vfs_tell(void *hnd) {
+  return iosched_stream_tell((iosched_stream_t *)hnd);
+}
+
+static size_t ios_vfs_total(void *hnd) {
+  return iosched_stream_total((iosched_stream_t *)hnd);
+}
+
+static vfs_handler_t ios_vfs = {
+  .nmmgr = {
+    .pathname = "/ios",
+    .pid = 0,
+    .version = 0x00010000,
+    .flags = 0,
+    .type = NMMGR_TYPE_VFS,
+    .list_ent = NMMGR_LIST_INIT,
+  },
+  .open = ios_vfs_open,
+  .close = ios_vfs_close,
+  .read = ios_vfs_read,
+  .seek = ios_vfs_seek,
+  .tell = ios_vfs_tell,
+  .total = ios_vfs_total,
+};
+
+int iosched_vfs_init(iosched_t *s) {
+  vfs_sched = s;
+  if (nmmgr_handler_add(&ios_vfs.nmmgr) < 0) {
+    printf("Error: can't mount /ios\n");
+    return 0;
+  }
+  return 1;
+}
+
+void iosched_vfs_shutdown(void) {
+  nmmgr_handler_remove(&ios_vfs.nmmgr);
+  vfs_sched = NULL;
+}
+#endif
@@ -0,0 +1,174 @@
+#ifndef IOSCHED_H
+#define IOSCHED_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**  Read-ahead I/O scheduler for streaming audio from a slow drive.
+
+     Every audio stream owns a ring buffer that a single I/O thread keeps
+     topped up between a low and a high watermark. Bulk reads (textures,
+     level data) are queued and split into chunk sized backend reads, so a
+     big load can never hold the drive for longer than one chunk. Once an
+     audio ring drops below its low watermark the scheduler serves only that
+     stream until it is back at the high watermark, bulk reads wait.
+
+     The core is a plain state machine driven by iosched_pump(), the
+     backend is a table of function pointers. On the Dreamcast
+     iosched_start() runs the pump in a KOS thread over fs_*() and
+     iosched_vfs_init() mounts /ios so LibADX can stream through it. On the
+     host tools/iosim.c drives the pump against a simulated slow drive.     */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOSCHED_MAX_STREAMS 4
+
+/* Defaults, a 44.1kHz stereo ADX stream is ~50KB/s so the ring holds about
+   2.5 s and audio takes over once less than 0.6 s is left */
+#define IOSCHED_DEFAULT_RING    (128 * 1024)
+#define IOSCHED_DEFAULT_LOW_WM  (IOSCHED_DEFAULT_RING / 4)
+#define IOSCHED_DEFAULT_HIGH_WM (IOSCHED_DEFAULT_RING - IOSCHED_DEFAULT_CHUNK)
+#define IOSCHED_DEFAULT_CHUNK   (32 * 1024)
+
+/* Bulk request status */
+#define IOSCHED_REQ_PENDING 0
+#define IOSCHED_REQ_DONE    1
+#define IOSCHED_REQ_ERROR   2
+
+typedef struct iosched_backend {
+  void *(*open)(void *ctx, const char *path);
+  ssize_t (*read)(void *ctx, void *fh, void *buf, size_t len);
+  off_t (*seek)(void *ctx, void *fh, off_t offset);   // absolute
+  off_t (*total)(void *ctx, void *fh);
+  void (*close)(void *ctx, void *fh);
+  void *ctx;
+} iosched_backend_t;
+
+/* fs_*() on the Dreamcast, stdio on the host */
+extern const iosched_backend_t iosched_backend_fs;
+
+typedef struct {
+  int ring_size;  // bytes of read-ahead per audio stream
+  int low_wm;     // below this audio preempts bulk reads
+  int high_wm;    // audio refills stop here
+  int chunk;      // largest single backend read
+} iosched_config_t;
+
+typedef struct {
+  uint32_t underruns;       // consumer reads that found the ring short
+  uint32_t underrun_bytes;  // bytes missing at those reads
+  uint32_t audio_reads;
+  uint32_t audio_bytes;
+  uint32_t bulk_reads;
+  uint32_t bulk_bytes;
+  uint32_t bulk_preempted;  // pumps where a queued bulk read waited for audio
+  int fill;                 // current fill of the emptiest stream
+  int fill_min;             // lowest fill seen since the last reset
+  int size;                 // ring size
+} iosched_stats_t;
+
+typedef struct iosched_req {
+  void *fh;                  // backend handle, opened by the caller
+  off_t offset;
+  uint8_t *dst;
+  size_t len;
+  size_t done;
+  volatile int status;       // IOSCHED_REQ_*
+  struct iosched_req *next;
+} iosched_req_t;
+
+typedef struct iosched iosched_t;
+typedef struct iosched_stream iosched_stream_t;
+
+/**
+ * @brief Create a scheduler
+ *
+ * @param backend File backend, copied
+ * @param cfg Ring and watermark sizes, NULL for the defaults
+ * @return iosched_t* NULL on failure
+ */
+iosched_t *iosched_create(const iosched_backend_t *backend, const iosched_config_t *cfg);
+void iosched_destroy(iosched_t *s);
+
+/**
+ * @brief Do one unit of I/O: one chunk for the neediest audio stream or
+ * the head bulk request
+ *
+ * @return int 1 if a read was issued, 0 if there was nothing to do
+ */
+int iosched_pump(iosched_t *s);
+
+/* Audio streams ------------------------------------------------------------ */
+
+iosched_stream_t *iosched_stream_open(iosched_t *s, const char *path);
+void iosched_stream_close(iosched_stream_t *st);
+
+/**
+ * @brief Copy buffered bytes out of a stream's ring
+ *
+ * A read that finds fewer than len bytes buffered, or fewer than are left
+ * in the file when that is less, counts as an underrun. With block set it
+ * then waits for the I/O thread, otherwise it returns what was there.
+ *
+ * @return ssize_t bytes copied, 0 at end of file
+ */
+ssize_t iosched_stream_read(iosched_stream_t *st, void *buf, size_t len, int block);
+
+/**
+ * @brief Reposition a stream, drops everything buffered
+ */
+off_t iosched_stream_seek(iosched_stream_t *st, off_t offset);
+off_t iosched_stream_tell(iosched_stream_t *st);
+off_t iosched_stream_total(iosched_stream_t *st);
+
+/* Bulk reads --------------------------------------------------------------- */
+
+void iosched_submit(iosched_t *s, iosched_req_t *req);
+
+/**
+ * @brief Block until a submitted request has finished
+ *
+ * Needs the I/O thread, on the host poll req->status instead.
+ *
+ * @return int 1 if all bytes were read, 0 on error
+ */
+int iosched_wait(iosched_t *s, iosched_req_t *req);
+
+/* Telemetry ---------------------------------------------------------------- */
+
+void iosched_get_stats(iosched_t *s, iosched_stats_t *out);
+void iosched_reset_stats(iosched_t *s);
+
+#ifdef _arch_dreamcast
+/**
+ * @brief Run iosched_pump() in its own thread until iosched_destroy()
+ */
+int iosched_start(iosched_t *s, int prio);
+
+/**
+ * @brief Read a whole file through the bulk queue, blocking
+ *
+ * One request for the file behind whatever bulk reads are queued, split
+ * into chunks that give way to any audio stream running low. Needs the
+ * I/O thread.
+ *
+ * @param align Alignment of the returned buffer
+ * @param size Set to the file size
+ * @return void* memalign()ed contents, for free(), NULL on failure
+ */
+void *iosched_load(iosched_t *s, const char *path, size_t align, size_t *size);
+
+/**
+ * @brief Mount /ios, "/ios/cd/sample.adx" streams /cd/sample.adx through s
+ */
+int iosched_vfs_init(iosched_t *s);
+void iosched_vfs_shutdown(void);
+#endif
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // IOSCHED_H
@@ -0,0 +1,171 @@
+/********************************************************************************************/
+/* Name:     pcmring.c                                                                      */
+/* Title:    Chunked PCM ring buffer for the AICA stream                                    */
+/* Platform: Dreamcast | KallistiOS:2.0 | host (simulation)                                 */
+/*                                                                                          */
+/* Description: Replaces the fixed 320KB snddrv pcm_buffer with a ring sized from a         */
+/* latency in milliseconds. Single producer, single consumer, no lock. See pcmring.h.       */
+/********************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pcmring.h"
+
+#ifdef _arch_dreamcast
+#include <malloc.h>
+#define pcm_alloc(n) memalign(32, n)
+#else
+#define pcm_alloc(n) malloc(n)
+#endif
+
+/* Keep the compiler from moving buffer accesses across a counter update.
+   The SH4 is single core, on the host the simulation is single threaded. */
+#define pcm_barrier() __asm__ __volatile__("" ::: "memory")
+
+int pcmring_init(pcmring_t *r, int rate, int channels, int capacity_ms, int chunk_frames) {
+  int chunks;
+
+  memset(r, 0, sizeof(*r));
+  if (chunk_frames <= 0)
+    chunk_frames = PCMRING_DEFAULT_CHUNK;
+  chunks = (int)(((int64_t)rate * capacity_ms / 1000 + chunk_frames - 1) / chunk_frames);
+  if (chunks < 2)
+    chunks = 2;
+
+  r->rate = rate;
+  r->channels = channels;
+  r->chunk_frames = chunk_frames;
+  r->frames = chunks * chunk_frames;
+  r->buf = pcm_alloc(pcmring_bytes(r));
+  if (r->buf == NULL) {
+    printf("Error: pcmring out of memory (%d bytes)\n", pcmring_bytes(r));
+    return 0;
+  }
+  memset(r->buf, 0, pcmring_bytes(r));
+  pcmring_reset_stats(r);
+  return 1;
+}
+
+void pcmring_free(pcmring_t *r) {
+  free(r->buf);
+  r->buf = NULL;
+}
+
+int16_t *pcmring_reserve(pcmring_t *r, int *frames) {
+  int pos = r->wr_pos;
+  int n = pcmring_space(r);
+
+  if (n > r->frames - pos)
+    n = r->frames - pos;
+  if (n > *frames)
+    n = *frames;
+  *frames = n;
+  return r->buf + pos * r->channels;
+}
+
+void pcmring_commit(pcmring_t *r, int frames) {
+  r->wr_pos += frames;
+  if (r->wr_pos >= r->frames)
+    r->wr_pos -= r->frames;
+  pcm_barrier();
+  r->wr += frames;
+}
+
+int pcmring_write(pcmring_t *r, const int16_t *pcm, int frames) {
+  int done = 0;
+
+  while (done < frames) {
+    int n = frames - done;
+    int16_t *dst = pcmring_reserve(r, &n);
+    if (n == 0)
+      break;
+    memcpy(dst, pcm + done * r->channels, n * r->channels * sizeof(int16_t));
+    pcmring_commit(r, n);
+    done += n;
+  }
+  return done;
+}
+
+int pcmring_read(pcmring_t *r, int16_t *dst, int frames) {
+  int fill = pcmring_fill(r);
+  int n = fill < frames ? fill : frames;
+  int pos = r->rd_pos;
+  int first = r->frames - pos;
+
+  if (fill < r->fill_min)
+    r->fill_min = fill;
+  if (first > n)
+    first = n;
+  pcm_barrier();
+  memcpy(dst, r->buf + pos * r->channels, first * r->channels * sizeof(int16_t));
+  memcpy(dst + first * r->channels, r->buf, (n - first) * r->channels * sizeof(int16_t));
+  if (n < frames) {
+    memset(dst + n * r->channels, 0, (frames - n) * r->channels * sizeof(int16_t));
+    r->underruns++;
+    r->underrun_frames += frames - n;
+  }
+  r->rd_pos = pos + n < r->frames ? pos + n : pos + n - r->frames;
+  pcm_barrier();
+  r->rd += n;
+  return n;
+}
+
+int pcmring_read_chunk(pcmring_t *r, int16_t *dst) {
+  return pcmring_read(r, dst, r->chunk_frames);
+}
+
+void pcmring_reset_stats(pcmring_t *r) {
+  r->underruns = 0;
+  r->underrun_frames = 0;
+  r->fill_min = r->frames;
+}
+
+#ifdef _arch_dreamcast
+/* KOS has at most four streams, the callback only gets the handle */
+#define PCMRING_MAX_STREAMS 4
+static pcmring_t *stream_ring[PCMRING_MAX_STREAMS];
+static int16_t *stream_chunk[PCMRING_MAX_STREAMS];
+
+static void *pcmring_stream_cb(snd_stream_hnd_t hnd, int smp_req, int *smp_recv) {
+  pcmring_t *r = stream_ring[hnd];
+  int frame_bytes = r->channels * sizeof(int16_t);
+  int frames = smp_req / frame_bytes;
+
+  // The driver asks in bytes, normally one chunk, never more than alloc'd
+  if (frames > r->chunk_frames)
+    frames = r->chunk_frames;
+  pcmring_read(r, stream_chunk[hnd], frames);
+  *smp_recv = frames * frame_bytes;
+  return stream_chunk[hnd];
+}
+
+snd_stream_hnd_t pcmring_stream_alloc(pcmring_t *r) {
+  int bytes = r->chunk_frames * r->channels * sizeof(int16_t);
+  snd_stream_hnd_t hnd = snd_stream_alloc(pcmring_stream_cb, bytes);
+
+  if (hnd == SND_STREAM_INVALID) {
+    printf("Error: pcmring snd_stream_alloc failed\n");
+    return SND_STREAM_INVALID;
+  }
+  if (hnd >= PCMRING_MAX_STREAMS) {
+    printf("Error: pcmring has no slot for stream %d\n", (int)hnd);
+    snd_stream_destroy(hnd);
+    return SND_STREAM_INVALID;
+  }
+  stream_chunk[hnd] = pcm_alloc(bytes);
+  if (stream_chunk[hnd] == NULL) {
+    printf("Error: pcmring out of memory\n");
+    snd_stream_destroy(hnd);
+    return SND_STREAM_INVALID;
+  }
+  stream_ring[hnd] = r;
+  return hnd;
+}
+
+void pcmring_stream_destroy(snd_stream_hnd_t hnd) {
+  snd_stream_destroy(hnd);
+  free(stream_chunk[hnd]);
+  stream_chunk[hnd] = NULL;
+  stream_ring[hnd] = NULL;
+}
+#endif
@@ -0,0 +1,115 @@
+#ifndef PCMRING_H
+#define PCMRING_H
+
+#include <stdint.h>
+
+/**  Chunked PCM ring between an audio decoder and the AICA stream.
+
+     LibADX's snddrv keeps a fixed unsigned int pcm_buffer[65536+16384]
+     (320KB) per driver whatever the stream format. This ring is sized from
+     a latency in milliseconds and the stream's rate and channel count, and
+     is drained in fixed chunks of interleaved 16 bit frames.
+
+     One producer (the decoder or mixer thread) and one consumer (the
+     snd_stream callback) share the ring without a lock: each side only
+     moves its own counter and position. The fill is the difference of the
+     free running counters, which stays right when they wrap. Underruns are filled with silence and counted.
+
+     tools/pcmsim measures underruns against capacity to pick the size.     */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frames handed to the AICA per callback, 512 stereo frames is 2KB */
+#define PCMRING_DEFAULT_CHUNK 512
+
+typedef struct {
+  int16_t *buf;
+  int frames;               // capacity in frames, a multiple of chunk_frames
+  int chunk_frames;
+  int channels;
+  int rate;
+  volatile uint32_t wr;     // frames written, only the producer moves it,
+                            // wraps after ~27 hours at 44.1kHz
+  volatile uint32_t rd;     // frames read, only the consumer moves it
+  int wr_pos;               // where wr is in buf, frames is not a power
+  int rd_pos;               // of two so wr % frames breaks when wr wraps
+  uint32_t underruns;       // chunks that were short
+  uint32_t underrun_frames; // silence frames inserted
+  int fill_min;             // lowest fill seen at a chunk boundary
+} pcmring_t;
+
+/**
+ * @brief Allocate a ring holding capacity_ms of audio
+ *
+ * The capacity is rounded up to whole chunks, at least two.
+ *
+ * @param r Ring to set up
+ * @param rate Sample rate in Hz
+ * @param channels 1 or 2
+ * @param capacity_ms Buffered audio in milliseconds
+ * @param chunk_frames Frames per AICA feed, 0 for PCMRING_DEFAULT_CHUNK
+ * @return int 1 on success, 0 on failure
+ */
+int pcmring_init(pcmring_t *r, int rate, int channels, int capacity_ms, int chunk_frames);
+void pcmring_free(pcmring_t *r);
+
+/* Ring memory in bytes */
+static inline int pcmring_bytes(const pcmring_t *r) {
+  return r->frames * r->channels * (int)sizeof(int16_t);
+}
+
+static inline int pcmring_fill(const pcmring_t *r) {
+  return (int)(r->wr - r->rd);
+}
+
+static inline int pcmring_space(const pcmring_t *r) {
+  return r->frames - pcmring_fill(r);
+}
+
+/**
+ * @brief Producer side: copy in up to frames interleaved frames
+ *
+ * @return int frames actually written, less than asked when full
+ */
+int pcmring_write(pcmring_t *r, const int16_t *pcm, int frames);
+
+/**
+ * @brief Producer side: reserve contiguous space to decode straight into
+ *
+ * Returns a pointer to at most *frames free frames (may be fewer at the
+ * wrap point); publish them with pcmring_commit().
+ */
+int16_t *pcmring_reserve(pcmring_t *r, int *frames);
+void pcmring_commit(pcmring_t *r, int frames);
+
+/**
+ * @brief Consumer side: take exactly one chunk, padding with silence
+ *
+ * @param dst chunk_frames * channels samples
+ * @return int frames that came from the ring
+ */
+int pcmring_read_chunk(pcmring_t *r, int16_t *dst);
+
+/* Same for an arbitrary frame count, used when the driver asks for less */
+int pcmring_read(pcmring_t *r, int16_t *dst, int frames);
+
+void pcmring_reset_stats(pcmring_t *r);
+
+#ifdef _arch_dreamcast
+#include <dc/sound/stream.h>
+/**
+ * @brief Allocate a KOS snd_stream that drains r one chunk per request
+ *
+ * The caller still owns snd_stream_start()/snd_stream_poll().
+ */
+snd_stream_hnd_t pcmring_stream_alloc(pcmring_t *r);
+void pcmring_stream_destroy(snd_stream_hnd_t hnd);
+#endif
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // PCMRING_H
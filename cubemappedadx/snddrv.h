@@ -74,7 +74,8 @@ struct snddrv {
        volatile int drv_status;
        volatile int dec_status;
        volatile int buf_status;
-       unsigned int pcm_buffer[65536+16384];
+       unsigned int pcm_buffer[65536+16384];    /* 320KB whatever the format,
+                                                   see pcmring.h for the sized ring */
        unsigned int *pcm_ptr;
 };
 extern struct snddrv snddrv;
@@ -0,0 +1,134 @@
+/********************************************************************************************/
+/* Name:     vcache.c                                                                       */
+/* Title:    Per frame transformed vertex cache                                             */
+/* Platform: Dreamcast | KallistiOS:2.0 | host (tools/host)                                 */
+/*                                                                                          */
+/* Description: Keys vertpipe output by mesh and matrix so later passes in the same frame   */
+/* skip the transform. See vcache.h.                                                        */
+/********************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "vcache.h"
+
+#ifdef _arch_dreamcast
+#include <malloc.h>
+#define entry_alloc() memalign(32, sizeof(vcache_entry_t))
+#else
+static void *entry_alloc(void) {
+  void *p;
+  return posix_memalign(&p, 32, sizeof(vcache_entry_t)) ? NULL : p;
+}
+#endif
+
+void vcache_init(vcache_t *c) {
+  memset(c, 0, sizeof(*c));
+  // Frame 0 is never current, so the zeroed entries start out stale
+  c->frame = 1;
+  vertpipe_default_view(&c->view);
+}
+
+void vcache_free(vcache_t *c) {
+  int i;
+
+  for (i = 0; i < VCACHE_ENTRIES; i++)
+    vertpipe_free(&c->e[i].pipe);
+  while (c->more) {
+    vcache_entry_t *e = c->more;
+    c->more = e->next;
+    vertpipe_free(&e->pipe);
+    free(e);
+  }
+  memset(c, 0, sizeof(*c));
+}
+
+void vcache_begin_frame(vcache_t *c) {
+  c->frame++;
+  if (c->frame == 0)
+    c->frame = 1;
+}
+
+/* An entry not handed out this frame. Evicting one that was would change
+   vertices a pass is still emitting, so once every entry is in use this
+   frame another one is added. */
+static vcache_entry_t *victim(vcache_t *c) {
+  vcache_entry_t *e;
+  int i;
+
+  for (i = 0; i < VCACHE_ENTRIES; i++)
+    if (c->e[i].frame != c->frame)
+      return &c->e[i];
+  for (e = c->more; e; e = e->next)
+    if (e->frame != c->frame)
+      return e;
+  e = entry_alloc();
+  if (e == NULL)
+    return NULL;
+  memset(e, 0, sizeof(*e));
+  e->next = c->more;
+  c->more = e;
+  c->stats.grown++;
+  return e;
+}
+
+static int matches(const vcache_t *c, const vcache_entry_t *e, const vecsoa3_t *pos, int n,
+                   const matrix_t *cur) {
+  return e->frame == c->frame && e->key == pos->x && e->n == n &&
+         !memcmp(&e->mat, cur, sizeof(matrix_t)) &&
+         !memcmp(&e->pipe.view, &c->view, sizeof(vertpipe_view_t));
+}
+
+static vcache_entry_t *find(vcache_t *c, const vecsoa3_t *pos, int n, const matrix_t *cur) {
+  vcache_entry_t *e;
+  int i;
+
+  for (i = 0; i < VCACHE_ENTRIES; i++)
+    if (matches(c, &c->e[i], pos, n, cur))
+      return &c->e[i];
+  for (e = c->more; e; e = e->next)
+    if (matches(c, e, pos, n, cur))
+      return e;
+  return NULL;
+}
+
+const vertpipe_t *vcache_get(vcache_t *c, const vecsoa3_t *pos, int n) {
+  matrix_t cur __attribute__((aligned(32)));
+  vcache_entry_t *e;
+
+  c->stats.lookups++;
+  mat_store(&cur);
+
+  e = find(c, pos, n, &cur);
+  if (e != NULL) {
+    c->stats.reuses++;
+    c->stats.verts_reused += n;
+    return &e->pipe;
+  }
+
+  e = victim(c);
+  if (e == NULL)
+    return NULL;
+  if (e->pipe.cap < n) {
+    vertpipe_free(&e->pipe);
+    if (!vertpipe_init(&e->pipe, n)) {
+      e->frame = 0;
+      return NULL;
+    }
+  }
+  e->key = pos->x;
+  e->n = n;
+  e->frame = c->frame;
+  memcpy(&e->mat, &cur, sizeof(matrix_t));
+  e->pipe.view = c->view;
+  vertpipe_transform(&e->pipe, pos, n);
+  c->stats.transforms++;
+  c->stats.verts_transformed += n;
+  return &e->pipe;
+}
+
+void vcache_get_stats(const vcache_t *c, vcache_stats_t *out) {
+  *out = c->stats;
+}
+
+void vcache_reset_stats(vcache_t *c) {
+  memset(&c->stats, 0, sizeof(c->stats));
+}
@@ -0,0 +1,89 @@
+#ifndef VCACHE_H
+#define VCACHE_H
+
+#include <stdint.h>
+#include "vertpipe.h"
+
+/**  Per frame cache of transformed geometry.
+
+     The cube is drawn twice a frame, opaque faces and then the Perlin
+     overlay, with the same matrix. Overlays, outlines and decals would add
+     more passes over the same mesh. vcache_get() transforms a mesh with
+     vertpipe the first time it sees that mesh under the matrix in XMTRX
+     this frame and hands back the same screen space vertices every time
+     after that, so later passes only write UV, colour and flags in
+     vertpipe_emit().
+
+     A mesh is known by its position arrays and vertex count, the matrix by
+     its 16 floats, read back with mat_store(). vcache_begin_frame()
+     forgets everything, so meshes that animate in place are safe as long
+     as they change between frames.
+
+     Every vertpipe_t handed out stays valid until the next
+     vcache_begin_frame(). Only entries from earlier frames are reused, a
+     frame with more than VCACHE_ENTRIES different meshes or matrices adds
+     entries, kept until vcache_free().
+
+     tools/vcachebench times 2, 4 and 8 passes with and without it.        */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VCACHE_ENTRIES 8
+
+typedef struct {
+  uint32_t lookups;           // vcache_get() calls
+  uint32_t transforms;        // meshes transformed
+  uint32_t reuses;            // lookups answered from the cache
+  uint32_t verts_transformed;
+  uint32_t verts_reused;
+  uint32_t grown;             // entries added past VCACHE_ENTRIES
+} vcache_stats_t;
+
+typedef struct vcache_entry {
+  const float *key;           // mesh x array
+  int n;
+  uint32_t frame;             // valid while this is the cache's frame
+  matrix_t mat __attribute__((aligned(32)));
+  vertpipe_t pipe;
+  struct vcache_entry *next;  // the added entries
+} vcache_entry_t;
+
+typedef struct {
+  vcache_entry_t e[VCACHE_ENTRIES];
+  uint32_t frame;
+  vcache_entry_t *more;       // added when all of e were in use in a frame
+  vertpipe_view_t view;       // screen mapping for everything transformed
+  vcache_stats_t stats;
+} vcache_t;
+
+/**
+ * @brief Empty cache, view set to the vertpipe default
+ */
+void vcache_init(vcache_t *c);
+void vcache_free(vcache_t *c);
+
+/**
+ * @brief Start a new frame, everything cached so far is dropped
+ */
+void vcache_begin_frame(vcache_t *c);
+
+/**
+ * @brief Screen space vertices for a mesh under the current XMTRX
+ *
+ * @param pos Object space positions, also the key
+ * @param n Number of vertices
+ * @return const vertpipe_t* For vertpipe_emit() until the next
+ * vcache_begin_frame(), NULL if out of memory
+ */
+const vertpipe_t *vcache_get(vcache_t *c, const vecsoa3_t *pos, int n);
+
+void vcache_get_stats(const vcache_t *c, vcache_stats_t *out);
+void vcache_reset_stats(vcache_t *c);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // VCACHE_H
@@ -0,0 +1,167 @@
+/********************************************************************************************/
+/* Name:     vecsoa.h                                                                       */
+/* Title:    Batched structure-of-arrays vector maths                                       */
+/* Platform: Dreamcast | KallistiOS:2.0 | host                                              */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   The vector.h functions work on one vector at a time. These work on N of them, stored  */
+/*   as separate x, y and z arrays so a loop touches each array in order.                   */
+/*                                                                                          */
+/*   Nothing in here changes XMTRX behind the caller's back. vecsoa_transform() only uses */
+/*   the matrix unit when there are enough vectors to pay for saving, loading and          */
+/*   restoring it, and puts the caller's matrix back afterwards. vecsoa_transform_loaded() */
+/*   uses whatever is in XMTRX now, for callers that manage it themselves.                 */
+/*                                                                                          */
+/*   tools/vecsoacheck runs all of it on the host against an emulated XMTRX.                */
+/********************************************************************************************/
+
+#ifndef VECSOA_H
+#define VECSOA_H 1
+
+#include "vector.h"
+
+// Below this many vectors FIPR per row beats three 16 float XMTRX transfers
+#ifndef VECSOA_XMTRX_MIN
+#define VECSOA_XMTRX_MIN 8
+#endif
+
+/**
+ * @brief N 3D vectors as three arrays
+ *
+ * The arrays may be the same ones for source and destination in every
+ * function below, each element is read before it is written.
+ */
+typedef struct {
+    FLOAT_TYPE *x, *y, *z;
+} vecsoa3_t;
+
+/**
+ * @brief dst[i] = a[i] x b[i]
+ */
+static inline void
+vecsoa_cross(const vecsoa3_t *dst, const vecsoa3_t *a, const vecsoa3_t *b, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        FLOAT_TYPE ax = a->x[i], ay = a->y[i], az = a->z[i];
+        FLOAT_TYPE bx = b->x[i], by = b->y[i], bz = b->z[i];
+        dst->x[i] = ay * bz - az * by;
+        dst->y[i] = az * bx - ax * bz;
+        dst->z[i] = ax * by - ay * bx;
+    }
+}
+
+/**
+ * @brief dst[i] = a[i] . b[i]
+ */
+static inline void
+vecsoa_dot(FLOAT_TYPE *dst, const vecsoa3_t *a, const vecsoa3_t *b, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+#ifdef DC_FAST_MATHS
+        dst[i] = fipr(a->x[i], a->y[i], a->z[i], 0.0f, b->x[i], b->y[i], b->z[i], 0.0f);
+#else
+        dst[i] = a->x[i] * b->x[i] + a->y[i] * b->y[i] + a->z[i] * b->z[i];
+#endif
+    }
+}
+
+/**
+ * @brief Normalize N vectors, zero length ones stay zero
+ */
+static inline void
+vecsoa_normalize(const vecsoa3_t *dst, const vecsoa3_t *src, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        FLOAT_TYPE x = src->x[i], y = src->y[i], z = src->z[i];
+#ifdef DC_FAST_MATHS
+        FLOAT_TYPE mag = fipr_magnitude_sqr(x, y, z, 0.0f);
+        FLOAT_TYPE f = mag > 0.0f ? frsqrt(mag) : 0.0f;
+#else
+        FLOAT_TYPE mag = x * x + y * y + z * z;
+        FLOAT_TYPE f = mag > 0.0f ? 1.0f / sqrtf(mag) : 0.0f;
+#endif
+        dst->x[i] = x * f;
+        dst->y[i] = y * f;
+        dst->z[i] = z * f;
+    }
+}
+
+/**
+ * @brief Transform N points by whatever is loaded in XMTRX, no divide
+ *
+ * The caller owns XMTRX here: load it once with mat_load() and make as
+ * many calls as there are batches for that matrix.
+ *
+ * @param dst Transformed x, y and z
+ * @param w Transformed w, NULL if not wanted
+ * @param src Points, w is taken as 1
+ * @param n Number of points
+ */
+static inline void
+vecsoa_transform_loaded(const vecsoa3_t *dst, FLOAT_TYPE *w, const vecsoa3_t *src, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        float x = src->x[i], y = src->y[i], z = src->z[i], ww = 1.0f;
+        mat_trans_nodiv(x, y, z, ww);
+        dst->x[i] = x;
+        dst->y[i] = y;
+        dst->z[i] = z;
+        if (w)
+            w[i] = ww;
+    }
+}
+
+/**
+ * @brief Transform N points by a matrix, no divide, XMTRX left as it was
+ *
+ * @param dst Transformed x, y and z
+ * @param w Transformed w, NULL if not wanted
+ * @param m Matrix, KOS layout (m[column][row])
+ * @param src Points, w is taken as 1
+ * @param n Number of points
+ */
+static inline void
+vecsoa_transform(const vecsoa3_t *dst, FLOAT_TYPE *w, const matrix_t *m,
+                 const vecsoa3_t *src, int n)
+{
+    const float (*c)[4] = *m;
+    int i;
+
+#ifdef DC_FAST_MATHS
+    if (n >= VECSOA_XMTRX_MIN) {
+        matrix_t saved __attribute__((aligned(32)));   // on the stack, so reentrant
+        mat_store(&saved);
+        mat_load(m);
+        vecsoa_transform_loaded(dst, w, src, n);
+        mat_load(&saved);
+        return;
+    }
+#endif
+
+    for (i = 0; i < n; i++) {
+        FLOAT_TYPE x = src->x[i], y = src->y[i], z = src->z[i];
+#ifdef DC_FAST_MATHS
+        dst->x[i] = fipr(c[0][0], c[1][0], c[2][0], c[3][0], x, y, z, 1.0f);
+        dst->y[i] = fipr(c[0][1], c[1][1], c[2][1], c[3][1], x, y, z, 1.0f);
+        dst->z[i] = fipr(c[0][2], c[1][2], c[2][2], c[3][2], x, y, z, 1.0f);
+        if (w)
+            w[i] = fipr(c[0][3], c[1][3], c[2][3], c[3][3], x, y, z, 1.0f);
+#else
+        dst->x[i] = c[0][0] * x + c[1][0] * y + c[2][0] * z + c[3][0];
+        dst->y[i] = c[0][1] * x + c[1][1] * y + c[2][1] * z + c[3][1];
+        dst->z[i] = c[0][2] * x + c[1][2] * y + c[2][2] * z + c[3][2];
+        if (w)
+            w[i] = c[0][3] * x + c[1][3] * y + c[2][3] * z + c[3][3];
+#endif
+    }
+}
+
+#endif
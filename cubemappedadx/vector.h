@@ -41,8 +41,11 @@
 #include <math.h>
 #include <assert.h>
 
-// Define DC_FAST_MATHS to enable fast math operations specific to Dreamcast hardware
+// Define DC_FAST_MATHS to enable fast math operations specific to Dreamcast hardware,
+// build with -DDC_NO_FAST_MATHS for the plain C versions
+#ifndef DC_NO_FAST_MATHS
 #define DC_FAST_MATHS 1
+#endif
 
 // If DC_FAST_MATHS is defined, include the Dreamcast-specific fast math library
 #ifdef DC_FAST_MATHS
@@ -132,23 +135,15 @@ vec_length (const FLOAT_TYPE *vec)
 #endif
 }
 
-/**
- * @brief Define a 4x4 matrix aligned to a 32-byte boundary
- *
- * This matrix is initialized with all zeros. The alignment is important
- * for optimal memory access on the Dreamcast hardware.
- */
-static matrix_t b_mat __attribute__((aligned(32))) =
-{
-    { 0.0, 0.0, 0.0, 0.0 },
-    { 0.0, 0.0, 0.0, 0.0 },
-    { 0.0, 0.0, 0.0, 0.0 },
-    { 0.0, 0.0, 0.0, 0.0 }
-};
-
 /**
  * @brief Calculate the cross product of two 3D vectors
  *
+ * Plain arithmetic on every platform. This used to build a matrix from b in
+ * a shared static and run a through XMTRX, which cost a 16 float load per
+ * call, wasn't reentrant and threw away whatever matrix the caller had
+ * loaded. Six multiplies are cheaper than all of that. For many vectors at
+ * once see vecsoa_cross() in vecsoa.h.
+ *
  * @param dst Pointer to the destination vector where the result will be stored
  * @param a Pointer to the first input vector
  * @param b Pointer to the second input vector
@@ -156,52 +151,7 @@ static matrix_t b_mat __attribute__((aligned(32))) =
 static inline void
 vec_cross(FLOAT_TYPE *dst, const FLOAT_TYPE *a, const FLOAT_TYPE *b)
 {
-#ifdef DC_FAST_MATHS
-    // Dreamcast-specific optimized version
-    
-    #if 0
-    // This block is commented out, but shows an alternative method using FIPR
-    FLOAT_TYPE tmpx = fipr(a[1], a[2], 0.0, 0.0, b[2], -b[1], 0.0, 0.0);
-    FLOAT_TYPE tmpy = fipr(a[2], a[0], 0.0, 0.0, b[0], -b[2], 0.0, 0.0);
-    FLOAT_TYPE tmpz = fipr(a[0], a[1], 0.0, 0.0, b[1], -b[0], 0.0, 0.0);
-    dst[0] = tmpx;
-    dst[1] = tmpy;
-    dst[2] = tmpz;
-    #else
-    // Current implementation uses matrix transformation
-    
-    // Set up temporary variables for vector 'a'
-    FLOAT_TYPE tmp1 = a[0], tmp2 = a[1], tmp3 = a[2], tmp4 = 0.0;
-    
-    // Set up the transformation matrix using vector 'b'
-    // Note: The commented out lines are presumably zero and don't need to be set explicitly
-    /*
-    b_mat[0][0] = b_mat[3][0] = b_mat[1][1] = b_mat[3][1] = 0.0;
-    b_mat[2][2] = b_mat[3][2] = b_mat[0][3] = b_mat[1][3] = 0.0;
-    b_mat[2][3] = b_mat[3][3] = 0.0;
-    */
-    b_mat[1][0] = b[2];
-    b_mat[2][0] = -b[1];
-    b_mat[0][1] = -b[2];
-    b_mat[2][1] = b[0];
-    b_mat[0][2] = b[1];
-    b_mat[1][2] = -b[0];
-    
-    // Load the matrix into the Dreamcast's matrix unit
-    mat_load(&b_mat);
-    
-    // Perform matrix transformation
-    mat_trans_nodiv(tmp1, tmp2, tmp3, tmp4);
-    
-    // Store the result
-    dst[0] = tmp1;
-    dst[1] = tmp2;
-    dst[2] = tmp3;
-    // Note: The comment "dirty" might indicate that this method might have some precision issues
-    #endif
-
-#else
-    // Standard cross product calculation for non-Dreamcast platforms
+    // Through temporaries so dst may be a or b
     FLOAT_TYPE dstc[3];
     
     dstc[0] = a[1] * b[2] - a[2] * b[1];
@@ -211,7 +161,6 @@ vec_cross(FLOAT_TYPE *dst, const FLOAT_TYPE *a, const FLOAT_TYPE *b)
     dst[0] = dstc[0];
     dst[1] = dstc[1];
     dst[2] = dstc[2];
-#endif
 }
 
 /**
@@ -348,6 +297,7 @@ static inline void
 vec_transform3_fipr(FLOAT_TYPE *dst, const FLOAT_TYPE *mat,
                     const FLOAT_TYPE *src)
 {
+#ifdef DC_FAST_MATHS
     // Transform x component
     dst[0] = fipr(mat[0], mat[4], mat[8],  mat[12],
                   src[0], src[1], src[2], 1.0f);
@@ -357,6 +307,11 @@ vec_transform3_fipr(FLOAT_TYPE *dst, const FLOAT_TYPE *mat,
     // Transform z component
     dst[2] = fipr(mat[2], mat[6], mat[10], mat[14],
                   src[0], src[1], src[2], 1.0f);
+#else
+    dst[0] = mat[0] * src[0] + mat[4] * src[1] + mat[8]  * src[2] + mat[12];
+    dst[1] = mat[1] * src[0] + mat[5] * src[1] + mat[9]  * src[2] + mat[13];
+    dst[2] = mat[2] * src[0] + mat[6] * src[1] + mat[10] * src[2] + mat[14];
+#endif
     // Note: The w component (1.0f) is implicit and not stored in the result
 }
 
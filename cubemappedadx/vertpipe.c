@@ -0,0 +1,150 @@
+/********************************************************************************************/
+/* Name:     vertpipe.c                                                                     */
+/* Title:    Batched transform and direct render submission                                 */
+/* Platform: Dreamcast | KallistiOS:2.0 | host (tools/host)                                 */
+/*                                                                                          */
+/* Description: FTRV every point in one loop, divide and map to the screen in a second,     */
+/* then emit strips into the store queues. See vertpipe.h.                                  */
+/********************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "vertpipe.h"
+
+#ifdef _arch_dreamcast
+#include <malloc.h>
+#define vp_alloc(n) memalign(32, n)
+#else
+#define vp_alloc(n) malloc(n)
+#endif
+
+void vertpipe_default_view(vertpipe_view_t *v) {
+  v->sx = 320.0f;
+  v->sy = -240.0f;
+  v->ox = 320.0f;
+  v->oy = 240.0f;
+  v->zscale = 1.0f;
+  v->zbias = 0.0f;
+  v->zmax = 65535.0f;
+}
+
+int vertpipe_init(vertpipe_t *p, int cap) {
+  // One block, each array starting on a cache line
+  int stride = (cap + 7) & ~7;
+  float *buf = vp_alloc(stride * 4 * sizeof(float));
+
+  memset(p, 0, sizeof(*p));
+  if (buf == NULL)
+    return 0;
+  p->cap = cap;
+  p->x = buf;
+  p->y = buf + stride;
+  p->z = buf + stride * 2;
+  p->w = buf + stride * 3;
+  vertpipe_default_view(&p->view);
+  return 1;
+}
+
+void vertpipe_free(vertpipe_t *p) {
+  free(p->x);
+  memset(p, 0, sizeof(*p));
+}
+
+void vertpipe_transform(vertpipe_t *p, const vecsoa3_t *pos, int n) {
+  const vertpipe_view_t vw = p->view;
+  vecsoa3_t out = {p->x, p->y, p->z};
+  float *x = p->x, *y = p->y, *z = p->z, *w = p->w;
+  int i;
+
+  if (n > p->cap)
+    n = p->cap;
+
+  // Nothing but FTRV in the first loop, so the pipeline stays full
+  vecsoa_transform_loaded(&out, w, pos, n);
+
+  for (i = 0; i < n; i++) {
+    float iw = 1.0f / w[i];
+    float d = iw * vw.zscale + vw.zbias;
+    x[i] = x[i] * iw * vw.sx + vw.ox;
+    y[i] = y[i] * iw * vw.sy + vw.oy;
+    z[i] = d < 0.0f ? 0.0f : d > vw.zmax ? vw.zmax : d;
+    w[i] = iw;
+  }
+  p->count = n;
+}
+
+void vertpipe_emit(const vertpipe_t *p, pvr_dr_state_t *dr, int first, int count,
+                   int strip_len, const float *u, const float *v, uint32_t argb) {
+  int end = first + count, left, i;
+
+  if (end > p->count)
+    end = p->count;
+  if (strip_len <= 0)
+    strip_len = end - first;
+  left = strip_len;
+
+  // Every field in order, so each vertex leaves in one store queue burst
+  for (i = first; i < end; i++) {
+    pvr_vertex_t *vert = pvr_dr_target(*dr);
+    vert->flags = (--left == 0 || i == end - 1) ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
+    vert->x = p->x[i];
+    vert->y = p->y[i];
+    vert->z = p->z[i];
+    vert->u = u ? u[i] : 0.0f;
+    vert->v = v ? v[i] : 0.0f;
+    vert->argb = argb;
+    vert->oargb = 0;
+    pvr_dr_commit(vert);
+    if (left == 0)
+      left = strip_len;
+  }
+}
+
+static inline void emit_one(const vertpipe_t *p, pvr_dr_state_t *dr, int k, uint32_t flags,
+                            const float *u, const float *v, uint32_t argb) {
+  pvr_vertex_t *vert = pvr_dr_target(*dr);
+  vert->flags = flags;
+  vert->x = p->x[k];
+  vert->y = p->y[k];
+  vert->z = p->z[k];
+  vert->u = u ? u[k] : 0.0f;
+  vert->v = v ? v[k] : 0.0f;
+  vert->argb = argb;
+  vert->oargb = 0;
+  pvr_dr_commit(vert);
+}
+
+void vertpipe_emit_indexed(const vertpipe_t *p, pvr_dr_state_t *dr, const uint16_t *idx,
+                           int count, const float *u, const float *v, uint32_t argb) {
+  int i;
+
+  for (i = 0; i < count; i++)
+    emit_one(p, dr, idx[i], i == count - 1 ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX,
+             u, v, argb);
+}
+
+void vertpipe_emit_strips(const vertpipe_t *p, pvr_dr_state_t *dr, const uint16_t *idx,
+                          const uint32_t *strip_first, int first, int last,
+                          const float *u, const float *v, uint32_t argb) {
+  uint32_t end = last > first ? strip_first[last] : 0;
+  int sent = 0, s;
+  uint32_t i;
+
+  for (s = first; s < last; s++) {
+    uint32_t a = strip_first[s], b = strip_first[s + 1];
+    if (a == b)
+      continue;
+    if (sent) {
+      // Zero area triangles carry the strip over to the next one
+      emit_one(p, dr, idx[a - 1], PVR_CMD_VERTEX, u, v, argb);
+      emit_one(p, dr, idx[a], PVR_CMD_VERTEX, u, v, argb);
+      sent += 2;
+      if (sent & 1) {
+        emit_one(p, dr, idx[a], PVR_CMD_VERTEX, u, v, argb);
+        sent++;
+      }
+    }
+    for (i = a; i < b; i++, sent++)
+      emit_one(p, dr, idx[i], i == end - 1 ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX,
+               u, v, argb);
+  }
+}
@@ -0,0 +1,122 @@
+#ifndef VERTPIPE_H
+#define VERTPIPE_H
+
+#include <stdint.h>
+#include <dc/pvr.h>
+#include "vecsoa.h"
+
+/**  Vertex pipeline: SoA positions in, PVR vertices out.
+
+     The cube renderers used to call mat_trans_single() per vertex, which is
+     an FTRV, a divide and the surrounding call per point, interleaved with
+     the store queue writes. This splits the work into two tight loops:
+
+       vertpipe_transform()  one batch of FTRVs through whatever is loaded in
+                             XMTRX, then divide and viewport mapping, into
+                             screen space arrays kept in the vertpipe_t
+       vertpipe_emit()       a run of those vertices written straight into
+                             pvr_dr_target() slots as strips, with UVs and
+                             colour
+
+     Keeping screen space around between the two means a second pass over
+     the same geometry only has to emit again.
+
+     tools/vertpipebench compares it against the per vertex loop on a 10k
+     vertex mesh.                                                           */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Screen x = x/w * sx + ox, y likewise, PVR depth = clamp(1/w * zscale + zbias, 0, zmax) */
+typedef struct {
+  float sx, sy;
+  float ox, oy;
+  float zscale, zbias;
+  float zmax;
+} vertpipe_view_t;
+
+typedef struct {
+  int cap;                    // vertices the arrays hold
+  int count;                  // transformed by the last vertpipe_transform()
+  float *x, *y, *z;           // screen space, z is the PVR depth
+  float *w;                   // 1/w
+  vertpipe_view_t view;
+} vertpipe_t;
+
+/**
+ * @brief Allocate the screen space arrays
+ *
+ * The view starts as 640x480 with y down and depth 1/w.
+ *
+ * @return int 1 on success
+ */
+int vertpipe_init(vertpipe_t *p, int cap);
+void vertpipe_free(vertpipe_t *p);
+
+/* 640x480, y down, depth 1/w */
+void vertpipe_default_view(vertpipe_view_t *v);
+
+/**
+ * @brief Transform points by XMTRX, divide and map to the screen
+ *
+ * XMTRX must hold the full object to clip space matrix and is not
+ * changed.
+ *
+ * @param pos Object space positions
+ * @param n Number of points, at most p->cap
+ */
+void vertpipe_transform(vertpipe_t *p, const vecsoa3_t *pos, int n);
+
+/**
+ * @brief Write transformed vertices into the direct render slots
+ *
+ * @param dr Direct render state from pvr_dr_init()
+ * @param first First vertex
+ * @param count Number of vertices
+ * @param strip_len Vertices per strip, the last of each gets EOL; 0 for one strip
+ * @param u Per vertex u, indexed like the positions, NULL for 0
+ * @param v Per vertex v, NULL for 0
+ * @param argb Colour for every vertex
+ */
+void vertpipe_emit(const vertpipe_t *p, pvr_dr_state_t *dr, int first, int count,
+                   int strip_len, const float *u, const float *v, uint32_t argb);
+
+/**
+ * @brief Write one strip of transformed vertices picked by index
+ *
+ * For indexed meshes (mesh.h), where a shared corner is transformed once
+ * and sent once per strip that uses it. The last vertex gets EOL.
+ *
+ * @param idx Vertex numbers, each below p->count
+ * @param count Length of the strip
+ * @param u Per vertex u, indexed like the positions, NULL for 0
+ * @param v Per vertex v, NULL for 0
+ * @param argb Colour for every vertex
+ */
+void vertpipe_emit_indexed(const vertpipe_t *p, pvr_dr_state_t *dr, const uint16_t *idx,
+                           int count, const float *u, const float *v, uint32_t argb);
+
+/**
+ * @brief Write several indexed strips as one long strip
+ *
+ * Strips first to last - 1 of a strip table (mesh.h layout: strip s is
+ * idx[strip_first[s]] up to idx[strip_first[s + 1]]) are joined through
+ * degenerate triangles, repeating the last vertex of one and the first of
+ * the next, plus one more when the strip so far is odd so every strip
+ * keeps its winding. One EOL at the end, so the TA starts one strip
+ * instead of last - first, at two or three extra vertices per join.
+ *
+ * @param strip_first Strip start table
+ * @param first First strip
+ * @param last One past the last strip
+ */
+void vertpipe_emit_strips(const vertpipe_t *p, pvr_dr_state_t *dr, const uint16_t *idx,
+                          const uint32_t *strip_first, int first, int last,
+                          const float *u, const float *v, uint32_t argb);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // VERTPIPE_H
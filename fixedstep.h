@@ -0,0 +1,179 @@
+#ifndef FIXEDSTEP_H
+#define FIXEDSTEP_H
+
+#include <stdint.h>
+
+#ifdef _arch_dreamcast
+#include <arch/irq.h>
+#include <stdio.h>
+#include <dc/vblank.h>
+#include <kos/sem.h>
+#endif
+
+/**  Fixed timestep simulation, decoupled from how often frames are drawn.
+
+     Speeds, friction and scrolling that are applied once per loop change
+     with the frame rate. Instead, the time that passed (timer_us_gettime64())
+     is turned into a whole number of simulation steps, each of the same
+     length, and whatever is left over becomes the blend factor between the
+     last two states for drawing:
+
+       int n = fixedstep_advance(&clock, timer_us_gettime64());
+       while (n--) {
+         prev = state;
+         update(&state, fixedstep_dt(&clock));
+       }
+       draw(fixedstep_lerp(prev.x, state.x, fixedstep_alpha(&clock)), ...);
+
+     A slow frame runs several steps, a fast one none, and the simulation
+     comes out the same either way. After a long stall (loading, a
+     debugger) at most max_steps are run and the rest of the time dropped.
+
+     Time is counted in microseconds times the step rate, so 60 steps a
+     second are exactly 60, not 1000000 / 16666.
+
+     vblank_pacer_wait() sleeps the calling thread until the next vertical
+     blank from the vblank interrupt, so the main loop can start each frame
+     on the display's beat without spinning on the video status register
+     the way vid_waitvbl() does.                                            */
+
+typedef struct {
+  uint32_t hz;           // steps per second
+  int max_steps;         // per fixedstep_advance(), the rest is dropped
+  uint64_t last_us;
+  uint64_t acc;          // time not simulated yet, in us * hz
+  uint32_t steps;        // run so far
+  uint64_t dropped_us;   // thrown away after stalls
+} fixedstep_t;
+
+/**
+ * @brief Start the clock
+ *
+ * Also use it to restart after a deliberate pause, so the pause is not
+ * counted as a stall.
+ *
+ * @param fs Clock
+ * @param hz Simulation steps per second
+ * @param now_us timer_us_gettime64()
+ */
+static inline void fixedstep_init(fixedstep_t *fs, uint32_t hz, uint64_t now_us) {
+  fs->hz = hz;
+  fs->max_steps = 8;
+  fs->last_us = now_us;
+  fs->acc = 0;
+  fs->steps = 0;
+  fs->dropped_us = 0;
+}
+
+/**
+ * @brief Take the time since the last call and turn it into steps
+ *
+ * @param fs Clock
+ * @param now_us timer_us_gettime64()
+ * @return int Steps to run this frame, 0 up to max_steps
+ */
+static inline int fixedstep_advance(fixedstep_t *fs, uint64_t now_us) {
+  uint64_t elapsed = now_us - fs->last_us;
+  uint64_t limit = (uint64_t)fs->max_steps * 1000000 / fs->hz;
+  int n;
+
+  fs->last_us = now_us;
+  if (elapsed > limit) {
+    fs->dropped_us += elapsed - limit;
+    elapsed = limit;
+  }
+  fs->acc += elapsed * fs->hz;
+  n = (int)(fs->acc / 1000000);
+  fs->acc -= (uint64_t)n * 1000000;
+  fs->steps += n;
+  return n;
+}
+
+/* Seconds per step */
+static inline float fixedstep_dt(const fixedstep_t *fs) {
+  return 1.0f / fs->hz;
+}
+
+/* How far into the next step the clock is, 0 up to 1, for drawing */
+static inline float fixedstep_alpha(const fixedstep_t *fs) {
+  return fs->acc / 1000000.0f;
+}
+
+static inline float fixedstep_lerp(float prev, float cur, float alpha) {
+  return prev + (cur - prev) * alpha;
+}
+
+#ifdef _arch_dreamcast
+typedef struct {
+  semaphore_t sem;
+  int handle;
+  volatile uint32_t count;    // vblanks since vblank_pacer_init()
+  volatile uint32_t wake;     // count the waiting thread wants
+  volatile int waiting;
+  uint32_t last;              // count at the last wake up
+  uint32_t missed;            // frames that took longer than their interval
+} vblank_pacer_t;
+
+static inline void vblank_pacer_irq(uint32_t code, void *data) {
+  vblank_pacer_t *p = (vblank_pacer_t *)data;
+  (void)code;
+  p->count++;
+  if (p->waiting && (int32_t)(p->count - p->wake) >= 0) {
+    p->waiting = 0;
+    sem_signal(&p->sem);
+  }
+}
+
+/**
+ * @brief Hook the vblank interrupt
+ *
+ * @return int 1 on success, 0 if no handler slot was free
+ */
+static inline int vblank_pacer_init(vblank_pacer_t *p) {
+  sem_init(&p->sem, 0);
+  p->count = p->wake = p->last = p->missed = 0;
+  p->waiting = 0;
+  p->handle = vblank_handler_add(vblank_pacer_irq, p);
+  if (p->handle < 0) {
+    printf("Error: no vblank handler slot for frame pacing\n");
+    sem_destroy(&p->sem);
+    return 0;
+  }
+  return 1;
+}
+
+static inline void vblank_pacer_shutdown(vblank_pacer_t *p) {
+  vblank_handler_remove(p->handle);
+  sem_destroy(&p->sem);
+}
+
+/**
+ * @brief Sleep until interval vblanks after the last wake up
+ *
+ * A frame that ran past its slot waits for the next vblank instead, and is
+ * counted in missed.
+ *
+ * @param p Pacer
+ * @param interval 1 for every vblank (60Hz), 2 for every other one, ...
+ * @return uint32_t Vblanks since the last wake up
+ */
+static inline uint32_t vblank_pacer_wait(vblank_pacer_t *p, int interval) {
+  uint32_t target = p->last + interval, since;
+  int old = irq_disable();
+
+  if ((int32_t)(p->count - target) >= 0) {
+    p->missed++;
+    target = p->count + 1;
+  }
+  p->wake = target;
+  p->waiting = 1;
+  irq_restore(old);
+  sem_wait(&p->sem);
+
+  since = p->count - p->last;
+  p->last = p->count;
+  return since;
+}
+#endif
+
+#endif // FIXEDSTEP_H
@@ -0,0 +1,544 @@
+#ifndef LZPACK_H
+#define LZPACK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**  Compressed asset pack, shared by the host packer (tools/lzpack.c),
+     tools/packbench.c and the demos.
+
+     A romdisk image linked into the ELF through bin2o is stored as is, so
+     every asset adds its full size to what has to go over serial or BBA,
+     or be read off the disc, before the program starts. A pack holds the
+     same tree with every file compressed on its own in the LZ4 block
+     format, which decodes at memcpy-like speed with nothing but byte
+     copies, so it suits the SH4 better than anything entropy coded.
+     Files that don't get smaller are stored. Little endian:
+
+       lzpack_hdr_t                16 bytes
+       lzpack_entry_t[files]       sorted by the hash of the path, then the
+                                   path, for a binary search
+       lzpack_group_t[groups]
+       names                       NUL terminated paths, "/texture/dc.dt",
+                                   and group names
+       data                        each file on a 32 byte boundary from the
+                                   start of the pack, the files of each
+                                   group back to back, group by group, then
+                                   the files in none
+
+     A pack is either all in memory, linked in with bin2o in place of the
+     romdisk, or read through an lzpack_io_t, off the disc:
+
+       lzpack_open(&pack, romdisk, 0);
+       // or
+       lzpack_io_t io = {lzpack_stdio_read, fopen("/cd/assets.lzp", "rb")};
+       lzpack_open_io(&pack, &io);
+
+     Read from the disc, opening a file costs a lookup in the index, kept
+     in memory, and one read of its packed bytes. A group is the files a
+     scene loads: lzpack_prefetch(&pack, "level1") reads all of them in
+     one sequential read, and loading them after that reads nothing.
+
+     lzpack_mount() puts a pack where the romdisk would have been, "/rd",
+     so fopen() and fs_open() find it unchanged. Nothing is decompressed
+     until a file is read. A read of the whole file from the start, as one
+     fs_read() or a large fread(), decodes straight into the caller's
+     buffer. Anything else, seeks, short reads and fs_mmap(), decodes the
+     file once into a buffer owned by the open file, freed on close. Stored
+     files of a pack in memory map straight into it.                      */
+
+#define LZPACK_FOURCC "LZP2"
+#define LZPACK_ALIGN 32
+#define LZPACK_ALIGN_UP(n) (((n) + LZPACK_ALIGN - 1) & ~(LZPACK_ALIGN - 1))
+#define LZPACK_NO_GROUP 0xffff
+
+typedef struct {
+  char fourcc[4];   // "LZP2"
+  uint32_t files;
+  uint32_t groups;
+  uint32_t names;   // bytes of names
+} lzpack_hdr_t;
+
+typedef struct {
+  uint32_t hash;    // lzpack_hash() of the path
+  uint32_t name;    // offset in names
+  uint32_t offset;  // of the data from the start of the pack
+  uint32_t packed;  // bytes of data, size when stored
+  uint32_t size;    // bytes once decoded
+  uint16_t group;   // LZPACK_NO_GROUP when in none
+  uint16_t pad;
+} lzpack_entry_t;
+
+typedef struct {
+  uint32_t name;    // offset in names
+  uint32_t offset;  // of its first file
+  uint32_t bytes;   // to the end of its last file
+  uint32_t files;
+} lzpack_group_t;
+
+/* Reads from a pack that isn't in memory */
+typedef struct {
+  int (*read)(void *ctx, uint32_t offset, void *buf, uint32_t len); // 1 on success
+  void *ctx;
+} lzpack_io_t;
+
+typedef struct {
+  const lzpack_entry_t *entry;
+  const lzpack_group_t *group;
+  const char *names;
+  uint32_t files, groups;
+  // The pack data in memory: all of it, or the last group prefetched
+  const uint8_t *cache;
+  uint32_t cache_offset, cache_bytes;
+  int resident;              // the whole pack is in memory
+  lzpack_io_t io;
+  void *index;               // the index as read through io
+  uint8_t *prefetched;
+  uint32_t reads;            // through io
+  uint64_t read_bytes;
+} lzpack_t;
+
+/* FNV-1a */
+static inline uint32_t lzpack_hash(const char *s) {
+  uint32_t h = 2166136261u;
+  while (*s)
+    h = (h ^ (uint8_t)*s++) * 16777619u;
+  return h;
+}
+
+/**
+ * @brief Decode one LZ4 block
+ *
+ * @param src The block
+ * @param packed Its size
+ * @param dst Room for size bytes
+ * @param size What the block decodes to
+ * @return int 1 on success, 0 if the block is corrupt or not exactly size
+ */
+static inline int lzpack_decode(const uint8_t *src, size_t packed, uint8_t *dst, size_t size) {
+  const uint8_t *ip = src, *iend = src + packed;
+  uint8_t *op = dst, *oend = dst + size;
+
+  while (ip < iend) {
+    unsigned token = *ip++;
+    size_t len = token >> 4, off;
+    const uint8_t *match;
+
+    if (len == 15) {
+      unsigned b;
+      do {
+        if (ip == iend)
+          return 0;
+        len += b = *ip++;
+      } while (b == 255);
+    }
+    if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+      return 0;
+    memcpy(op, ip, len);
+    op += len;
+    ip += len;
+    // Only the last sequence ends without a match
+    if (ip == iend)
+      break;
+
+    if (iend - ip < 2)
+      return 0;
+    off = ip[0] | ip[1] << 8;
+    ip += 2;
+    if (off == 0 || off > (size_t)(op - dst))
+      return 0;
+    len = token & 15;
+    if (len == 15) {
+      unsigned b;
+      do {
+        if (ip == iend)
+          return 0;
+        len += b = *ip++;
+      } while (b == 255);
+    }
+    len += 4;
+    if (len > (size_t)(oend - op))
+      return 0;
+    match = op - off;
+    if (off >= len) {
+      memcpy(op, match, len);
+      op += len;
+    } else {
+      // Overlapping, a run repeating the last off bytes
+      while (len--)
+        *op++ = *match++;
+    }
+  }
+  return op == oend;
+}
+
+/* Point into an index: the header and everything up to the data */
+static inline int lzpack_parse(lzpack_t *lz, const void *index, size_t size) {
+  const lzpack_hdr_t *hdr = (const lzpack_hdr_t *)index;
+
+  if (size < sizeof(*hdr) || memcmp(hdr->fourcc, LZPACK_FOURCC, 4) ||
+      size < sizeof(*hdr) + hdr->files * sizeof(lzpack_entry_t) +
+                 hdr->groups * sizeof(lzpack_group_t) + hdr->names)
+    return 0;
+  lz->entry = (const lzpack_entry_t *)((const uint8_t *)index + sizeof(*hdr));
+  lz->group = (const lzpack_group_t *)(lz->entry + hdr->files);
+  lz->names = (const char *)(lz->group + hdr->groups);
+  lz->files = hdr->files;
+  lz->groups = hdr->groups;
+  return 1;
+}
+
+/**
+ * @brief Open a pack that is all in memory
+ *
+ * @param pack The pack, in memory for as long as it is used
+ * @param size Its size, 0 when not known
+ * @return int 1 on success, 0 if it is not a pack
+ */
+static inline int lzpack_open(lzpack_t *lz, const void *pack, size_t size) {
+  memset(lz, 0, sizeof(*lz));
+  if (!lzpack_parse(lz, pack, size ? size : (size_t)-1))
+    return 0;
+  lz->cache = (const uint8_t *)pack;
+  lz->cache_bytes = size ? size : 0xffffffffu;
+  lz->resident = 1;
+  return 1;
+}
+
+static inline int lzpack_io_read(lzpack_t *lz, uint32_t offset, void *buf, uint32_t len) {
+  lz->reads++;
+  lz->read_bytes += len;
+  return lz->io.read(lz->io.ctx, offset, buf, len);
+}
+
+/* lzpack_io_t.read for a FILE *, as ctx */
+static inline int lzpack_stdio_read(void *ctx, uint32_t offset, void *buf, uint32_t len) {
+  FILE *fp = (FILE *)ctx;
+  return fp != NULL && fseek(fp, offset, SEEK_SET) == 0 && fread(buf, 1, len, fp) == len;
+}
+
+/**
+ * @brief Open a pack read through io, keeping only its index in memory
+ *
+ * @param io How to read it, copied
+ * @return int 1 on success, 0 on failure
+ */
+static inline int lzpack_open_io(lzpack_t *lz, const lzpack_io_t *io) {
+  lzpack_hdr_t hdr;
+  size_t size;
+
+  memset(lz, 0, sizeof(*lz));
+  lz->io = *io;
+  if (!lzpack_io_read(lz, 0, &hdr, sizeof(hdr)) || memcmp(hdr.fourcc, LZPACK_FOURCC, 4)) {
+    printf("Error: not an " LZPACK_FOURCC " pack\n");
+    return 0;
+  }
+  size = sizeof(hdr) + hdr.files * sizeof(lzpack_entry_t) +
+         hdr.groups * sizeof(lzpack_group_t) + hdr.names;
+  if ((lz->index = malloc(size)) == NULL) {
+    printf("Error: no memory for the pack index\n");
+    return 0;
+  }
+  memcpy(lz->index, &hdr, sizeof(hdr));
+  if (!lzpack_io_read(lz, sizeof(hdr), (uint8_t *)lz->index + sizeof(hdr), size - sizeof(hdr)) ||
+      !lzpack_parse(lz, lz->index, size)) {
+    printf("Error: can't read the pack index\n");
+    free(lz->index);
+    lz->index = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+static inline void lzpack_close(lzpack_t *lz) {
+  free(lz->index);
+  free(lz->prefetched);
+  memset(lz, 0, sizeof(*lz));
+}
+
+/* The entry for a path, "/texture/dc.dt", NULL if there is none */
+static inline const lzpack_entry_t *lzpack_find(const lzpack_t *lz, const char *path) {
+  uint32_t h = lzpack_hash(path), lo = 0, hi = lz->files;
+
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (lz->entry[mid].hash < h)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  for (; lo < lz->files && lz->entry[lo].hash == h; lo++)
+    if (!strcmp(path, lz->names + lz->entry[lo].name))
+      return &lz->entry[lo];
+  return NULL;
+}
+
+/* A group by name, NULL if there is none */
+static inline const lzpack_group_t *lzpack_find_group(const lzpack_t *lz, const char *name) {
+  for (uint32_t g = 0; g < lz->groups; g++)
+    if (!strcmp(name, lz->names + lz->group[g].name))
+      return &lz->group[g];
+  return NULL;
+}
+
+/**
+ * @brief Read a group's files in one go, ahead of loading them
+ *
+ * Replaces the group prefetched before, so no file of that one may still be
+ * open. A pack all in memory has nothing to read.
+ *
+ * @param name The group, NULL to free the last one
+ * @return int 1 on success, 0 on failure
+ */
+static inline int lzpack_prefetch(lzpack_t *lz, const char *name) {
+  const lzpack_group_t *g;
+
+  if (lz->resident)
+    return 1;
+  free(lz->prefetched);
+  lz->prefetched = NULL;
+  lz->cache = NULL;
+  lz->cache_offset = lz->cache_bytes = 0;
+  if (name == NULL)
+    return 1;
+  if ((g = lzpack_find_group(lz, name)) == NULL) {
+    printf("Error: no group %s in the pack\n", name);
+    return 0;
+  }
+  lz->prefetched = (uint8_t *)malloc(g->bytes ? g->bytes : 1);
+  if (lz->prefetched == NULL || !lzpack_io_read(lz, g->offset, lz->prefetched, g->bytes)) {
+    printf("Error: can't prefetch %s\n", name);
+    free(lz->prefetched);
+    lz->prefetched = NULL;
+    return 0;
+  }
+  lz->cache = lz->prefetched;
+  lz->cache_offset = g->offset;
+  lz->cache_bytes = g->bytes;
+  return 1;
+}
+
+/* A file's packed bytes when they are in memory, NULL when they have to be read */
+static inline const uint8_t *lzpack_cached(const lzpack_t *lz, const lzpack_entry_t *e) {
+  if (lz->cache == NULL || e->offset < lz->cache_offset ||
+      e->offset - lz->cache_offset + (uint64_t)e->packed > lz->cache_bytes)
+    return NULL;
+  return lz->cache + (e->offset - lz->cache_offset);
+}
+
+/**
+ * @brief Decode a file
+ *
+ * From memory when the pack or the file's group is there, otherwise after
+ * one read of its packed bytes.
+ *
+ * @param dst Room for e->size bytes
+ * @return int 1 on success, 0 if it can't be read or its data is corrupt
+ */
+static inline int lzpack_read(lzpack_t *lz, const lzpack_entry_t *e, void *dst) {
+  const uint8_t *src = lzpack_cached(lz, e);
+  uint8_t *tmp = NULL;
+  int ok;
+
+  if (src == NULL) {
+    if (e->packed == e->size)
+      return lzpack_io_read(lz, e->offset, dst, e->size);
+    if ((tmp = (uint8_t *)malloc(e->packed)) == NULL ||
+        !lzpack_io_read(lz, e->offset, tmp, e->packed)) {
+      free(tmp);
+      return 0;
+    }
+    src = tmp;
+  }
+  if (e->packed == e->size) {
+    memcpy(dst, src, e->size);
+    ok = 1;
+  } else {
+    ok = lzpack_decode(src, e->packed, (uint8_t *)dst, e->size);
+  }
+  free(tmp);
+  return ok;
+}
+
+#ifdef _arch_dreamcast
+#include <arch/timer.h>
+#include <kos/fs.h>
+#include <kos/nmmgr.h>
+#include <malloc.h>
+
+/* What the mounted pack has decoded so far */
+typedef struct {
+  uint32_t opens;
+  uint32_t decodes;    // files decoded, a file opened twice counts twice
+  uint32_t direct;     // of those, straight into the caller's buffer
+  uint64_t bytes;      // decoded
+  uint64_t decode_us;
+} lzpack_stats_t;
+
+static lzpack_t *lzpack_vfs_pack;
+static lzpack_stats_t lzpack_stats;
+
+typedef struct {
+  const lzpack_entry_t *e;
+  uint8_t *data;  // the whole file once decoded, NULL until then
+  int owned;      // data was allocated, not the pack itself
+  size_t pos;
+} lzpack_file_t;
+
+static int lzpack_vfs_decode(lzpack_file_t *f, uint8_t *dst) {
+  uint64_t t0 = timer_us_gettime64();
+  int ok = lzpack_read(lzpack_vfs_pack, f->e, dst);
+
+  if (!ok)
+    printf("Error: can't read %s from the pack\n", lzpack_vfs_pack->names + f->e->name);
+  lzpack_stats.decodes++;
+  lzpack_stats.bytes += f->e->size;
+  lzpack_stats.decode_us += timer_us_gettime64() - t0;
+  return ok;
+}
+
+/* A stored file of a pack in memory, used where it is */
+static const uint8_t *lzpack_vfs_in_place(const lzpack_file_t *f) {
+  if (!lzpack_vfs_pack->resident || f->e->packed != f->e->size)
+    return NULL;
+  return lzpack_cached(lzpack_vfs_pack, f->e);
+}
+
+/* The whole file in memory, for seeks, short reads and fs_mmap() */
+static uint8_t *lzpack_vfs_data(lzpack_file_t *f) {
+  if (f->data != NULL)
+    return f->data;
+  if ((f->data = (uint8_t *)lzpack_vfs_in_place(f)) != NULL)
+    return f->data;
+  f->data = (uint8_t *)memalign(LZPACK_ALIGN, f->e->size ? f->e->size : 1);
+  if (f->data == NULL) {
+    printf("Error: no memory to decode %s\n", lzpack_vfs_pack->names + f->e->name);
+    return NULL;
+  }
+  f->owned = 1;
+  if (!lzpack_vfs_decode(f, f->data)) {
+    free(f->data);
+    f->data = NULL;
+    f->owned = 0;
+  }
+  return f->data;
+}
+
+static void *lzpack_vfs_open(vfs_handler_t *vfs, const char *fn, int mode) {
+  const lzpack_entry_t *e;
+  lzpack_file_t *f;
+
+  (void)vfs;
+  if ((mode & O_MODE_MASK) != O_RDONLY || (mode & O_DIR))
+    return NULL;
+  if ((e = lzpack_find(lzpack_vfs_pack, fn)) == NULL)
+    return NULL;
+  if ((f = (lzpack_file_t *)calloc(1, sizeof(*f))) == NULL)
+    return NULL;
+  f->e = e;
+  lzpack_stats.opens++;
+  return f;
+}
+
+static int lzpack_vfs_close(void *hnd) {
+  lzpack_file_t *f = (lzpack_file_t *)hnd;
+
+  if (f->owned)
+    free(f->data);
+  free(f);
+  return 0;
+}
+
+static ssize_t lzpack_vfs_read(void *hnd, void *buf, size_t cnt) {
+  lzpack_file_t *f = (lzpack_file_t *)hnd;
+  size_t left = f->e->size - f->pos;
+
+  if (cnt > left)
+    cnt = left;
+  // The whole file in one go: no buffer of our own
+  if (f->data == NULL && f->pos == 0 && cnt == f->e->size && lzpack_vfs_in_place(f) == NULL) {
+    if (!lzpack_vfs_decode(f, (uint8_t *)buf))
+      return -1;
+    lzpack_stats.direct++;
+    f->pos = cnt;
+    return cnt;
+  }
+  if (cnt == 0)
+    return 0;
+  if (lzpack_vfs_data(f) == NULL)
+    return -1;
+  memcpy(buf, f->data + f->pos, cnt);
+  f->pos += cnt;
+  return cnt;
+}
+
+static off_t lzpack_vfs_seek(void *hnd, off_t offset, int whence) {
+  lzpack_file_t *f = (lzpack_file_t *)hnd;
+
+  if (whence == SEEK_CUR)
+    offset += f->pos;
+  else if (whence == SEEK_END)
+    offset += f->e->size;
+  if (offset < 0)
+    offset = 0;
+  if ((size_t)offset > f->e->size)
+    offset = f->e->size;
+  f->pos = offset;
+  return offset;
+}
+
+static off_t lzpack_vfs_tell(void *hnd) {
+  return ((lzpack_file_t *)hnd)->pos;
+}
+
+static size_t lzpack_vfs_total(void *hnd) {
+  return ((lzpack_file_t *)hnd)->e->size;
+}
+
+static void *lzpack_vfs_mmap(void *hnd) {
+  return lzpack_vfs_data((lzpack_file_t *)hnd);
+}
+
+static vfs_handler_t lzpack_vfs = {
+  .nmmgr = {
+    .pathname = "/rd",
+    .pid = 0,
+    .version = 0x00010000,
+    .flags = 0,
+    .type = NMMGR_TYPE_VFS,
+    .list_ent = NMMGR_LIST_INIT,
+  },
+  .open = lzpack_vfs_open,
+  .close = lzpack_vfs_close,
+  .read = lzpack_vfs_read,
+  .seek = lzpack_vfs_seek,
+  .tell = lzpack_vfs_tell,
+  .total = lzpack_vfs_total,
+  .mmap = lzpack_vfs_mmap,
+};
+
+/**
+ * @brief Mount an open pack, one at a time
+ *
+ * @param lz The pack, open until lzpack_unmount()
+ * @param mountpoint Where, "/rd" in place of KOS_INIT_ROMDISK()
+ * @return int 1 on success, 0 on failure
+ */
+static inline int lzpack_mount(lzpack_t *lz, const char *mountpoint) {
+  lzpack_vfs_pack = lz;
+  strncpy(lzpack_vfs.nmmgr.pathname, mountpoint, sizeof(lzpack_vfs.nmmgr.pathname) - 1);
+  if (nmmgr_handler_add(&lzpack_vfs.nmmgr) < 0) {
+    printf("Error: can't mount %s\n", mountpoint);
+    return 0;
+  }
+  return 1;
+}
+
+static inline void lzpack_unmount(void) {
+  nmmgr_handler_remove(&lzpack_vfs.nmmgr);
+}
+#endif
+
+#endif // LZPACK_H
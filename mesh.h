@@ -0,0 +1,207 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**  Indexed mesh file, shared by the host converter (tools/meshconv.c) and
+     the demos.
+
+     The file is laid out exactly as the renderer wants it in memory, so
+     loading is a single read, or on the romdisk no read at all: mesh_load()
+     maps the file and points straight into it. Every section starts on a
+     32 byte boundary from the start of the file:
+
+       mesh_hdr_t                  32 bytes
+       x, y, z                     float[vert_count] each
+       u, v                        float[vert_count] each, v = 0 at the top
+       group_first                 uint32_t[group_count + 1], the strips of
+                                   group g are group_first[g] up to
+                                   group_first[g + 1], one group per material
+       strip_first                 uint32_t[strip_count + 1], the indices of
+                                   strip s are strip_first[s] up to
+                                   strip_first[s + 1]
+       index                       uint16_t[index_count]
+
+     Positions come first as separate arrays, ready for vecsoa/vertpipe.
+     Everything is little endian like the SH4.                              */
+
+#define MESH_FOURCC "DCM1"
+#define MESH_ALIGN 32
+#define MESH_ALIGN_UP(n) (((n) + MESH_ALIGN - 1) & ~(MESH_ALIGN - 1))
+
+typedef struct {
+  char fourcc[4];             // "DCM1"
+  uint16_t vert_count;
+  uint16_t group_count;
+  uint32_t strip_count;
+  uint32_t index_count;
+  uint32_t file_size;         // header included
+  uint32_t reserved[3];
+} mesh_hdr_t;
+
+typedef struct {
+  int vert_count, group_count, strip_count, index_count;
+  float *x, *y, *z;
+  float *u, *v;
+  const uint32_t *group_first;
+  const uint32_t *strip_first;
+  const uint16_t *index;
+  void *mem;                  // our copy of the file, NULL when mapped
+  int fd;                     // open while mapped, -1 otherwise
+} mesh_t;
+
+/* Offsets of every section, from the counts alone */
+typedef struct {
+  uint32_t x, y, z, u, v, group_first, strip_first, index, end;
+} mesh_layout_t;
+
+static inline void mesh_layout(int verts, int groups, int strips, int indices,
+                               mesh_layout_t *l) {
+  uint32_t fsize = MESH_ALIGN_UP(verts * (uint32_t)sizeof(float));
+  l->x = MESH_ALIGN_UP((uint32_t)sizeof(mesh_hdr_t));
+  l->y = l->x + fsize;
+  l->z = l->y + fsize;
+  l->u = l->z + fsize;
+  l->v = l->u + fsize;
+  l->group_first = l->v + fsize;
+  l->strip_first = l->group_first + MESH_ALIGN_UP((groups + 1) * (uint32_t)sizeof(uint32_t));
+  l->index = l->strip_first + MESH_ALIGN_UP((strips + 1) * (uint32_t)sizeof(uint32_t));
+  l->end = l->index + MESH_ALIGN_UP(indices * (uint32_t)sizeof(uint16_t));
+}
+
+/* Point the mesh at a file image already in memory. 1 if it checks out:
+   the sizes, and every strip, group and index inside what the file holds,
+   so the renderers can index with them unchecked. */
+static inline int mesh_bind(mesh_t *m, uint8_t *base, size_t size) {
+  const mesh_hdr_t *h = (const mesh_hdr_t *)base;
+  const uint32_t *group_first, *strip_first;
+  const uint16_t *index;
+  mesh_layout_t l;
+
+  if (size < sizeof(mesh_hdr_t) || memcmp(h->fourcc, MESH_FOURCC, 4))
+    return 0;
+  mesh_layout(h->vert_count, h->group_count, h->strip_count, h->index_count, &l);
+  if (l.end != h->file_size || size < l.end)
+    return 0;
+  group_first = (const uint32_t *)(base + l.group_first);
+  strip_first = (const uint32_t *)(base + l.strip_first);
+  index = (const uint16_t *)(base + l.index);
+  if (group_first[0] != 0 || group_first[h->group_count] != h->strip_count ||
+      strip_first[0] != 0 || strip_first[h->strip_count] != h->index_count)
+    return 0;
+  for (uint32_t g = 0; g < h->group_count; g++)
+    if (group_first[g] > group_first[g + 1])
+      return 0;
+  for (uint32_t s = 0; s < h->strip_count; s++)
+    if (strip_first[s] > strip_first[s + 1])
+      return 0;
+  for (uint32_t i = 0; i < h->index_count; i++)
+    if (index[i] >= h->vert_count)
+      return 0;
+  m->vert_count = h->vert_count;
+  m->group_count = h->group_count;
+  m->strip_count = h->strip_count;
+  m->index_count = h->index_count;
+  m->x = (float *)(base + l.x);
+  m->y = (float *)(base + l.y);
+  m->z = (float *)(base + l.z);
+  m->u = (float *)(base + l.u);
+  m->v = (float *)(base + l.v);
+  m->group_first = group_first;
+  m->strip_first = strip_first;
+  m->index = index;
+  return 1;
+}
+
+#ifdef _arch_dreamcast
+#include <kos/fs.h>
+#include <malloc.h>
+
+/**
+ * @brief Load a mesh, mapped in place on the romdisk, read in one go elsewhere
+ *
+ * @param filename The mesh file
+ * @param m Filled in on success
+ * @return int 1 on success, 0 on failure
+ */
+static inline int mesh_load(const char *filename, mesh_t *m) {
+  file_t fd = fs_open(filename, O_RDONLY);
+  size_t size;
+  uint8_t *p;
+
+  memset(m, 0, sizeof(*m));
+  m->fd = -1;
+  if (fd < 0) {
+    printf("Error: mesh %s not found\n", filename);
+    return 0;
+  }
+  size = fs_total(fd);
+
+  // The romdisk hands out a pointer into its image
+  p = fs_mmap(fd);
+  if (p != NULL && ((uintptr_t)p & 3) == 0 && mesh_bind(m, p, size)) {
+    m->fd = fd;
+    return 1;
+  }
+
+  m->mem = memalign(MESH_ALIGN, size);
+  if (m->mem == NULL || fs_read(fd, m->mem, size) != (ssize_t)size ||
+      !mesh_bind(m, m->mem, size)) {
+    printf("Error: mesh %s is not a " MESH_FOURCC " file\n", filename);
+    free(m->mem);
+    m->mem = NULL;
+    fs_close(fd);
+    return 0;
+  }
+  fs_close(fd);
+  return 1;
+}
+
+static inline void mesh_unload(mesh_t *m) {
+  if (m->fd >= 0)
+    fs_close(m->fd);
+  free(m->mem);
+  memset(m, 0, sizeof(*m));
+  m->fd = -1;
+}
+
+#else
+
+static inline int mesh_load(const char *filename, mesh_t *m) {
+  FILE *fp = fopen(filename, "rb");
+  long size;
+
+  memset(m, 0, sizeof(*m));
+  m->fd = -1;
+  if (fp == NULL) {
+    printf("Error: mesh %s not found\n", filename);
+    return 0;
+  }
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  m->mem = malloc(size > 0 ? size : 1);
+  if (m->mem == NULL || fread(m->mem, 1, size, fp) != (size_t)size ||
+      !mesh_bind(m, m->mem, size)) {
+    printf("Error: mesh %s is not a " MESH_FOURCC " file\n", filename);
+    free(m->mem);
+    m->mem = NULL;
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+  return 1;
+}
+
+static inline void mesh_unload(mesh_t *m) {
+  free(m->mem);
+  memset(m, 0, sizeof(*m));
+  m->fd = -1;
+}
+
+#endif
+
+#endif // MESH_H
@@ -0,0 +1,58 @@
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <dc/pvr.h>
+
+#ifndef OVERDRAW
+#define OVERDRAW 0 // Set to 1 to draw an overdraw heatmap instead of the scene
+#endif
+
+/**  Overdraw heatmap builds.
+
+     With OVERDRAW set to 1 every context passed through overdraw_poly_cxt()
+     or overdraw_sprite_cxt() loses its texture, specular and fog and blends
+     ONE, ONE, and every colour passed through OVERDRAW_ARGB() becomes
+     OVERDRAW_STEP. Each layer the TSP shades then adds one step to the
+     pixel and the screen counts the layers: 0x20 a channel is one, white is
+     eight or more. Depth compare and culling are left as they were, so what
+     adds up is what the hardware really shades: one layer a pixel for the
+     opaque and punch-through lists, however many are behind it, and every
+     translucent layer that is not hidden.
+
+     The vertices stay as they are: a packed colour is in the same place
+     with or without a texture, and the UVs are ignored.
+
+     tools/pvrrender -d draws the same from a recorded stream on the host
+     and prints the numbers per tile.                                       */
+
+#define OVERDRAW_STEP 0xFF202020
+
+#define OVERDRAW_ARGB(argb) (OVERDRAW ? OVERDRAW_STEP : (uint32)(argb))
+
+static inline void overdraw_poly_cxt(pvr_poly_cxt_t *cxt) {
+#if OVERDRAW
+  cxt->txr.enable = PVR_TEXTURE_DISABLE;
+  cxt->gen.alpha = PVR_ALPHA_DISABLE;
+  cxt->gen.fog_type = PVR_FOG_DISABLE;
+  cxt->gen.specular = PVR_SPECULAR_DISABLE;
+  cxt->blend.src = PVR_BLEND_ONE;
+  cxt->blend.dst = PVR_BLEND_ONE;
+#else
+  (void)cxt;
+#endif
+}
+
+static inline void overdraw_sprite_cxt(pvr_sprite_cxt_t *cxt) {
+#if OVERDRAW
+  cxt->txr.enable = PVR_TEXTURE_DISABLE;
+  cxt->gen.alpha = PVR_ALPHA_DISABLE;
+  cxt->gen.fog_type = PVR_FOG_DISABLE;
+  cxt->gen.specular = PVR_SPECULAR_DISABLE;
+  cxt->blend.src = PVR_BLEND_ONE;
+  cxt->blend.dst = PVR_BLEND_ONE;
+#else
+  (void)cxt;
+#endif
+}
+
+#endif // OVERDRAW_H
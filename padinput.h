@@ -0,0 +1,305 @@
+#ifndef PADINPUT_H
+#define PADINPUT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _arch_dreamcast
+#include <arch/timer.h>
+#include <dc/maple.h>
+#include <dc/maple/controller.h>
+#include <kos/thread.h>
+#endif
+
+/**  Controller input polled on its own thread.
+
+     Reading maple from the render loop costs a maple_enum_type() and a
+     status copy per port every frame, and edges have to be worked out
+     there with per port bit tricks. Here a thread polls every port at a
+     fixed rate and publishes one 32 byte snapshot: the buttons held on any
+     pad, the sticks and triggers, and the press, release and repeat events
+     as toggle bits. The render loop reads that one cache line.
+
+     Publishing is lock free. The snapshot is double buffered; the poller
+     writes the copy readers are not pointed at, then bumps the sequence
+     number. A reader that was preempted long enough for the poller to
+     start on its copy again sees the sequence move by two and reads again.
+     On the single SH4 that only happens if the poller runs in the middle
+     of the 32 byte copy.
+
+     Events are toggles rather than flags: each press flips its button's
+     bit in pressed_t. A reader keeps the toggles it saw last and XORs, so
+     it sees a button's event if there was an odd number of them since its
+     last read, however many polls happened in between, and any number of
+     readers can follow the same snapshot. A tap shorter than a frame still
+     shows up as a press and a release. Two presses of one button between
+     reads cancel out; maple refreshes at 60Hz, so that takes a reader
+     missing at least two frames. Counters per button would not fit the
+     one cache line.
+
+       padinput_init(&pad, &padinput_backend_maple, 4000);
+       padinput_start(&pad, PRIO_DEFAULT - 1);
+       ...
+       padinput_read(&pad, &view);     // once a frame
+       if (view.pressed & CONT_DPAD_RIGHT) ...
+
+     padinput_update() is the whole poller minus the thread and the clock,
+     tools/padcheck drives it on the host.                                  */
+
+#define PADINPUT_PORTS 4
+#define PADINPUT_REPEAT_DELAY_US 400000 // held this long before repeating
+#define PADINPUT_REPEAT_RATE_US  100000 // then a repeat this often
+
+/* One port as polled */
+typedef struct {
+  uint32_t buttons;
+  int joyx, joyy;        // -128 to 127
+  int ltrig, rtrig;      // 0 to 255
+} padinput_raw_t;
+
+typedef struct padinput_backend {
+  int (*poll)(void *ctx, int port, padinput_raw_t *out); // 0 if nothing in the port
+  uint64_t (*now_us)(void *ctx);
+  void *ctx;
+} padinput_backend_t;
+
+/* What the poller publishes, one cache line */
+typedef struct {
+  uint32_t seq;          // snapshots published
+  uint32_t time_us;      // when polled, low 32 bits of the clock
+  uint32_t change_us;    // when the buttons last changed
+  uint16_t buttons;      // held on any pad
+  uint16_t pressed_t;    // a button's bit flips on every press,
+  uint16_t released_t;   // ... release,
+  uint16_t repeat_t;     // ... and repeat while held
+  int16_t joyx, joyy;    // summed over the pads, clamped
+  uint8_t ltrig, rtrig;  // the most any pad has
+  uint8_t ports;         // bit per port with a controller
+  uint8_t pad[5];
+} __attribute__((aligned(32))) padinput_snap_t;
+
+/* A reader's view: the snapshot and the buttons with an odd number of
+   each event since its last read */
+typedef struct {
+  padinput_snap_t snap;
+  uint16_t pressed, released, repeat;
+  uint32_t retries;      // reads the poller got in the middle of
+} padinput_view_t;
+
+typedef struct {
+  padinput_snap_t buf[2];
+  volatile uint32_t begun;      // seq of the snapshot being written
+  volatile uint32_t published;  // seq of the newest complete one
+  padinput_backend_t be;
+  uint32_t period_us;
+  // poller state
+  padinput_snap_t next;
+  uint64_t next_repeat[16];
+  volatile int running;
+#ifdef _arch_dreamcast
+  kthread_t *thread;
+#endif
+  uint32_t polls;
+  uint64_t poll_us;             // time spent polling, for the cost report
+} padinput_t;
+
+#ifdef _arch_dreamcast
+/* One CPU: only the compiler can reorder */
+#define PADINPUT_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define PADINPUT_BARRIER() __sync_synchronize()
+#endif
+
+/**
+ * @brief Set up, nothing polled yet
+ *
+ * @param p Input service
+ * @param backend Where the pads come from, copied
+ * @param period_us Time between polls; maple refreshes at 60Hz, 4000 sees
+ *                  every refresh within 4ms
+ */
+static inline void padinput_init(padinput_t *p, const padinput_backend_t *backend,
+                                 uint32_t period_us) {
+  memset(p, 0, sizeof(*p));
+  p->be = *backend;
+  p->period_us = period_us;
+}
+
+static inline int padinput_clamp(int v, int lo, int hi) {
+  return v < lo ? lo : v > hi ? hi : v;
+}
+
+/**
+ * @brief Fold one poll of every port into a snapshot and publish it
+ *
+ * @param p Input service
+ * @param raw The ports, raw[i] only read if bit i of ports is set
+ * @param ports Bit per port with a controller
+ * @param now_us Clock at the poll
+ */
+static inline void padinput_update(padinput_t *p, const padinput_raw_t *raw, int ports,
+                                   uint64_t now_us) {
+  padinput_snap_t *n = &p->next;
+  uint16_t buttons = 0, down, up, repeat = 0;
+  int joyx = 0, joyy = 0, ltrig = 0, rtrig = 0;
+
+  for (int i = 0; i < PADINPUT_PORTS; i++) {
+    if (!(ports & (1 << i)))
+      continue;
+    buttons |= (uint16_t)raw[i].buttons;
+    joyx += raw[i].joyx;
+    joyy += raw[i].joyy;
+    if (raw[i].ltrig > ltrig)
+      ltrig = raw[i].ltrig;
+    if (raw[i].rtrig > rtrig)
+      rtrig = raw[i].rtrig;
+  }
+
+  down = buttons & ~n->buttons;
+  up = n->buttons & ~buttons;
+  for (int b = 0; b < 16; b++) {
+    uint16_t bit = 1 << b;
+    if (down & bit) {
+      p->next_repeat[b] = now_us + PADINPUT_REPEAT_DELAY_US;
+    } else if ((buttons & bit) && now_us >= p->next_repeat[b]) {
+      repeat |= bit;
+      p->next_repeat[b] += PADINPUT_REPEAT_RATE_US;
+      if (p->next_repeat[b] <= now_us)
+        p->next_repeat[b] = now_us + PADINPUT_REPEAT_RATE_US;
+    }
+  }
+
+  if (down | up)
+    n->change_us = (uint32_t)now_us;
+  n->time_us = (uint32_t)now_us;
+  n->buttons = buttons;
+  n->pressed_t ^= down;
+  n->released_t ^= up;
+  n->repeat_t ^= repeat;
+  n->joyx = (int16_t)padinput_clamp(joyx, -128, 127);
+  n->joyy = (int16_t)padinput_clamp(joyy, -128, 127);
+  n->ltrig = (uint8_t)ltrig;
+  n->rtrig = (uint8_t)rtrig;
+  n->ports = (uint8_t)ports;
+
+  // Write the copy readers are not pointed at, then point them at it
+  n->seq = p->published + 1;
+  p->begun = n->seq;
+  PADINPUT_BARRIER();
+  p->buf[n->seq & 1] = *n;
+  PADINPUT_BARRIER();
+  p->published = n->seq;
+}
+
+/* Poll every port through the backend and publish */
+static inline void padinput_poll(padinput_t *p) {
+  padinput_raw_t raw[PADINPUT_PORTS];
+  uint64_t t0 = p->be.now_us(p->be.ctx);
+  int ports = 0;
+
+  for (int i = 0; i < PADINPUT_PORTS; i++) {
+    if (p->be.poll(p->be.ctx, i, &raw[i]))
+      ports |= 1 << i;
+  }
+  padinput_update(p, raw, ports, t0);
+  p->polls++;
+  p->poll_us += p->be.now_us(p->be.ctx) - t0;
+}
+
+/**
+ * @brief Copy the newest snapshot and work out the events since the last read
+ *
+ * Never blocks; the view starts zeroed for a first read.
+ */
+static inline void padinput_read(padinput_t *p, padinput_view_t *v) {
+  padinput_snap_t old = v->snap;
+
+  for (;;) {
+    uint32_t seq = p->published;
+    PADINPUT_BARRIER();
+    v->snap = p->buf[seq & 1];
+    PADINPUT_BARRIER();
+    // The poller only writes this copy again once it starts on seq + 2
+    if (p->begun - seq < 2)
+      break;
+    v->retries++;
+  }
+  v->pressed = v->snap.pressed_t ^ old.pressed_t;
+  v->released = v->snap.released_t ^ old.released_t;
+  v->repeat = v->snap.repeat_t ^ old.repeat_t;
+}
+
+#ifdef _arch_dreamcast
+static inline int padinput_maple_poll(void *ctx, int port, padinput_raw_t *out) {
+  maple_device_t *dev = maple_enum_type(port, MAPLE_FUNC_CONTROLLER);
+  cont_state_t *state;
+  (void)ctx;
+
+  if (dev == NULL || (state = (cont_state_t *)maple_dev_status(dev)) == NULL)
+    return 0;
+  out->buttons = state->buttons;
+  out->joyx = state->joyx;
+  out->joyy = state->joyy;
+  out->ltrig = state->ltrig;
+  out->rtrig = state->rtrig;
+  return 1;
+}
+
+static inline uint64_t padinput_maple_now_us(void *ctx) {
+  (void)ctx;
+  return timer_us_gettime64();
+}
+
+static const padinput_backend_t padinput_backend_maple = {
+  padinput_maple_poll, padinput_maple_now_us, NULL
+};
+
+static inline void *padinput_thread(void *param) {
+  padinput_t *p = (padinput_t *)param;
+  uint64_t next = timer_us_gettime64();
+
+  while (p->running) {
+    uint64_t now;
+    padinput_poll(p);
+    // Keep to the period however long the poll took
+    next += p->period_us;
+    now = timer_us_gettime64();
+    if (next > now)
+      thd_sleep((int)((next - now + 999) / 1000));
+    else
+      next = now;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Poll once now, then keep polling on a thread
+ *
+ * @param prio Thread priority, above the render loop so a long frame
+ *             cannot hold input up
+ * @return int 1 on success, 0 if the thread could not be created
+ */
+static inline int padinput_start(padinput_t *p, int prio) {
+  padinput_poll(p);
+  p->running = 1;
+  p->thread = thd_create(0, padinput_thread, p);
+  if (p->thread == NULL) {
+    printf("Error: padinput thread create failed\n");
+    p->running = 0;
+    return 0;
+  }
+  thd_set_prio(p->thread, prio);
+  return 1;
+}
+
+static inline void padinput_stop(padinput_t *p) {
+  if (!p->running)
+    return;
+  p->running = 0;
+  thd_join(p->thread, NULL);
+  p->thread = NULL;
+}
+#endif
+
+#endif // PADINPUT_H
@@ -0,0 +1,206 @@
+#ifndef PADREC_H
+#define PADREC_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "padinput.h"
+
+/**  Controller input recorded per simulation step, and played back.
+
+     Timing runs are only comparable if the pad does the same thing every
+     time. The recorder logs what a step saw of the pad: the buttons held,
+     the presses and releases since the last step, the sticks and the
+     triggers. Playback hands exactly that back, one record per step, so a
+     replayed run simulates the same frames whatever the frame rate.
+
+     File layout, little endian like the SH4:
+
+       padrec_hdr_t                16 bytes, "DCIN"
+       padrec_rec_t[rec_count]     12 bytes each
+
+     A record covers repeat steps in a row with the same input; an idle pad
+     costs 12 bytes however long it sits there. Presses and releases only
+     happen on the first step of a record.
+
+     tools/padrec compiles text scripts to this format and dumps recordings
+     back to text.                                                          */
+
+#define PADREC_FOURCC "DCIN"
+#define PADREC_VERSION 1
+
+typedef struct {
+  char fourcc[4];           // "DCIN"
+  uint16_t version;
+  uint16_t hz;              // simulation steps per second when recorded
+  uint32_t steps;
+  uint32_t rec_count;
+} padrec_hdr_t;
+
+typedef struct {
+  uint16_t repeat;          // steps this record covers, 1 or more
+  uint16_t buttons;
+  uint16_t pressed;         // on the first step only
+  uint16_t released;
+  int8_t joyx, joyy;
+  uint8_t ltrig, rtrig;
+} padrec_rec_t;
+
+typedef struct {
+  padrec_hdr_t hdr;
+  padrec_rec_t *recs;
+  uint32_t cap;
+  // playback
+  uint32_t next;            // record
+  uint32_t left;            // steps left in recs[next - 1]
+} padrec_t;
+
+static inline void padrec_init(padrec_t *r, uint16_t hz) {
+  memset(r, 0, sizeof(*r));
+  memcpy(r->hdr.fourcc, PADREC_FOURCC, 4);
+  r->hdr.version = PADREC_VERSION;
+  r->hdr.hz = hz;
+}
+
+static inline void padrec_free(padrec_t *r) {
+  free(r->recs);
+  r->recs = NULL;
+  r->cap = r->hdr.rec_count = r->hdr.steps = 0;
+}
+
+/**
+ * @brief Append one step
+ *
+ * @return int 1, or 0 when out of memory (the step is lost)
+ */
+static inline int padrec_add(padrec_t *r, const padrec_rec_t *in) {
+  padrec_rec_t *last = r->hdr.rec_count ? &r->recs[r->hdr.rec_count - 1] : NULL;
+
+  if (last && !in->pressed && !in->released && last->repeat < 0xffff &&
+      last->buttons == in->buttons && last->joyx == in->joyx && last->joyy == in->joyy &&
+      last->ltrig == in->ltrig && last->rtrig == in->rtrig) {
+    last->repeat++;
+    r->hdr.steps++;
+    return 1;
+  }
+  if (r->hdr.rec_count == r->cap) {
+    uint32_t cap = r->cap ? r->cap * 2 : 256;
+    padrec_rec_t *recs = realloc(r->recs, cap * sizeof(padrec_rec_t));
+    if (recs == NULL) {
+      printf("Error: padrec out of memory at step %u\n", (unsigned)r->hdr.steps);
+      return 0;
+    }
+    r->recs = recs;
+    r->cap = cap;
+  }
+  r->recs[r->hdr.rec_count] = *in;
+  r->recs[r->hdr.rec_count].repeat = 1;
+  r->hdr.rec_count++;
+  r->hdr.steps++;
+  return 1;
+}
+
+/* Record the input a step saw, from a padinput view */
+static inline int padrec_record(padrec_t *r, const padinput_view_t *v) {
+  padrec_rec_t in;
+  in.repeat = 1;
+  in.buttons = v->snap.buttons;
+  in.pressed = v->pressed;
+  in.released = v->released;
+  in.joyx = (int8_t)v->snap.joyx;
+  in.joyy = (int8_t)v->snap.joyy;
+  in.ltrig = v->snap.ltrig;
+  in.rtrig = v->snap.rtrig;
+  return padrec_add(r, &in);
+}
+
+/**
+ * @brief Load a recording for playback
+ *
+ * @return int 1 on success, 0 on a missing or bad file
+ */
+static inline int padrec_load(const char *filename, padrec_t *r) {
+  FILE *fp = fopen(filename, "rb");
+  size_t n;
+
+  memset(r, 0, sizeof(*r));
+  if (fp == NULL) {
+    printf("Error: fopen %s failed, %s\n", filename, strerror(errno));
+    return 0;
+  }
+  if (fread(&r->hdr, sizeof(r->hdr), 1, fp) != 1 ||
+      memcmp(r->hdr.fourcc, PADREC_FOURCC, 4) != 0 || r->hdr.version != PADREC_VERSION) {
+    printf("Error: %s is not a pad recording\n", filename);
+    fclose(fp);
+    return 0;
+  }
+  n = r->hdr.rec_count;
+  r->recs = malloc(n ? n * sizeof(padrec_rec_t) : 1);
+  if (r->recs == NULL || fread(r->recs, sizeof(padrec_rec_t), n, fp) != n) {
+    printf("Error: %s is truncated\n", filename);
+    fclose(fp);
+    padrec_free(r);
+    return 0;
+  }
+  fclose(fp);
+  r->cap = r->hdr.rec_count;
+  return 1;
+}
+
+static inline int padrec_save(const char *filename, const padrec_t *r) {
+  FILE *fp = fopen(filename, "wb");
+  int ok;
+
+  if (fp == NULL) {
+    printf("Error: fopen %s failed, %s\n", filename, strerror(errno));
+    return 0;
+  }
+  ok = fwrite(&r->hdr, sizeof(r->hdr), 1, fp) == 1 &&
+       fwrite(r->recs, sizeof(padrec_rec_t), r->hdr.rec_count, fp) == r->hdr.rec_count;
+  if (fclose(fp) != 0)
+    ok = 0;
+  if (!ok)
+    printf("Error: writing %s failed\n", filename);
+  return ok;
+}
+
+/**
+ * @brief The next step's input, in the same view padinput_read() fills
+ *
+ * @return int 1, or 0 once the recording has run out (v is then idle)
+ */
+static inline int padrec_play(padrec_t *r, padinput_view_t *v) {
+  const padrec_rec_t *in;
+
+  v->pressed = v->released = v->repeat = 0;
+  if (r->left == 0) {
+    if (r->next >= r->hdr.rec_count) {
+      memset(&v->snap, 0, sizeof(v->snap));
+      return 0;
+    }
+    in = &r->recs[r->next++];
+    r->left = in->repeat;
+    v->pressed = in->pressed;
+    v->released = in->released;
+  }
+  in = &r->recs[r->next - 1];
+  r->left--;
+  v->snap.seq++;
+  v->snap.buttons = in->buttons;
+  v->snap.joyx = in->joyx;
+  v->snap.joyy = in->joyy;
+  v->snap.ltrig = in->ltrig;
+  v->snap.rtrig = in->rtrig;
+  v->snap.ports = 1;
+  return 1;
+}
+
+/* Back to the first step */
+static inline void padrec_rewind(padrec_t *r) {
+  r->next = r->left = 0;
+}
+
+#endif // PADREC_H
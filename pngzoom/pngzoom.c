@@ -14,43 +14,140 @@
 /* Description:                                                                             */
 /* The purpose of this example is to show pngzoom out then in and back out to a new image.  */
 /* Very much like demo disk or loading TRANSITION                                           */
+/* The backgrounds are VQ textures converted at build time, in strips so a 640x480 image    */
+/* shows pixel for pixel (tools/pngstrip.c), about 8x smaller than ARGB4444 and loaded as   */
+/* they are instead of decoded from PNG on the SH4.                                          */
+/* Only one background is in texture memory: crossing zoom 1.0 snapshots the screen with    */
+/* render to texture (../transition.h), frees the old one and streams the other in on a     */
+/* thread while the snapshot zooms or fades away on top of it.                              */
 /* History: version 1                                                                       */
 /********************************************************************************************/
 /********************************************************************************************/
 /*                                                                                          */
 /********************************************************************************************/ 
 #include <kos.h>        /*Includes necessary KallistiOS (KOS) headers for Dreamcast development */
-#include <png/png.h>    /* PNG library headers for handling PNG images. */
-#include <zlib/zlib.h>  /* Zlib library headers for data compression and decompression.*/
 #include <stdlib.h>     /* standard library headers for general-purpose functions.*/
 #include <assert.h>     /* assert library headers for runtime assertion checking.*/
 #include <math.h>       /*Standard slower math library headers for mathematical function.*/
 #include <stdbool.h>    /* boolean library headers for C99 boolean type.*/
+#include "../fixedstep.h" /* Fixed timestep updates and vblank frame pacing.*/
+#include "../transition.h" /* Render to texture scene transitions.*/
+#include "../pvrtex.h"  /* texture management, single header code */
 
 // Declare the external ROM disk
 extern uint8 romdisk_boot[];
 KOS_INIT_ROMDISK(romdisk_boot);
 
-// Declare global texture pointers
-pvr_ptr_t back_tex_normal;
-pvr_ptr_t back_tex_zoomed;
-pvr_ptr_t current_tex; // Current texture used for drawing
+// The two backgrounds, only one of them loaded at a time
+#define BACK_NORMAL 0
+#define BACK_ZOOMED 1
+const char *back_files[2] = { "/rd/background_normal", "/rd/background_zoomed" };
+
+// A background: <name>.bgs says how big the image is, the strips are
+// <name>_0.dt, <name>_1.dt, ... left to right. Written by tools/pngstrip.
+#define BACK_MAX_STRIPS 8
+
+typedef struct {
+    char magic[4]; // "BGS1"
+    uint16_t width, height; // The image, the strips are at least as big
+    uint16_t strips;
+    uint16_t pad;
+} back_index_t;
+
+typedef struct {
+    uint16_t width, height;
+    int strips;
+    dttex_info_t strip[BACK_MAX_STRIPS];
+} background_t;
+
+background_t current_back; // Current background used for drawing
+int back_shown = BACK_NORMAL;  // The one in current_back
+int back_wanted = BACK_NORMAL; // The one the zoom level asks for
+
+// Swapping backgrounds goes through a transition, 0.5s once the new one is loaded
+#define TRANSITION_STEPS 30
+transition_t trans;
+int trans_running = 0;
 
 // Initialize the zoom level
 float zoom_level = 1.0f;
+float prev_zoom_level = 1.0f; // Zoom level one step back, for drawing between steps
+
+// The zoom moves in fixed 60Hz steps whatever the frame rate, each frame
+// starts on a vblank. 3.0 per second is what 0.1 a frame with the old
+// 18ms sleeps came to.
+#define SIM_HZ 60
+#define ZOOM_PER_SEC 3.0f
+#define FRAME_VBLANKS 1 // 2 for 30fps, the zoom speed stays the same
+
+fixedstep_t sim_clock;
+vblank_pacer_t pacer;
+int pacing = 0; // vblank_pacer_init() worked
 
 /**
- * @brief Initialize background textures.
+ * @brief Free a background's strips.
+ * @param back The background.
  */
-void back_init() {
-    back_tex_normal = pvr_mem_malloc(512 * 512 * 2);
-    png_to_texture("/rd/background_normal.png", back_tex_normal, PNG_FULL_ALPHA);
+void back_free(background_t *back) {
+    for (int i = 0; i < back->strips; i++) {
+        pvrtex_unload(&back->strip[i]);
+    }
+    back->strips = 0;
+}
 
-    back_tex_zoomed = pvr_mem_malloc(512 * 512 * 2);
-    png_to_texture("/rd/background_zoomed.png", back_tex_zoomed, PNG_FULL_ALPHA);
+/**
+ * @brief Load a background, each strip in texture memory of its exact size.
+ * @param back The background to fill.
+ * @param name Its path without the extension.
+ * @return 1 on success, 0 on failure.
+ */
+int back_load(background_t *back, const char *name) {
+    back_index_t index;
+    char path[256];
+    FILE *fp;
+
+    back->strips = 0;
+    snprintf(path, sizeof(path), "%s.bgs", name);
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        printf("Error: fopen %s failed\n", path);
+        return 0;
+    }
+    if (fread(&index, sizeof(index), 1, fp) != 1 || memcmp(index.magic, "BGS1", 4) ||
+        index.strips == 0 || index.strips > BACK_MAX_STRIPS) {
+        printf("Error: %s is not a background index\n", path);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+
+    back->width = index.width;
+    back->height = index.height;
+    for (int i = 0; i < index.strips; i++) {
+        snprintf(path, sizeof(path), "%s_%d.dt", name, i);
+        if (!pvrtex_load(path, &back->strip[i])) {
+            back_free(back);
+            return 0;
+        }
+        back->strips = i + 1;
+    }
+    return 1;
+}
 
-    // Set the initial texture to normal
-    current_tex = back_tex_normal;
+/**
+ * @brief Load a background on the transition's thread.
+ * @param arg Its name, from back_files.
+ * @return 1 on success, 0 on failure.
+ */
+int back_load_thread(void *arg) {
+    return back_load(&current_back, (const char *)arg);
+}
+
+/**
+ * @brief Initialize the background, the normal one to start with.
+ */
+void back_init() {
+    back_load(&current_back, back_files[BACK_NORMAL]);
 }
 
 /**
@@ -61,73 +158,164 @@ void draw_back(float zoom) {
     pvr_poly_cxt_t cxt;
     pvr_poly_hdr_t hdr;
     pvr_vertex_t vert;
-
-    // Set up the polygon context for the background texture
-    pvr_poly_cxt_txr(&cxt, PVR_LIST_TR_POLY, PVR_TXRFMT_ARGB4444, 512, 512, current_tex, PVR_FILTER_BILINEAR);
-    pvr_poly_compile(&hdr, &cxt);
-    pvr_prim(&hdr, sizeof(hdr));
+    int x = 0; // Where the strip starts in the image
 
     vert.argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
     vert.oargb = 0;
-    vert.flags = PVR_CMD_VERTEX;
-
-    float width = 640 * zoom;
-    float height = 480 * zoom;
-
-    // Draw the textured quad with the specified zoom level
-    vert.x = 320 - width / 2;
-    vert.y = 240 - height / 2;
     vert.z = 1;
-    vert.u = 0.0;
-    vert.v = 0.0;
-    pvr_prim(&vert, sizeof(vert));
-
-    vert.x = 320 + width / 2;
-    vert.y = 240 - height / 2;
-    vert.u = 1.0;
-    pvr_prim(&vert, sizeof(vert));
-
-    vert.x = 320 - width / 2;
-    vert.y = 240 + height / 2;
-    vert.u = 0.0;
-    vert.v = 1.0;
-    pvr_prim(&vert, sizeof(vert));
-
-    vert.x = 320 + width / 2;
-    vert.y = 240 + height / 2;
-    vert.u = 1.0;
-    vert.v = 1.0;
-    vert.flags = PVR_CMD_VERTEX_EOL;
-    pvr_prim(&vert, sizeof(vert));
+
+    // The image fills the screen at zoom 1, one quad per strip
+    float scale_x = 640.0f / current_back.width * zoom;
+    float scale_y = 480.0f / current_back.height * zoom;
+    float top = 240 - current_back.height * scale_y / 2;
+    float bottom = 240 + current_back.height * scale_y / 2;
+
+    for (int i = 0; i < current_back.strips; i++) {
+        dttex_info_t *strip = &current_back.strip[i];
+        int used = current_back.width - x < strip->width ? current_back.width - x : strip->width;
+        float left = 320 + (x - current_back.width / 2.0f) * scale_x;
+        float right = left + used * scale_x;
+        float u = (float)used / strip->width;
+        float v = (float)current_back.height / strip->height;
+
+        // Opaque, and clamped so no strip's filtering wraps round to its other edge
+        pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY, strip->pvrformat, strip->width, strip->height,
+                         strip->ptr, PVR_FILTER_BILINEAR);
+        cxt.txr.uv_clamp = PVR_UVCLAMP_UV;
+        pvr_poly_compile(&hdr, &cxt);
+        pvr_prim(&hdr, sizeof(hdr));
+
+        vert.flags = PVR_CMD_VERTEX;
+        vert.x = left;
+        vert.y = top;
+        vert.u = 0.0;
+        vert.v = 0.0;
+        pvr_prim(&vert, sizeof(vert));
+
+        vert.x = right;
+        vert.u = u;
+        pvr_prim(&vert, sizeof(vert));
+
+        vert.x = left;
+        vert.y = bottom;
+        vert.u = 0.0;
+        vert.v = v;
+        pvr_prim(&vert, sizeof(vert));
+
+        vert.x = right;
+        vert.u = u;
+        vert.flags = PVR_CMD_VERTEX_EOL;
+        pvr_prim(&vert, sizeof(vert));
+
+        x += strip->width;
+    }
 }
 
 /**
- * @brief Adjust zoom level based on controller input.
- * @param state Pointer to the controller state structure.
+ * @brief Adjust zoom level based on controller input, one simulation step.
+ * @param buttons Buttons held.
+ * @param dt Seconds per step.
  */
-void zoom_in_out(cont_state_t *state) {
-    if (state->buttons & CONT_A) {
+void zoom_in_out(uint32 buttons, float dt) {
+    prev_zoom_level = zoom_level;
+    if (buttons & CONT_A) {
         // Zoom out
-        if (zoom_level > 0.0f) {
-            zoom_level -= 0.1f;
-        } else {
+        zoom_level -= ZOOM_PER_SEC * dt;
+        if (zoom_level < 0.0f) {
             zoom_level = 0.0f;
         }
-    } else if (state->buttons & CONT_B) {
+    } else if (buttons & CONT_B) {
         // Zoom in
-        if (zoom_level < 1.1f) {
-            zoom_level += 0.1f;
-        } else {
+        zoom_level += ZOOM_PER_SEC * dt;
+        if (zoom_level > 1.1f) {
             zoom_level = 1.1f;
         }
     }
 
-    // Determine which texture to use based on the zoom level
-    if (zoom_level <= 1.0f) {
-        current_tex = back_tex_normal;
+    // Determine which background to use based on the zoom level, present()
+    // swaps to it
+    back_wanted = zoom_level <= 1.0f ? BACK_NORMAL : BACK_ZOOMED;
+
+    if (trans_running) {
+        transition_step(&trans);
+    }
+}
+
+/**
+ * @brief Run the simulation steps due, holding the given buttons.
+ * @param buttons Buttons held.
+ * @return Where to draw between the last two steps, 0 to 1.
+ */
+float step_zoom(uint32 buttons) {
+    int steps = fixedstep_advance(&sim_clock, timer_us_gettime64());
+    while (steps--) {
+        zoom_in_out(buttons, fixedstep_dt(&sim_clock));
+    }
+    return fixedstep_alpha(&sim_clock);
+}
+
+/**
+ * @brief Draw the outgoing scene for the transition snapshot.
+ * @param arg The zoom level to draw.
+ */
+void draw_outgoing(void *arg) {
+    pvr_list_begin(PVR_LIST_OP_POLY);
+    draw_back(*(float *)arg);
+    pvr_list_finish();
+}
+
+/**
+ * @brief Swap to the background the zoom level wants, through a transition.
+ * Called after pvr_wait_ready(). transition_begin() waits for the snapshot's
+ * render, so once it returns nothing is drawing with the old one.
+ * @param zoom The zoom level on screen.
+ */
+void swap_back(float zoom) {
+    transition_kind_t kind = back_wanted == BACK_ZOOMED ? TRANSITION_ZOOM : TRANSITION_CROSSFADE;
+
+    trans_running = transition_begin(&trans, kind, TRANSITION_STEPS, draw_outgoing, &zoom);
+    // The snapshot holds the old background now, or with no room for it the
+    // new one is loaded here and simply replaces it
+    back_free(&current_back);
+    back_shown = back_wanted;
+    if (trans_running) {
+        transition_load(&trans, back_load_thread, (void *)back_files[back_shown]);
     } else {
-        current_tex = back_tex_zoomed;
+        back_load(&current_back, back_files[back_shown]);
+    }
+    fixedstep_init(&sim_clock, SIM_HZ, timer_us_gettime64()); // The capture is not a stall
+}
+
+/**
+ * @brief Wait for the next frame's vblank and draw one frame.
+ * @param zoom The zoom level to draw.
+ * @param alpha Where between the last two steps, for the transition.
+ */
+void present(float zoom, float alpha) {
+    if (pacing) {
+        vblank_pacer_wait(&pacer, FRAME_VBLANKS);
+    }
+    pvr_wait_ready();
+    // transition_end() waits for the last frame that drew the snapshot
+    if (trans_running && transition_done(&trans)) {
+        transition_end(&trans);
+        trans_running = 0;
+    }
+    if (!trans_running && back_wanted != back_shown) {
+        swap_back(zoom);
     }
+    pvr_scene_begin();
+    pvr_list_begin(PVR_LIST_OP_POLY);
+    if (!trans_running || transition_loaded(&trans)) {
+        draw_back(zoom);
+    }
+    pvr_list_finish();
+    if (trans_running) {
+        pvr_list_begin(PVR_LIST_TR_POLY);
+        transition_draw(&trans, alpha);
+        pvr_list_finish();
+    }
+    pvr_scene_finish();
 }
 
 // PVR initialization parameters
@@ -154,66 +342,49 @@ int main() {
     int done = 0; // Flag to exit the loop
     float preset_zoom = 2.0f; // Start with maximum zoom
     float current_zoom = preset_zoom;
+    float prev_zoom = preset_zoom;
+
+    pacing = vblank_pacer_init(&pacer);
+    fixedstep_init(&sim_clock, SIM_HZ, timer_us_gettime64());
 
     // Zoom-out phase
     while (current_zoom > 1.0f) {
-        current_zoom -= 0.1f;
-
-        pvr_wait_ready();
-        pvr_scene_begin();
-        pvr_list_begin(PVR_LIST_TR_POLY);
-        draw_back(current_zoom);
-        pvr_list_finish();
-        pvr_scene_finish();
-
-        thd_sleep(18); // Wait for a short delay to visualize the zoom effect
+        int steps = fixedstep_advance(&sim_clock, timer_us_gettime64());
+        while (steps--) {
+            prev_zoom = current_zoom;
+            current_zoom -= ZOOM_PER_SEC * fixedstep_dt(&sim_clock);
+        }
+        float alpha = fixedstep_alpha(&sim_clock);
+        present(fixedstep_lerp(prev_zoom, current_zoom, alpha), alpha);
     }
 
     thd_sleep(1000); // Wait for 1 second
+    fixedstep_init(&sim_clock, SIM_HZ, timer_us_gettime64()); // The pause is not a stall
 
     // Simulate pressing 'A' to zoom to minimum
     while (zoom_level > 0.0f) {
-        cont_state_t state;
-        state.buttons = CONT_A;
-        zoom_in_out(&state);
-
-        pvr_wait_ready();
-        pvr_scene_begin();
-        pvr_list_begin(PVR_LIST_TR_POLY);
-        draw_back(zoom_level);
-        pvr_list_finish();
-        pvr_scene_finish();
-
-        thd_sleep(18); // Wait for a short delay to visualize the zoom effect
+        float alpha = step_zoom(CONT_A);
+        present(fixedstep_lerp(prev_zoom_level, zoom_level, alpha), alpha);
     }
 
     // Simulate pressing 'B' to zoom out to normal display
     while (zoom_level < 1.1f) {
-        cont_state_t state;
-        state.buttons = CONT_B;
-        zoom_in_out(&state);
-
-        pvr_wait_ready();
-        pvr_scene_begin();
-        pvr_list_begin(PVR_LIST_TR_POLY);
-        draw_back(zoom_level);
-        pvr_list_finish();
-        pvr_scene_finish();
-
-        thd_sleep(18); // Wait for a short delay to visualize the zoom effect
+        float alpha = step_zoom(CONT_B);
+        present(fixedstep_lerp(prev_zoom_level, zoom_level, alpha), alpha);
     }
 
     // Main loop - Normal operation
     while (!done) {
         maple_device_t *dev;
         int i = 0; // Index variable for maple_enum_type
+        uint32 buttons = 0; // Held on any controller
         maple_device_t *first_dev = maple_enum_type(0, MAPLE_FUNC_CONTROLLER);
         while (first_dev != NULL) {
             dev = first_dev;
             cont_state_t *state = (cont_state_t *)maple_dev_status(dev);
 
             // Adjust zoom level based on button presses
-            zoom_in_out(state);
+            buttons |= state->buttons;
 
             // Check if Start button is pressed
             if (state->buttons & CONT_START) {
@@ -224,19 +395,24 @@ int main() {
             first_dev = maple_enum_type(++i, MAPLE_FUNC_CONTROLLER);
         }
 
-        // Clear the screen
-        pvr_wait_ready();
-        pvr_scene_begin();
-        pvr_list_begin(PVR_LIST_TR_POLY);
-        draw_back(zoom_level);
-        pvr_list_finish();
-        pvr_scene_finish();
+        // However many steps are due since the last frame, then draw
+        float alpha = step_zoom(buttons);
+        present(fixedstep_lerp(prev_zoom_level, zoom_level, alpha), alpha);
     }
 
 out:
     // Clean up resources
-    pvr_mem_free(back_tex_normal);
-    pvr_mem_free(back_tex_zoomed);
+    if (trans_running) {
+        pvr_wait_ready();
+        transition_end(&trans);
+    }
+    back_free(&current_back);
+    if (pacing) {
+        printf("%u steps, %u frames missed their vblank, %u ms dropped\n",
+               (unsigned)sim_clock.steps, (unsigned)pacer.missed,
+               (unsigned)(sim_clock.dropped_us / 1000));
+        vblank_pacer_shutdown(&pacer);
+    }
     pvr_shutdown();
     vid_shutdown();
 
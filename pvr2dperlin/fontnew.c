@@ -26,7 +26,10 @@
 */
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "fontnew.h"
+#include "../overdraw.h"
+#include "../pvrpal.h"
 
 // Global variables for utility texture and its header
 pvr_ptr_t util_texture;
@@ -60,6 +63,7 @@ void setup_util_texture() {
     // Set up a polygon context for the utility texture
     pvr_poly_cxt_txr(&base, PVR_LIST_TR_POLY, PVR_TXRFMT_ARGB4444 | PVR_TXRFMT_NONTWIDDLED,
                      256, 256, util_texture, PVR_FILTER_NONE);
+    overdraw_poly_cxt(&base);
     pvr_poly_compile(&util_txr_hdr, &base);
 }
 
@@ -91,7 +95,7 @@ void draw_poly_char(float x1, float y1, float z1, float a, float r, float g, flo
     vert.z = z1;
     vert.u = u1;
     vert.v = v2;
-    vert.argb = PVR_PACK_COLOR(a, r, g, b);
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(a, r, g, b));
     vert.oargb = 0;
     pvr_prim(&vert, sizeof(vert));
 
@@ -183,6 +187,7 @@ void draw_poly_box(float x1, float y1, float x2, float y2, float z,
 
     // Set up the polygon context and compile the header
     pvr_poly_cxt_col(&cxt, PVR_LIST_TR_POLY);
+    overdraw_poly_cxt(&cxt);
     pvr_poly_compile(&poly, &cxt);
     pvr_prim(&poly, sizeof(poly));
 
@@ -191,22 +196,24 @@ void draw_poly_box(float x1, float y1, float x2, float y2, float z,
     vert.x = x1;
     vert.y = y2;
     vert.z = z;
-    vert.argb = PVR_PACK_COLOR((a1 + a2) / 2, (r1 + r2) / 2, (g1 + g2) / 2, (b1 + b2) / 2);
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR((a1 + a2) / 2, (r1 + r2) / 2,
+                                             (g1 + g2) / 2, (b1 + b2) / 2));
     vert.oargb = 0;
     pvr_prim(&vert, sizeof(vert));
 
     vert.y = y1;
-    vert.argb = PVR_PACK_COLOR(a1, r1, g1, b1);
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(a1, r1, g1, b1));
     pvr_prim(&vert, sizeof(vert));
 
     vert.x = x2;
     vert.y = y2;
-    vert.argb = PVR_PACK_COLOR(a2, r2, g2, b2);
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(a2, r2, g2, b2));
     pvr_prim(&vert, sizeof(vert));
 
     vert.flags = PVR_CMD_VERTEX_EOL;
     vert.y = y1;
-    vert.argb = PVR_PACK_COLOR((a1 + a2) / 2, (r1 + r2) / 2, (g1 + g2) / 2, (b1 + b2) / 2);
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR((a1 + a2) / 2, (r1 + r2) / 2,
+                                             (g1 + g2) / 2, (b1 + b2) / 2));
     pvr_prim(&vert, sizeof(vert));
 }
 
@@ -219,6 +226,7 @@ void draw_poly_box_v2(float x1, float y1, float x2, float y2, float z,
     pvr_vertex_t    vert;
     
     pvr_poly_cxt_col(&cxt, PVR_LIST_TR_POLY);
+    overdraw_poly_cxt(&cxt);
     pvr_poly_compile(&poly, &cxt);
     pvr_prim(&poly, sizeof(poly));
     
@@ -226,29 +234,228 @@ void draw_poly_box_v2(float x1, float y1, float x2, float y2, float z,
     vert.x = x1;
     vert.y = y2;
     vert.z = z;
-    vert.argb = PVR_PACK_COLOR(
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(
                     (a1 + a2) / 2,
                     (r1 + r2) / 2,
                     (g1 + g2) / 2,
-                    (b1 + b2) / 2);
+                    (b1 + b2) / 2));
     vert.oargb = 0;
     pvr_prim(&vert, sizeof(vert));
     
     vert.y = y1;
-    vert.argb = PVR_PACK_COLOR(a1, r1, g1, b1);
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(a1, r1, g1, b1));
     pvr_prim(&vert, sizeof(vert));
     
     vert.x = x2;
     vert.y = y2;
-    vert.argb = PVR_PACK_COLOR(a2, r2, g2, b2);
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(a2, r2, g2, b2));
     pvr_prim(&vert, sizeof(vert));
     
     vert.flags = PVR_CMD_VERTEX_EOL;
     vert.y = y1;
-    vert.argb = PVR_PACK_COLOR(
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(
                     (a1 + a2) / 2,
                     (r1 + r2) / 2,
                     (g1 + g2) / 2,
-                    (b1 + b2) / 2);
+                    (b1 + b2) / 2));
     pvr_prim(&vert, sizeof(vert));
 }
+
+/* Signed distance field text ------------------------------------------------
+ * One small PAL8 atlas built on the host by tools/sdffont, drawn at any size.
+ * See ../sdffont.h for the file format and the ramp math.
+ */
+pvr_ptr_t sdf_texture = NULL;
+static sdf_font_hdr_t sdf_hdr;
+static int sdf_mode = SDF_MODE_RAMP;
+static pvr_poly_hdr_t sdf_txr_hdr[SDF_RAMP_BANKS];
+static int sdf_pal_first = -1, sdf_pal_entries;
+
+/**
+ * @brief Load an SDF font atlas and set up its palette banks
+ *
+ * In SDF_MODE_RAMP every magnification bucket gets its own anti-aliasing
+ * ramp in one of SDF_RAMP_BANKS PAL8 banks in a row and text goes in the TR
+ * list. In SDF_MODE_ALPHA_TEST one bank holds an identity ramp, the
+ * punch-through alpha reference is set to the glyph edge and text goes in
+ * the PT list, which gives hard edges at any magnification. The PT list must
+ * have a bin size in pvr_init_params_t for that mode.
+ *
+ * The banks are reserved through ../pvrpal.h, in ARGB8888, so this fails
+ * if palettes in another format are loaded already. Loading again replaces
+ * the font.
+ *
+ * @param filename Path to the .sdf file
+ * @param mode SDF_MODE_RAMP or SDF_MODE_ALPHA_TEST
+ * @return int 1 on success, 0 on failure
+ */
+int setup_sdf_texture(const char *filename, int mode) {
+    FILE *fp;
+    uint8 *atlas;
+    size_t size;
+    int bank, i;
+    pvr_poly_cxt_t cxt;
+
+    free_sdf_texture();
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        printf("Error: fopen %s failed\n", filename);
+        return 0;
+    }
+    if (fread(&sdf_hdr, sizeof(sdf_hdr), 1, fp) != 1 ||
+        memcmp(sdf_hdr.fourcc, SDF_FOURCC, 4) != 0) {
+        printf("Error: %s is not an SDF font\n", filename);
+        fclose(fp);
+        return 0;
+    }
+
+    size = sdf_hdr.width * sdf_hdr.height;
+    atlas = (uint8 *)memalign(32, size);
+    if (atlas == NULL || fread(atlas, size, 1, fp) != 1) {
+        printf("Error: short read on %s\n", filename);
+        free(atlas);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+
+    sdf_texture = pvr_mem_malloc(size);
+    if (sdf_texture == NULL) {
+        printf("Error: pvr_mem_malloc failed\n");
+        free(atlas);
+        return 0;
+    }
+    // Palettised textures have to be twiddled, pvr_txr_load_ex does that for us
+    pvr_txr_load_ex(atlas, sdf_texture, sdf_hdr.width, sdf_hdr.height, PVR_TXRLOAD_8BPP);
+    free(atlas);
+
+    sdf_pal_entries = (mode == SDF_MODE_ALPHA_TEST ? 1 : SDF_RAMP_BANKS) * 256;
+    sdf_pal_first = pvrpal_alloc(sdf_pal_entries, PVR_PAL_ARGB8888, filename);
+    if (sdf_pal_first < 0) {
+        free_sdf_texture();
+        return 0;
+    }
+
+    sdf_mode = mode;
+    if (mode == SDF_MODE_ALPHA_TEST) {
+        for (i = 0; i < 256; i++)
+            pvr_set_pal_entry(sdf_pal_first + i, ((uint32)i << 24) | 0x00FFFFFF);
+        PVR_SET(PVR_PT_ALPHA_REF, SDF_EDGE_VALUE);
+    } else {
+        for (bank = 0; bank < SDF_RAMP_BANKS; bank++) {
+            float texel_px = sdf_ramp_texel_px(bank);
+            for (i = 0; i < 256; i++) {
+                uint32 a = sdf_ramp_alpha(i, sdf_hdr.spread, texel_px);
+                pvr_set_pal_entry(sdf_pal_first + bank * 256 + i, (a << 24) | 0x00FFFFFF);
+            }
+        }
+    }
+
+    // One header per bank, the texture and filtering are the same for all
+    for (bank = 0; bank < SDF_RAMP_BANKS; bank++) {
+        int pal = sdf_pal_first / 256 + (mode == SDF_MODE_ALPHA_TEST ? 0 : bank);
+        pvr_poly_cxt_txr(&cxt, mode == SDF_MODE_ALPHA_TEST ? PVR_LIST_PT_POLY : PVR_LIST_TR_POLY,
+                         PVR_TXRFMT_PAL8BPP | PVR_TXRFMT_8BPP_PAL(pal),
+                         sdf_hdr.width, sdf_hdr.height, sdf_texture, PVR_FILTER_BILINEAR);
+        overdraw_poly_cxt(&cxt);
+        pvr_poly_compile(&sdf_txr_hdr[bank], &cxt);
+    }
+    return 1;
+}
+
+/* Free the atlas and give its palette banks back */
+void free_sdf_texture(void) {
+    if (sdf_texture != NULL) {
+        pvr_mem_free(sdf_texture);
+        sdf_texture = NULL;
+    }
+    pvrpal_free(sdf_pal_first, sdf_pal_entries);
+    sdf_pal_first = -1;
+}
+
+/**
+ * @brief Width in pixels of a string drawn with draw_sdf_strf
+ *
+ * @param size Line height in pixels
+ * @param str String to measure
+ */
+float sdf_text_width(float size, const char *str) {
+    if (sdf_texture == NULL)
+        return strlen(str) * 12.0f;
+    return strlen(str) * sdf_hdr.advance * (size / sdf_hdr.cell_h);
+}
+
+/**
+ * @brief Draw a formatted string from the SDF atlas at any size
+ *
+ * Falls back to the bfont bitmap path at its native size if no SDF font was
+ * loaded. In SDF_MODE_RAMP this must be called while the TR list is open, in
+ * SDF_MODE_ALPHA_TEST while the PT list is open.
+ *
+ * @param x1 Starting X-coordinate of the string
+ * @param y1 Top Y-coordinate of the string
+ * @param z1 Z-coordinate (depth) of the string
+ * @param size Line height in pixels, 24 matches bfont
+ * @param a Alpha value for color blending
+ * @param r Red component of the text color
+ * @param g Green component of the text color
+ * @param b Blue component of the text color
+ * @param fmt Format string (printf-style)
+ * @param ... Variable arguments for the format string
+ */
+void draw_sdf_strf(float x1, float y1, float z1, float size, float a, float r,
+                   float g, float b, char *fmt, ...) {
+    va_list args;
+    pvr_vertex_t vert;
+    char *s;
+
+    va_start(args, fmt);
+    vsprintf(strbuf, fmt, args);
+    va_end(args);
+
+    if (sdf_texture == NULL) {
+        draw_poly_strf(x1, y1, z1, a, r, g, b, "%s", strbuf);
+        return;
+    }
+
+    float scale = size / sdf_hdr.cell_h;
+    float w = sdf_hdr.cell_w * scale;
+    float h = sdf_hdr.cell_h * scale;
+    float du = (float)sdf_hdr.cell_w / sdf_hdr.width;
+    float dv = (float)sdf_hdr.cell_h / sdf_hdr.height;
+
+    pvr_prim(&sdf_txr_hdr[sdf_ramp_bucket(scale)], sizeof(pvr_poly_hdr_t));
+
+    vert.z = z1;
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(a, r, g, b));
+    vert.oargb = 0;
+    for (s = strbuf; *s; s++, x1 += sdf_hdr.advance * scale) {
+        int c = *s & 0x7f;
+        if (c == ' ')
+            continue;
+        float u1 = (c % SDF_GRID_COLS) * du;
+        float v1 = (c / SDF_GRID_COLS) * dv;
+
+        vert.flags = PVR_CMD_VERTEX;
+        vert.x = x1;
+        vert.y = y1 + h;
+        vert.u = u1;
+        vert.v = v1 + dv;
+        pvr_prim(&vert, sizeof(vert));
+
+        vert.y = y1;
+        vert.v = v1;
+        pvr_prim(&vert, sizeof(vert));
+
+        vert.x = x1 + w;
+        vert.y = y1 + h;
+        vert.u = u1 + du;
+        vert.v = v1 + dv;
+        pvr_prim(&vert, sizeof(vert));
+
+        vert.flags = PVR_CMD_VERTEX_EOL;
+        vert.y = y1;
+        vert.v = v1;
+        pvr_prim(&vert, sizeof(vert));
+    }
+}
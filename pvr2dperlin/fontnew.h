@@ -28,6 +28,7 @@
 
 #include <kos.h>
 #include <math.h>
+#include "../sdffont.h"
 
 /* texture.c */
 extern pvr_ptr_t        util_texture;
@@ -40,4 +41,13 @@ void draw_poly_box(float x1, float y1, float x2, float y2, float z,
                    float a2, float r2, float g2, float b2);
 void draw_poly_box_v2(float x1, float y1, float x2, float y2, float z,
                    float a1, float r1, float g1, float b1,
-                   float a2, float r2, float g2, float b2);                   
\ No newline at end of file
+                   float a2, float r2, float g2, float b2);                   
+
+/* Signed distance field text, scalable, see ../sdffont.h */
+#define SDF_MODE_RAMP       0   /* anti-aliased, TR list, one palette bank per scale bucket */
+#define SDF_MODE_ALPHA_TEST 1   /* hard edges, PT list, identity palette + alpha reference */
+extern pvr_ptr_t        sdf_texture;
+int setup_sdf_texture(const char *filename, int mode);
+void free_sdf_texture(void);
+float sdf_text_width(float size, const char *str);
+void draw_sdf_strf(float x1, float y1, float z1, float size, float a, float r, float g, float b, char *fmt, ...);
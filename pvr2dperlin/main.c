@@ -29,12 +29,14 @@
 #include <dc/fmath.h> /* Fast math library headers for optimized mathematical functions */
 #include <dc/matrix.h> /* Matrix library headers for handling matrix operations */
 #include <dc/sq.h> /* SH-4 Store Queue library headers for optimized memory transfers */
-#include <png/png.h> /* PNG library headers for handling PNG images */
 #include <stdio.h> /* Standard I/O library headers for input and output functions */
 #include <stdlib.h> /* Standard library headers for general-purpose functions */
 #include <dc/video.h> /* Video library headers for video display functions */
 #include "fontnew.h" /* Custom font header for font rendering */
 #include "perlin.h" /* Custom Perlin noise header for procedural texture generation */
+#include "../fixedstep.h" /* Fixed timestep updates, independent of the frame rate */
+#include "../overdraw.h" /* OVERDRAW=1 draws the layers shaded per pixel instead */
+#include "../pvrtex.h" /* .dt textures, in the format the build picked for each */
 
 #define M_PI 3.14159265358979323846264338327950288419716939937510f
 #define PERLIN_TEXTURE_SIZE 16
@@ -71,19 +73,9 @@ PerlinParams perlin_params = {
     .metallic_hue = 0.0f
 };
 
-/**
- * @struct kos_texture_t
- * @brief Structure for handling textures in KallistiOS
- */
-typedef struct {
-    pvr_ptr_t ptr;  /* Pointer to texture data in PVR memory */
-    int w, h;       /* Width and height of the texture */
-    uint32 fmt;     /* Texture format */
-} kos_texture_t;
-
 /* Global variables */
 pvr_ptr_t perlin_texture = NULL;      /* Pointer to Perlin noise texture */
-kos_texture_t* dc_logo_texture = NULL; /* Pointer to Dreamcast logo texture */
+dttex_info_t dc_logo_texture;         /* Dreamcast logo texture, ptr NULL if missing */
 int toggle_cooldown = 0;              /* Cooldown for toggling interface */
 int text_needs_update = 1;            /* Flag for text update requirement */
 int show_interface = 1;               /* Flag to show/hide interface */
@@ -93,6 +85,9 @@ float avrg_gpu_time = 0;              /* Average GPU processing time */
 float avrg_cpu_time = 0;              /* Average CPU processing time */
 float avrg_idle_time = 0;             /* Average idle time */
 float total_frame_time = 0;           /* Total frame processing time */
+fixedstep_t sim_clock;                /* 60Hz simulation clock: scrolling and held buttons */
+
+#define SIM_HZ 60
 
 /* Function prototypes */
 float perlin_noise_2D(float x, float y, int seed);
@@ -272,6 +267,7 @@ void render_backdrop() {
     
     // Disable culling to ensure the quad is always visible
     cxt.gen.culling = PVR_CULLING_NONE;
+    overdraw_poly_cxt(&cxt);
     
     // Compile the polygon header
     pvr_poly_compile(&hdr, &cxt);
@@ -288,7 +284,7 @@ void render_backdrop() {
     vert->flags = PVR_CMD_VERTEX;
     vert->x = 0.0f; vert->y = 0.0f; vert->z = 1.0f;
     vert->u = 0.0f; vert->v = 0.0f;
-    vert->argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
+    vert->argb = OVERDRAW_ARGB(PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f));
     vert->oargb = 0;
     pvr_dr_commit(vert);
 
@@ -297,7 +293,7 @@ void render_backdrop() {
     vert->flags = PVR_CMD_VERTEX;
     vert->x = 640.0f; vert->y = 0.0f; vert->z = 1.0f;
     vert->u = 1.0f; vert->v = 0.0f;
-    vert->argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
+    vert->argb = OVERDRAW_ARGB(PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f));
     vert->oargb = 0;
     pvr_dr_commit(vert);
 
@@ -306,7 +302,7 @@ void render_backdrop() {
     vert->flags = PVR_CMD_VERTEX;
     vert->x = 0.0f; vert->y = 480.0f; vert->z = 1.0f;
     vert->u = 0.0f; vert->v = 1.0f;
-    vert->argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
+    vert->argb = OVERDRAW_ARGB(PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f));
     vert->oargb = 0;
     pvr_dr_commit(vert);
 
@@ -315,56 +311,12 @@ void render_backdrop() {
     vert->flags = PVR_CMD_VERTEX_EOL;
     vert->x = 640.0f; vert->y = 480.0f; vert->z = 1.0f;
     vert->u = 1.0f; vert->v = 1.0f;
-    vert->argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
+    vert->argb = OVERDRAW_ARGB(PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f));
     vert->oargb = 0;
     pvr_dr_commit(vert);
 }
 
 
-/**
- * @brief Load a PNG texture file into PVR memory
- *
- * @param filename Path to the PNG file
- * @return kos_texture_t* Pointer to the loaded texture, or NULL if loading failed
- */
-kos_texture_t* load_png_texture(const char *filename) {
-    kos_texture_t* texture;
-    kos_img_t img;
-
-    // Attempt to load the PNG file into a KOS image structure
-    if (png_to_img(filename, PNG_FULL_ALPHA, &img) < 0) {
-        return NULL;  // Return NULL if PNG loading fails
-    }
-
-    // Allocate memory for the texture structure
-    texture = (kos_texture_t*)malloc(sizeof(kos_texture_t));
-    if (!texture) {
-        kos_img_free(&img, 0);  // Free the KOS image if texture allocation fails
-        return NULL;
-    }
-
-    // Allocate PVR memory for the texture data
-    texture->ptr = pvr_mem_malloc(img.byte_count);
-    if (!texture->ptr) {
-        free(texture);          // Free the texture structure if PVR memory allocation fails
-        kos_img_free(&img, 0);  // Free the KOS image
-        return NULL;
-    }
-
-    // Set texture properties
-    texture->w = img.w;    // Width of the texture
-    texture->h = img.h;    // Height of the texture
-    texture->fmt = PVR_TXRFMT_ARGB4444;  // Set texture format to ARGB4444
-
-    // Load the image data into PVR memory
-    pvr_txr_load_kimg(&img, texture->ptr, 0);
-
-    // Free the KOS image as it's no longer needed
-    kos_img_free(&img, 0);
-
-    return texture;  // Return the loaded texture
-}
-
 /**
  * @brief Initialize a polygon context for rendering textured polygons
  *
@@ -372,16 +324,14 @@ kos_texture_t* load_png_texture(const char *filename) {
  */
 void init_poly_context(pvr_poly_cxt_t *cxt) {
     // Initialize the polygon context for textured rendering
-    pvr_poly_cxt_txr(cxt, 
-                     PVR_LIST_TR_POLY,          // Use the translucent polygon list
-                     PVR_TXRFMT_ARGB4444,       // Texture format (ARGB4444)
-                     dc_logo_texture->w,        // Texture width
-                     dc_logo_texture->h,        // Texture height
-                     dc_logo_texture->ptr,      // Pointer to texture data in PVR memory
-                     PVR_FILTER_BILINEAR);      // Use bilinear filtering for texture sampling
+    pvrtex_poly_cxt(cxt,
+                    PVR_LIST_TR_POLY,          // Use the translucent polygon list
+                    &dc_logo_texture,          // Format, size and texture memory from the .dt
+                    PVR_FILTER_BILINEAR);      // Use bilinear filtering for texture sampling
 
     // Set culling mode to counter-clockwise
     cxt->gen.culling = PVR_CULLING_CCW;
+    overdraw_poly_cxt(cxt);
 }
 
 
@@ -463,7 +413,7 @@ void render_text_overlay() {
 
 
 // Render the Dreamcast logo
-if (dc_logo_texture) {
+if (dc_logo_texture.ptr != NULL) {
     pvr_poly_cxt_t cxt;
     pvr_poly_hdr_t hdr;
     pvr_vertex_t vert;
@@ -477,9 +427,9 @@ if (dc_logo_texture) {
 
     // Set up the first vertex (top-left of the logo)
     vert.flags = PVR_CMD_VERTEX;
-    vert.x = 640 - dc_logo_texture->w; vert.y = 0; vert.z = 1;
+    vert.x = 640 - dc_logo_texture.width; vert.y = 0; vert.z = 1;
     vert.u = 0.0f; vert.v = 0.0f;
-    vert.argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
+    vert.argb = OVERDRAW_ARGB(PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f));
     vert.oargb = 0;
     pvr_prim(&vert, sizeof(vert));
 
@@ -489,13 +439,13 @@ if (dc_logo_texture) {
     pvr_prim(&vert, sizeof(vert));
 
     // Set up the third vertex (bottom-left of the logo)
-    vert.x = 640 - dc_logo_texture->w; vert.y = dc_logo_texture->h;
+    vert.x = 640 - dc_logo_texture.width; vert.y = dc_logo_texture.height;
     vert.u = 0.0f; vert.v = 1.0f;
     pvr_prim(&vert, sizeof(vert));
 
     // Set up the fourth vertex (bottom-right of the logo)
     vert.flags = PVR_CMD_VERTEX_EOL;
-    vert.x = 640; vert.y = dc_logo_texture->h;
+    vert.x = 640; vert.y = dc_logo_texture.height;
     vert.u = 1.0f; vert.v = 1.0f;
     pvr_prim(&vert, sizeof(vert));
 }
@@ -580,9 +530,89 @@ draw_poly_box(8, metrics_y - 4,
                    2.0f,                                         // Z coordinate (depth)
                    1.0f, 1.0f, 1.0f, 1.0f,                       // RGBA color (white)
                    "Total: %.2fms", total_frame_time);           // Text with formatted total frame time
+
+    // Title drawn from the SDF atlas, one 16x32 cell set scaled up to 48px
+    if (sdf_texture != NULL) {
+        const char *title = "PERLIN 2D";
+        draw_sdf_strf(640 - 20 - sdf_text_width(48.0f, title), 480 - 20 - 48, 6.0f, 48.0f,
+                      0.9f, 1.0f, 1.0f, 1.0f, (char *)title);
+    }
 }
 
 
+/**
+ * @brief Advance the simulation by one fixed step
+ *
+ * Applies the held buttons and the analog stick, scrolls the noise and
+ * counts down the toggle cooldown.
+ *
+ * @param state Controller state read this frame
+ */
+void update_perlin(const cont_state_t *state) {
+    // Metallic hue adjustment (X, Y buttons)
+    if (state->buttons & CONT_X) {
+        perlin_params.metallic_hue = fmodf(perlin_params.metallic_hue + 0.02f, 1.0f);
+        text_needs_update = 1;
+    }
+    if (state->buttons & CONT_Y) {
+        perlin_params.metallic_hue = fmodf(perlin_params.metallic_hue - 0.02f, 1.0f);
+        text_needs_update = 1;
+    }
+
+    // Scale adjustment (Up, Down on D-pad)
+    if (state->buttons & CONT_DPAD_UP) {
+        perlin_params.scale *= 1.1f;  // Increase scale by 10%
+        text_needs_update = 1;
+    }
+    if (state->buttons & CONT_DPAD_DOWN) {
+        perlin_params.scale *= 0.9f;  // Decrease scale by 10%
+        text_needs_update = 1;
+    }
+    
+    // Persistence adjustment (Left, Right on D-pad)
+    if (state->buttons & CONT_DPAD_LEFT) {
+        perlin_params.persistence = fmaxf(perlin_params.persistence - 0.05f, 0.1f);
+        text_needs_update = 1;
+    }
+    if (state->buttons & CONT_DPAD_RIGHT) {
+        perlin_params.persistence = fminf(perlin_params.persistence + 0.05f, 1.0f);
+        text_needs_update = 1;
+    }
+
+    // Lacunarity adjustment (A+X, A+Y buttons)
+    if ((state->buttons & (CONT_A | CONT_X)) == (CONT_A | CONT_X)) {
+        perlin_params.lacunarity = fminf(perlin_params.lacunarity * 1.1f, 4.0f);
+        text_needs_update = 1;
+    }
+    if ((state->buttons & (CONT_A | CONT_Y)) == (CONT_A | CONT_Y)) {
+        perlin_params.lacunarity = fmaxf(perlin_params.lacunarity * 0.9f, 1.0f);
+        text_needs_update = 1;
+    }
+
+    // Octaves adjustment (B+X, B+Y buttons)
+    if ((state->buttons & (CONT_B | CONT_X)) == (CONT_B | CONT_X)) {
+        perlin_params.octaves = fminf(perlin_params.octaves + 1, 8);
+        text_needs_update = 1;
+    }
+    if ((state->buttons & (CONT_B | CONT_Y)) == (CONT_B | CONT_Y)) {
+        perlin_params.octaves = fmaxf(perlin_params.octaves - 1, 1);
+        text_needs_update = 1;
+    }
+
+    // Offset adjustment (analog stick)
+    if (abs(state->joyx) > 16 || abs(state->joyy) > 16) {
+        perlin_params.offset_x += state->joyx / 100.0f;
+        perlin_params.offset_y -= state->joyy / 100.0f;
+        text_needs_update = 1;
+    }
+
+    // Decrease toggle cooldown if it's active
+    if (toggle_cooldown > 0) toggle_cooldown--;
+
+    // Constant movement of the Perlin noise (scrolling effect)
+    perlin_params.offset_y += 2.0f;
+}
+
 /**
  * @brief Main function for the Dreamcast application
  * @param argc Argument count
@@ -605,15 +635,33 @@ int main(int argc, char *argv[]) {
     
     // Initialize the font texture for text rendering
     setup_util_texture();
+
+    // Scalable HUD text, built from assets/font/hud.png by tools/sdffont,
+    // the bfont path above stays in use if it is missing
+    if (!setup_sdf_texture("/rd/font/hud.sdf", SDF_MODE_RAMP)) {
+        printf("No SDF font, HUD title disabled\n");
+    }
     
-    // Load the Dreamcast logo texture
-    dc_logo_texture = load_png_texture("/rd/dc_logo.png");
-    if (!dc_logo_texture) {
+    // Load the Dreamcast logo texture, converted from assets/texture/dc_logo.png
+    // by the build in whatever format tools/texpick picked for it. The logo is
+    // not in the tree, drop a dc_logo.png there to get it; without it this
+    // fails and nothing is drawn in the corner. A palettised pick shares the
+    // palette with the SDF ramps above, see ../pvrpal.h
+    uint64 load_start = timer_us_gettime64();
+    if (!pvrtex_load_named("/rd/texture/textures.txt", "dc_logo", &dc_logo_texture)) {
         printf("Failed to load Dreamcast logo texture\n");
+    } else {
+        printf("textures: 1, %u KB texture memory in %u us\n",
+               (unsigned)(dc_logo_texture.size / 1024),
+               (unsigned)(timer_us_gettime64() - load_start));
     }
     
     // Initialize previous button state
     int prev_buttons = 0;
+    cont_state_t pad;
+    
+    // Start the simulation clock
+    fixedstep_init(&sim_clock, SIM_HZ, timer_us_gettime64());
     
     // Main game loop
     while(1) {
@@ -655,10 +703,15 @@ int main(int argc, char *argv[]) {
         cpu_start = timer_us_gettime64();
 	    
 
+memset(&pad, 0, sizeof(pad));  // No controller, no input
+
 MAPLE_FOREACH_BEGIN(MAPLE_FUNC_CONTROLLER, cont_state_t, state)
     // Check if the Start button is pressed to exit the program
     if (state->buttons & CONT_START)
         goto out;
+
+    // Held buttons and the stick are applied per simulation step below
+    pad = *state;
     
     // Toggle color mode (A+B buttons)
     if ((state->buttons & (CONT_A | CONT_B)) == (CONT_A | CONT_B) &&
@@ -668,63 +721,6 @@ MAPLE_FOREACH_BEGIN(MAPLE_FUNC_CONTROLLER, cont_state_t, state)
         text_needs_update = 1;  // Flag to update UI text
     }
 
-    // Metallic hue adjustment (X, Y buttons)
-    if (state->buttons & CONT_X) {
-        perlin_params.metallic_hue = fmodf(perlin_params.metallic_hue + 0.02f, 1.0f);
-        text_needs_update = 1;
-    }
-    if (state->buttons & CONT_Y) {
-        perlin_params.metallic_hue = fmodf(perlin_params.metallic_hue - 0.02f, 1.0f);
-        text_needs_update = 1;
-    }
-
-    // Scale adjustment (Up, Down on D-pad)
-    if (state->buttons & CONT_DPAD_UP) {
-        perlin_params.scale *= 1.1f;  // Increase scale by 10%
-        text_needs_update = 1;
-    }
-    if (state->buttons & CONT_DPAD_DOWN) {
-        perlin_params.scale *= 0.9f;  // Decrease scale by 10%
-        text_needs_update = 1;
-    }
-    
-    // Persistence adjustment (Left, Right on D-pad)
-    if (state->buttons & CONT_DPAD_LEFT) {
-        perlin_params.persistence = fmaxf(perlin_params.persistence - 0.05f, 0.1f);
-        text_needs_update = 1;
-    }
-    if (state->buttons & CONT_DPAD_RIGHT) {
-        perlin_params.persistence = fminf(perlin_params.persistence + 0.05f, 1.0f);
-        text_needs_update = 1;
-    }
-
-    // Lacunarity adjustment (A+X, A+Y buttons)
-    if ((state->buttons & (CONT_A | CONT_X)) == (CONT_A | CONT_X)) {
-        perlin_params.lacunarity = fminf(perlin_params.lacunarity * 1.1f, 4.0f);
-        text_needs_update = 1;
-    }
-    if ((state->buttons & (CONT_A | CONT_Y)) == (CONT_A | CONT_Y)) {
-        perlin_params.lacunarity = fmaxf(perlin_params.lacunarity * 0.9f, 1.0f);
-        text_needs_update = 1;
-    }
-
-    // Octaves adjustment (B+X, B+Y buttons)
-    if ((state->buttons & (CONT_B | CONT_X)) == (CONT_B | CONT_X)) {
-        perlin_params.octaves = fminf(perlin_params.octaves + 1, 8);
-        text_needs_update = 1;
-    }
-    if ((state->buttons & (CONT_B | CONT_Y)) == (CONT_B | CONT_Y)) {
-        perlin_params.octaves = fmaxf(perlin_params.octaves - 1, 1);
-        text_needs_update = 1;
-    }
-
-    // Offset adjustment (analog stick)
-    if (abs(state->joyx) > 16 || abs(state->joyy) > 16) {
-        perlin_params.offset_x += state->joyx / 100.0f;
-        perlin_params.offset_y -= state->joyy / 100.0f;
-        text_needs_update = 1;
-    }
-
            // Reset all Perlin noise parameters to their default values when both triggers are pressed
     if ((state->ltrig > 200) && (state->rtrig > 200)) {
         perlin_params.scale = 32.0f;
@@ -753,11 +749,12 @@ MAPLE_FOREACH_BEGIN(MAPLE_FUNC_CONTROLLER, cont_state_t, state)
 
 MAPLE_FOREACH_END()  // End of controller input processing
 
-// Decrease toggle cooldown if it's active
-if (toggle_cooldown > 0) toggle_cooldown--;
-
-// Constant movement of the Perlin noise (scrolling effect)
-perlin_params.offset_y += 2.0f;
+// Scrolling, held buttons and the cooldown advance per 60Hz step, so they
+// run at the same speed whatever the frame rate
+int steps = fixedstep_advance(&sim_clock, timer_us_gettime64());
+while (steps--) {
+    update_perlin(&pad);
+}
 
 // Recreate the Perlin texture if any parameters have changed
 if (text_needs_update) {
@@ -791,10 +788,8 @@ if (perlin_texture != NULL) {
 if (util_texture != NULL) {
     pvr_mem_free(util_texture);
 }
-if (dc_logo_texture != NULL) {
-    pvr_mem_free(dc_logo_texture->ptr);
-    free(dc_logo_texture);
-}
+free_sdf_texture();
+pvrtex_unload(&dc_logo_texture);
 
 // Shut down the PVR system
 pvr_shutdown();
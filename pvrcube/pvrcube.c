@@ -21,9 +21,11 @@
 #include <dc/matrix.h> /* Matrix library headers for handling matrix operations */
 #include <dc/matrix3d.h> /* Matrix3D library headers for handling 3D matrix operations */
 
-#include "../cube.h" /* Cube vertices and side strips layout */
+#include "../cube.h" /* Cube state and side colours */
+#include "../mesh.h" /* Indexed strip meshes, mapped straight from the romdisk */
 #include "../pvrtex.h" /* texture management, single header code */
 #include "../perspective.h" /* Perspective projection matrix functions */
+#include "../fixedstep.h" /* Fixed timestep updates, drawn between the last two steps */
 
 #define ABS(x) ((x) < 0 ? -(x) : (x))
 
@@ -33,57 +35,109 @@
 #define MAX_ZOOM 15.0f
 #define ZOOM_SPEED 0.3f
 
+/* 1 sends the strips as one joined through degenerate triangles: one EOL
+   instead of six for 34 vertices instead of 24. The TA cuts strips into
+   runs of six triangles, and a side plus its join fills exactly one, so
+   the bin entries stay the same (tools/stripcheck). */
+#ifndef CUBE_STITCH
+#define CUBE_STITCH 0
+#endif
+
 extern uint8 romdisk[];
 KOS_INIT_FLAGS(INIT_DEFAULT | INIT_MALLOCSTATS);
 KOS_INIT_ROMDISK(romdisk);
 
 static float fovy = DEFAULT_FOV;
 
+/* Speeds, friction and the controls are per step of a fixed 60Hz clock, so
+   the cube moves the same at any frame rate. The previous step's pose is
+   kept to draw in between. */
+#define SIM_HZ 60
+static fixedstep_t sim_clock;
+static struct cube prev_state;
+
 static dttex_info_t texture;
 
+/* The cube from romdisk/mesh/cube.msh (assets/mesh/cube.obj through
+   tools/meshconv): a group per side, one strip each */
+static mesh_t cube_mesh;
+static vec3f_t *tverts; // cube_mesh transformed, a vertex each
+
 static inline void init_poly_context(pvr_poly_cxt_t *cxt) {
-  pvr_poly_cxt_txr(cxt, PVR_LIST_TR_POLY, texture.pvrformat, texture.width,
-                   texture.height, texture.ptr, PVR_FILTER_BILINEAR);
+  // Mipmapped when the .dt has mip levels, see MIPMAP in the Makefile
+  pvrtex_poly_cxt(cxt, PVR_LIST_TR_POLY, &texture, PVR_FILTER_BILINEAR);
   cxt->gen.culling = PVR_CULLING_NONE; // disable culling for polygons facing
                                        // away from the camera
   cxt->gen.specular = PVR_SPECULAR_ENABLE;
 }
 
-void render_cube(void) {
+/* One vertex of one side, UVs from the mesh and specular colour by side */
+static inline void emit_vertex(pvr_dr_state_t *dr_state, int index, int side,
+                               uint32_t flags) {
+  const vec3f_t *vp = tverts + index;
+  pvr_vertex_t *vert = pvr_dr_target(*dr_state);
+  vert->flags = flags;
+  vert->x = vp->x;
+  vert->y = vp->y;
+  vert->z = vp->z;
+  vert->u = cube_mesh.u[index];
+  vert->v = cube_mesh.v[index];
+  vert->argb = 0xCFFFFFFF;
+  // The oargb specular color does the following:
+  // resulting color = texsample * argb + oargb.
+  // So white texture samples will remain white and black texture samples
+  // will be the same as oargb
+  vert->oargb = cube_side_colors[side % 6];
+  pvr_dr_commit(vert);
+}
+
+void render_cube(float alpha) {
   mat_load(&stored_projection_view);
-  mat_translate(cube_state.pos.x, cube_state.pos.y, cube_state.pos.z);
+  mat_translate(fixedstep_lerp(prev_state.pos.x, cube_state.pos.x, alpha),
+                fixedstep_lerp(prev_state.pos.y, cube_state.pos.y, alpha),
+                fixedstep_lerp(prev_state.pos.z, cube_state.pos.z, alpha));
   mat_scale(MODEL_SCALE, MODEL_SCALE, MODEL_SCALE);
-  mat_rotate_x(cube_state.rot.x);
-  mat_rotate_y(cube_state.rot.y);
+  mat_rotate_x(fixedstep_lerp(prev_state.rot.x, cube_state.rot.x, alpha));
+  mat_rotate_y(fixedstep_lerp(prev_state.rot.y, cube_state.rot.y, alpha));
 
-  vec3f_t tverts[8] __attribute__((aligned(32))) = {0};
-  mat_transform((vector_t*)&cube_vertices, (vector_t*)&tverts, 8, sizeof(vec3f_t));
+  // mat_transform() wants the positions interleaved
+  for (int i = 0; i < cube_mesh.vert_count; i++) {
+    tverts[i].x = cube_mesh.x[i];
+    tverts[i].y = cube_mesh.y[i];
+    tverts[i].z = cube_mesh.z[i];
+  }
+  mat_transform((vector_t*)tverts, (vector_t*)tverts, cube_mesh.vert_count, sizeof(vec3f_t));
 
   pvr_poly_cxt_t cxt;
   pvr_dr_state_t dr_state;
   pvr_poly_hdr_t hdr;
-  pvr_vertex_t *vert;
   init_poly_context(&cxt);
   pvr_poly_compile(&hdr, &cxt);
   pvr_prim(&hdr, sizeof(hdr));
   pvr_dr_init(&dr_state);
-  for (int i = 0; i < 6; i++) {
-    for (int j = 0; j < 4; j++) {
-      vec3f_t *vp = tverts + cube_side_strips[i][j];
-      vert = pvr_dr_target(dr_state);
-      vert->flags = (j == 3) ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
-      vert->x = vp->x;
-      vert->y = vp->y;
-      vert->z = vp->z;
-      vert->u = cube_tex_coords[j][0];
-      vert->v = cube_tex_coords[j][1];
-      vert->argb = 0xCFFFFFFF;
-      // The oargb specular color does the following:
-      // resulting color = texsample * argb + oargb.
-      // So white texture samples will remain white and black texture samples
-      // will be the same as oargb
-      vert->oargb = cube_side_colors[i];
-      pvr_dr_commit(vert);
+
+  // With CUBE_STITCH all strips go as one with a single EOL. Between strips
+  // the last vertex of one and the first of the next are sent again; the
+  // triangles that makes have no area and are dropped, and as every side is
+  // four vertices the next one still starts on an even vertex and keeps its
+  // winding.
+  int last = -1, last_side = 0;
+  for (int g = 0; g < cube_mesh.group_count; g++) {
+    for (uint32_t s = cube_mesh.group_first[g]; s < cube_mesh.group_first[g + 1]; s++) {
+      const uint16_t *index = cube_mesh.index + cube_mesh.strip_first[s];
+      int n = cube_mesh.strip_first[s + 1] - cube_mesh.strip_first[s];
+      int eol = !CUBE_STITCH || s + 1 == (uint32_t)cube_mesh.strip_count;
+      if (CUBE_STITCH && last >= 0 && n > 0) {
+        emit_vertex(&dr_state, last, last_side, PVR_CMD_VERTEX);
+        emit_vertex(&dr_state, index[0], g, PVR_CMD_VERTEX);
+      }
+      for (int j = 0; j < n; j++)
+        emit_vertex(&dr_state, index[j], g,
+                    (eol && j == n - 1) ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX);
+      if (n > 0) {
+        last = index[n - 1];
+        last_side = g;
+      }
     }
   }
   pvr_dr_finish();
@@ -99,12 +153,36 @@ static inline void cube_reset_state() {
 }
 
 
-int update_state() {
+/* Read the pad, 0 once START is pressed. No controller reads as no input. */
+static int read_pad(cont_state_t *pad) {
   int keep_running = 1;
+  memset(pad, 0, sizeof(*pad));
   MAPLE_FOREACH_BEGIN(MAPLE_FUNC_CONTROLLER, cont_state_t, state)
   if (state->buttons & CONT_START){
     keep_running = 0;
   }
+  *pad = *state;
+
+  if (state->buttons & CONT_DPAD_RIGHT) {
+    printf("fovy = %f\n"
+           "cube_state.pos.x = %f\n"
+           "cube_state.pos.y = %f\n"
+           "cube_state.pos.z = %f\n"
+           "cube_state.rot.x = %f\n"
+           "cube_state.rot.y = %f\n"
+           "cube_state.speed.x = %f\n"
+           "cube_state.speed.y = %f\n",
+           fovy, cube_state.pos.x, cube_state.pos.y, cube_state.pos.z,
+           cube_state.rot.x, cube_state.rot.y, cube_state.speed.x,
+           cube_state.speed.y);
+  }
+  MAPLE_FOREACH_END()
+  return keep_running;
+}
+
+/* One simulation step with the buttons and sticks last read */
+static void step_cube(const cont_state_t *state) {
+  prev_state = cube_state;
 
   if (abs(state->joyx) > 16)
     cube_state.pos.x += (state->joyx / 32768.0f) * 20.5f; // Increased sensitivity
@@ -128,9 +206,8 @@ int update_state() {
     cube_state.speed.x -= 0.001f;
 
   if (state->buttons & CONT_DPAD_LEFT) {
-    cube_state = (struct cube){0};
-    fovy = DEFAULT_FOV;
     cube_reset_state();
+    prev_state = cube_state;
   }
   if (state->buttons & CONT_DPAD_DOWN) {
     fovy -= 1.0f;
@@ -141,21 +218,6 @@ int update_state() {
     update_projection_view(fovy);
   }
 
-  if (state->buttons & CONT_DPAD_RIGHT) {
-    printf("fovy = %f\n"
-           "cube_state.pos.x = %f\n"
-           "cube_state.pos.y = %f\n"
-           "cube_state.pos.z = %f\n"
-           "cube_state.rot.x = %f\n"
-           "cube_state.rot.y = %f\n"
-           "cube_state.speed.x = %f\n"
-           "cube_state.speed.y = %f\n",
-           fovy, cube_state.pos.x, cube_state.pos.y, cube_state.pos.z,
-           cube_state.rot.x, cube_state.rot.y, cube_state.speed.x,
-           cube_state.speed.y);
-  }
-  MAPLE_FOREACH_END()
-
   // Apply rotation
   cube_state.rot.x += cube_state.speed.x;
   cube_state.rot.y += cube_state.speed.y;
@@ -163,7 +225,6 @@ int update_state() {
   // Apply friction
   cube_state.speed.x *= 0.99f;
   cube_state.speed.y *= 0.99f;
-  return keep_running;
 }
 
 int main(int argc, char *argv[]) {
@@ -183,23 +244,42 @@ int main(int argc, char *argv[]) {
     printf("Failed to load texture.\n");
     return -1;
   }
+  if (!mesh_load("/rd/mesh/cube.msh", &cube_mesh) ||
+      (tverts = memalign(32, cube_mesh.vert_count * sizeof(vec3f_t))) == NULL) {
+    printf("Failed to load the cube mesh.\n");
+    mesh_unload(&cube_mesh);
+    pvrtex_unload(&texture);
+    pvr_shutdown();
+    return -1;
+  }
   cube_reset_state();
+  prev_state = cube_state;
+
+  cont_state_t pad;
+  fixedstep_init(&sim_clock, SIM_HZ, timer_us_gettime64());
 
   while (1) {
-    if (!update_state())
+    if (!read_pad(&pad))
       break;
 
+    // As many steps as the time since the last frame holds, maybe none
+    int steps = fixedstep_advance(&sim_clock, timer_us_gettime64());
+    while (steps--)
+      step_cube(&pad);
+
     pvr_wait_ready();
     pvr_scene_begin();
     pvr_list_begin(PVR_LIST_TR_POLY);
 
-    render_cube();
+    render_cube(fixedstep_alpha(&sim_clock));
 
     pvr_list_finish();
     pvr_scene_finish();
   }
 
   printf("Cleaning up\n");
+  free(tverts);
+  mesh_unload(&cube_mesh);
   pvrtex_unload(&texture);
   pvr_shutdown(); // Clean up PVR resources
   vid_shutdown(); // This function reinitializes the video system to what dcload
@@ -0,0 +1,85 @@
+#ifndef PVRPAL_H
+#define PVRPAL_H
+
+#include <dc/pvr.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**  Palette banks shared by everything that loads palettised textures.
+
+     The PVR has 1024 palette entries, 64 banks of 16 for PAL4 textures or
+     4 of 256 for PAL8, and one palette format for all of them. Whatever
+     fills entries reserves them here first, so an SDF font's ramps and a
+     texture from pvrtex_load_named() never land in the same bank.
+
+     The first reservation sets the format. While anything is reserved a
+     request in another format is refused, so a loader cannot switch it
+     under the colours already loaded; once everything is released the
+     next reservation may pick again.
+
+     The allocator is one object for the whole program, whichever files
+     include this, so the definition below is weak.                         */
+
+#define PVRPAL_ENTRIES 1024
+#define PVRPAL_BANK 16              // smallest reservation, one PAL4 bank
+
+typedef struct {
+  uint64_t used;                    // bit per 16 entry bank
+  int format;                       // PVR_PAL_*, while used is not 0
+} pvrpal_t;
+
+__attribute__((weak)) pvrpal_t pvrpal;
+
+/**
+ * @brief The palette format in use, or fallback when nothing is reserved
+ */
+static inline int pvrpal_format(int fallback) {
+  return pvrpal.used ? pvrpal.format : fallback;
+}
+
+static inline uint64_t pvrpal_mask(int first, int entries) {
+  int banks = entries / PVRPAL_BANK;
+  return (banks >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << banks) - 1) << (first / PVRPAL_BANK);
+}
+
+/**
+ * @brief Reserve palette entries and set the palette format
+ *
+ * @param entries 16 per PAL4 bank or 256 per PAL8 bank; reservations of
+ *                256 or more start on a PAL8 bank
+ * @param fmt PVR_PAL_* the entries will be written in
+ * @param owner Named in the error message
+ * @return int The first entry, -1 when there is no room or fmt differs
+ *             from the format of what is already reserved
+ */
+static inline int pvrpal_alloc(int entries, int fmt, const char *owner) {
+  int align = entries >= 256 ? 256 : PVRPAL_BANK;
+
+  if (pvrpal.used && fmt != pvrpal.format) {
+    printf("Error: %s wants palette format %d, %d is in use\n", owner, fmt, pvrpal.format);
+    return -1;
+  }
+  entries = (entries + PVRPAL_BANK - 1) & ~(PVRPAL_BANK - 1);
+  for (int first = 0; first + entries <= PVRPAL_ENTRIES; first += align) {
+    uint64_t mask = pvrpal_mask(first, entries);
+    if (pvrpal.used & mask)
+      continue;
+    if (!pvrpal.used)
+      pvr_set_pal_format(fmt);
+    pvrpal.used |= mask;
+    pvrpal.format = fmt;
+    return first;
+  }
+  printf("Error: no room for %d palette entries for %s\n", entries, owner);
+  return -1;
+}
+
+/* Give back what pvrpal_alloc() returned */
+static inline void pvrpal_free(int first, int entries) {
+  if (first < 0)
+    return;
+  entries = (entries + PVRPAL_BANK - 1) & ~(PVRPAL_BANK - 1);
+  pvrpal.used &= ~pvrpal_mask(first, entries);
+}
+
+#endif // PVRPAL_H
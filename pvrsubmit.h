@@ -0,0 +1,177 @@
+#ifndef PVRSUBMIT_H
+#define PVRSUBMIT_H
+
+#include <dc/pvr.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**  Vertex submission that works the same with or without PVR DMA.
+
+     Direct rendering writes every 32 byte block through a store queue
+     straight to the TA, and the CPU waits whenever the TA is slower than
+     it. In DMA mode the blocks go into a vertex buffer in main RAM instead
+     and pvr_scene_finish() hands the whole frame to the DMA controller,
+     which feeds the TA while the CPU goes on to build the next frame. KOS
+     splits each list's buffer in half and swaps the halves every frame, so
+     the arrays are double buffered.
+
+     The render code is the same either way:
+
+       pvrsub_begin(&sub, &bufs, list);
+       blk = pvrsub_target(&sub);   // like pvr_dr_target(), 32 bytes
+       ... fill blk ...
+       pvrsub_commit(&sub, blk);    // like pvr_dr_commit()
+       pvrsub_finish(&sub);         // like pvr_dr_finish()
+
+     Like the store queues, the block before the current target is still
+     writable until it is committed a second time, so sprites that span two
+     blocks keep working. In DMA mode pvr_prim() appends to the same buffer,
+     so finish before using it and begin again after.
+
+     pvrsub_init() picks the mode: pass the same dma flag as dma_enabled in
+     pvr_init_params_t.
+
+     When a frame's half fills up the buffer is cut back to the end of the
+     last whole primitive, read from the command word of each committed
+     block (headers, end of strip, sprites as two blocks; 64 byte polygon
+     vertices are not told apart). From then on pvrsub_target() hands out a
+     scratch block that is never submitted and the rest of the list is
+     counted in bufs->dropped.                                              */
+
+/* Per list buffer sizes, both halves together; 0 for lists not used */
+typedef struct {
+  int dma;
+  size_t size[PVR_LIST_PT_POLY + 1];
+  void *buf[PVR_LIST_PT_POLY + 1];
+  uint32_t dropped;           // blocks that did not fit, DMA only
+} pvrsub_bufs_t;
+
+typedef struct {
+  pvrsub_bufs_t *bufs;
+  int dma;                    // from pvrsub_init()
+  pvr_list_t list;
+  pvr_dr_state_t dr;
+  uint8_t *ptr, *start, *end; // DMA: write position and the end of this frame's half
+  uint8_t *mark;              // DMA: end of the last whole primitive
+  int sprite;                 // DMA: under a sprite header, vertices take two blocks
+  int tail;                   // DMA: the next block is a sprite vertex's second half
+  int full;                   // DMA: out of room, writes go to scratch
+  uint8_t scratch[64] __attribute__((aligned(32)));
+} pvrsub_t;
+
+#define PVRSUB_ADDR(p) ((uintptr_t)(p) & 0x1fffffff) /* same RAM, any mirror */
+
+/**
+ * @brief Set up the RAM vertex buffers for DMA mode
+ *
+ * Call after pvr_init() with dma_enabled set. Each used list gets a 32 byte
+ * aligned buffer of bufs->size[list] bytes, half of which is what one frame
+ * of that list may hold. Does nothing when dma is 0.
+ *
+ * @param bufs Sizes in, buffers out
+ * @param dma The dma_enabled flag given to pvr_init()
+ * @return int 1 on success, 0 if a buffer could not be allocated
+ */
+static inline int pvrsub_init(pvrsub_bufs_t *bufs, int dma) {
+  bufs->dma = dma;
+  bufs->dropped = 0;
+  for (int list = 0; list <= PVR_LIST_PT_POLY; list++) {
+    bufs->buf[list] = NULL;
+    if (!dma || bufs->size[list] == 0)
+      continue;
+    bufs->size[list] = (bufs->size[list] + 63) & ~63;
+    bufs->buf[list] = memalign(32, bufs->size[list]);
+    if (bufs->buf[list] == NULL) {
+      printf("Error: no RAM for a %u byte vertex buffer\n", (unsigned)bufs->size[list]);
+      return 0;
+    }
+    pvr_set_vertbuf(list, bufs->buf[list], bufs->size[list]);
+  }
+  return 1;
+}
+
+/* Free the buffers, after pvr_shutdown() */
+static inline void pvrsub_shutdown(pvrsub_bufs_t *bufs) {
+  for (int list = 0; list <= PVR_LIST_PT_POLY; list++) {
+    free(bufs->buf[list]);
+    bufs->buf[list] = NULL;
+  }
+}
+
+/**
+ * @brief Start writing vertices for a list
+ *
+ * @param sub Submission state
+ * @param bufs The buffers from pvrsub_init()
+ * @param list The list the vertices belong to, open with pvr_list_begin()
+ */
+static inline void pvrsub_begin(pvrsub_t *sub, pvrsub_bufs_t *bufs, pvr_list_t list) {
+  sub->bufs = bufs;
+  sub->dma = bufs->dma;
+  sub->list = list;
+  if (sub->dma) {
+    size_t half = bufs->size[list] / 2;
+    size_t used = PVRSUB_ADDR(pvr_vertbuf_tail(list)) - PVRSUB_ADDR(bufs->buf[list]);
+    sub->start = sub->ptr = sub->mark = (uint8_t *)pvr_vertbuf_tail(list);
+    sub->sprite = sub->tail = sub->full = 0;
+    // Whatever is left of this frame's half
+    sub->end = sub->start + (used < half ? half - used : 2 * half - used);
+  } else {
+    pvr_dr_init(&sub->dr);
+  }
+}
+
+static inline void *pvrsub_target(pvrsub_t *sub) {
+  if (!sub->dma)
+    return pvr_dr_target(sub->dr);
+  if (sub->ptr >= sub->end && !sub->full) {
+    // Drop the primitive that did not fit rather than send half of it
+    sub->full = 1;
+    sub->ptr = sub->mark;
+  }
+  if (sub->full) {
+    // The second half of a sprite is written through target - 32, so hand
+    // out the upper block of the scratch and keep both inside it
+    sub->bufs->dropped++;
+    return sub->scratch + 32;
+  }
+  return sub->ptr;
+}
+
+static inline void pvrsub_commit(pvrsub_t *sub, void *blk) {
+  uint32_t cmd;
+
+  if (!sub->dma) {
+    pvr_dr_commit(blk);
+    return;
+  }
+  if (sub->full)
+    return;
+  cmd = *(const uint32_t *)blk;
+  sub->ptr += 32;
+  if (sub->tail) {
+    sub->tail = 0;
+    sub->mark = sub->ptr;
+  } else if ((cmd >> 29) == 4 || (cmd >> 29) == 5) {
+    // Polygon, modifier volume or sprite header
+    sub->sprite = (cmd >> 29) == 5;
+    sub->mark = sub->ptr;
+  } else if ((cmd & PVR_CMD_VERTEX_EOL) == PVR_CMD_VERTEX_EOL) {
+    if (sub->sprite)
+      sub->tail = 1;
+    else
+      sub->mark = sub->ptr;
+  }
+}
+
+/* Done with this list for now; more can follow with another pvrsub_begin() */
+static inline void pvrsub_finish(pvrsub_t *sub) {
+  if (sub->dma)
+    pvr_vertbuf_written(sub->list, sub->ptr - sub->start);
+  else
+    pvr_dr_finish();
+}
+
+#endif // PVRSUBMIT_H
@@ -9,6 +9,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "pvrpal.h"
+
+#ifndef PVRTEX_MIPMAP_BIAS
+#define PVRTEX_MIPMAP_BIAS PVR_MIPBIAS_NORMAL // D adjust for mipmapped textures
+#endif
+
 typedef fDtHeader dt_header_t;
 
 typedef struct {
@@ -27,6 +33,9 @@ typedef struct {
   } flags;
   uint16_t width;
   uint16_t height;
+  uint32_t size;    // bytes in texture memory, all the mip levels with mipmaps
+  int mipmap_bias;  // PVR_MIPBIAS_*, PVRTEX_MIPMAP_BIAS unless changed
+  uint16_t pal_first, pal_entries; // reserved by pvrtex_load_named(), 0 entries if none
   pvr_ptr_t ptr;
 } dttex_info_t;
 
@@ -47,7 +56,13 @@ int pvrtex_load(const char *filename, dttex_info_t *texinfo) {
       success = 0;
       break;
     }
-    fread(&(texinfo->hdr), sizeof(dt_header_t), 1, fp);
+    if (fread(&(texinfo->hdr), sizeof(dt_header_t), 1, fp) != 1) {
+      printf("Error: %s is too short\n", filename);
+      success = 0;
+      break;
+    }
+    // Everything after the header, the mip levels smallest first when
+    // there are any
     size_t tdatasize =
         texinfo->hdr.chunk_size - ((1 + texinfo->hdr.header_size) << 5);
 
@@ -59,14 +74,29 @@ int pvrtex_load(const char *filename, dttex_info_t *texinfo) {
     texinfo->width = fDtGetPvrWidth(&texinfo->hdr);
     texinfo->height = fDtGetPvrHeight(&texinfo->hdr);
 
-    texinfo->pvrformat = texinfo->hdr.pvr_type & 0xFFC00000;
+    // Bit 31 is the mipmap flag, which goes in the context instead
+    texinfo->pvrformat = texinfo->hdr.pvr_type & 0x7FC00000;
+    texinfo->size = tdatasize;
+    texinfo->mipmap_bias = PVRTEX_MIPMAP_BIAS;
+    texinfo->pal_first = texinfo->pal_entries = 0;
+    if (texinfo->flags.mipmapped && (!texinfo->flags.twiddled || texinfo->width != texinfo->height)) {
+      printf("Error: %s is mipmapped but not square and twiddled\n", filename);
+      success = 0;
+      break;
+    }
 
     void *buffer = malloc(tdatasize);
-    fread(buffer, tdatasize, 1, fp);
+    if (buffer == NULL || fread(buffer, tdatasize, 1, fp) != 1) {
+      printf("Error: reading %s failed\n", filename);
+      free(buffer);
+      success = 0;
+      break;
+    }
 
     texinfo->ptr = pvr_mem_malloc(tdatasize);
     if (texinfo->ptr == NULL) {
       printf("Error: pvr_mem_malloc failed\n");
+      free(buffer);
       success = 0;
       break;
     }
@@ -81,8 +111,46 @@ int pvrtex_load(const char *filename, dttex_info_t *texinfo) {
   return success;
 }
 
+/**
+ * @brief Polygon context for a loaded texture
+ *
+ * pvr_poly_cxt_txr() with the texture's format and size, and mipmapping
+ * with its mipmap_bias when the file has mip levels.
+ *
+ * @param cxt The context to fill
+ * @param list The list it is for
+ * @param texinfo The texture
+ * @param filter PVR_FILTER_*
+ */
+static inline void pvrtex_poly_cxt(pvr_poly_cxt_t *cxt, pvr_list_t list, const dttex_info_t *texinfo,
+                                   int filter) {
+  pvr_poly_cxt_txr(cxt, list, texinfo->pvrformat, texinfo->width, texinfo->height, texinfo->ptr,
+                   filter);
+  if (texinfo->flags.mipmapped) {
+    cxt->txr.mipmap = PVR_MIPMAP_ENABLE;
+    cxt->txr.mipmap_bias = texinfo->mipmap_bias;
+  }
+}
+
+/**
+ * @brief Sprite context for a loaded texture, as pvrtex_poly_cxt()
+ */
+static inline void pvrtex_sprite_cxt(pvr_sprite_cxt_t *cxt, pvr_list_t list,
+                                     const dttex_info_t *texinfo, int filter) {
+  pvr_sprite_cxt_txr(cxt, list, texinfo->pvrformat, texinfo->width, texinfo->height, texinfo->ptr,
+                     filter);
+  if (texinfo->flags.mipmapped) {
+    cxt->txr.mipmap = PVR_MIPMAP_ENABLE;
+    cxt->txr.mipmap_bias = texinfo->mipmap_bias;
+  }
+}
+
 /**
  * @brief Load a palette from a file
+ *
+ * Reserve the entries with pvrpal_alloc() first, which sets the palette
+ * format; a fmt other than the one in use is refused.
+ *
  * @param filename The filename of the palette
  * @param fmt The format of the palette
  * @param offset The offset to load the palette
@@ -101,11 +169,17 @@ int pvrtex_load_palette(const char *filename, int fmt, size_t offset) {
   int success = 1;
   struct {
     char fourcc[4];
-    size_t colors;
+    uint32_t colors;
   } palette_hdr;
 
   FILE *fp = NULL;
   do {
+    if (fmt != pvrpal_format(fmt)) {
+      printf("Error: %s is for palette format %d, %d is in use\n", filename, fmt,
+             pvrpal_format(fmt));
+      success = 0;
+      break;
+    }
     fp = fopen(filename, "rb");
     if (fp == NULL) {
       printf("Error: fopen %s failed, %s\n", filename, strerror(errno));
@@ -116,7 +190,6 @@ int pvrtex_load_palette(const char *filename, int fmt, size_t offset) {
     uint32_t colors[palette_hdr.colors];
     fread(&colors, sizeof(uint32_t), palette_hdr.colors, fp);
 
-    pvr_set_pal_format(fmt);
     for (size_t i = 0; i < palette_hdr.colors; i++) {
       uint32_t color = colors[i];  // format 0xAARRGGBB
       switch (fmt) {
@@ -153,6 +226,10 @@ int pvrtex_load_palette(const char *filename, int fmt, size_t offset) {
  * @return int 1 on success, 0 on failure
  */
 int pvrtex_unload(dttex_info_t *texinfo) {
+  if (texinfo->pal_entries) {
+    pvrpal_free(texinfo->pal_first, texinfo->pal_entries);
+    texinfo->pal_entries = 0;
+  }
   if (texinfo->ptr != NULL) {
     pvr_mem_free(texinfo->ptr);
     texinfo->ptr = NULL;
@@ -160,4 +237,62 @@ int pvrtex_unload(dttex_info_t *texinfo) {
   }
   return 0;
 }
+
+/**
+ * @brief Load a texture by name, in whatever format the build picked for it
+ *
+ * Looks name up in a manifest written by tools/texpick and loads
+ * name.dt from the manifest's directory. Palettised textures get their
+ * name.dt.pal loaded into a bank reserved with pvrpal_alloc(), which goes
+ * into pvrformat, so pvrtex_poly_cxt() needs nothing else, and which
+ * pvrtex_unload() gives back. The palette is written in the format already
+ * in use, say an SDF font's ARGB8888, or as RGB565 when it is the first.
+ * The .pal holds ARGB8888, which converts to either.
+ *
+ * @param manifest The manifest, e.g. "/rd/texture/textures.txt"
+ * @param name The texture's PNG name without the extension
+ * @param texinfo The texture texinfo struct
+ * @return int 1 on success, 0 on failure
+ */
+int pvrtex_load_named(const char *manifest, const char *name, dttex_info_t *texinfo) {
+  char line[128], entry[64], format[16], path[256];
+  const char *slash = strrchr(manifest, '/');
+  int dir = slash ? (int)(slash - manifest) + 1 : 0, found = 0;
+  FILE *fp = fopen(manifest, "r");
+
+  if (fp == NULL) {
+    printf("Error: fopen %s failed, %s\n", manifest, strerror(errno));
+    return 0;
+  }
+  while (!found && fgets(line, sizeof(line), fp) != NULL)
+    found = line[0] != '#' && sscanf(line, "%63s %15s", entry, format) == 2 &&
+            !strcmp(entry, name);
+  fclose(fp);
+  if (!found) {
+    printf("Error: %s is not in %s\n", name, manifest);
+    return 0;
+  }
+
+  snprintf(path, sizeof(path), "%.*s%s.dt", dir, manifest, name);
+  if (!pvrtex_load(path, texinfo))
+    return 0;
+  if (texinfo->flags.palettised) {
+    int pal8 = !strcmp(format, "PAL8");
+    int entries = pal8 ? 256 : 16, fmt = pvrpal_format(PVR_PAL_RGB565);
+    int first = pvrpal_alloc(entries, fmt, name);
+    if (first < 0) {
+      pvrtex_unload(texinfo);
+      return 0;
+    }
+    texinfo->pal_first = first;
+    texinfo->pal_entries = entries;
+    strcat(path, ".pal");
+    if (!pvrtex_load_palette(path, fmt, first)) {
+      pvrtex_unload(texinfo);
+      return 0;
+    }
+    texinfo->pvrformat |= pal8 ? PVR_TXRFMT_8BPP_PAL(first / 256) : PVR_TXRFMT_4BPP_PAL(first / 16);
+  }
+  return 1;
+}
 #endif  // PVTEX_H
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef SDFFONT_H
+#define SDFFONT_H
+
+#include <stdint.h>
+
+/**  Signed distance field font atlas, shared by the host generator
+     (tools/sdffont.c) and the runtime renderer (pvr2dperlin/fontnew.c).
+
+     The atlas holds the 128 ASCII glyphs in a 16x8 grid of cells. Every texel
+     stores the distance to the nearest glyph edge, biased so that
+     SDF_EDGE_VALUE is exactly on the outline, larger values are inside the
+     glyph and each `spread` texels away from the edge moves the value by 127.
+     The texture is uploaded as PAL8, so the palette decides how a distance
+     turns into coverage: a soft ramp for anti-aliased text or an identity
+     ramp plus the punch-through alpha reference for a hard alpha test.
+
+     File layout: sdf_font_hdr_t (32 bytes) followed by width * height
+     8 bit distance values, row major, not twiddled.                          */
+
+#define SDF_FOURCC "SDF1"
+#define SDF_EDGE_VALUE 128
+#define SDF_GRID_COLS 16
+#define SDF_GRID_ROWS 8
+
+typedef struct {
+  char fourcc[4];      // "SDF1"
+  uint16_t width;      // atlas width in texels, power of two
+  uint16_t height;     // atlas height in texels, power of two
+  uint16_t cell_w;     // glyph cell size in texels
+  uint16_t cell_h;
+  uint16_t advance;    // horizontal pen advance in texels
+  uint8_t spread;      // distance in texels that maps to 127 value steps
+  uint8_t first_char;  // first glyph in the grid, always 0 for now
+  uint8_t num_chars;   // glyphs stored, 128
+  uint8_t reserved[15];
+} sdf_font_hdr_t;
+
+/**
+ * @brief Coverage for a distance sample when drawn at a given magnification
+ *
+ * One screen pixel covers 1/texel_px atlas texels, which is
+ * (127 / spread) / texel_px distance steps. Spreading the 0..255 alpha ramp
+ * over exactly that range gives one pixel of anti-aliasing at any scale.
+ *
+ * @param value 8 bit distance sample
+ * @param spread Spread the atlas was generated with
+ * @param texel_px Screen pixels per atlas texel
+ * @return uint8_t alpha 0..255
+ */
+static inline uint8_t sdf_ramp_alpha(int value, int spread, float texel_px) {
+  float steps_per_px = (127.0f / (float)spread) / texel_px;
+  float a = ((float)(value - SDF_EDGE_VALUE) / steps_per_px) + 0.5f;
+  if (a <= 0.0f)
+    return 0;
+  if (a >= 1.0f)
+    return 255;
+  return (uint8_t)(a * 255.0f + 0.5f);
+}
+
+/*  The palette is shared by every glyph drawn in a frame, so the runtime keeps
+    one ramp per magnification bucket in its own PAL8 bank and picks the
+    bank per string. Bucket b is built for 2^(b-1) screen pixels per texel:
+    half size, native and double size and up.                                */
+#define SDF_RAMP_BANKS 3
+
+static inline float sdf_ramp_texel_px(int bucket) {
+  return (float)(1 << bucket) * 0.5f;
+}
+
+static inline int sdf_ramp_bucket(float texel_px) {
+  if (texel_px < 0.75f)
+    return 0;
+  if (texel_px < 1.5f)
+    return 1;
+  return 2;
+}
+
+#endif // SDFFONT_H
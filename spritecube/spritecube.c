@@ -22,10 +22,30 @@
 #else
 #define XSCALE 1.0f
 #endif
+#ifndef VERTEX_DMA
+#define VERTEX_DMA 0 // Set to 1 to build the lists in RAM and DMA them to the TA
+#endif
+#ifndef INPUT_THREAD
+#define INPUT_THREAD 1 // Poll the pads on a thread, 0 to poll them in the render loop
+#endif
+#ifndef BENCH
+#define BENCH 0 // Set to 1 to replay the scenarios in /rd/bench and report timings
+#endif
+#ifndef LZPACK
+#define LZPACK 0 // Set to 1 when the romdisk is linked as an LZ4 pack, see ../lzpack.h
+#endif
 #define FRAMETIMES
-#include "../cube.h"        /* Cube vertices and side strips layout */
+#include "../cube.h"        /* Cube state and side colours */
+#include "../mesh.h"        /* Indexed strip meshes, mapped from the romdisk */
 #include "../perspective.h" /* Perspective projection matrix functions */
 #include "../pvrtex.h"      /* texture management, single header code */
+#include "../pvrsubmit.h"   /* Same vertex writes for store queues and DMA */
+#include "../padinput.h"    /* Controller polling thread, edge events */
+#include "../padrec.h"      /* Pad recording and playback per step */
+#include "../fixedstep.h"   /* Fixed rate simulation clock */
+#include "../overdraw.h"    /* OVERDRAW=1 draws layers shaded instead */
+#include "../lzpack.h"      /* Compressed romdisk, decoded per file on open */
+#define SIM_HZ 60           // Simulation steps per second
 #define DEFAULT_FOV 75.0f   // Field of view, adjust with dpad up/down
 #define ZOOM_SPEED 0.3f
 #define MODEL_SCALE 3.0f
@@ -45,11 +65,48 @@ typedef enum {
 } render_mode_e;
 
 static render_mode_e render_mode = TEXTURED_TR;
+static const char *render_mode_names[MAX_RENDERMODE] = {
+    "TEXTURED_TR", "CUBES_CUBE_MIN", "CUBES_CUBE_MAX", "WIREFRAME_EMPTY",
+    "WIREFRAME_FILLED"};
+// With VERTEX_DMA, per list RAM for two frames. CUBES_CUBE_MAX without FSAA
+// is 17*17*16 cubes of 6 sprites of 64 bytes, 1.8MB a frame.
+static pvrsub_bufs_t vertbufs = {
+    .size = {[PVR_LIST_OP_POLY] = 4 << 20, [PVR_LIST_TR_POLY] = 64 << 10}};
 static float fovy = DEFAULT_FOV;
 static dttex_info_t texture256;
 static dttex_info_t texture64;
 static dttex_info_t texture32;
 
+/* The cube from romdisk/mesh/cube.msh (assets/mesh/cube.obj through
+   tools/meshconv). A sprite is one quad, so every side has to be a single
+   strip of four vertices, a, d, b, c in sprite corners; load_cube_mesh()
+   refuses anything else. */
+#define CUBE_MESH_MAX_VERTS 8 // transformed on the stack per cube
+static mesh_t cube_mesh;
+static vec3f_t mesh_min, mesh_max;                 // bounds of the mesh
+static vec3f_t mesh_unit[CUBE_MESH_MAX_VERTS];     // 0 to 1 across the bounds
+
+static inline const uint16_t *side_strip(int side) {
+  return cube_mesh.index + cube_mesh.strip_first[cube_mesh.group_first[side]];
+}
+
+/* A corner of the mesh's bounding box, 0 for the min and 1 for the max */
+static inline vec3f_t box_corner(int x, int y, int z) {
+  return (vec3f_t){x ? mesh_max.x : mesh_min.x, y ? mesh_max.y : mesh_min.y,
+                   z ? mesh_max.z : mesh_min.z};
+}
+
+/* The mesh positions through the current matrix */
+static inline void transform_mesh(vec3f_t *tverts) {
+  for (int i = 0; i < cube_mesh.vert_count; i++) {
+    tverts[i].x = cube_mesh.x[i];
+    tverts[i].y = cube_mesh.y[i];
+    tverts[i].z = cube_mesh.z[i];
+  }
+  mat_transform((vector_t *)tverts, (vector_t *)tverts, cube_mesh.vert_count,
+                sizeof(vec3f_t));
+}
+
 static inline void set_cube_transform() {
   mat_load(&stored_projection_view);
   mat_translate(cube_state.pos.x, cube_state.pos.y, cube_state.pos.z);
@@ -59,12 +116,13 @@ static inline void set_cube_transform() {
 }
 
 static inline void draw_textured_sprite(vec3f_t *tverts, uint32_t side,
-                                        pvr_dr_state_t *dr_state) {
-  vec3f_t *ac = tverts + cube_side_strips[side][0];
-  vec3f_t *bc = tverts + cube_side_strips[side][2];
-  vec3f_t *cc = tverts + cube_side_strips[side][3];
-  vec3f_t *dc = tverts + cube_side_strips[side][1];
-  pvr_sprite_txr_t *quad = (pvr_sprite_txr_t *)pvr_dr_target(*dr_state);
+                                        pvrsub_t *sub) {
+  const uint16_t *strip = side_strip(side);
+  vec3f_t *ac = tverts + strip[0];
+  vec3f_t *bc = tverts + strip[2];
+  vec3f_t *cc = tverts + strip[3];
+  vec3f_t *dc = tverts + strip[1];
+  pvr_sprite_txr_t *quad = (pvr_sprite_txr_t *)pvrsub_target(sub);
   quad->flags = PVR_CMD_VERTEX_EOL;
   quad->ax = ac->x;
   quad->ay = ac->y;
@@ -73,48 +131,45 @@ static inline void draw_textured_sprite(vec3f_t *tverts, uint32_t side,
   quad->by = bc->y;
   quad->bz = bc->z;
   quad->cx = cc->x;
-  pvr_dr_commit(quad);
-  quad = (pvr_sprite_txr_t *)pvr_dr_target(*dr_state);
+  pvrsub_commit(sub, quad);
+  quad = (pvr_sprite_txr_t *)pvrsub_target(sub);
   /* make a pointer with 32 bytes negative offset to allow field access to the
    * second half of the quad */
-  pvr_sprite_txr_t *quad2ndhalf = (pvr_sprite_txr_t *)((int)quad - 32);
+  pvr_sprite_txr_t *quad2ndhalf = (pvr_sprite_txr_t *)((uintptr_t)quad - 32);
   quad2ndhalf->cy = cc->y;
   quad2ndhalf->cz = cc->z;
   quad2ndhalf->dx = dc->x;
   quad2ndhalf->dy = dc->y;
-  quad2ndhalf->auv =
-      PVR_PACK_16BIT_UV(cube_tex_coords[0][0], cube_tex_coords[0][1]);
-  quad2ndhalf->cuv =
-      PVR_PACK_16BIT_UV(cube_tex_coords[3][0], cube_tex_coords[3][1]);
-  quad2ndhalf->buv =
-      PVR_PACK_16BIT_UV(cube_tex_coords[2][0], cube_tex_coords[2][1]);
-  pvr_dr_commit(quad);
+  // The whole texture on every side
+  quad2ndhalf->auv = PVR_PACK_16BIT_UV(0.0f, 0.0f);
+  quad2ndhalf->cuv = PVR_PACK_16BIT_UV(1.0f, 1.0f);
+  quad2ndhalf->buv = PVR_PACK_16BIT_UV(1.0f, 0.0f);
+  pvrsub_commit(sub, quad);
 }
 
 void render_txr_tr_cube(void) {
   set_cube_transform();
-  vec3f_t tverts[8] __attribute__((aligned(32))) = {0};
-  mat_transform((vector_t *)&cube_vertices, (vector_t *)&tverts, 8,
-                sizeof(vec3f_t));
-  pvr_dr_state_t dr_state;
+  vec3f_t tverts[CUBE_MESH_MAX_VERTS] __attribute__((aligned(32)));
+  transform_mesh(tverts);
+  pvrsub_t sub;
   pvr_sprite_cxt_t cxt;
-  pvr_sprite_cxt_txr(&cxt, PVR_LIST_TR_POLY, texture256.pvrformat,
-                     texture256.width, texture256.height, texture256.ptr,
-                     PVR_FILTER_BILINEAR);
+  // Mipmapped when the .dt has mip levels, see MIPMAP in the Makefile
+  pvrtex_sprite_cxt(&cxt, PVR_LIST_TR_POLY, &texture256, PVR_FILTER_BILINEAR);
   cxt.gen.specular = PVR_SPECULAR_ENABLE;
   cxt.gen.culling = PVR_CULLING_NONE;
-  pvr_dr_init(&dr_state);
+  overdraw_sprite_cxt(&cxt);
+  pvrsub_begin(&sub, &vertbufs, PVR_LIST_TR_POLY);
   pvr_sprite_hdr_t hdr;
   pvr_sprite_compile(&hdr, &cxt);
-  hdr.argb = 0x7FFFFFFF;
-  for (int i = 0; i < 6; i++) {
-    pvr_sprite_hdr_t *hdrpntr = (pvr_sprite_hdr_t *)pvr_dr_target(dr_state);
+  hdr.argb = OVERDRAW_ARGB(0x7FFFFFFF);
+  for (int i = 0; i < cube_mesh.group_count; i++) {
+    pvr_sprite_hdr_t *hdrpntr = (pvr_sprite_hdr_t *)pvrsub_target(&sub);
     *hdrpntr = hdr;
-    hdrpntr->oargb = cube_side_colors[i];
-    pvr_dr_commit(hdrpntr);
-    draw_textured_sprite(tverts, i, &dr_state);
+    hdrpntr->oargb = cube_side_colors[i % 6];
+    pvrsub_commit(&sub, hdrpntr);
+    draw_textured_sprite(tverts, i, &sub);
   }
-  pvr_dr_finish();
+  pvrsub_finish(&sub);
 }
 
 void render_cubes_cube() {
@@ -128,27 +183,28 @@ void render_cubes_cube() {
     // triangles pr. second 17*17*16 cubes, or 3329280 triangles pr. second,
     // works with FSAA disabled, set #define SUPERSAMPLING 0
     pvr_sprite_cxt_txr(
-        &cxt, PVR_LIST_OP_POLY, texture32.pvrformat | PVR_TXRFMT_4BPP_PAL(16),
+        &cxt, PVR_LIST_OP_POLY, texture32.pvrformat,
         texture32.width, texture32.height, texture32.ptr, PVR_FILTER_BILINEAR);
   } else {
     pvr_sprite_cxt_txr(
-        &cxt, PVR_LIST_OP_POLY, texture64.pvrformat | PVR_TXRFMT_8BPP_PAL(0),
+        &cxt, PVR_LIST_OP_POLY, texture64.pvrformat,
         texture64.width, texture64.height, texture64.ptr, PVR_FILTER_BILINEAR);
     cxt.gen.specular = PVR_SPECULAR_ENABLE;
   }
-  pvr_dr_state_t dr_state;
-  pvr_dr_init(&dr_state);
+  overdraw_sprite_cxt(&cxt);
+  pvrsub_t sub;
+  pvrsub_begin(&sub, &vertbufs, PVR_LIST_OP_POLY);
   pvr_sprite_hdr_t hdr;
   pvr_sprite_compile(&hdr, &cxt);
-  hdr.argb = 0xFFFFFFFF;
+  hdr.argb = OVERDRAW_ARGB(0xFFFFFFFF);
   if (render_mode == CUBES_CUBE_MAX) { // use single shared header for MAX mode
                                        // without specular
-    pvr_sprite_hdr_t *hdrptr = (pvr_sprite_hdr_t *)pvr_dr_target(dr_state);
+    pvr_sprite_hdr_t *hdrptr = (pvr_sprite_hdr_t *)pvrsub_target(&sub);
     *hdrptr = hdr;
-    pvr_dr_commit(hdrptr);
+    pvrsub_commit(&sub, hdrptr);
   }
-  vec3f_t cube_min = cube_vertices[6];
-  vec3f_t cube_max = cube_vertices[3];
+  vec3f_t cube_min = mesh_min;
+  vec3f_t cube_max = mesh_max;
   vec3f_t cube_step = {
       (cube_max.x - cube_min.x) / cuberoot_cubes,
       (cube_max.y - cube_min.y) / cuberoot_cubes,
@@ -167,45 +223,35 @@ void render_cubes_cube() {
       for (int cz = 0; cz < cuberoot_cubes; cz++) {
         if (render_mode == CUBES_CUBE_MIN) {
           pvr_sprite_hdr_t *hdrpntr =
-              (pvr_sprite_hdr_t *)pvr_dr_target(dr_state);
+              (pvr_sprite_hdr_t *)pvrsub_target(&sub);
           *hdrpntr = hdr;
           hdrpntr->oargb = cube_side_colors[(cx + cy + cz) % 6];
-          pvr_dr_commit(hdrpntr);
+          pvrsub_commit(&sub, hdrpntr);
         }
         vec3f_t cube_pos = {cube_min.x + cube_step.x * (float)cx,
                             cube_min.y + cube_step.y * (float)cy,
                             cube_min.z + cube_step.z * (float)cz};
-        vec3f_t tverts[8] __attribute__((aligned(32))) = {
-            {.x = cube_pos.x, .y = cube_pos.y, .z = cube_pos.z + cube_size.z},
-            {.x = cube_pos.x,
-             .y = cube_pos.y + cube_size.y,
-             .z = cube_pos.z + cube_size.z},
-            {.x = cube_pos.x + cube_size.x,
-             .y = cube_pos.y,
-             .z = cube_pos.z + cube_size.z},
-            {.x = cube_pos.x + cube_size.x,
-             .y = cube_pos.y + cube_size.y,
-             .z = cube_pos.z + cube_size.z},
-            {.x = cube_pos.x + cube_size.x, .y = cube_pos.y, .z = cube_pos.z},
-            {.x = cube_pos.x + cube_size.x,
-             .y = cube_pos.y + cube_size.y,
-             .z = cube_pos.z},
-            {.x = cube_pos.x, .y = cube_pos.y, .z = cube_pos.z},
-            {.x = cube_pos.x, .y = cube_pos.y + cube_size.y, .z = cube_pos.z}};
-        mat_transform((vector_t *)&tverts, (vector_t *)&tverts, 8,
-                      sizeof(vec3f_t));
-        for (int i = 0; i < 6; i++) {
-          draw_textured_sprite(tverts, i, &dr_state);
+        // The mesh shrunk into this cube's box
+        vec3f_t tverts[CUBE_MESH_MAX_VERTS] __attribute__((aligned(32)));
+        for (int i = 0; i < cube_mesh.vert_count; i++) {
+          tverts[i].x = cube_pos.x + mesh_unit[i].x * cube_size.x;
+          tverts[i].y = cube_pos.y + mesh_unit[i].y * cube_size.y;
+          tverts[i].z = cube_pos.z + mesh_unit[i].z * cube_size.z;
+        }
+        mat_transform((vector_t *)&tverts, (vector_t *)&tverts,
+                      cube_mesh.vert_count, sizeof(vec3f_t));
+        for (int i = 0; i < cube_mesh.group_count; i++) {
+          draw_textured_sprite(tverts, i, &sub);
         }
       };
     }
   }
-  pvr_dr_finish();
+  pvrsub_finish(&sub);
 }
 
 static inline void draw_sprite_line(vec3f_t *from, vec3f_t *to, float centerz,
-                                    pvr_dr_state_t *dr_state) {
-  pvr_sprite_col_t *quad = (pvr_sprite_col_t *)pvr_dr_target(*dr_state);
+                                    pvrsub_t *sub) {
+  pvr_sprite_col_t *quad = (pvr_sprite_col_t *)pvrsub_target(sub);
   quad->flags = PVR_CMD_VERTEX_EOL;
   if (from->x > to->x) {
     vec3f_t *tmp = from;
@@ -221,18 +267,18 @@ static inline void draw_sprite_line(vec3f_t *from, vec3f_t *to, float centerz,
   quad->by = to->y;
   quad->bz = to->z + centerz * 0.1;
   quad->cx = to->x + LINE_WIDTH * XSCALE * direction.y;
-  pvr_dr_commit(quad);
-  quad = (pvr_sprite_col_t *)pvr_dr_target(*dr_state);
-  pvr_sprite_col_t *quad2ndhalf = (pvr_sprite_col_t *)((int)quad - 32);
+  pvrsub_commit(sub, quad);
+  quad = (pvr_sprite_col_t *)pvrsub_target(sub);
+  pvr_sprite_col_t *quad2ndhalf = (pvr_sprite_col_t *)((uintptr_t)quad - 32);
   quad2ndhalf->cy = to->y - LINE_WIDTH * direction.x;
   quad2ndhalf->cz = to->z + centerz * 0.1;
   quad2ndhalf->dx = from->x + LINE_WIDTH * XSCALE * direction.y;
   quad2ndhalf->dy = from->y - LINE_WIDTH * direction.x;
-  pvr_dr_commit(quad);
+  pvrsub_commit(sub, quad);
 }
 
 void render_wire_grid(vec3f_t *min, vec3f_t *max, vec3f_t *dir1, vec3f_t *dir2,
-                      int num_lines, uint32_t color, pvr_dr_state_t *dr_state) {
+                      int num_lines, uint32_t color, pvrsub_t *sub) {
   vec3f_t step = {(max->x - min->x) / (num_lines + 1),
                   (max->y - min->y) / (num_lines + 1),
                   (max->z - min->z) / (num_lines + 1)};
@@ -240,10 +286,11 @@ void render_wire_grid(vec3f_t *min, vec3f_t *max, vec3f_t *dir1, vec3f_t *dir2,
     pvr_sprite_cxt_t cxt;
     pvr_sprite_cxt_col(&cxt, PVR_LIST_OP_POLY);
     cxt.gen.culling = PVR_CULLING_NONE;
-    pvr_sprite_hdr_t *hdrpntr = (pvr_sprite_hdr_t *)pvr_dr_target(*dr_state);
+    overdraw_sprite_cxt(&cxt);
+    pvr_sprite_hdr_t *hdrpntr = (pvr_sprite_hdr_t *)pvrsub_target(sub);
     pvr_sprite_compile(hdrpntr, &cxt);
-    hdrpntr->argb = color;
-    pvr_dr_commit(hdrpntr);
+    hdrpntr->argb = OVERDRAW_ARGB(color);
+    pvrsub_commit(sub, hdrpntr);
   }
   vec3f_t twolines[4] = {0};
   vec3f_t *from_v = twolines + 0;
@@ -265,84 +312,90 @@ void render_wire_grid(vec3f_t *min, vec3f_t *max, vec3f_t *dir1, vec3f_t *dir2,
     to_h->z = dir2->z == 0.0f ? max->z : min->z + i * step.z * dir2->z;
     mat_transform((vector_t *)twolines, (vector_t *)twolines, 4,
                   sizeof(vec3f_t));
-    draw_sprite_line(from_v, to_v, 0, dr_state);
-    draw_sprite_line(from_h, to_h, 0, dr_state);
+    draw_sprite_line(from_v, to_v, 0, sub);
+    draw_sprite_line(from_h, to_h, 0, sub);
   }
-  draw_sprite_line(min, max, 0, dr_state);
+  draw_sprite_line(min, max, 0, sub);
 }
 
 void render_wire_cube(void) {
   set_cube_transform();
-  vec3f_t tverts[8] __attribute__((aligned(32))) = {0};
-  mat_transform((vector_t *)&cube_vertices, (vector_t *)&tverts, 8,
-                sizeof(vec3f_t));
-  pvr_dr_state_t dr_state;
+  vec3f_t tverts[CUBE_MESH_MAX_VERTS] __attribute__((aligned(32)));
+  transform_mesh(tverts);
+  pvrsub_t sub;
   pvr_sprite_cxt_t cxt;
   pvr_sprite_cxt_col(&cxt, PVR_LIST_OP_POLY);
   cxt.gen.culling = PVR_CULLING_NONE;
-  pvr_dr_init(&dr_state);
+  overdraw_sprite_cxt(&cxt);
+  pvrsub_begin(&sub, &vertbufs, PVR_LIST_OP_POLY);
   pvr_sprite_hdr_t hdr;
   pvr_sprite_compile(&hdr, &cxt);
-  for (int i = 0; i < 6; i++) {
-    pvr_sprite_hdr_t *hdrpntr = (pvr_sprite_hdr_t *)pvr_dr_target(dr_state);
-    hdr.argb = cube_side_colors[i];
+  for (int i = 0; i < cube_mesh.group_count; i++) {
+    pvr_sprite_hdr_t *hdrpntr = (pvr_sprite_hdr_t *)pvrsub_target(&sub);
+    hdr.argb = OVERDRAW_ARGB(cube_side_colors[i % 6]);
     *hdrpntr = hdr;
-    pvr_dr_commit(hdrpntr);
-    vec3f_t *ac = tverts + cube_side_strips[i][0];
-    vec3f_t *bc = tverts + cube_side_strips[i][2];
-    vec3f_t *cc = tverts + cube_side_strips[i][3];
-    vec3f_t *dc = tverts + cube_side_strips[i][1];
+    pvrsub_commit(&sub, hdrpntr);
+    const uint16_t *strip = side_strip(i);
+    vec3f_t *ac = tverts + strip[0];
+    vec3f_t *bc = tverts + strip[2];
+    vec3f_t *cc = tverts + strip[3];
+    vec3f_t *dc = tverts + strip[1];
     float centerz = (ac->z + bc->z + cc->z + dc->z) / 4.0f;
-    draw_sprite_line(ac, dc, centerz, &dr_state);
-    draw_sprite_line(bc, cc, centerz, &dr_state);
-    draw_sprite_line(dc, cc, centerz, &dr_state);
-    draw_sprite_line(ac, bc, centerz, &dr_state);
+    draw_sprite_line(ac, dc, centerz, &sub);
+    draw_sprite_line(bc, cc, centerz, &sub);
+    draw_sprite_line(dc, cc, centerz, &sub);
+    draw_sprite_line(ac, bc, centerz, &sub);
   }
+  // The grids run between corners of the mesh's bounding box
+  vec3f_t c0 = box_corner(0, 0, 1), c1 = box_corner(0, 1, 1);
+  vec3f_t c3 = box_corner(1, 1, 1), c4 = box_corner(1, 0, 0);
+  vec3f_t c5 = box_corner(1, 1, 0), c6 = box_corner(0, 0, 0);
+  vec3f_t c7 = box_corner(0, 1, 0);
   vec3f_t wiredir1 = (vec3f_t){1, 0, 0};
   vec3f_t wiredir2 = (vec3f_t){0, 1, 0};
-  render_wire_grid(cube_vertices + 0, cube_vertices + 3, &wiredir1, &wiredir2,
-                   cube_state.grid_size, cube_side_colors[0], &dr_state);
+  render_wire_grid(&c0, &c3, &wiredir1, &wiredir2,
+                   cube_state.grid_size, cube_side_colors[0], &sub);
   if (render_mode == WIREFRAME_FILLED) {
     for (int i = 1; i < cube_state.grid_size + 1; i++) {
-      vec3f_t inner_from = *(cube_vertices + 0);
-      vec3f_t inner_to = *(cube_vertices + 3);
+      vec3f_t inner_from = c0;
+      vec3f_t inner_to = c3;
       float z_offset =
           i * ((inner_from.x - inner_to.x) / (cube_state.grid_size + 1));
       inner_from.z += z_offset;
       inner_to.z += z_offset;
       render_wire_grid(&inner_from, &inner_to, &wiredir1, &wiredir2,
-                       cube_state.grid_size, 0x55FFFFFF, &dr_state);
+                       cube_state.grid_size, 0x55FFFFFF, &sub);
     }
   }
-  render_wire_grid(cube_vertices + 4, cube_vertices + 7, &wiredir1, &wiredir2,
-                   cube_state.grid_size, cube_side_colors[1], &dr_state);
+  render_wire_grid(&c4, &c7, &wiredir1, &wiredir2,
+                   cube_state.grid_size, cube_side_colors[1], &sub);
   wiredir2.y = 0;
   wiredir2.z = 1;
-  render_wire_grid(cube_vertices + 0, cube_vertices + 4, &wiredir1, &wiredir2,
-                   cube_state.grid_size, cube_side_colors[5], &dr_state);
+  render_wire_grid(&c0, &c4, &wiredir1, &wiredir2,
+                   cube_state.grid_size, cube_side_colors[5], &sub);
   if (render_mode == WIREFRAME_FILLED) {
     for (int i = 1; i < cube_state.grid_size + 1; i++) {
-      vec3f_t inner_from = *(cube_vertices + 0);
-      vec3f_t inner_to = *(cube_vertices + 4);
+      vec3f_t inner_from = c0;
+      vec3f_t inner_to = c4;
       float y_offset =
           i * ((inner_to.x - inner_from.x) / (cube_state.grid_size + 1));
       inner_from.y += y_offset;
       inner_to.y += y_offset;
       render_wire_grid(&inner_from, &inner_to, &wiredir1, &wiredir2,
-                       cube_state.grid_size, 0x55FFFFFF, &dr_state);
+                       cube_state.grid_size, 0x55FFFFFF, &sub);
     }
   }
-  render_wire_grid(cube_vertices + 1, cube_vertices + 5, &wiredir1, &wiredir2,
-                   cube_state.grid_size, cube_side_colors[4], &dr_state);
+  render_wire_grid(&c1, &c5, &wiredir1, &wiredir2,
+                   cube_state.grid_size, cube_side_colors[4], &sub);
   wiredir1.x = 0;
   wiredir1.z = 1;
   wiredir2.z = 0;
   wiredir2.y = 1;
-  render_wire_grid(cube_vertices + 4, cube_vertices + 3, &wiredir1, &wiredir2,
-                   cube_state.grid_size, cube_side_colors[3], &dr_state);
-  render_wire_grid(cube_vertices + 6, cube_vertices + 1, &wiredir1, &wiredir2,
-                   cube_state.grid_size, cube_side_colors[2], &dr_state);
-  pvr_dr_finish();
+  render_wire_grid(&c4, &c3, &wiredir1, &wiredir2,
+                   cube_state.grid_size, cube_side_colors[3], &sub);
+  render_wire_grid(&c6, &c1, &wiredir1, &wiredir2,
+                   cube_state.grid_size, cube_side_colors[2], &sub);
+  pvrsub_finish(&sub);
 }
 
 static inline void cube_reset_state() {
@@ -356,83 +409,255 @@ static inline void cube_reset_state() {
   update_projection_view(fovy);
 }
 
-static uint32_t dpad_right_down = 0;
-static inline int update_state() {
-  for (int i = 0; i < 4; i++) {
-    maple_device_t *cont = maple_enum_type(i, MAPLE_FUNC_CONTROLLER);
-    if (cont) {
-      cont_state_t *state = (cont_state_t *)maple_dev_status(cont);
-      if (state->buttons & CONT_START) {
-        return 0;
-      }
-      if (state->buttons & CONT_DPAD_RIGHT) {
-        if ((dpad_right_down & (1 << i)) == 0) {
-          dpad_right_down |= (1 << i);
-          switch (render_mode) {
-          case TEXTURED_TR:
-          case CUBES_CUBE_MIN:
-          case CUBES_CUBE_MAX:
-            render_mode++;
-            break;
-          default:
-            cube_state.grid_size += WIREFRAME_GRID_LINES_STEP;
-            if (cube_state.grid_size > WIREFRAME_MAX_GRID_LINES) {
-              cube_state.grid_size = WIREFRAME_MIN_GRID_LINES;
-              render_mode++;
-              if (render_mode >= MAX_RENDERMODE) {
-                render_mode = TEXTURED_TR;
-              }
-            }
-          }
+#if !BENCH
+static padinput_t pad;
+static fixedstep_t sim_clock;
+#endif
+static padinput_view_t pad_view;
+// What the next simulation step sees: presses and releases wait here until
+// a step has run, so a frame that runs no step does not lose them
+static padinput_view_t step_in;
+#ifdef RECORD_TO
+static padrec_t recording;
+#endif
+#ifdef FRAMETIMES
+static uint64_t input_us = 0; // render loop time spent getting the input
+#endif
+
+// One simulation step, the only place the pad changes the scene
+static inline void step_cube(const padinput_view_t *in) {
+  const padinput_snap_t *state = &in->snap;
+  if (in->pressed & CONT_DPAD_RIGHT) {
+    switch (render_mode) {
+    case TEXTURED_TR:
+    case CUBES_CUBE_MIN:
+    case CUBES_CUBE_MAX:
+      render_mode++;
+      break;
+    default:
+      cube_state.grid_size += WIREFRAME_GRID_LINES_STEP;
+      if (cube_state.grid_size > WIREFRAME_MAX_GRID_LINES) {
+        cube_state.grid_size = WIREFRAME_MIN_GRID_LINES;
+        render_mode++;
+        if (render_mode >= MAX_RENDERMODE) {
+          render_mode = TEXTURED_TR;
         }
-      } else {
-        dpad_right_down &= ~(1 << i);
-      }
-      if (abs(state->joyx) > 16)
-        cube_state.pos.x +=
-            (state->joyx / 32768.0f) * 20.5f; // Increased sensitivity
-      if (abs(state->joyy) > 16)
-        cube_state.pos.y += (state->joyy / 32768.0f) *
-                            20.5f; // Increased sensitivity and inverted Y
-      if (state->ltrig > 16)       // Left trigger to zoom out
-        cube_state.pos.z -= (state->ltrig / 255.0f) * ZOOM_SPEED;
-      if (state->rtrig > 16) // Right trigger to zoom in
-        cube_state.pos.z += (state->rtrig / 255.0f) * ZOOM_SPEED;
-      if (cube_state.pos.z < MIN_ZOOM)
-        cube_state.pos.z = MIN_ZOOM; // Farther away
-      if (cube_state.pos.z > MAX_ZOOM)
-        cube_state.pos.z = MAX_ZOOM; // Closer to the screen
-      if (state->buttons & CONT_X)
-        cube_state.speed.y += 0.001f;
-      if (state->buttons & CONT_B)
-        cube_state.speed.y -= 0.001f;
-      if (state->buttons & CONT_A)
-        cube_state.speed.x += 0.001f;
-      if (state->buttons & CONT_Y)
-        cube_state.speed.x -= 0.001f;
-      if (state->buttons & CONT_DPAD_LEFT) {
-        fovy = DEFAULT_FOV;
-        cube_reset_state();
-      }
-      if (state->buttons & CONT_DPAD_DOWN) {
-        fovy -= 1.0f;
-        update_projection_view(fovy);
-      }
-      if (state->buttons & CONT_DPAD_UP) {
-        fovy += 1.0f;
-        update_projection_view(fovy);
       }
     }
   }
+  if (abs(state->joyx) > 16)
+    cube_state.pos.x +=
+        (state->joyx / 32768.0f) * 20.5f; // Increased sensitivity
+  if (abs(state->joyy) > 16)
+    cube_state.pos.y += (state->joyy / 32768.0f) *
+                        20.5f; // Increased sensitivity and inverted Y
+  if (state->ltrig > 16)       // Left trigger to zoom out
+    cube_state.pos.z -= (state->ltrig / 255.0f) * ZOOM_SPEED;
+  if (state->rtrig > 16) // Right trigger to zoom in
+    cube_state.pos.z += (state->rtrig / 255.0f) * ZOOM_SPEED;
+  if (cube_state.pos.z < MIN_ZOOM)
+    cube_state.pos.z = MIN_ZOOM; // Farther away
+  if (cube_state.pos.z > MAX_ZOOM)
+    cube_state.pos.z = MAX_ZOOM; // Closer to the screen
+  if (state->buttons & CONT_X)
+    cube_state.speed.y += 0.001f;
+  if (state->buttons & CONT_B)
+    cube_state.speed.y -= 0.001f;
+  if (state->buttons & CONT_A)
+    cube_state.speed.x += 0.001f;
+  if (state->buttons & CONT_Y)
+    cube_state.speed.x -= 0.001f;
+  if (state->buttons & CONT_DPAD_LEFT) {
+    fovy = DEFAULT_FOV;
+    cube_reset_state();
+  }
+  if (state->buttons & CONT_DPAD_DOWN) {
+    fovy -= 1.0f;
+    update_projection_view(fovy);
+  }
+  if (state->buttons & CONT_DPAD_UP) {
+    fovy += 1.0f;
+    update_projection_view(fovy);
+  }
   cube_state.rot.x += cube_state.speed.x;
   cube_state.rot.y += cube_state.speed.y;
   cube_state.speed.x *= 0.99f;
   cube_state.speed.y *= 0.99f;
+}
+
+#if BENCH
+// Scenarios from assets/bench, compiled by tools/padrec
+static const char *bench_files[] = {"/rd/bench/modes.pad",
+                                    "/rd/bench/cubemax.pad",
+                                    "/rd/bench/zoomout.pad"};
+#define BENCH_COUNT (int)(sizeof(bench_files) / sizeof(bench_files[0]))
+static int bench_at = -1;
+static padrec_t bench_rec;
+static struct {
+  uint32_t frames;
+  uint64_t frame_us, busy_us, wait_us;
+  uint32_t max_frame_us;
+  uint64_t render; // pvr_get_stats() rnd_last_time: each sample is whole ms, the mean isn't
+} bench_times[MAX_RENDERMODE];
+
+static void bench_report(void) {
+  printf("bench %s, %s:\n", bench_files[bench_at],
+         texture256.flags.mipmapped ? "mipmapped" : "no mipmaps");
+  for (int m = 0; m < MAX_RENDERMODE; m++) {
+    uint32_t n = bench_times[m].frames;
+    if (n == 0)
+      continue;
+    printf("  %-16s %5u frames, frame avg %5u us max %6u us, cpu busy %5u us, "
+           "waiting %5u us, render %5.2f ms (mean of 1 ms samples)\n",
+           render_mode_names[m], (unsigned)n, (unsigned)(bench_times[m].frame_us / n),
+           (unsigned)bench_times[m].max_frame_us, (unsigned)(bench_times[m].busy_us / n),
+           (unsigned)(bench_times[m].wait_us / n), (double)bench_times[m].render / n);
+  }
+  if (vertbufs.dropped)
+    printf("  %u blocks did not fit the vertex buffer\n", (unsigned)vertbufs.dropped);
+}
+
+// Report on the scenario that ran out and start the next one from a reset
+// scene; 0 once they have all run
+static int bench_next(void) {
+  if (bench_at >= 0) {
+    bench_report();
+    padrec_free(&bench_rec);
+  }
+  if (++bench_at == BENCH_COUNT)
+    return 0;
+  if (!padrec_load(bench_files[bench_at], &bench_rec))
+    return 0;
+  if (bench_rec.hdr.hz != SIM_HZ)
+    printf("Warning: %s was recorded at %u Hz, replayed at %u Hz\n",
+           bench_files[bench_at], (unsigned)bench_rec.hdr.hz, SIM_HZ);
+  memset(bench_times, 0, sizeof(bench_times));
+  vertbufs.dropped = 0;
+  render_mode = TEXTURED_TR;
+  cube_state.grid_size = WIREFRAME_MIN_GRID_LINES;
+  cube_reset_state();
+  return 1;
+}
+#endif
+
+static inline int update_state() {
+#if BENCH
+  // One recorded step per frame, however long the frame took, so every run
+  // draws the same frames
+  while (bench_at < 0 || !padrec_play(&bench_rec, &step_in)) {
+    if (!bench_next())
+      return 0;
+  }
+  step_cube(&step_in);
+  return 1;
+#else
+#ifdef FRAMETIMES
+  uint64_t t0 = timer_us_gettime64();
+#endif
+#if !INPUT_THREAD
+  padinput_poll(&pad); // the same maple reads, in the render loop
+#endif
+  padinput_read(&pad, &pad_view);
+#ifdef FRAMETIMES
+  input_us += timer_us_gettime64() - t0;
+#endif
+  if (pad_view.snap.buttons & CONT_START) {
+    return 0;
+  }
+  step_in.snap = pad_view.snap;
+  step_in.pressed |= pad_view.pressed;
+  step_in.released |= pad_view.released;
+  int steps = fixedstep_advance(&sim_clock, timer_us_gettime64());
+  while (steps--) {
+#ifdef RECORD_TO
+    padrec_record(&recording, &step_in);
+#endif
+    step_cube(&step_in);
+    step_in.pressed = step_in.released = 0;
+  }
+  return 1;
+#endif
+}
+/* Asset loads, timed to compare the romdisk with the pack from LZPACK=1 */
+static uint64_t assets_us;
+
+static int load_texture(const char *filename, dttex_info_t *texinfo) {
+  uint64_t t0 = timer_us_gettime64();
+  int ok = pvrtex_load(filename, texinfo);
+  uint32_t us = (uint32_t)(timer_us_gettime64() - t0);
+  assets_us += us;
+  printf("%s: %u us\n", filename, (unsigned)us);
+  return ok;
+}
+
+/* Timed with the textures; the bounds and per-cube scaling for the
+   renderers are worked out once here */
+static int load_cube_mesh(const char *filename) {
+  uint64_t t0 = timer_us_gettime64();
+  uint32_t us;
+
+  if (!mesh_load(filename, &cube_mesh))
+    return 0;
+  us = (uint32_t)(timer_us_gettime64() - t0);
+  assets_us += us;
+  printf("%s: %u us\n", filename, (unsigned)us);
+  for (int g = 0; g < cube_mesh.group_count; g++) {
+    uint32_t s = cube_mesh.group_first[g];
+    if (cube_mesh.group_first[g + 1] != s + 1 ||
+        cube_mesh.strip_first[s + 1] - cube_mesh.strip_first[s] != 4) {
+      printf("Error: %s side %d is not one strip of 4, can't draw it as a sprite\n",
+             filename, g);
+      mesh_unload(&cube_mesh);
+      return 0;
+    }
+  }
+  if (cube_mesh.vert_count == 0 || cube_mesh.vert_count > CUBE_MESH_MAX_VERTS) {
+    printf("Error: %s has %d vertices, up to %d fit\n", filename, cube_mesh.vert_count,
+           CUBE_MESH_MAX_VERTS);
+    mesh_unload(&cube_mesh);
+    return 0;
+  }
+  mesh_min = mesh_max = (vec3f_t){cube_mesh.x[0], cube_mesh.y[0], cube_mesh.z[0]};
+  for (int i = 1; i < cube_mesh.vert_count; i++) {
+    mesh_min.x = fminf(mesh_min.x, cube_mesh.x[i]);
+    mesh_min.y = fminf(mesh_min.y, cube_mesh.y[i]);
+    mesh_min.z = fminf(mesh_min.z, cube_mesh.z[i]);
+    mesh_max.x = fmaxf(mesh_max.x, cube_mesh.x[i]);
+    mesh_max.y = fmaxf(mesh_max.y, cube_mesh.y[i]);
+    mesh_max.z = fmaxf(mesh_max.z, cube_mesh.z[i]);
+  }
+  for (int i = 0; i < cube_mesh.vert_count; i++) {
+    mesh_unit[i].x = (cube_mesh.x[i] - mesh_min.x) / (mesh_max.x - mesh_min.x);
+    mesh_unit[i].y = (cube_mesh.y[i] - mesh_min.y) / (mesh_max.y - mesh_min.y);
+    mesh_unit[i].z = (cube_mesh.z[i] - mesh_min.z) / (mesh_max.z - mesh_min.z);
+  }
   return 1;
 }
+
+/* Into banks reserved through ../pvrpal.h, the bank goes in pvrformat */
+static int load_palette(const char *filename, dttex_info_t *texinfo, int entries) {
+  uint64_t t0 = timer_us_gettime64();
+  int first = pvrpal_alloc(entries, PVR_PAL_RGB565, filename);
+  int ok = first >= 0 && pvrtex_load_palette(filename, PVR_PAL_RGB565, first);
+  uint32_t us = (uint32_t)(timer_us_gettime64() - t0);
+  if (first >= 0) {
+    texinfo->pal_first = first;
+    texinfo->pal_entries = entries;
+    texinfo->pvrformat |= entries == 256 ? PVR_TXRFMT_8BPP_PAL(first / 256)
+                                         : PVR_TXRFMT_4BPP_PAL(first / 16);
+  }
+  assets_us += us;
+  printf("%s: %u us\n", filename, (unsigned)us);
+  return ok;
+}
+
 extern uint8 romdisk[];
 KOS_INIT_FLAGS(INIT_DEFAULT | INIT_MALLOCSTATS);
+#if LZPACK
+static lzpack_t pack;
+#else
 KOS_INIT_ROMDISK(romdisk);
+#endif
 int main(int argc, char *argv[]) {
 #ifdef DEBUG
   gdb_init();
@@ -442,33 +667,92 @@ int main(int argc, char *argv[]) {
       {PVR_BINSIZE_16, PVR_BINSIZE_0, PVR_BINSIZE_16, PVR_BINSIZE_0,
        PVR_BINSIZE_0},
       3 << 20,       // Vertex buffer size, 3MB
-      0,             // No DMA15
+      VERTEX_DMA,    // DMA the lists from RAM, see pvrsubmit.h
       SUPERSAMPLING, // Set horisontal FSAA
       0,             // Translucent Autosort enabled.
       3              // Extra OPBs
   };
   pvr_init(&params);
+  if (!pvrsub_init(&vertbufs, VERTEX_DMA))
+    return -1;
   pvr_set_bg_color(0, 0, 0);
-  if (!pvrtex_load("/rd/texture/rgb565_vq_tw/dc.dt", &texture256))
+#if LZPACK
+  if (!lzpack_open(&pack, romdisk, 0) || !lzpack_mount(&pack, "/rd"))
+    return -1;
+  // Reads nothing with the pack linked in, one read for all of these off a disc
+  if (!lzpack_prefetch(&pack, "boot"))
+    return -1;
+#endif
+  if (!load_cube_mesh("/rd/mesh/cube.msh"))
     return -1;
-  if (!pvrtex_load("/rd/texture/pal8/dc_64sq_256colors.dt", &texture64))
+  if (!load_texture("/rd/texture/rgb565_vq_tw/dc.dt", &texture256))
     return -1;
-  if (!pvrtex_load_palette("/rd/texture/pal8/dc_64sq_256colors.dt.pal",
-                           PVR_PAL_RGB565, 0))
+  if (!load_texture("/rd/texture/pal8/dc_64sq_256colors.dt", &texture64))
     return -1;
-  if (!pvrtex_load("/rd/texture/pal4/dc_32sq_16colors.dt", &texture32))
+  if (!load_palette("/rd/texture/pal8/dc_64sq_256colors.dt.pal", &texture64, 256))
     return -1;
-  if (!pvrtex_load_palette("/rd/texture/pal4/dc_32sq_16colors.dt.pal",
-                           PVR_PAL_RGB565, 256))
+  if (!load_texture("/rd/texture/pal4/dc_32sq_16colors.dt", &texture32))
     return -1;
+  if (!load_palette("/rd/texture/pal4/dc_32sq_16colors.dt.pal", &texture32, 16))
+    return -1;
+  printf("assets: %u us from the %s, %u ms after power on\n", (unsigned)assets_us,
+         LZPACK ? "pack" : "romdisk", (unsigned)timer_ms_gettime64());
+#if LZPACK
+  printf("pack: %u opens, %u decodes (%u straight to the caller), %u KB in %u us\n",
+         (unsigned)lzpack_stats.opens, (unsigned)lzpack_stats.decodes,
+         (unsigned)lzpack_stats.direct, (unsigned)(lzpack_stats.bytes / 1024),
+         (unsigned)lzpack_stats.decode_us);
+#endif
   cube_reset_state();
+#if !BENCH
+  padinput_init(&pad, &padinput_backend_maple, 4000);
+#if INPUT_THREAD
+  if (!padinput_start(&pad, PRIO_DEFAULT - 1))
+    return -1;
+#endif
+#ifdef RECORD_TO
+  padrec_init(&recording, SIM_HZ);
+#endif
+  fixedstep_init(&sim_clock, SIM_HZ, timer_us_gettime64());
+#endif
+#ifdef FRAMETIMES
+  // CPU time per frame spent building and submitting the scene against time
+  // spent waiting for the PVR, averaged per render mode
+  uint64_t busy_us = 0, wait_us = 0;
+  uint32_t timed_frames = 0;
+  render_mode_e timed_mode = render_mode;
+  // Input to photon: from when the poller saw a button change until the PVR
+  // has shown the first frame built after it, as seen at the next frame
+  pvr_stats_t pvr_st;
+  pvr_get_stats(&pvr_st);
+  uint32_t frames_base = pvr_st.frame_count, frames_submitted = 0;
+  uint32_t lat_start = 0, lat_frame = 0, lat_us = 0, lat_events = 0;
+  int lat_state = 0; // 0 idle, 1 change seen, 2 frame submitted
+#if BENCH
+  uint64_t frame_end = 0;
+#endif
+#endif
   while (update_state()) {
 #ifdef FRAMETIMES
     vid_border_color(255, 0, 0);
+    uint64_t t0 = timer_us_gettime64();
 #endif
     pvr_wait_ready();
 #ifdef FRAMETIMES
     vid_border_color(0, 255, 0);
+    uint64_t t1 = timer_us_gettime64();
+    if (lat_state == 2) {
+      pvr_get_stats(&pvr_st);
+      if (pvr_st.frame_count - frames_base >= lat_frame) {
+        lat_us += (uint32_t)t1 - lat_start;
+        lat_events++;
+        lat_state = 0;
+      }
+    }
+    if (lat_state == 0 && (pad_view.pressed | pad_view.released)) {
+      lat_start = pad_view.snap.change_us;
+      lat_state = 1;
+    }
 #endif
     pvr_scene_begin();
     switch (render_mode) {
@@ -496,12 +780,70 @@ int main(int argc, char *argv[]) {
     vid_border_color(0, 0, 255);
 #endif
     pvr_scene_finish();
+#ifdef FRAMETIMES
+    frames_submitted++;
+    if (lat_state == 1) {
+      lat_frame = frames_submitted;
+      lat_state = 2;
+    }
+#if BENCH
+    uint64_t t2 = timer_us_gettime64();
+    bench_times[render_mode].frames++;
+    bench_times[render_mode].wait_us += t1 - t0;
+    bench_times[render_mode].busy_us += t2 - t1;
+    // The render that pvr_wait_ready() waited for, the frame before this one
+    pvr_get_stats(&pvr_st);
+    bench_times[render_mode].render += pvr_st.rnd_last_time;
+    if (frame_end) {
+      uint32_t frame_us = (uint32_t)(t2 - frame_end);
+      bench_times[render_mode].frame_us += frame_us;
+      if (frame_us > bench_times[render_mode].max_frame_us)
+        bench_times[render_mode].max_frame_us = frame_us;
+    }
+    frame_end = t2;
+    continue;
+#endif
+    if (render_mode != timed_mode) {
+      busy_us = wait_us = timed_frames = input_us = 0;
+      timed_mode = render_mode;
+    }
+    wait_us += t1 - t0;
+    busy_us += timer_us_gettime64() - t1;
+    if (++timed_frames == 120) {
+      printf("%s, %s: cpu busy %u us/frame, waiting %u us/frame",
+             render_mode_names[timed_mode], VERTEX_DMA ? "DMA" : "direct",
+             (unsigned)(busy_us / timed_frames), (unsigned)(wait_us / timed_frames));
+      if (vertbufs.dropped)
+        printf(", %u blocks did not fit the vertex buffer", (unsigned)vertbufs.dropped);
+      printf(", input %s %u us/frame", INPUT_THREAD ? "thread" : "polled",
+             (unsigned)(input_us / timed_frames));
+      if (lat_events)
+        printf(", input to photon %u us (%u events)", (unsigned)(lat_us / lat_events),
+               (unsigned)lat_events);
+      printf("\n");
+      busy_us = wait_us = timed_frames = input_us = 0;
+      lat_us = lat_events = 0;
+    }
+#endif
   }
   printf("Cleaning up\n");
+#ifdef RECORD_TO
+  printf("Recorded %u steps in %u records\n", (unsigned)recording.hdr.steps,
+         (unsigned)recording.hdr.rec_count);
+  padrec_save(RECORD_TO, &recording);
+  padrec_free(&recording);
+#endif
+#if INPUT_THREAD && !BENCH
+  printf("padinput: %u polls, %u us each, %u reads retried\n", (unsigned)pad.polls,
+         (unsigned)(pad.polls ? pad.poll_us / pad.polls : 0), (unsigned)pad_view.retries);
+  padinput_stop(&pad);
+#endif
   pvrtex_unload(&texture256);
   pvrtex_unload(&texture64);
   pvrtex_unload(&texture32);
+  mesh_unload(&cube_mesh);
   pvr_shutdown(); // Clean up PVR resources
+  pvrsub_shutdown(&vertbufs);
   vid_shutdown(); // This function reinitializes the video system to what dcload
                   // and friends expect it to be Run the main application here;
   printf("Exiting main\n");
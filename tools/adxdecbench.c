@@ -0,0 +1,224 @@
+/********************************************************************************************/
+/* Host tool: ADX decoder check and benchmark                                               */
+/********************************************************************************************/
+/* Name:     adxdecbench.c                                                                  */
+/* Title:    adxdec_block() against adxdec_frame_ref(), bit for bit and samples per second  */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Decodes the same frames with the reference and the block decoder and compares every    */
+/*   sample and the final history. Three kinds of input:                                    */
+/*     - ADX files, given on the command line or written by adxsynth.h                      */
+/*     - random frames with any scale and nibble, which live in the clamp                   */
+/*     - random frames at several rates and high-pass settings, for other coefficients      */
+/*   Then both decoders run over the same few MB of frames and the rate is printed.         */
+/*   Exits non-zero on any mismatch so it can sit in a script.                              */
+/*                                                                                          */
+/* Usage:    adxdecbench [-s seconds] [file.adx ...]                                        */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../cubemappedadx/adxdec.h"
+#include "adxsynth.h"
+
+#define RANDOM_FRAMES 200000
+#define BENCH_FRAMES  8192
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t rng = 0x2545f491;
+
+static uint32_t rand32(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void ref_frames(const adxdec_header_t *h, const uint8_t *in, int16_t *out, int frames,
+                       adxdec_hist_t *hist) {
+  for (int f = 0; f < frames; f++) {
+    for (int ch = 0; ch < h->channels; ch++)
+      adxdec_frame_ref(in + ch * 18, out + ch, h->channels, &hist[ch], h->coef1, h->coef2);
+    in += 18 * h->channels;
+    out += ADXDEC_SAMPLES_PER_FRAME * h->channels;
+  }
+}
+
+static void block_frames(const adxdec_header_t *h, const uint8_t *in, int16_t *out, int frames,
+                         adxdec_hist_t *hist) {
+  for (int f = 0; f < frames; f++) {
+    adxdec_block(h, in, out, hist);
+    in += 18 * h->channels;
+    out += ADXDEC_SAMPLES_PER_FRAME * h->channels;
+  }
+}
+
+/* Decode frames both ways from the same history and compare. 1 if equal. */
+static int compare(const char *what, const adxdec_header_t *h, const uint8_t *in, int frames) {
+  int n = frames * ADXDEC_SAMPLES_PER_FRAME * h->channels;
+  int16_t *a = malloc(n * sizeof(int16_t)), *b = malloc(n * sizeof(int16_t));
+  adxdec_hist_t ha[ADXDEC_MAX_CHANNELS], hb[ADXDEC_MAX_CHANNELS];
+  int ok = 1;
+
+  memset(ha, 0, sizeof(ha));
+  memset(hb, 0, sizeof(hb));
+  ref_frames(h, in, a, frames, ha);
+  block_frames(h, in, b, frames, hb);
+  for (int i = 0; i < n; i++) {
+    if (a[i] != b[i]) {
+      printf("%s: MISMATCH at sample %d channel %d: ref %d block %d\n", what,
+             i / h->channels, i % h->channels, a[i], b[i]);
+      ok = 0;
+      break;
+    }
+  }
+  if (ok && memcmp(ha, hb, sizeof(ha))) {
+    printf("%s: MISMATCH in the history after %d frames\n", what, frames);
+    ok = 0;
+  }
+  if (ok)
+    printf("%-44s %8d samples  ok\n", what, n);
+  free(a);
+  free(b);
+  return ok;
+}
+
+static uint8_t *random_frames(int frames, int channels) {
+  uint8_t *buf = malloc(frames * 18 * channels);
+  for (int i = 0; i < frames * channels; i++) {
+    uint8_t *f = buf + i * 18;
+    // Mostly full range scales, some small ones so the history can recover
+    int scale = rand32() & 3 ? rand32() & 0x7fff : rand32() & 0xff;
+    f[0] = scale >> 8;
+    f[1] = scale;
+    for (int j = 2; j < 18; j++)
+      f[j] = rand32();
+  }
+  return buf;
+}
+
+static int check_file(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  uint8_t *buf;
+  long len;
+  adxdec_header_t h;
+  int frames, ok;
+
+  if (fp == NULL) {
+    perror(path);
+    return 0;
+  }
+  fseek(fp, 0, SEEK_END);
+  len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  buf = malloc(len);
+  if (fread(buf, 1, len, fp) != (size_t)len || !adxdec_parse_header(buf, len, &h)) {
+    printf("%s: not an ADX file\n", path);
+    fclose(fp);
+    free(buf);
+    return 0;
+  }
+  fclose(fp);
+  frames = (h.samples + ADXDEC_SAMPLES_PER_FRAME - 1) / ADXDEC_SAMPLES_PER_FRAME;
+  if (frames > (len - h.data_offset) / (18 * h.channels))
+    frames = (len - h.data_offset) / (18 * h.channels);
+  ok = compare(path, &h, buf + h.data_offset, frames);
+  free(buf);
+  return ok;
+}
+
+static void bench(int channels, float seconds) {
+  adxdec_header_t h;
+  uint8_t *in = random_frames(BENCH_FRAMES, channels);
+  int16_t *out = malloc(BENCH_FRAMES * ADXDEC_SAMPLES_PER_FRAME * channels * sizeof(int16_t));
+  adxdec_hist_t hist[ADXDEC_MAX_CHANNELS];
+  double rate[2];
+
+  memset(&h, 0, sizeof(h));
+  h.channels = channels;
+  h.rate = 44100;
+  h.highpass = 500;
+  adxdec_coefs(h.rate, h.highpass, &h.coef1, &h.coef2);
+
+  for (int k = 0; k < 2; k++) {
+    double t0 = now_s(), t;
+    long samples = 0;
+    memset(hist, 0, sizeof(hist));
+    do {
+      if (k == 0)
+        ref_frames(&h, in, out, BENCH_FRAMES, hist);
+      else
+        block_frames(&h, in, out, BENCH_FRAMES, hist);
+      samples += (long)BENCH_FRAMES * ADXDEC_SAMPLES_PER_FRAME * channels;
+      t = now_s() - t0;
+    } while (t < seconds);
+    rate[k] = samples / t;
+  }
+  printf("%-6s  ref %7.1f Msamples/s   block %7.1f Msamples/s   %.2fx\n",
+         channels == 2 ? "stereo" : "mono", rate[0] / 1e6, rate[1] / 1e6, rate[1] / rate[0]);
+  free(in);
+  free(out);
+}
+
+int main(int argc, char *argv[]) {
+  static const int rates[] = {11025, 22050, 32000, 44100, 48000};
+  static const int highpass[] = {0, 500, 2000};
+  float seconds = 1.0f;
+  int nfiles = 0, ok = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      seconds = (float)atof(argv[++i]);
+    } else if (argv[i][0] != '-') {
+      ok &= check_file(argv[i]);
+      nfiles++;
+    } else {
+      fprintf(stderr, "usage: adxdecbench [-s seconds] [file.adx ...]\n");
+      return 1;
+    }
+  }
+
+  if (nfiles == 0) {
+    ok &= adxsynth_write("/tmp/adxdecbench_m.adx", 22050, 1, 5.0f, 220.0f, 1) &&
+          check_file("/tmp/adxdecbench_m.adx");
+    ok &= adxsynth_write("/tmp/adxdecbench_s.adx", 44100, 2, 5.0f, 330.0f, 2) &&
+          check_file("/tmp/adxdecbench_s.adx");
+  }
+
+  for (int channels = 1; channels <= 2; channels++) {
+    for (unsigned r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+      for (unsigned p = 0; p < sizeof(highpass) / sizeof(highpass[0]); p++) {
+        char what[64];
+        adxdec_header_t h;
+        uint8_t *in = random_frames(RANDOM_FRAMES / 15, channels);
+        memset(&h, 0, sizeof(h));
+        h.channels = channels;
+        h.rate = rates[r];
+        h.highpass = highpass[p];
+        adxdec_coefs(h.rate, h.highpass, &h.coef1, &h.coef2);
+        snprintf(what, sizeof(what), "random %s %dHz hp %d (%d,%d)",
+                 channels == 2 ? "stereo" : "mono", h.rate, h.highpass, h.coef1, h.coef2);
+        ok &= compare(what, &h, in, RANDOM_FRAMES / 15);
+        free(in);
+      }
+    }
+  }
+
+  if (!ok) {
+    printf("\nFAIL: block decoder differs from the reference\n");
+    return 1;
+  }
+  printf("\nall bit exact\n\n");
+  bench(1, seconds);
+  bench(2, seconds);
+  return 0;
+}
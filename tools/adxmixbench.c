@@ -0,0 +1,187 @@
+/********************************************************************************************/
+/* Host tool: ADX mixer benchmark                                                           */
+/********************************************************************************************/
+/* Name:     adxmixbench.c                                                                  */
+/* Title:    Decode-plus-mix cost per voice for cubemappedadx/adxmix.c                      */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Plays 1..N voices through the mixer and times how long a few seconds of output take.   */
+/*   With no files on the command line it writes its own test streams to /tmp: a 44.1kHz    */
+/*   stereo "music" track plus 22kHz mono ambients, so the resampler is exercised too.      */
+/*                                                                                          */
+/*   A second pass sets a CPU budget just under what all voices cost and reports which      */
+/*   priorities survive, to check the drop order. A dropped voice's handle is then used     */
+/*   on the voice played into its slot, which must not notice.                              */
+/*                                                                                          */
+/*   The numbers are host numbers; scale by the usual host/SH4 factor or look at            */
+/*   adxmix_stats_t on the console for the real cost.                                       */
+/*                                                                                          */
+/* Usage:    adxmixbench [-n voices] [-s seconds] [-w out.wav] [file.adx ...]               */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../cubemappedadx/adxmix.h"
+#include "adxsynth.h"
+
+#define BENCH_RATE 44100
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void le16(uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void le32(uint8_t *p, uint32_t v) {
+  le16(p, v);
+  le16(p + 2, v >> 16);
+}
+
+static void write_wav(const char *path, const int16_t *pcm, int frames) {
+  uint8_t h[44];
+  uint32_t bytes = frames * 4;
+  FILE *fp = fopen(path, "wb");
+
+  if (fp == NULL) {
+    perror(path);
+    return;
+  }
+  memcpy(h, "RIFF", 4);
+  le32(h + 4, 36 + bytes);
+  memcpy(h + 8, "WAVEfmt ", 8);
+  le32(h + 16, 16);
+  le16(h + 20, 1);                  // PCM
+  le16(h + 22, 2);                  // stereo
+  le32(h + 24, BENCH_RATE);
+  le32(h + 28, BENCH_RATE * 4);
+  le16(h + 32, 4);
+  le16(h + 34, 16);
+  memcpy(h + 36, "data", 4);
+  le32(h + 40, bytes);
+  fwrite(h, 1, sizeof(h), fp);
+  fwrite(pcm, 4, frames, fp);       // little endian host
+  fclose(fp);
+}
+
+static void play_voices(adxmix_t *m, char **files, int n, int *handles) {
+  for (int i = 0; i < n; i++) {
+    // Voice 0 is the music, the rest ambients at falling priority, spread across
+    int prio = i == 0 ? ADXMIX_PRIO_MUSIC : ADXMIX_PRIO_AMBIENT - i;
+    float pan = i == 0 ? 0.0f : (i & 1 ? -0.5f : 0.5f);
+    if ((handles[i] = adxmix_play(m, files[i], 1, prio, i == 0 ? 0.8f : 0.3f, pan)) < 0)
+      exit(1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  char *files[ADXMIX_MAX_VOICES];
+  char names[ADXMIX_MAX_VOICES][64];
+  int handles[ADXMIX_MAX_VOICES];
+  int nfiles = 0, voices = ADXMIX_MAX_VOICES;
+  float seconds = 10.0f;
+  const char *wav = NULL;
+  int frames;
+  int16_t *out;
+  double base = 0.0, all_us = 0.0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      voices = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      seconds = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      wav = argv[++i];
+    else if (argv[i][0] != '-' && nfiles < ADXMIX_MAX_VOICES)
+      files[nfiles++] = argv[i];
+    else {
+      fprintf(stderr, "usage: adxmixbench [-n voices] [-s seconds] [-w out.wav] [file.adx ...]\n");
+      return 1;
+    }
+  }
+  if (voices < 1 || voices > ADXMIX_MAX_VOICES || seconds <= 0.0f) {
+    fprintf(stderr, "adxmixbench: 1 to %d voices\n", ADXMIX_MAX_VOICES);
+    return 1;
+  }
+
+  // Make up whatever files were not given
+  for (int i = nfiles; i < voices; i++) {
+    int music = i == 0;
+    snprintf(names[i], sizeof(names[i]), "/tmp/adxmixbench%d.adx", i);
+    if (!adxsynth_write(names[i], music ? 44100 : 22050, music ? 2 : 1, music ? 8.0f : 3.0f,
+                        110.0f * (i + 1), 1234 + i))
+      return 1;
+    files[i] = names[i];
+  }
+
+  frames = (int)(BENCH_RATE * seconds);
+  out = malloc(frames * 4);
+
+  printf("%d Hz stereo output, %.1f s per run\n\n", BENCH_RATE, seconds);
+  printf("voices   ms total   us/s audio   us/s per voice   x realtime\n");
+  for (int n = 1; n <= voices; n++) {
+    adxmix_t *m = adxmix_create(BENCH_RATE, 100, 0);
+    double t0, us;
+    play_voices(m, files, n, handles);
+    t0 = now_s();
+    adxmix_render(m, out, frames);
+    us = (now_s() - t0) * 1e6;
+    if (n == 1)
+      base = us;
+    all_us = us;
+    printf("%6d   %8.2f   %10.0f   %14.0f   %10.0f\n", n, us / 1000.0, us / seconds,
+           n > 1 ? (us - base) / seconds / (n - 1) : us / seconds, seconds * 1e6 / us);
+    if (n == voices && wav)
+      write_wav(wav, out, frames);
+    adxmix_destroy(m);
+  }
+
+  // Budget a bit under the full set's measured cost: the tail of the
+  // priority list has to go, the music has to stay
+  {
+    float pct = (float)(all_us / (seconds * 1e6) * 100.0 * 0.6);
+    adxmix_stats_t st;
+    adxmix_t *m = adxmix_create(BENCH_RATE, 100, pct);
+    int stale = -1, dropped = 0, fresh = -1, ok = 1;
+    play_voices(m, files, voices, handles);
+    adxmix_render(m, out, frames);
+    adxmix_get_stats(m, &st);
+    printf("\nbudget %.3f%% of real time (%u us per chunk): %d playing, %u dropped, music %s\n",
+           pct, (unsigned)st.budget_us, st.active, (unsigned)st.dropped,
+           adxmix_voice_active(m, handles[0]) ? "kept" : "DROPPED");
+    for (int i = 0; i < voices; i++) {
+      int active = adxmix_voice_active(m, handles[i]);
+      printf("  voice %d %-8s %s\n", i, i == 0 ? "music" : "ambient",
+             active ? "playing" : "dropped");
+      if (!active) {
+        stale = i;
+        dropped++;
+      }
+    }
+
+    // Voices take the lowest free slot, so replaying once per dropped voice
+    // refills the last one's slot. Its old handle must not reach the new voice.
+    if (stale >= 0) {
+      for (int i = 0; i < dropped; i++)
+        fresh = adxmix_play(m, files[stale], 1, ADXMIX_PRIO_SFX, 0.3f, 0.0f);
+      adxmix_stop(m, handles[stale]);
+      ok = fresh >= 0 && adxmix_voice_active(m, fresh) && !adxmix_voice_active(m, handles[stale]);
+      printf("stale handle %d after replay as %d: %s\n", handles[stale], fresh,
+             ok ? "ignored" : "REACHED THE NEW VOICE");
+    }
+    adxmix_destroy(m);
+    if (!ok)
+      return 1;
+  }
+
+  free(out);
+  return 0;
+}
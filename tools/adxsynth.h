@@ -0,0 +1,152 @@
+#ifndef ADXSYNTH_H
+#define ADXSYNTH_H
+
+/**  Tiny ADX encoder for the host audio tools.
+
+     The repo ships no ADX files, so the benches make their own: a few
+     seconds of tones and noise, encoded with the same prediction the
+     decoder uses. Quality is beside the point, the bitstream just has to be
+     valid and exercise every nibble value and the clamp.                   */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cubemappedadx/adxdec.h"
+
+#define ADXSYNTH_DATA_OFFSET 0x38
+
+static void adxsynth_be16(uint8_t *p, int v) {
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static void adxsynth_be32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/* Encode one 32 sample frame of one channel, tracking the decoder's history */
+static void adxsynth_frame(const int16_t *in, int stride, uint8_t *out, adxdec_hist_t *h,
+                           int coef1, int coef2) {
+  int peak = 0, scale, i;
+  int s1 = h->s1, s2 = h->s2;
+
+  // Size the scale from the residual against the decoder's own prediction
+  for (i = 0; i < ADXDEC_SAMPLES_PER_FRAME; i++) {
+    int x = in[i * stride];
+    int r = x - ((coef1 * s1 + coef2 * s2) >> 12);
+    if (abs(r) > peak)
+      peak = abs(r);
+    s2 = s1;
+    s1 = x;
+  }
+  scale = (peak + 6) / 7;
+  if (scale < 1)
+    scale = 1;
+  if (scale > 0x7fff)
+    scale = 0x7fff;
+
+  adxsynth_be16(out, scale);
+  memset(out + 2, 0, 16);
+  s1 = h->s1;
+  s2 = h->s2;
+  for (i = 0; i < ADXDEC_SAMPLES_PER_FRAME; i++) {
+    int pred = (coef1 * s1 + coef2 * s2) >> 12;
+    int r = in[i * stride] - pred;
+    int d = (int)lrintf((float)r / scale);
+    int s0;
+    if (d > 7)
+      d = 7;
+    if (d < -8)
+      d = -8;
+    out[2 + (i >> 1)] |= (i & 1) ? (d & 15) : ((d & 15) << 4);
+    s0 = d * scale + pred;
+    s0 = s0 > 32767 ? 32767 : s0 < -32768 ? -32768 : s0;
+    s2 = s1;
+    s1 = s0;
+  }
+  h->s1 = s1;
+  h->s2 = s2;
+}
+
+/**
+ * @brief Write a looping version 3 ADX file of synthetic audio
+ *
+ * Each channel is a tone at freq (the right channel a fifth up) with some
+ * noise on top; seed makes the noise repeatable.
+ *
+ * @return int 1 on success
+ */
+static int adxsynth_write(const char *path, int rate, int channels, float seconds, float freq,
+                          unsigned seed) {
+  int samples = (int)(rate * seconds) & ~(ADXDEC_SAMPLES_PER_FRAME - 1);
+  int frames = samples / ADXDEC_SAMPLES_PER_FRAME;
+  int16_t *pcm = malloc(samples * channels * sizeof(int16_t));
+  uint8_t hdr[ADXSYNTH_DATA_OFFSET], frame[18];
+  adxdec_hist_t hist[ADXDEC_MAX_CHANNELS];
+  int coef1, coef2, i, ch;
+  FILE *fp;
+
+  if (pcm == NULL)
+    return 0;
+  for (i = 0; i < samples; i++) {
+    for (ch = 0; ch < channels; ch++) {
+      float t = (float)i / rate;
+      float f = freq * (ch ? 1.5f : 1.0f);
+      float v = 0.6f * sinf(2.0f * 3.14159265f * f * t);
+      seed = seed * 1103515245u + 12345u;
+      v += 0.1f * ((int)(seed >> 16 & 0x7fff) - 16384) / 16384.0f;
+      pcm[i * channels + ch] = (int16_t)(v * 32767.0f);
+    }
+  }
+
+  memset(hdr, 0, sizeof(hdr));
+  adxsynth_be16(hdr, 0x8000);
+  adxsynth_be16(hdr + 2, ADXSYNTH_DATA_OFFSET - 4);
+  hdr[4] = 3;               // standard ADX
+  hdr[5] = 18;
+  hdr[6] = 4;
+  hdr[7] = channels;
+  adxsynth_be32(hdr + 8, rate);
+  adxsynth_be32(hdr + 12, samples);
+  adxsynth_be16(hdr + 16, 500);
+  hdr[0x12] = 3;
+  adxsynth_be32(hdr + 0x18, 1);                 // loop the whole file
+  adxsynth_be32(hdr + 0x1c, 0);
+  adxsynth_be32(hdr + 0x20, ADXSYNTH_DATA_OFFSET);
+  adxsynth_be32(hdr + 0x24, samples);
+  adxsynth_be32(hdr + 0x28, ADXSYNTH_DATA_OFFSET + frames * 18 * channels);
+  memcpy(hdr + ADXSYNTH_DATA_OFFSET - 6, "(c)CRI", 6);
+
+  fp = fopen(path, "wb");
+  if (fp == NULL) {
+    perror(path);
+    free(pcm);
+    return 0;
+  }
+  fwrite(hdr, 1, sizeof(hdr), fp);
+  adxdec_coefs(rate, 500, &coef1, &coef2);
+  memset(hist, 0, sizeof(hist));
+  for (i = 0; i < frames; i++) {
+    for (ch = 0; ch < channels; ch++) {
+      adxsynth_frame(pcm + i * ADXDEC_SAMPLES_PER_FRAME * channels + ch, channels, frame,
+                     &hist[ch], coef1, coef2);
+      fwrite(frame, 1, 18, fp);
+    }
+  }
+  // End of stream marker
+  memset(frame, 0, sizeof(frame));
+  adxsynth_be16(frame, 0x8001);
+  adxsynth_be16(frame + 2, 14);
+  fwrite(frame, 1, 18, fp);
+  fclose(fp);
+  free(pcm);
+  return 1;
+}
+
+#endif // ADXSYNTH_H
@@ -0,0 +1,17 @@
+/* Host stand-in for <arch/types.h> */
+#ifndef HOST_ARCH_TYPES_H
+#define HOST_ARCH_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef int64_t int64;
+
+#endif
@@ -0,0 +1,26 @@
+/* Host stand-in for <dc/fmath.h>: the SH4 instructions as plain C */
+#ifndef HOST_DC_FMATH_H
+#define HOST_DC_FMATH_H
+
+#include <math.h>
+
+#define F_PI 3.1415926f
+
+static inline float fipr(float x, float y, float z, float w,
+                         float a, float b, float c, float d) {
+  return x * a + y * b + z * c + w * d;
+}
+
+static inline float fipr_magnitude_sqr(float x, float y, float z, float w) {
+  return x * x + y * y + z * z + w * w;
+}
+
+#define __fipr_magnitude_sqr fipr_magnitude_sqr
+
+static inline float fsqrt(float x) { return sqrtf(x); }
+static inline float frsqrt(float x) { return 1.0f / sqrtf(x); }
+static inline float fsin(float x) { return sinf(x); }
+static inline float fcos(float x) { return cosf(x); }
+static inline float ftan(float x) { return tanf(x); }
+
+#endif
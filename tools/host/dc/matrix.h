@@ -0,0 +1,38 @@
+/* Host stand-in for <dc/matrix.h>: XMTRX is a global the tools can inspect */
+#ifndef HOST_DC_MATRIX_H
+#define HOST_DC_MATRIX_H
+
+typedef float matrix_t[4][4];
+
+typedef struct {
+  float x, y, z, w;
+} vector_t;
+
+typedef vector_t point_t;
+
+/* The emulated matrix register, m[column][row] like the real thing */
+extern matrix_t host_xmtrx;
+
+void mat_store(matrix_t *out);
+void mat_load(const matrix_t *in);
+void mat_identity(void);
+void mat_apply(const matrix_t *src);
+void host_ftrv(float *x, float *y, float *z, float *w);
+
+/* x, y, z with w = 1 through XMTRX, then x and y divided by w and z
+   replaced with 1/w; vecskip is the stride in bytes */
+void mat_transform(vector_t *invecs, vector_t *outvecs, int veccnt, int vecskip);
+
+#define mat_trans_nodiv(x, y, z, w) host_ftrv(&(x), &(y), &(z), &(w))
+
+/* x and y divided by w, z replaced with 1/w, as on the SH4 */
+#define mat_trans_single(x, y, z) do { \
+    float __w = 1.0f; \
+    host_ftrv(&(x), &(y), &(z), &__w); \
+    __w = 1.0f / __w; \
+    (x) *= __w; \
+    (y) *= __w; \
+    (z) = __w; \
+  } while (0)
+
+#endif
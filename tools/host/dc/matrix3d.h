@@ -0,0 +1,16 @@
+/* Host stand-in for <dc/matrix3d.h>: each call multiplies XMTRX by its matrix */
+#ifndef HOST_DC_MATRIX3D_H
+#define HOST_DC_MATRIX3D_H
+
+#include <dc/matrix.h>
+
+void mat_rotate_x(float r);
+void mat_rotate_y(float r);
+void mat_rotate_z(float r);
+void mat_rotate(float xr, float yr, float zr);
+void mat_translate(float x, float y, float z);
+void mat_scale(float x, float y, float z);
+void mat_perspective(float xcenter, float ycenter, float cot_fovy_2, float znear, float zfar);
+void mat_lookat(const point_t *eye, const point_t *center, const vector_t *up);
+
+#endif
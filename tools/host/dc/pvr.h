@@ -0,0 +1,313 @@
+/* Host stand-in for <dc/pvr.h>: the part of the KOS PVR API the examples use.
+   Headers are compiled bit for bit as KOS does, except that texture
+   addresses are offsets into host/pvr.c's 8MB of texture memory. Blocks sent
+   inside a scene are counted per list and, with PVR_STREAM=<file> in the
+   environment, recorded (host/pvrstream.h). Committed vertices also go to
+   host_pvr_capture() so a tool can look at them outside a scene. */
+#ifndef HOST_DC_PVR_H
+#define HOST_DC_PVR_H
+
+#include <arch/types.h>
+
+typedef void *pvr_ptr_t;
+typedef uint32 pvr_list_t;
+
+typedef struct {
+  uint32 flags;
+  float x, y, z, u, v;
+  uint32 argb, oargb;
+} pvr_vertex_t;
+
+typedef struct {
+  uint32 cmd, mode1, mode2, mode3;
+  uint32 d1, d2, d3, d4;
+} pvr_poly_hdr_t;
+
+typedef struct {
+  uint32 cmd, mode1, mode2, mode3;
+  uint32 argb, oargb, d1, d2;
+} pvr_sprite_hdr_t;
+
+typedef struct {
+  uint32 flags;
+  float ax, ay, az, bx, by, bz, cx;
+  float cy, cz, dx, dy;
+  uint32 dummy, auv, buv, cuv;
+} pvr_sprite_txr_t;
+
+typedef struct {
+  uint32 flags;
+  float ax, ay, az, bx, by, bz, cx;
+  float cy, cz, dx, dy;
+  uint32 d1, d2, d3, d4;
+} pvr_sprite_col_t;
+
+typedef struct {
+  int enable, filter, mipmap, mipmap_bias, uv_flip, uv_clamp, alpha, env;
+  int width, height, format;
+  pvr_ptr_t base;
+} pvr_txr_cxt_t;
+
+typedef struct {
+  int list_type;
+  struct {
+    int alpha, shading, fog_type, culling, color_clamp, clip_mode, modifier_mode, specular;
+  } gen;
+  struct {
+    int src, dst, src_enable, dst_enable;
+  } blend;
+  struct {
+    int color, uv, modifier;
+  } fmt;
+  struct {
+    int comparison, write;
+  } depth;
+  pvr_txr_cxt_t txr;
+} pvr_poly_cxt_t;
+
+typedef struct {
+  int list_type;
+  struct {
+    int alpha, fog_type, culling, color_clamp, clip_mode, specular;
+  } gen;
+  struct {
+    int src, dst, src_enable, dst_enable;
+  } blend;
+  struct {
+    int comparison, write;
+  } depth;
+  pvr_txr_cxt_t txr;
+} pvr_sprite_cxt_t;
+
+#define PVR_LIST_OP_POLY 0
+#define PVR_LIST_OP_MOD  1
+#define PVR_LIST_TR_POLY 2
+#define PVR_LIST_TR_MOD  3
+#define PVR_LIST_PT_POLY 4
+
+#define PVR_CMD_POLYHDR    0x80840000
+#define PVR_CMD_SPRITE     0xa0000000
+#define PVR_CMD_VERTEX     0xe0000000
+#define PVR_CMD_VERTEX_EOL 0xf0000000
+
+#define PVR_SHADE_FLAT    0
+#define PVR_SHADE_GOURAUD 1
+
+#define PVR_DEPTHCMP_NEVER    0
+#define PVR_DEPTHCMP_LESS     1
+#define PVR_DEPTHCMP_EQUAL    2
+#define PVR_DEPTHCMP_LEQUAL   3
+#define PVR_DEPTHCMP_GREATER  4
+#define PVR_DEPTHCMP_NOTEQUAL 5
+#define PVR_DEPTHCMP_GEQUAL   6
+#define PVR_DEPTHCMP_ALWAYS   7
+
+#define PVR_CULLING_NONE  0
+#define PVR_CULLING_SMALL 1
+#define PVR_CULLING_CCW   2
+#define PVR_CULLING_CW    3
+
+#define PVR_DEPTHWRITE_ENABLE  0
+#define PVR_DEPTHWRITE_DISABLE 1
+
+#define PVR_TEXTURE_DISABLE 0
+#define PVR_TEXTURE_ENABLE  1
+
+#define PVR_BLEND_ZERO         0
+#define PVR_BLEND_ONE          1
+#define PVR_BLEND_DESTCOLOR    2
+#define PVR_BLEND_INVDESTCOLOR 3
+#define PVR_BLEND_SRCALPHA     4
+#define PVR_BLEND_INVSRCALPHA  5
+#define PVR_BLEND_DESTALPHA    6
+#define PVR_BLEND_INVDESTALPHA 7
+#define PVR_BLEND_DISABLE      0
+#define PVR_BLEND_ENABLE       1
+
+#define PVR_FOG_TABLE   0
+#define PVR_FOG_VERTEX  1
+#define PVR_FOG_DISABLE 2
+#define PVR_FOG_TABLE2  3
+
+#define PVR_USERCLIP_DISABLE 0
+#define PVR_USERCLIP_INSIDE  2
+#define PVR_USERCLIP_OUTSIDE 3
+
+#define PVR_CLRCLAMP_DISABLE 0
+#define PVR_CLRCLAMP_ENABLE  1
+
+#define PVR_SPECULAR_DISABLE 0
+#define PVR_SPECULAR_ENABLE  1
+
+#define PVR_ALPHA_DISABLE 0
+#define PVR_ALPHA_ENABLE  1
+
+#define PVR_TXRALPHA_ENABLE  0
+#define PVR_TXRALPHA_DISABLE 1
+
+#define PVR_UVFLIP_NONE 0
+#define PVR_UVCLAMP_NONE 0
+
+#define PVR_FILTER_NONE      0
+#define PVR_FILTER_NEAREST   0
+#define PVR_FILTER_BILINEAR  2
+#define PVR_FILTER_TRILINEAR1 4
+#define PVR_FILTER_TRILINEAR2 6
+
+#define PVR_MIPBIAS_NORMAL 4
+
+#define PVR_TXRENV_REPLACE       0
+#define PVR_TXRENV_MODULATE      1
+#define PVR_TXRENV_DECAL         2
+#define PVR_TXRENV_MODULATEALPHA 3
+
+#define PVR_MIPMAP_DISABLE 0
+#define PVR_MIPMAP_ENABLE  1
+
+#define PVR_CLRFMT_ARGBPACKED     0
+#define PVR_CLRFMT_4FLOATS        1
+#define PVR_CLRFMT_INTENSITY      2
+#define PVR_CLRFMT_INTENSITY_PREV 3
+
+#define PVR_UVFMT_32BIT 0
+#define PVR_UVFMT_16BIT 1
+
+#define PVR_MODIFIER_DISABLE 0
+#define PVR_MODIFIER_ENABLE  1
+
+#define PVR_TXRFMT_NONE        0
+#define PVR_TXRFMT_VQ_DISABLE  (0 << 30)
+#define PVR_TXRFMT_VQ_ENABLE   (1 << 30)
+#define PVR_TXRFMT_ARGB1555    (0 << 27)
+#define PVR_TXRFMT_RGB565      (1 << 27)
+#define PVR_TXRFMT_ARGB4444    (2 << 27)
+#define PVR_TXRFMT_YUV422      (3 << 27)
+#define PVR_TXRFMT_BUMP        (4 << 27)
+#define PVR_TXRFMT_PAL4BPP     (5 << 27)
+#define PVR_TXRFMT_PAL8BPP     (6 << 27)
+#define PVR_TXRFMT_TWIDDLED    (0 << 26)
+#define PVR_TXRFMT_NONTWIDDLED (1 << 26)
+#define PVR_TXRFMT_NOSTRIDE    (0 << 21)
+#define PVR_TXRFMT_STRIDE      (1 << 25)
+#define PVR_TXRFMT_8BPP_PAL(x) ((x) << 25)
+#define PVR_TXRFMT_4BPP_PAL(x) ((x) << 21)
+
+#define PVR_PAL_ARGB1555 0
+#define PVR_PAL_RGB565   1
+#define PVR_PAL_ARGB4444 2
+#define PVR_PAL_ARGB8888 3
+
+#define PVR_BINSIZE_0  0
+#define PVR_BINSIZE_8  8
+#define PVR_BINSIZE_16 16
+#define PVR_BINSIZE_32 32
+
+typedef struct {
+  int opb_sizes[5];
+  int vertex_buf_size;
+  int dma_enabled;
+  int fsaa_enabled;
+  int autosort_disabled;
+  int opb_overflow_count;
+} pvr_init_params_t;
+
+typedef struct {
+  uint32 frame_last_time, reg_last_time, rnd_last_time, buf_last_time;
+  float frame_rate;
+  uint32 frame_count, vbl_count;
+  uint32 vtx_buffer_used, vtx_buffer_used_max;
+} pvr_stats_t;
+
+#define PVR_PACK_COLOR(a, r, g, b) ( \
+    ((uint8)((a) * 255) << 24) | \
+    ((uint8)((r) * 255) << 16) | \
+    ((uint8)((g) * 255) << 8) | \
+    ((uint8)((b) * 255) << 0))
+
+/* The top 16 bits of each float */
+static inline uint32 PVR_PACK_16BIT_UV(float u, float v) {
+  union {
+    float f;
+    uint32 i;
+  } cu = {u}, cv = {v};
+  return (cu.i & 0xffff0000) | (cv.i >> 16);
+}
+
+int pvr_init(const pvr_init_params_t *params);
+int pvr_shutdown(void);
+void pvr_set_bg_color(float r, float g, float b);
+int pvr_get_stats(pvr_stats_t *stat);
+
+int pvr_wait_ready(void);
+void pvr_scene_begin(void);
+int pvr_scene_finish(void);
+int pvr_list_begin(pvr_list_t list);
+int pvr_list_finish(void);
+int pvr_prim(const void *data, int size);
+
+void *pvr_set_vertbuf(pvr_list_t list, void *buffer, int len);
+void *pvr_vertbuf_tail(pvr_list_t list);
+void pvr_vertbuf_written(pvr_list_t list, uint32 amt);
+
+pvr_ptr_t pvr_mem_malloc(size_t size);
+void pvr_mem_free(pvr_ptr_t chunk);
+uint32 pvr_mem_available(void);
+void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32 count);
+
+/* pvr_txr_load_ex() flags: 8 and 16 bit texels, twiddled unless told not to */
+#define PVR_TXRLOAD_4BPP          0x01
+#define PVR_TXRLOAD_8BPP          0x02
+#define PVR_TXRLOAD_16BPP         0x03
+#define PVR_TXRLOAD_FMT_MASK      0x0f
+#define PVR_TXRLOAD_FMT_NOTWIDDLE 0x80
+
+void pvr_txr_load_ex(const void *src, pvr_ptr_t dst, uint32 w, uint32 h, uint32 flags);
+
+void pvr_set_pal_format(int fmt);
+void pvr_set_pal_entry(uint32 idx, uint32 value);
+
+/* Registers, only kept. The punch-through alpha reference goes in each
+   recorded frame. */
+#define PVR_PT_ALPHA_REF 0x011c
+
+void host_pvr_set_reg(uint32 reg, uint32 value);
+uint32 host_pvr_get_reg(uint32 reg);
+
+#define PVR_SET(reg, value) host_pvr_set_reg((reg), (value))
+#define PVR_GET(reg)        host_pvr_get_reg(reg)
+
+void pvr_poly_cxt_col(pvr_poly_cxt_t *dst, pvr_list_t list);
+void pvr_poly_cxt_txr(pvr_poly_cxt_t *dst, pvr_list_t list, int textureformat, int tw,
+                      int th, pvr_ptr_t textureaddr, int filtering);
+void pvr_poly_compile(pvr_poly_hdr_t *dst, const pvr_poly_cxt_t *src);
+void pvr_sprite_cxt_col(pvr_sprite_cxt_t *dst, pvr_list_t list);
+void pvr_sprite_cxt_txr(pvr_sprite_cxt_t *dst, pvr_list_t list, int textureformat, int tw,
+                        int th, pvr_ptr_t textureaddr, int filtering);
+void pvr_sprite_compile(pvr_sprite_hdr_t *dst, const pvr_sprite_cxt_t *src);
+
+/* Two 32 byte slots like the store queues, flipped by pvr_dr_target() */
+typedef uint32 pvr_dr_state_t;
+
+void *host_pvr_dr_target(pvr_dr_state_t *s);
+void host_pvr_dr_commit(void *addr);
+
+#define pvr_dr_init(vtx_buf_ptr)   (*(vtx_buf_ptr) = 0)
+#define pvr_dr_target(vtx_buf_ptr) ((pvr_vertex_t *)host_pvr_dr_target(&(vtx_buf_ptr)))
+#define pvr_dr_commit(addr)        host_pvr_dr_commit(addr)
+#define pvr_dr_finish()            ((void)0)
+
+/**
+ * @brief Where committed 32 byte blocks go
+ *
+ * @param buf Blocks are appended here, NULL to just count them
+ * @param cap Blocks buf holds, the rest are counted and dropped
+ */
+void host_pvr_capture(void *buf, size_t cap);
+
+/* Blocks committed since the last host_pvr_capture() */
+size_t host_pvr_committed(void);
+
+/* The texture memory, pvr_ptr_t values point into it */
+extern uint8 host_pvr_vram[];
+
+#endif
@@ -0,0 +1,23 @@
+/* Host stand-in for <dc/vec3f.h> */
+#ifndef HOST_DC_VEC3F_H
+#define HOST_DC_VEC3F_H
+
+#include <math.h>
+
+typedef struct vec3f {
+  float x, y, z;
+} vec3f_t;
+
+#define vec3f_dot(x1, y1, z1, x2, y2, z2, w) \
+  ((w) = (x1) * (x2) + (y1) * (y2) + (z1) * (z2))
+
+#define vec3f_length(x, y, z, w) ((w) = sqrtf((x) * (x) + (y) * (y) + (z) * (z)))
+
+#define vec3f_normalize(x, y, z) do { \
+    float __l = 1.0f / sqrtf((x) * (x) + (y) * (y) + (z) * (z)); \
+    (x) *= __l; \
+    (y) *= __l; \
+    (z) *= __l; \
+  } while (0)
+
+#endif
@@ -0,0 +1,34 @@
+/********************************************************************************************/
+/* Host tool support: clock and file system                                                 */
+/********************************************************************************************/
+/* The KOS timer from the host's monotonic clock, and /rd/ and /pc/ paths mapped to host    */
+/* directories for an example built with kos.h.                                             */
+/********************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "arch/types.h"
+
+uint64 timer_us_gettime64(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64 timer_ms_gettime64(void) {
+  return timer_us_gettime64() / 1000;
+}
+
+FILE *host_fopen(const char *path, const char *mode) {
+  char buf[1024];
+  if (strncmp(path, "/rd/", 4) == 0) {
+    const char *rd = getenv("HOST_ROMDISK");
+    snprintf(buf, sizeof(buf), "%s/%s", rd && *rd ? rd : "romdisk", path + 4);
+    path = buf;
+  } else if (strncmp(path, "/pc/", 4) == 0) {
+    path += 3;
+  }
+  return fopen(path, mode);
+}
@@ -0,0 +1,57 @@
+/* Host stand-in for <kos.h>: enough to build an example's render loop on the
+   development machine. Paths under /rd/ are looked up in $HOST_ROMDISK
+   (romdisk/ by default), /pc/ paths are host paths, as with dcload. */
+#ifndef HOST_KOS_H
+#define HOST_KOS_H
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arch/types.h>
+#include <dc/fmath.h>
+#include <dc/matrix.h>
+#include <dc/matrix3d.h>
+#include <dc/pvr.h>
+
+#define INIT_DEFAULT     0
+#define INIT_MALLOCSTATS 0
+#define KOS_INIT_FLAGS(flags) extern int host_kos_init_flags
+#define KOS_INIT_ROMDISK(rd)  extern int host_kos_init_romdisk
+
+#define CONT_C          (1 << 0)
+#define CONT_B          (1 << 1)
+#define CONT_A          (1 << 2)
+#define CONT_START      (1 << 3)
+#define CONT_DPAD_UP    (1 << 4)
+#define CONT_DPAD_DOWN  (1 << 5)
+#define CONT_DPAD_LEFT  (1 << 6)
+#define CONT_DPAD_RIGHT (1 << 7)
+#define CONT_Z          (1 << 8)
+#define CONT_Y          (1 << 9)
+#define CONT_X          (1 << 10)
+#define CONT_D          (1 << 11)
+
+uint64 timer_us_gettime64(void);
+uint64 timer_ms_gettime64(void);
+
+static inline void vid_border_color(int r, int g, int b) {
+  (void)r;
+  (void)g;
+  (void)b;
+}
+static inline void vid_waitvbl(void) {}
+static inline void vid_shutdown(void) {}
+
+/* No BIOS font on the host, text drawn with it stays blank */
+static inline void bfont_draw(void *buffer, uint32 bufwidth, int opaque, uint32 c) {
+  (void)buffer;
+  (void)bufwidth;
+  (void)opaque;
+  (void)c;
+}
+
+FILE *host_fopen(const char *path, const char *mode);
+#define fopen(path, mode) host_fopen(path, mode)
+
+#endif
@@ -0,0 +1,7 @@
+/* Host stand-in for KOS's <png/png.h>: the same libpng, from the host */
+#ifndef HOST_PNG_PNG_H
+#define HOST_PNG_PNG_H
+
+#include <png.h>
+
+#endif
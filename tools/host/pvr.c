@@ -0,0 +1,504 @@
+/********************************************************************************************/
+/* Host tool support: the PVR as a recorder                                                 */
+/********************************************************************************************/
+/* pvr_dr_target() hands out one of two 32 byte slots the way the SH4 store queues work,    */
+/* pvr_dr_commit() copies the slot to the capture buffer and, inside a scene, to the frame. */
+/* pvr_prim() and the DMA vertex buffers end up in the same frame. pvr_scene_finish()       */
+/* counts the frame's blocks per list and, with PVR_STREAM=<file> set, writes the frame     */
+/* and whatever texture memory and palette changed before it to that file, see              */
+/* pvrstream.h; PVR_STREAM_FRAMES=<first>[-<last>] keeps only those frames. pvr_shutdown()  */
+/* prints the totals.                                                                       */
+/********************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dc/pvr.h"
+#include "pvrstream.h"
+
+static uint32 sq[2][8] __attribute__((aligned(32)));
+static uint8 *capture;
+static size_t capture_cap, committed;
+
+uint8 host_pvr_vram[PVRSTREAM_VRAM] __attribute__((aligned(32)));
+
+/* Allocations, sorted by offset */
+#define MAX_ALLOCS 4096
+static struct {
+  uint32 offset, size;
+} allocs[MAX_ALLOCS];
+static int alloc_count;
+
+static struct {
+  int inited;
+  pvr_init_params_t params;
+  int in_scene;
+  pvr_list_t list;
+  uint32 bg_argb;
+  uint32 pal[1024];
+  int pal_format, pal_dirty;
+  uint32 regs[0x2000 / 4];
+  // This frame's blocks, all lists in the order sent
+  uint8 *frame;
+  size_t frame_blocks, frame_cap;
+  // DMA mode vertex buffers, halves swapped every frame
+  struct {
+    uint8 *buf;
+    uint32 len, used;
+  } vb[PVRSTREAM_LISTS];
+  int vb_half;
+  pvrstream_stats_t stats;
+  FILE *stream;
+  uint32 first, last;       // frames to record
+} pvr;
+
+void *host_pvr_dr_target(pvr_dr_state_t *s) {
+  *s ^= 32;
+  return sq[*s >> 5];
+}
+
+static void frame_add(const void *blk) {
+  if (pvr.frame_blocks == pvr.frame_cap) {
+    size_t cap = pvr.frame_cap ? pvr.frame_cap * 2 : 4096;
+    uint8 *frame = realloc(pvr.frame, cap * 32);
+    if (frame == NULL) {
+      fprintf(stderr, "host pvr: no memory for a %u block frame\n", (unsigned)cap);
+      exit(1);
+    }
+    pvr.frame = frame;
+    pvr.frame_cap = cap;
+  }
+  memcpy(pvr.frame + pvr.frame_blocks++ * 32, blk, 32);
+}
+
+static void frame_end_list(void) {
+  static const uint32 end[8];
+  frame_add(end);
+}
+
+void host_pvr_dr_commit(void *addr) {
+  if (capture && committed < capture_cap)
+    memcpy(capture + committed * 32, addr, 32);
+  committed++;
+  if (pvr.in_scene)
+    frame_add(addr);
+}
+
+void host_pvr_capture(void *buf, size_t cap) {
+  capture = buf;
+  capture_cap = cap;
+  committed = 0;
+}
+
+size_t host_pvr_committed(void) {
+  return committed;
+}
+
+static void stream_chunk(const char *id, const void *hdr, uint32 hdr_size, const void *data,
+                         uint32 data_size) {
+  pvrstream_chunk_t chunk;
+  if (pvr.stream == NULL)
+    return;
+  memcpy(chunk.id, id, 4);
+  chunk.size = hdr_size + data_size;
+  if (fwrite(&chunk, sizeof(chunk), 1, pvr.stream) != 1 ||
+      fwrite(hdr, 1, hdr_size, pvr.stream) != hdr_size ||
+      (data_size && fwrite(data, 1, data_size, pvr.stream) != data_size)) {
+    fprintf(stderr, "host pvr: writing the stream failed, recording stopped\n");
+    fclose(pvr.stream);
+    pvr.stream = NULL;
+  }
+}
+
+int pvr_init(const pvr_init_params_t *params) {
+  const char *path = getenv("PVR_STREAM");
+  pvrstream_init_t init;
+
+  memset(&pvr.stats, 0, sizeof(pvr.stats));
+  pvr.params = *params;
+  pvr.inited = 1;
+  pvr.stream = NULL;
+  pvr.first = 0;
+  pvr.last = 0xffffffff;
+  if (getenv("PVR_STREAM_FRAMES")) {
+    unsigned first, last;
+    int n = sscanf(getenv("PVR_STREAM_FRAMES"), "%u-%u", &first, &last);
+    if (n >= 1)
+      pvr.first = pvr.last = first;
+    if (n == 2)
+      pvr.last = last;
+  }
+  if (path && *path) {
+    pvrstream_hdr_t hdr;
+    pvr.stream = fopen(path, "wb");
+    if (pvr.stream == NULL) {
+      perror(path);
+      return -1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.fourcc, PVRSTREAM_FOURCC, 4);
+    hdr.version = PVRSTREAM_VERSION;
+    fwrite(&hdr, sizeof(hdr), 1, pvr.stream);
+    for (int i = 0; i < PVRSTREAM_LISTS; i++)
+      init.opb_sizes[i] = params->opb_sizes[i];
+    init.vertex_buf_size = params->vertex_buf_size;
+    init.dma_enabled = params->dma_enabled;
+    init.fsaa_enabled = params->fsaa_enabled;
+    init.autosort_disabled = params->autosort_disabled;
+    init.opb_overflow_count = params->opb_overflow_count;
+    stream_chunk("INIT", &init, sizeof(init), NULL, 0);
+  }
+  return 0;
+}
+
+int pvr_shutdown(void) {
+  if (!pvr.inited)
+    return -1;
+  printf("host pvr: ");
+  pvrstream_print_stats(stdout, &pvr.stats);
+  if (pvr.stream)
+    fclose(pvr.stream);
+  pvr.stream = NULL;
+  free(pvr.frame);
+  pvr.frame = NULL;
+  pvr.frame_blocks = pvr.frame_cap = 0;
+  pvr.inited = 0;
+  return 0;
+}
+
+void pvr_set_bg_color(float r, float g, float b) {
+  pvr.bg_argb = 0xff000000 | (uint32)(r * 255) << 16 | (uint32)(g * 255) << 8 |
+                (uint32)(b * 255);
+}
+
+int pvr_get_stats(pvr_stats_t *stat) {
+  memset(stat, 0, sizeof(*stat));
+  stat->frame_count = stat->vbl_count = pvr.stats.frames;
+  stat->frame_rate = 60.0f;
+  return 0;
+}
+
+/* Nothing is ever still rendering */
+int pvr_wait_ready(void) {
+  return 0;
+}
+
+void pvr_scene_begin(void) {
+  pvr.in_scene = 1;
+  pvr.frame_blocks = 0;
+  for (int i = 0; i < PVRSTREAM_LISTS; i++)
+    pvr.vb[i].used = 0;
+}
+
+int pvr_scene_finish(void) {
+  pvrstream_parser_t parser;
+  pvrstream_frame_t hdr;
+
+  if (pvr.params.dma_enabled) {
+    // The DMA sends the lists in order, each with its end of list
+    for (int i = 0; i < PVRSTREAM_LISTS; i++) {
+      uint8 *p = pvr.vb[i].buf + pvr.vb_half * (pvr.vb[i].len / 2);
+      if (pvr.vb[i].used == 0)
+        continue;
+      for (uint32 off = 0; off < pvr.vb[i].used; off += 32)
+        frame_add(p + off);
+      frame_end_list();
+    }
+    pvr.vb_half ^= 1;
+  }
+  pvr.in_scene = 0;
+
+  pvrstream_parser_init(&parser);
+  for (size_t i = 0; i < pvr.frame_blocks; i++)
+    pvrstream_feed(&parser, pvr.frame + i * 32, &pvr.stats);
+
+  if (pvr.pal_dirty) {
+    pvrstream_pal_t pal = {(uint32_t)pvr.pal_format};
+    stream_chunk("PAL ", &pal, sizeof(pal), pvr.pal, sizeof(pvr.pal));
+    pvr.pal_dirty = 0;
+  }
+  hdr.frame = pvr.stats.frames;
+  hdr.bg_argb = pvr.bg_argb;
+  hdr.blocks = (uint32_t)pvr.frame_blocks;
+  hdr.pt_alpha_ref = pvr.regs[PVR_PT_ALPHA_REF / 4] & 0xff;
+  if (hdr.frame >= pvr.first && hdr.frame <= pvr.last)
+    stream_chunk("FRAM", &hdr, sizeof(hdr), pvr.frame, (uint32)(pvr.frame_blocks * 32));
+  pvr.stats.frames++;
+  return 0;
+}
+
+int pvr_list_begin(pvr_list_t list) {
+  pvr.list = list;
+  return 0;
+}
+
+int pvr_list_finish(void) {
+  if (!pvr.params.dma_enabled && pvr.in_scene)
+    frame_end_list();
+  return 0;
+}
+
+int pvr_prim(const void *data, int size) {
+  for (int off = 0; off < size; off += 32) {
+    if (pvr.params.dma_enabled) {
+      memcpy(pvr_vertbuf_tail(pvr.list), (const uint8 *)data + off, 32);
+      pvr_vertbuf_written(pvr.list, 32);
+    } else if (pvr.in_scene) {
+      frame_add((const uint8 *)data + off);
+    }
+  }
+  return 0;
+}
+
+void *pvr_set_vertbuf(pvr_list_t list, void *buffer, int len) {
+  void *old = pvr.vb[list].buf;
+  pvr.vb[list].buf = buffer;
+  pvr.vb[list].len = len;
+  pvr.vb[list].used = 0;
+  return old;
+}
+
+void *pvr_vertbuf_tail(pvr_list_t list) {
+  return pvr.vb[list].buf + pvr.vb_half * (pvr.vb[list].len / 2) + pvr.vb[list].used;
+}
+
+void pvr_vertbuf_written(pvr_list_t list, uint32 amt) {
+  pvr.vb[list].used += amt;
+}
+
+/* First fit, 32 byte aligned */
+pvr_ptr_t pvr_mem_malloc(size_t size) {
+  uint32 at = 0;
+  int i;
+  pvrstream_mem_t m;
+
+  size = (size + 31) & ~(size_t)31;
+  if (alloc_count == MAX_ALLOCS)
+    return NULL;
+  for (i = 0; i < alloc_count; i++) {
+    if (allocs[i].offset - at >= size)
+      break;
+    at = allocs[i].offset + allocs[i].size;
+  }
+  if (i == alloc_count && PVRSTREAM_VRAM - at < size)
+    return NULL;
+  memmove(&allocs[i + 1], &allocs[i], (alloc_count - i) * sizeof(allocs[0]));
+  allocs[i].offset = at;
+  allocs[i].size = (uint32)size;
+  alloc_count++;
+
+  m.offset = at;
+  m.size = (uint32)size;
+  m.alloc = 1;
+  pvrstream_count_mem(&pvr.stats, &m);
+  stream_chunk("MEM ", &m, sizeof(m), NULL, 0);
+  return host_pvr_vram + at;
+}
+
+void pvr_mem_free(pvr_ptr_t chunk) {
+  uint32 offset = (uint32)((uint8 *)chunk - host_pvr_vram);
+  pvrstream_mem_t m;
+
+  for (int i = 0; i < alloc_count; i++) {
+    if (allocs[i].offset != offset)
+      continue;
+    m.offset = offset;
+    m.size = allocs[i].size;
+    m.alloc = 0;
+    pvrstream_count_mem(&pvr.stats, &m);
+    stream_chunk("MEM ", &m, sizeof(m), NULL, 0);
+    memmove(&allocs[i], &allocs[i + 1], (alloc_count - i - 1) * sizeof(allocs[0]));
+    alloc_count--;
+    return;
+  }
+  fprintf(stderr, "host pvr: pvr_mem_free of %p, not allocated\n", chunk);
+}
+
+uint32 pvr_mem_available(void) {
+  return PVRSTREAM_VRAM - pvr.stats.vram_used;
+}
+
+void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32 count) {
+  pvrstream_vram_t v = {(uint32_t)((uint8 *)dst - host_pvr_vram)};
+  memcpy(dst, src, count);
+  pvr.stats.uploaded += count;
+  stream_chunk("VRAM", &v, sizeof(v), src, count);
+}
+
+/* Twiddled order puts v in the low bit, a rectangle is a row of squares */
+static uint32 twiddle(uint32 x, uint32 y, uint32 w, uint32 h) {
+  uint32 m = w < h ? w : h, t = 0;
+  for (uint32 b = 0; (1u << b) < m; b++)
+    t |= ((y >> b) & 1) << (2 * b) | ((x >> b) & 1) << (2 * b + 1);
+  return t + (x / m + y / m) * m * m;
+}
+
+void pvr_txr_load_ex(const void *src, pvr_ptr_t dst, uint32 w, uint32 h, uint32 flags) {
+  uint32 bpp = (flags & PVR_TXRLOAD_FMT_MASK) == PVR_TXRLOAD_16BPP ? 2 : 1;
+  uint8 *tmp;
+
+  if ((flags & PVR_TXRLOAD_FMT_MASK) == PVR_TXRLOAD_4BPP) {
+    fprintf(stderr, "host pvr: pvr_txr_load_ex of 4 bit texels is not done\n");
+    exit(1);
+  }
+  if (flags & PVR_TXRLOAD_FMT_NOTWIDDLE) {
+    pvr_txr_load(src, dst, w * h * bpp);
+    return;
+  }
+  if ((tmp = malloc(w * h * bpp)) == NULL) {
+    fprintf(stderr, "host pvr: no memory to twiddle a %ux%u texture\n", (unsigned)w, (unsigned)h);
+    exit(1);
+  }
+  for (uint32 y = 0; y < h; y++)
+    for (uint32 x = 0; x < w; x++)
+      memcpy(tmp + twiddle(x, y, w, h) * bpp, (const uint8 *)src + (y * w + x) * bpp, bpp);
+  pvr_txr_load(tmp, dst, w * h * bpp);
+  free(tmp);
+}
+
+void host_pvr_set_reg(uint32 reg, uint32 value) {
+  pvr.regs[(reg / 4) & (0x2000 / 4 - 1)] = value;
+}
+
+uint32 host_pvr_get_reg(uint32 reg) {
+  return pvr.regs[(reg / 4) & (0x2000 / 4 - 1)];
+}
+
+void pvr_set_pal_format(int fmt) {
+  pvr.pal_format = fmt;
+  pvr.pal_dirty = 1;
+}
+
+void pvr_set_pal_entry(uint32 idx, uint32 value) {
+  pvr.pal[idx & 1023] = value;
+  pvr.pal_dirty = 1;
+}
+
+/* Context set up and header compiling, as KOS does it */
+
+static void cxt_common(int list, int *alpha, int *src, int *dst) {
+  if (list > PVR_LIST_OP_MOD) {
+    *alpha = PVR_ALPHA_ENABLE;
+    *src = PVR_BLEND_SRCALPHA;
+    *dst = PVR_BLEND_INVSRCALPHA;
+  } else {
+    *alpha = PVR_ALPHA_DISABLE;
+    *src = PVR_BLEND_ONE;
+    *dst = PVR_BLEND_ZERO;
+  }
+}
+
+static void cxt_txr(pvr_txr_cxt_t *txr, int list, int textureformat, int tw, int th,
+                    pvr_ptr_t textureaddr, int filtering) {
+  txr->enable = PVR_TEXTURE_ENABLE;
+  txr->filter = filtering;
+  txr->mipmap_bias = PVR_MIPBIAS_NORMAL;
+  txr->width = tw;
+  txr->height = th;
+  txr->base = textureaddr;
+  txr->format = textureformat;
+  txr->env = PVR_TXRENV_MODULATE;
+  txr->alpha = list > PVR_LIST_OP_MOD ? PVR_TXRALPHA_ENABLE : PVR_TXRALPHA_DISABLE;
+}
+
+void pvr_poly_cxt_col(pvr_poly_cxt_t *dst, pvr_list_t list) {
+  memset(dst, 0, sizeof(*dst));
+  dst->list_type = list;
+  dst->fmt.color = PVR_CLRFMT_ARGBPACKED;
+  dst->fmt.uv = PVR_UVFMT_32BIT;
+  dst->gen.shading = PVR_SHADE_GOURAUD;
+  dst->depth.comparison = PVR_DEPTHCMP_GREATER;
+  dst->depth.write = PVR_DEPTHWRITE_ENABLE;
+  dst->gen.culling = PVR_CULLING_CCW;
+  dst->txr.enable = PVR_TEXTURE_DISABLE;
+  cxt_common(list, &dst->gen.alpha, &dst->blend.src, &dst->blend.dst);
+  dst->gen.fog_type = PVR_FOG_DISABLE;
+  dst->gen.color_clamp = PVR_CLRCLAMP_DISABLE;
+}
+
+void pvr_poly_cxt_txr(pvr_poly_cxt_t *dst, pvr_list_t list, int textureformat, int tw,
+                      int th, pvr_ptr_t textureaddr, int filtering) {
+  pvr_poly_cxt_col(dst, list);
+  cxt_txr(&dst->txr, list, textureformat, tw, th, textureaddr, filtering);
+}
+
+void pvr_sprite_cxt_col(pvr_sprite_cxt_t *dst, pvr_list_t list) {
+  memset(dst, 0, sizeof(*dst));
+  dst->list_type = list;
+  dst->depth.comparison = PVR_DEPTHCMP_GREATER;
+  dst->depth.write = PVR_DEPTHWRITE_ENABLE;
+  dst->gen.culling = PVR_CULLING_CCW;
+  dst->txr.enable = PVR_TEXTURE_DISABLE;
+  cxt_common(list, &dst->gen.alpha, &dst->blend.src, &dst->blend.dst);
+  dst->gen.fog_type = PVR_FOG_DISABLE;
+  dst->gen.color_clamp = PVR_CLRCLAMP_DISABLE;
+}
+
+void pvr_sprite_cxt_txr(pvr_sprite_cxt_t *dst, pvr_list_t list, int textureformat, int tw,
+                        int th, pvr_ptr_t textureaddr, int filtering) {
+  pvr_sprite_cxt_col(dst, list);
+  cxt_txr(&dst->txr, list, textureformat, tw, th, textureaddr, filtering);
+}
+
+static uint32 size_code(int size) {
+  uint32 code = 0;
+  while (code < 7 && (8 << code) < size)
+    code++;
+  return code;
+}
+
+static uint32 mode1(int comparison, int culling, int write, int txr) {
+  return (comparison & 7) << 29 | (culling & 3) << 27 | (write & 1) << 26 | (txr & 1) << 25;
+}
+
+static uint32 mode2(int src, int dst, int src_enable, int dst_enable, int fog, int clamp,
+                    int alpha) {
+  return (src & 7) << 29 | (dst & 7) << 26 | (src_enable & 1) << 25 | (dst_enable & 1) << 24 |
+         (fog & 3) << 22 | (clamp & 1) << 21 | (alpha & 1) << 20;
+}
+
+/* The texture half of mode 2, and mode 3 */
+static void txr_words(const pvr_txr_cxt_t *txr, uint32 *m2, uint32 *m3) {
+  uint32 offset;
+  if (txr->enable == PVR_TEXTURE_DISABLE) {
+    *m3 = 0;
+    return;
+  }
+  offset = (uint32)((uint8 *)txr->base - host_pvr_vram);
+  *m2 |= (txr->alpha & 1) << 19 | (txr->uv_flip & 3) << 17 | (txr->uv_clamp & 3) << 15 |
+         (txr->filter << 12 & 3 << 13) | (txr->mipmap_bias & 15) << 8 | (txr->env & 3) << 6 |
+         size_code(txr->width) << 3 | size_code(txr->height);
+  *m3 = (uint32)(txr->mipmap & 1) << 31 | (uint32)txr->format | (offset & 0x00fffff8) >> 3;
+}
+
+void pvr_poly_compile(pvr_poly_hdr_t *dst, const pvr_poly_cxt_t *src) {
+  dst->cmd = PVR_CMD_POLYHDR;
+  if (src->txr.enable == PVR_TEXTURE_ENABLE)
+    dst->cmd |= 8;
+  dst->cmd |= (src->list_type & 7) << 24 | (src->fmt.color & 3) << 4 |
+              (src->gen.shading & 1) << 1 | (src->fmt.uv & 1) | (src->gen.clip_mode & 3) << 16 |
+              (src->fmt.modifier & 1) << 7 | (src->gen.modifier_mode & 1) << 6 |
+              (src->gen.specular & 1) << 2;
+  dst->mode1 = mode1(src->depth.comparison, src->gen.culling, src->depth.write, src->txr.enable);
+  dst->mode2 = mode2(src->blend.src, src->blend.dst, src->blend.src_enable,
+                     src->blend.dst_enable, src->gen.fog_type, src->gen.color_clamp,
+                     src->gen.alpha);
+  txr_words(&src->txr, &dst->mode2, &dst->mode3);
+  dst->d1 = dst->d2 = dst->d3 = dst->d4 = 0xffffffff;
+}
+
+void pvr_sprite_compile(pvr_sprite_hdr_t *dst, const pvr_sprite_cxt_t *src) {
+  dst->cmd = PVR_CMD_SPRITE;
+  if (src->txr.enable == PVR_TEXTURE_ENABLE)
+    dst->cmd |= 8;
+  dst->cmd |= (src->list_type & 7) << 24 | (src->gen.clip_mode & 3) << 16 |
+              (src->gen.specular & 1) << 2 | PVR_UVFMT_16BIT;
+  dst->mode1 = mode1(src->depth.comparison, src->gen.culling, src->depth.write, src->txr.enable);
+  dst->mode2 = mode2(src->blend.src, src->blend.dst, src->blend.src_enable,
+                     src->blend.dst_enable, src->gen.fog_type, src->gen.color_clamp,
+                     src->gen.alpha);
+  txr_words(&src->txr, &dst->mode2, &dst->mode3);
+  dst->argb = 0xffffffff;
+  dst->oargb = 0;
+  dst->d1 = dst->d2 = 0xffffffff;
+}
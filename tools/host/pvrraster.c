@@ -0,0 +1,969 @@
+/********************************************************************************************/
+/* Host tool support: reference rasterizer for recorded PVR streams                         */
+/********************************************************************************************/
+/* pvrraster_frame() decodes a frame's blocks into triangles the way the TA reads them:     */
+/* strips into triangles with every other one turned around, sprites into two triangles     */
+/* with the fourth corner's depth and UV taken from the plane of the other three. Each      */
+/* triangle gets its edges and the planes of its attributes over 1/w, so a pixel anywhere   */
+/* can be shaded without going back to the vertices, and is put in the bin of every tile    */
+/* its bounding box touches. pvrraster_render() then draws tiles on as many threads as it   */
+/* is given, see pvrraster.h for what is and isn't drawn.                                   */
+/********************************************************************************************/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pvrraster.h"
+
+#define LIST_OP  0
+#define LIST_TR  2
+#define LIST_PT  4
+#define VRAM_MASK (PVRSTREAM_VRAM - 1)
+
+static inline float f32(uint32_t w) {
+  union {
+    uint32_t i;
+    float f;
+  } c = {w};
+  return c.f;
+}
+
+static inline float clamp01(float f) {
+  return f < 0.0f ? 0.0f : f > 1.0f ? 1.0f : f;
+}
+
+static void unpack_argb(uint32_t c, float out[4]) {
+  for (int k = 0; k < 4; k++)
+    out[k] = ((c >> (24 - 8 * k)) & 0xff) / 255.0f;
+}
+
+/* Twiddled order puts v in the low bit, a rectangle is a row of squares */
+static uint32_t twiddle_bits[1024];
+
+static void twiddle_init(void) {
+  for (uint32_t i = 0; i < 1024; i++) {
+    twiddle_bits[i] = 0;
+    for (uint32_t b = 0; b < 10; b++)
+      twiddle_bits[i] |= ((i >> b) & 1) << (2 * b);
+  }
+}
+
+static inline uint32_t twiddle(uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+  uint32_t m = w < h ? w : h;
+  return (twiddle_bits[x & (m - 1)] << 1 | twiddle_bits[y & (m - 1)]) + (x / m + y / m) * m * m;
+}
+
+int pvrraster_init(pvrraster_t *r, const pvrstream_init_t *init) {
+  twiddle_init();
+  memset(r, 0, sizeof(*r));
+  r->width = init->fsaa_enabled ? PVRRASTER_W * 2 : PVRRASTER_W;
+  r->height = PVRRASTER_H;
+  r->tiles_x = r->width / PVRRASTER_TILE;
+  r->tiles_y = r->height / PVRRASTER_TILE;
+  r->autosort = !init->autosort_disabled;
+  r->vram = calloc(PVRSTREAM_VRAM, 1);
+  r->bins = calloc((size_t)r->tiles_x * r->tiles_y * PVRSTREAM_LISTS, sizeof(pvrraster_bin_t));
+  if (r->vram == NULL || r->bins == NULL) {
+    pvrraster_free(r);
+    return 0;
+  }
+  return 1;
+}
+
+void pvrraster_free(pvrraster_t *r) {
+  if (r->bins) {
+    for (int i = 0; i < r->tiles_x * r->tiles_y * PVRSTREAM_LISTS; i++)
+      free(r->bins[i].tri);
+  }
+  free(r->bins);
+  free(r->vram);
+  free(r->hdr);
+  free(r->tri);
+  memset(r, 0, sizeof(*r));
+}
+
+void pvrraster_apply(pvrraster_t *r, const pvrstream_chunk_t *chunk, const void *data) {
+  if (pvrstream_is(chunk, "VRAM") && chunk->size >= sizeof(pvrstream_vram_t)) {
+    const pvrstream_vram_t *v = data;
+    uint32_t size = chunk->size - sizeof(*v);
+    if (v->offset < PVRSTREAM_VRAM && size <= PVRSTREAM_VRAM - v->offset)
+      memcpy(r->vram + v->offset, v + 1, size);
+  } else if (pvrstream_is(chunk, "PAL ") && chunk->size >= sizeof(pvrstream_pal_t) + 4096) {
+    const pvrstream_pal_t *p = data;
+    r->pal_format = p->format;
+    memcpy(r->pal, p + 1, sizeof(r->pal));
+  }
+}
+
+/* Frame set up */
+
+static void decode_hdr(pvrraster_hdr_t *h, const uint32_t *w) {
+  uint32_t bias;
+
+  memset(h, 0, sizeof(*h));
+  h->cmd = w[0];
+  h->mode1 = w[1];
+  h->mode2 = w[2];
+  h->mode3 = w[3];
+  h->list = (h->cmd >> 24) & 7;
+  if (h->list >= PVRSTREAM_LISTS)
+    h->list = LIST_PT;
+  h->textured = (h->cmd >> 3) & 1;
+  h->offset = (h->cmd >> 2) & 1;
+  h->compare = h->mode1 >> 29;
+  // A volume needs both its faces
+  h->cull = h->list == 1 || h->list == 3 ? 0 : (h->mode1 >> 27) & 3;
+  h->zwrite = !((h->mode1 >> 26) & 1);
+  h->src = h->mode2 >> 29;
+  h->dst = (h->mode2 >> 26) & 7;
+  h->use_alpha = (h->mode2 >> 20) & 1;
+  h->txr_alpha = !((h->mode2 >> 19) & 1);
+  h->flip_u = (h->mode2 >> 18) & 1;
+  h->flip_v = (h->mode2 >> 17) & 1;
+  h->clamp_u = (h->mode2 >> 16) & 1;
+  h->clamp_v = (h->mode2 >> 15) & 1;
+  h->filter = (h->mode2 >> 13) & 3;
+  bias = (h->mode2 >> 8) & 15;
+  h->bias = bias ? log2f(bias / 4.0f) : 0.0f;
+  h->env = (h->mode2 >> 6) & 3;
+  h->w = 8 << ((h->mode2 >> 3) & 7);
+  h->h = 8 << (h->mode2 & 7);
+  h->vq = (h->mode3 >> 30) & 1;
+  h->format = (h->mode3 >> 27) & 7;
+  h->addr = (h->mode3 & 0x1fffff) << 3;
+  // The palette selector takes the bits that mean scan order and stride otherwise
+  if (h->format == 5) {
+    h->pal = ((h->mode3 >> 21) & 63) * 16;
+    h->twiddled = 1;
+  } else if (h->format == 6) {
+    h->pal = ((h->mode3 >> 25) & 3) * 256;
+    h->twiddled = 1;
+  } else {
+    h->twiddled = !((h->mode3 >> 26) & 1);
+  }
+  h->mipmap = h->twiddled && h->mode3 >> 31;
+}
+
+typedef struct {
+  int hdr;                         /* last header, -1 for none */
+  pvrstream_kind_t kind;
+  int vert_blocks;
+  float face_base[4], face_offset[4];
+  pvrraster_vert_t strip[2];
+  uint32_t strip_len;
+} parse_t;
+
+static void uv16(uint32_t uv, float *u, float *v) {
+  *u = f32(uv & 0xffff0000);
+  *v = f32(uv << 16);
+}
+
+/* One polygon vertex, in any of the layouts the header allows */
+static void decode_vert(const parse_t *ps, const pvrraster_hdr_t *h, const uint32_t *w,
+                        pvrraster_vert_t *v) {
+  int col = (h->cmd >> 4) & 3;
+
+  memset(v, 0, sizeof(*v));
+  v->x = f32(w[1]);
+  v->y = f32(w[2]);
+  v->z = f32(w[3]);
+  if (h->textured) {
+    if (h->cmd & 1)
+      uv16(w[4], &v->u, &v->v);
+    else {
+      v->u = f32(w[4]);
+      v->v = f32(w[5]);
+    }
+  }
+  switch (col) {
+  case 0:
+    unpack_argb(w[6], v->base);
+    if (h->textured)
+      unpack_argb(w[7], v->offset);
+    break;
+  case 1:
+    // Floating colour follows the position, in the second half when textured
+    for (int k = 0; k < 4; k++) {
+      v->base[k] = clamp01(f32(w[h->textured ? 8 + k : 4 + k]));
+      if (h->textured)
+        v->offset[k] = clamp01(f32(w[12 + k]));
+    }
+    break;
+  default:
+    // Intensity scales the face colour from the header, the alpha stays
+    v->base[0] = ps->face_base[0];
+    v->offset[0] = ps->face_offset[0];
+    for (int k = 1; k < 4; k++) {
+      v->base[k] = clamp01(ps->face_base[k] * f32(w[6]));
+      if (h->textured)
+        v->offset[k] = clamp01(ps->face_offset[k] * f32(w[7]));
+    }
+    break;
+  }
+}
+
+static int grow(void **p, uint32_t *cap, uint32_t count, size_t size) {
+  void *q;
+  uint32_t n;
+  if (count < *cap)
+    return 1;
+  n = *cap ? *cap * 2 : 256;
+  if ((q = realloc(*p, n * size)) == NULL)
+    return 0;
+  *p = q;
+  *cap = n;
+  return 1;
+}
+
+static void set_plane(float out[3], const pvrraster_vert_t *v, const float a[3], double inv) {
+  double d1 = a[1] - a[0], d2 = a[2] - a[0];
+  double dx = (d1 * ((double)v[2].y - v[0].y) - d2 * ((double)v[1].y - v[0].y)) * inv;
+  double dy = (d2 * ((double)v[1].x - v[0].x) - d1 * ((double)v[2].x - v[0].x)) * inv;
+  out[0] = (float)dx;
+  out[1] = (float)dy;
+  out[2] = (float)(a[0] - dx * v[0].x - dy * v[0].y);
+}
+
+static inline int clampi(int v, int lo, int hi) {
+  return v < lo ? lo : v > hi ? hi : v;
+}
+
+/* Cull, set up and bin one triangle. odd turns strip winding around. */
+static int add_tri(pvrraster_t *r, uint32_t hdr, const pvrraster_vert_t *a,
+                   const pvrraster_vert_t *b, const pvrraster_vert_t *c, int odd, int index) {
+  const pvrraster_hdr_t *h = &r->hdr[hdr];
+  pvrraster_vert_t v[3] = {*a, *b, *c};
+  pvrraster_tri_t *t;
+  double area, inv;
+  float minx, maxx, miny, maxy;
+  uint32_t id = r->tri_count;
+
+  // Binned like the rest for the object pointer counts, only not drawn
+  if (h->list != LIST_OP && h->list != LIST_TR && h->list != LIST_PT)
+    r->skipped++;
+  area = ((double)b->x - a->x) * ((double)c->y - a->y) -
+         ((double)c->x - a->x) * ((double)b->y - a->y);
+  if (!(area != 0.0) || !isfinite(area)) {
+    r->culled++;
+    return 1;
+  }
+  // Screen y points down: positive is clockwise, which CCW culling keeps
+  if ((h->cull == 2 && (odd ? -area : area) < 0) || (h->cull == 3 && (odd ? -area : area) > 0)) {
+    r->culled++;
+    return 1;
+  }
+  if (area < 0) {
+    v[1] = *c;
+    v[2] = *b;
+    area = -area;
+  }
+  // Flat shading takes the colour of the vertex that finished the triangle
+  if (!((h->cmd >> 1) & 1)) {
+    for (int i = 0; i < 2; i++) {
+      memcpy(v[i].base, c->base, sizeof(c->base));
+      memcpy(v[i].offset, c->offset, sizeof(c->offset));
+    }
+  }
+
+  minx = fminf(v[0].x, fminf(v[1].x, v[2].x));
+  maxx = fmaxf(v[0].x, fmaxf(v[1].x, v[2].x));
+  miny = fminf(v[0].y, fminf(v[1].y, v[2].y));
+  maxy = fmaxf(v[0].y, fmaxf(v[1].y, v[2].y));
+  if (maxx < 0 || maxy < 0 || minx >= r->width || miny >= r->height)
+    return 1;
+  if (!grow((void **)&r->tri, &r->tri_cap, r->tri_count, sizeof(*t)))
+    return 0;
+  t = &r->tri[r->tri_count++];
+  t->x0 = (int16_t)clampi((int)floorf(minx), 0, r->width - 1);
+  t->x1 = (int16_t)clampi((int)ceilf(maxx), 0, r->width - 1);
+  t->y0 = (int16_t)clampi((int)floorf(miny), 0, r->height - 1);
+  t->y1 = (int16_t)clampi((int)ceilf(maxy), 0, r->height - 1);
+  t->hdr = hdr;
+  t->list = h->list;
+  t->object = r->objects;
+  t->index = (uint8_t)(index > 255 ? 255 : index);
+
+  for (int i = 0; i < 3; i++) {
+    const pvrraster_vert_t *p = &v[i], *q = &v[(i + 1) % 3];
+    t->ex[i] = p->x;
+    t->ey[i] = p->y;
+    t->ea[i] = -((double)q->y - p->y);
+    t->eb[i] = (double)q->x - p->x;
+    // Of two triangles sharing an edge exactly one owns it
+    t->tie[i] = t->ea[i] > 0 || (t->ea[i] == 0 && t->eb[i] > 0);
+  }
+
+  inv = 1.0 / area;
+  {
+    float z[3] = {v[0].z, v[1].z, v[2].z};
+    set_plane(t->plane[0], v, z, inv);
+  }
+  for (int k = 0; k < PVRRASTER_PLANES - 1; k++) {
+    float a3[3];
+    for (int i = 0; i < 3; i++) {
+      float val = k == 0   ? v[i].u
+                  : k == 1 ? v[i].v
+                  : k < 6  ? v[i].base[k - 2]
+                           : v[i].offset[k - 6];
+      a3[i] = val * v[i].z;
+    }
+    set_plane(t->plane[k + 1], v, a3, inv);
+  }
+
+  for (int ty = t->y0 / PVRRASTER_TILE; ty <= t->y1 / PVRRASTER_TILE; ty++) {
+    for (int tx = t->x0 / PVRRASTER_TILE; tx <= t->x1 / PVRRASTER_TILE; tx++) {
+      pvrraster_bin_t *bin = &r->bins[(ty * r->tiles_x + tx) * PVRSTREAM_LISTS + t->list];
+      if (!grow((void **)&bin->tri, &bin->cap, bin->count, sizeof(uint32_t)))
+        return 0;
+      bin->tri[bin->count++] = id;
+    }
+  }
+  return 1;
+}
+
+/* A sprite is two triangles, the fourth corner on the plane of the first three */
+static int add_sprite(pvrraster_t *r, const parse_t *ps, const pvrraster_hdr_t *h,
+                      const uint32_t *w, const float base[4], const float offset[4]) {
+  pvrraster_vert_t v[4];
+  double det, s, t;
+
+  memset(v, 0, sizeof(v));
+  for (int i = 0; i < 3; i++) {
+    v[i].x = f32(w[1 + 3 * i]);
+    v[i].y = f32(w[2 + 3 * i]);
+    v[i].z = f32(w[3 + 3 * i]);
+  }
+  v[3].x = f32(w[10]);
+  v[3].y = f32(w[11]);
+  if (h->textured) {
+    for (int i = 0; i < 3; i++)
+      uv16(w[13 + i], &v[i].u, &v[i].v);
+  }
+  for (int i = 0; i < 4; i++) {
+    memcpy(v[i].base, base, sizeof(v[i].base));
+    memcpy(v[i].offset, offset, sizeof(v[i].offset));
+  }
+  // d = a + s (b - a) + t (c - a)
+  det = ((double)v[1].x - v[0].x) * ((double)v[2].y - v[0].y) -
+        ((double)v[2].x - v[0].x) * ((double)v[1].y - v[0].y);
+  if (det == 0.0) {
+    r->culled += 2;
+    return 1;
+  }
+  s = (((double)v[3].x - v[0].x) * ((double)v[2].y - v[0].y) -
+       ((double)v[2].x - v[0].x) * ((double)v[3].y - v[0].y)) / det;
+  t = (((double)v[1].x - v[0].x) * ((double)v[3].y - v[0].y) -
+       ((double)v[3].x - v[0].x) * ((double)v[1].y - v[0].y)) / det;
+  v[3].z = (float)(v[0].z + s * (v[1].z - v[0].z) + t * (v[2].z - v[0].z));
+  if (h->textured && v[3].z != 0.0f) {
+    double uz = v[0].u * v[0].z + s * (v[1].u * v[1].z - v[0].u * v[0].z) +
+                t * (v[2].u * v[2].z - v[0].u * v[0].z);
+    double vz = v[0].v * v[0].z + s * (v[1].v * v[1].z - v[0].v * v[0].z) +
+                t * (v[2].v * v[2].z - v[0].v * v[0].z);
+    v[3].u = (float)(uz / v[3].z);
+    v[3].v = (float)(vz / v[3].z);
+  }
+  return add_tri(r, (uint32_t)ps->hdr, &v[0], &v[1], &v[2], 0, 0) &&
+         add_tri(r, (uint32_t)ps->hdr, &v[0], &v[2], &v[3], 0, 0);
+}
+
+int pvrraster_frame(pvrraster_t *r, const pvrstream_frame_t *f) {
+  const uint32_t *blk = (const uint32_t *)(f + 1);
+  float sprite_base[4] = {1, 1, 1, 1}, sprite_offset[4] = {0, 0, 0, 0};
+  parse_t ps;
+
+  r->frame = f->frame;
+  r->bg_argb = f->bg_argb;
+  r->pt_alpha_ref = f->pt_alpha_ref;
+  r->hdr_count = r->tri_count = r->objects = 0;
+  r->culled = r->skipped = 0;
+  for (int i = 0; i < r->tiles_x * r->tiles_y * PVRSTREAM_LISTS; i++)
+    r->bins[i].count = 0;
+
+  memset(&ps, 0, sizeof(ps));
+  ps.hdr = -1;
+  for (uint32_t b = 0; b < f->blocks;) {
+    const uint32_t *w = blk + b * 8;
+    uint32_t para = w[0] >> 29;
+
+    if (para == PVRSTREAM_PARA_POLY || para == PVRSTREAM_PARA_SPRITE) {
+      pvrraster_hdr_t *h;
+      int blocks = 1;
+      if (!grow((void **)&r->hdr, &r->hdr_cap, r->hdr_count, sizeof(*h)))
+        return 0;
+      h = &r->hdr[r->hdr_count];
+      decode_hdr(h, w);
+      ps.hdr = (int)r->hdr_count++;
+      ps.strip_len = 0;
+      if (para == PVRSTREAM_PARA_SPRITE) {
+        ps.kind = PVRSTREAM_SPRITE;
+        ps.vert_blocks = 2;
+        unpack_argb(w[4], sprite_base);
+        unpack_argb(w[5], sprite_offset);
+      } else if (h->list == 1 || h->list == 3) {
+        ps.kind = PVRSTREAM_MOD;
+        ps.vert_blocks = 2;
+      } else {
+        ps.kind = PVRSTREAM_POLY;
+        ps.vert_blocks = pvrstream_vert_blocks(h->cmd);
+        blocks = pvrstream_hdr_blocks(h->cmd);
+        // Intensity mode 1 keeps the face colour of the header, mode 2 the last one
+        if (((h->cmd >> 4) & 3) == 2 && b + blocks <= f->blocks) {
+          const uint32_t *fc = blocks == 2 ? w + 8 : w + 4;
+          for (int k = 0; k < 4; k++) {
+            ps.face_base[k] = clamp01(f32(fc[k]));
+            ps.face_offset[k] = blocks == 2 ? clamp01(f32(fc[4 + k])) : 0.0f;
+          }
+        }
+      }
+      b += blocks;
+    } else if (para == PVRSTREAM_PARA_VERTEX) {
+      if (b + ps.vert_blocks > f->blocks)
+        break;
+      if (ps.hdr >= 0) {
+        const pvrraster_hdr_t *h = &r->hdr[ps.hdr];
+        if (ps.kind == PVRSTREAM_SPRITE) {
+          if (!add_sprite(r, &ps, h, w, sprite_base, sprite_offset))
+            return 0;
+          r->objects++;
+        } else if (ps.kind == PVRSTREAM_MOD) {
+          pvrraster_vert_t v[3];
+          memset(v, 0, sizeof(v));
+          for (int i = 0; i < 3; i++) {
+            v[i].x = f32(w[1 + 3 * i]);
+            v[i].y = f32(w[2 + 3 * i]);
+            v[i].z = f32(w[3 + 3 * i]);
+          }
+          if (!add_tri(r, (uint32_t)ps.hdr, &v[0], &v[1], &v[2], 0, 0))
+            return 0;
+          r->objects++;
+        } else if (ps.kind == PVRSTREAM_POLY) {
+          pvrraster_vert_t v;
+          decode_vert(&ps, h, w, &v);
+          if (ps.strip_len >= 2 &&
+              !add_tri(r, (uint32_t)ps.hdr, &ps.strip[0], &ps.strip[1], &v,
+                       (ps.strip_len - 2) & 1, (int)ps.strip_len - 2))
+            return 0;
+          ps.strip[0] = ps.strip[1];
+          ps.strip[1] = v;
+          ps.strip_len++;
+          if (w[0] & PVRSTREAM_EOL) {
+            ps.strip_len = 0;
+            r->objects++;
+          }
+        }
+      }
+      b += ps.vert_blocks;
+    } else {
+      if (para == PVRSTREAM_PARA_END) {
+        ps.hdr = -1;
+        ps.kind = PVRSTREAM_NONE;
+      }
+      b++;
+    }
+  }
+  return 1;
+}
+
+/* Textures */
+
+/* Bytes (VQ: index bytes) from the start of the data to the size x size level */
+static uint32_t mip_offset(const pvrraster_hdr_t *h, uint32_t size) {
+  uint32_t off;
+  if (!h->mipmap)
+    return 0;
+  if (h->vq) {
+    off = 0;
+    for (uint32_t m = 1; m < size; m <<= 1)
+      off += m == 1 ? 1 : (m / 2) * (m / 2);
+    return off;
+  }
+  off = h->format == 5 ? 1 : h->format == 6 ? 3 : 6;
+  for (uint32_t m = 1; m < size; m <<= 1)
+    off += h->format == 5 ? (m * m + 1) / 2 : h->format == 6 ? m * m : m * m * 2;
+  return off;
+}
+
+static uint32_t argb16(int format, uint32_t t) {
+  uint32_t a, r, g, b;
+  switch (format) {
+  case 0: // ARGB1555
+    a = t & 0x8000 ? 0xff : 0;
+    r = (t >> 10) & 31, g = (t >> 5) & 31, b = t & 31;
+    return a << 24 | (r << 3 | r >> 2) << 16 | (g << 3 | g >> 2) << 8 | (b << 3 | b >> 2);
+  case 1: // RGB565
+    r = (t >> 11) & 31, g = (t >> 5) & 63, b = t & 31;
+    return 0xff000000 | (r << 3 | r >> 2) << 16 | (g << 2 | g >> 4) << 8 | (b << 3 | b >> 2);
+  case 2: // ARGB4444
+    a = (t >> 12) & 15, r = (t >> 8) & 15, g = (t >> 4) & 15, b = t & 15;
+    return (a * 17) << 24 | (r * 17) << 16 | (g * 17) << 8 | b * 17;
+  default: // YUV422 and bump maps are not drawn
+    return 0xff808080;
+  }
+}
+
+static uint32_t pal_entry(const pvrraster_t *r, uint32_t i) {
+  uint32_t e = r->pal[i & 1023];
+  return r->pal_format == 3 ? e : argb16(r->pal_format == 1 ? 1 : r->pal_format == 2 ? 2 : 0, e);
+}
+
+static inline uint32_t rd16(const pvrraster_t *r, uint32_t a) {
+  return r->vram[a & VRAM_MASK] | r->vram[(a + 1) & VRAM_MASK] << 8;
+}
+
+/* x, y already inside the lw x lh level */
+static uint32_t texel(const pvrraster_t *r, const pvrraster_hdr_t *h, uint32_t lw, uint32_t lh,
+                      uint32_t x, uint32_t y) {
+  uint32_t i;
+  if (h->vq) {
+    // 2x2 blocks of 16 bit texels from a 256 entry codebook ahead of the indices
+    uint32_t bw = lw > 1 ? lw / 2 : 1, bh = lh > 1 ? lh / 2 : 1;
+    uint32_t code = r->vram[(h->addr + 2048 + mip_offset(h, lw) +
+                             twiddle(x / 2, y / 2, bw, bh)) & VRAM_MASK];
+    return argb16(h->format, rd16(r, h->addr + code * 8 + ((x & 1) * 2 + (y & 1)) * 2));
+  }
+  i = h->twiddled ? twiddle(x, y, lw, lh) : y * lw + x;
+  switch (h->format) {
+  case 5: {
+    uint8_t p = r->vram[(h->addr + mip_offset(h, lw) + i / 2) & VRAM_MASK];
+    return pal_entry(r, h->pal + (i & 1 ? p >> 4 : p & 15));
+  }
+  case 6:
+    return pal_entry(r, h->pal + r->vram[(h->addr + mip_offset(h, lw) + i) & VRAM_MASK]);
+  default:
+    return argb16(h->format, rd16(r, h->addr + mip_offset(h, lw) + i * 2));
+  }
+}
+
+static inline uint32_t address(int x, uint32_t n, int clamp, int flip) {
+  if (clamp)
+    return (uint32_t)clampi(x, 0, (int)n - 1);
+  if (flip) {
+    uint32_t m = (uint32_t)x & (2 * n - 1);
+    return m < n ? m : 2 * n - 1 - m;
+  }
+  return (uint32_t)x & (n - 1);
+}
+
+static void sample(const pvrraster_t *r, const pvrraster_hdr_t *h, float u, float v, float lod,
+                   float out[4]) {
+  uint32_t lw = h->w, lh = h->h;
+  float fu, fv;
+
+  if (h->mipmap) {
+    int level = (int)floorf(lod + h->bias + 0.5f), top = 0;
+    while ((1u << (top + 1)) <= lw)
+      top++;
+    level = clampi(level, 0, top);
+    lw >>= level;
+    lh >>= level;
+  }
+  fu = u * lw;
+  fv = v * lh;
+  if (h->filter == 0) {
+    uint32_t c = texel(r, h, lw, lh, address((int)floorf(fu), lw, h->clamp_u, h->flip_u),
+                       address((int)floorf(fv), lh, h->clamp_v, h->flip_v));
+    unpack_argb(c, out);
+  } else {
+    int x0 = (int)floorf(fu - 0.5f), y0 = (int)floorf(fv - 0.5f);
+    float fx = fu - 0.5f - x0, fy = fv - 0.5f - y0;
+    float c[4][4];
+    for (int i = 0; i < 4; i++) {
+      uint32_t x = address(x0 + (i & 1), lw, h->clamp_u, h->flip_u);
+      uint32_t y = address(y0 + (i >> 1), lh, h->clamp_v, h->flip_v);
+      unpack_argb(texel(r, h, lw, lh, x, y), c[i]);
+    }
+    for (int k = 0; k < 4; k++)
+      out[k] = (c[0][k] * (1 - fx) + c[1][k] * fx) * (1 - fy) +
+               (c[2][k] * (1 - fx) + c[3][k] * fx) * fy;
+  }
+}
+
+/* Tiles */
+
+static inline float plane_at(const float p[3], float x, float y) {
+  return p[0] * x + p[1] * y + p[2];
+}
+
+static inline int inside(const pvrraster_tri_t *t, double x, double y) {
+  for (int i = 0; i < 3; i++) {
+    double e = t->ea[i] * (x - t->ex[i]) + t->eb[i] * (y - t->ey[i]);
+    if (e < 0 || (e == 0 && !t->tie[i]))
+      return 0;
+  }
+  return 1;
+}
+
+static inline int depth_pass(int compare, float z, float d) {
+  switch (compare) {
+  case 0:
+    return 0;
+  case 1:
+    return z < d;
+  case 2:
+    return z == d;
+  case 3:
+    return z <= d;
+  case 4:
+    return z > d;
+  case 5:
+    return z != d;
+  case 6:
+    return z >= d;
+  default:
+    return 1;
+  }
+}
+
+/* The colour of a triangle at a pixel centre, a r g b */
+static void shade(const pvrraster_t *r, const pvrraster_tri_t *t, float x, float y,
+                  float out[4]) {
+  const pvrraster_hdr_t *h = &r->hdr[t->hdr];
+  float z = plane_at(t->plane[0], x, y), inv = z != 0.0f ? 1.0f / z : 0.0f;
+  float base[4], offs[4];
+
+  for (int k = 0; k < 4; k++) {
+    base[k] = clamp01(plane_at(t->plane[3 + k], x, y) * inv);
+    offs[k] = clamp01(plane_at(t->plane[7 + k], x, y) * inv);
+  }
+  if (h->textured) {
+    float u = plane_at(t->plane[1], x, y) * inv, v = plane_at(t->plane[2], x, y) * inv;
+    float lod = 0.0f, tex[4];
+    if (h->mipmap) {
+      // Texels per pixel, from the screen derivatives of u and v
+      float dudx = (t->plane[1][0] - u * t->plane[0][0]) * inv * h->w;
+      float dvdx = (t->plane[2][0] - v * t->plane[0][0]) * inv * h->h;
+      float dudy = (t->plane[1][1] - u * t->plane[0][1]) * inv * h->w;
+      float dvdy = (t->plane[2][1] - v * t->plane[0][1]) * inv * h->h;
+      float rho = fmaxf(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+      lod = rho > 0.0f ? 0.5f * log2f(rho) : 0.0f;
+    }
+    sample(r, h, u, v, lod, tex);
+    if (!h->txr_alpha)
+      tex[0] = 1.0f;
+    switch (h->env) {
+    case 0: // replace
+      memcpy(out, tex, sizeof(tex));
+      break;
+    case 1: // modulate
+      out[0] = tex[0];
+      for (int k = 1; k < 4; k++)
+        out[k] = tex[k] * base[k];
+      break;
+    case 2: // decal
+      out[0] = base[0];
+      for (int k = 1; k < 4; k++)
+        out[k] = tex[k] * tex[0] + base[k] * (1.0f - tex[0]);
+      break;
+    default: // modulate alpha
+      for (int k = 0; k < 4; k++)
+        out[k] = tex[k] * base[k];
+      break;
+    }
+    if (h->offset) {
+      for (int k = 1; k < 4; k++)
+        out[k] = clamp01(out[k] + offs[k]);
+    }
+  } else {
+    memcpy(out, base, sizeof(base));
+  }
+  if (!h->use_alpha)
+    out[0] = 1.0f;
+}
+
+/* Factor 2 and 3 are the other side's colour: the destination for the source
+   factor, the source for the destination factor */
+static void factor(int f, const float src[4], const float dst[4], const float other[4],
+                   float out[4]) {
+  float a;
+  switch (f) {
+  case 2:
+  case 3:
+    for (int k = 0; k < 4; k++)
+      out[k] = f == 2 ? other[k] : 1.0f - other[k];
+    return;
+  case 0:
+    a = 0.0f;
+    break;
+  case 1:
+    a = 1.0f;
+    break;
+  case 4:
+    a = src[0];
+    break;
+  case 5:
+    a = 1.0f - src[0];
+    break;
+  case 6:
+    a = dst[0];
+    break;
+  default:
+    a = 1.0f - dst[0];
+    break;
+  }
+  out[0] = out[1] = out[2] = out[3] = a;
+}
+
+static void blend(const pvrraster_hdr_t *h, const float src[4], float dst[4]) {
+  float sf[4], df[4];
+  factor(h->src, src, dst, dst, sf);
+  factor(h->dst, src, dst, src, df);
+  for (int k = 0; k < 4; k++)
+    dst[k] = clamp01(src[k] * sf[k] + dst[k] * df[k]);
+}
+
+typedef struct {
+  uint32_t tri;
+  uint16_t pixel;
+  float z;
+} frag_t;
+
+typedef struct {
+  float col[PVRRASTER_TILE * PVRRASTER_TILE][4];
+  float depth[PVRRASTER_TILE * PVRRASTER_TILE];
+  int32_t winner[PVRRASTER_TILE * PVRRASTER_TILE];
+  uint16_t isp[PVRRASTER_TILE * PVRRASTER_TILE];  /* triangles depth tested */
+  uint16_t tsp[PVRRASTER_TILE * PVRRASTER_TILE];  /* and shaded */
+  frag_t *frag;
+  uint32_t frag_count, frag_cap;
+} tile_t;
+
+/* Far to near per pixel, in the order sent where they are level */
+static int frag_cmp(const void *a, const void *b) {
+  const frag_t *fa = a, *fb = b;
+  if (fa->pixel != fb->pixel)
+    return fa->pixel < fb->pixel ? -1 : 1;
+  if (fa->z != fb->z)
+    return fa->z < fb->z ? -1 : 1;
+  return fa->tri < fb->tri ? -1 : fa->tri > fb->tri;
+}
+
+/* The part of a triangle's bounds inside the tile at x0, y0 */
+static inline int clip_bounds(const pvrraster_tri_t *t, int x0, int y0, int *xs, int *xe,
+                              int *ys, int *ye) {
+  *xs = t->x0 > x0 ? t->x0 : x0;
+  *xe = t->x1 < x0 + PVRRASTER_TILE - 1 ? t->x1 : x0 + PVRRASTER_TILE - 1;
+  *ys = t->y0 > y0 ? t->y0 : y0;
+  *ye = t->y1 < y0 + PVRRASTER_TILE - 1 ? t->y1 : y0 + PVRRASTER_TILE - 1;
+  return *xs <= *xe && *ys <= *ye;
+}
+
+/* What pvrraster_overdraw() draws for 0 to 8 or more shaded layers */
+static const uint8_t heat[9][3] = {
+    {0, 0, 0},     {0, 0, 128},   {0, 64, 255}, {0, 192, 192}, {0, 192, 0},
+    {224, 224, 0}, {255, 128, 0}, {255, 0, 0},  {255, 255, 255}};
+
+static void render_tile(const pvrraster_t *r, tile_t *tb, int tx, int ty, uint8_t *rgb,
+                        uint16_t *layers) {
+  const int x0 = tx * PVRRASTER_TILE, y0 = ty * PVRRASTER_TILE;
+  const pvrraster_bin_t *op = pvrraster_bin(r, tx, ty, LIST_OP);
+  const pvrraster_bin_t *tr = pvrraster_bin(r, tx, ty, LIST_TR);
+  const pvrraster_bin_t *pt = pvrraster_bin(r, tx, ty, LIST_PT);
+  int xs, xe, ys, ye, scale = r->width / PVRRASTER_W;
+  float bg[4];
+
+  unpack_argb(r->bg_argb | 0xff000000, bg);
+  for (int p = 0; p < PVRRASTER_TILE * PVRRASTER_TILE; p++) {
+    memcpy(tb->col[p], bg, sizeof(bg));
+    tb->depth[p] = 0.0f;
+    tb->winner[p] = -1;
+    tb->isp[p] = tb->tsp[p] = 0;
+  }
+
+  // Opaque: which triangle is in front first, then one shade per pixel
+  for (uint32_t i = 0; i < op->count; i++) {
+    const pvrraster_tri_t *t = &r->tri[op->tri[i]];
+    const pvrraster_hdr_t *h = &r->hdr[t->hdr];
+    if (!clip_bounds(t, x0, y0, &xs, &xe, &ys, &ye))
+      continue;
+    for (int y = ys; y <= ye; y++) {
+      for (int x = xs; x <= xe; x++) {
+        int p = (y - y0) * PVRRASTER_TILE + (x - x0);
+        float z;
+        if (!inside(t, x + 0.5, y + 0.5))
+          continue;
+        tb->isp[p]++;
+        z = plane_at(t->plane[0], x + 0.5f, y + 0.5f);
+        if (!depth_pass(h->compare, z, tb->depth[p]))
+          continue;
+        if (h->zwrite)
+          tb->depth[p] = z;
+        tb->winner[p] = (int32_t)op->tri[i];
+      }
+    }
+  }
+  for (int p = 0; p < PVRRASTER_TILE * PVRRASTER_TILE; p++) {
+    float src[4];
+    if (tb->winner[p] < 0)
+      continue;
+    tb->tsp[p]++;
+    shade(r, &r->tri[tb->winner[p]], x0 + (p % PVRRASTER_TILE) + 0.5f,
+          y0 + (p / PVRRASTER_TILE) + 0.5f, src);
+    // The opaque list ignores the blend factors
+    memcpy(tb->col[p], src, sizeof(src));
+  }
+
+  // Punch-through: after the opaque list, in the order sent. Each pixel is
+  // shaded to get its alpha, under the reference it leaves colour and depth
+  for (uint32_t i = 0; i < pt->count; i++) {
+    const pvrraster_tri_t *t = &r->tri[pt->tri[i]];
+    const pvrraster_hdr_t *h = &r->hdr[t->hdr];
+    if (!clip_bounds(t, x0, y0, &xs, &xe, &ys, &ye))
+      continue;
+    for (int y = ys; y <= ye; y++) {
+      for (int x = xs; x <= xe; x++) {
+        int p = (y - y0) * PVRRASTER_TILE + (x - x0);
+        float z, src[4];
+        if (!inside(t, x + 0.5, y + 0.5))
+          continue;
+        tb->isp[p]++;
+        z = plane_at(t->plane[0], x + 0.5f, y + 0.5f);
+        if (!depth_pass(h->compare, z, tb->depth[p]))
+          continue;
+        shade(r, t, x + 0.5f, y + 0.5f, src);
+        if ((uint32_t)(src[0] * 255.0f + 0.5f) < r->pt_alpha_ref)
+          continue;
+        tb->tsp[p]++;
+        if (h->zwrite)
+          tb->depth[p] = z;
+        memcpy(tb->col[p], src, sizeof(src));
+      }
+    }
+  }
+
+  // Translucent: autosort tests against the opaque depth and blends far to
+  // near, level with the opaque surface still counts as in front
+  tb->frag_count = 0;
+  for (uint32_t i = 0; i < tr->count; i++) {
+    const pvrraster_tri_t *t = &r->tri[tr->tri[i]];
+    const pvrraster_hdr_t *h = &r->hdr[t->hdr];
+    if (!clip_bounds(t, x0, y0, &xs, &xe, &ys, &ye))
+      continue;
+    for (int y = ys; y <= ye; y++) {
+      for (int x = xs; x <= xe; x++) {
+        int p = (y - y0) * PVRRASTER_TILE + (x - x0);
+        float z, src[4];
+        if (!inside(t, x + 0.5, y + 0.5))
+          continue;
+        tb->isp[p]++;
+        z = plane_at(t->plane[0], x + 0.5f, y + 0.5f);
+        if (r->autosort) {
+          if (z < tb->depth[p] ||
+              !grow((void **)&tb->frag, &tb->frag_cap, tb->frag_count, sizeof(frag_t)))
+            continue;
+          tb->frag[tb->frag_count++] = (frag_t){tr->tri[i], (uint16_t)p, z};
+          continue;
+        }
+        if (!depth_pass(h->compare, z, tb->depth[p]))
+          continue;
+        if (h->zwrite)
+          tb->depth[p] = z;
+        tb->tsp[p]++;
+        shade(r, t, x + 0.5f, y + 0.5f, src);
+        blend(h, src, tb->col[p]);
+      }
+    }
+  }
+  if (tb->frag_count) {
+    qsort(tb->frag, tb->frag_count, sizeof(frag_t), frag_cmp);
+    for (uint32_t i = 0; i < tb->frag_count; i++) {
+      const frag_t *fr = &tb->frag[i];
+      const pvrraster_tri_t *t = &r->tri[fr->tri];
+      float src[4];
+      tb->tsp[fr->pixel]++;
+      shade(r, t, x0 + (fr->pixel % PVRRASTER_TILE) + 0.5f,
+            y0 + (fr->pixel / PVRRASTER_TILE) + 0.5f, src);
+      blend(&r->hdr[t->hdr], src, tb->col[fr->pixel]);
+    }
+  }
+
+  // Out, FSAA averages each pair of columns. An overdraw heatmap takes the
+  // colour from the number of layers shaded instead.
+  if (layers) {
+    for (int y = 0; y < PVRRASTER_TILE; y++) {
+      uint16_t *l = layers + ((y0 + y) * r->width + x0) * 2;
+      for (int x = 0; x < PVRRASTER_TILE; x++) {
+        l[x * 2] = tb->isp[y * PVRRASTER_TILE + x];
+        l[x * 2 + 1] = tb->tsp[y * PVRRASTER_TILE + x];
+      }
+    }
+    for (int y = 0; y < PVRRASTER_TILE; y++) {
+      for (int x = 0; x < PVRRASTER_TILE; x += scale) {
+        uint8_t *o = rgb + ((y0 + y) * PVRRASTER_W + (x0 + x) / scale) * 3;
+        for (int k = 0; k < 3; k++) {
+          int c = 0;
+          for (int s = 0; s < scale; s++) {
+            int n = tb->tsp[y * PVRRASTER_TILE + x + s];
+            c += heat[n < 8 ? n : 8][k];
+          }
+          o[k] = (uint8_t)(c / scale);
+        }
+      }
+    }
+    return;
+  }
+  for (int y = 0; y < PVRRASTER_TILE; y++) {
+    for (int x = 0; x < PVRRASTER_TILE; x += scale) {
+      uint8_t *o = rgb + ((y0 + y) * PVRRASTER_W + (x0 + x) / scale) * 3;
+      for (int k = 1; k < 4; k++) {
+        float c = 0.0f;
+        for (int s = 0; s < scale; s++)
+          c += tb->col[y * PVRRASTER_TILE + x + s][k];
+        o[k - 1] = (uint8_t)(c / scale * 255.0f + 0.5f);
+      }
+    }
+  }
+}
+
+typedef struct {
+  const pvrraster_t *r;
+  uint8_t *rgb;
+  uint16_t *layers;
+  pthread_mutex_t lock;
+  int next;
+} job_t;
+
+static void *worker(void *arg) {
+  job_t *job = arg;
+  tile_t *tb = calloc(1, sizeof(*tb));
+  int tiles = job->r->tiles_x * job->r->tiles_y;
+
+  if (tb == NULL)
+    return NULL;
+  for (;;) {
+    int n;
+    pthread_mutex_lock(&job->lock);
+    n = job->next++;
+    pthread_mutex_unlock(&job->lock);
+    if (n >= tiles)
+      break;
+    render_tile(job->r, tb, n % job->r->tiles_x, n / job->r->tiles_x, job->rgb, job->layers);
+  }
+  free(tb->frag);
+  free(tb);
+  return NULL;
+}
+
+static void run(const pvrraster_t *r, int threads, uint8_t *rgb, uint16_t *layers) {
+  job_t job = {r, rgb, layers, PTHREAD_MUTEX_INITIALIZER, 0};
+  pthread_t th[64];
+  int started = 0;
+
+  if (threads > 64)
+    threads = 64;
+  while (started < threads - 1 && pthread_create(&th[started], NULL, worker, &job) == 0)
+    started++;
+  worker(&job);
+  for (int i = 0; i < started; i++)
+    pthread_join(th[i], NULL);
+}
+
+void pvrraster_render(const pvrraster_t *r, int threads, uint8_t *rgb) {
+  run(r, threads, rgb, NULL);
+}
+
+void pvrraster_overdraw(const pvrraster_t *r, int threads, uint16_t *layers, uint8_t *rgb) {
+  run(r, threads, rgb, layers);
+}
@@ -0,0 +1,146 @@
+/* Reference rasterizer for recorded PVR streams (pvrstream.h).
+
+   Draws a frame's blocks the way the PVR does, closely enough that two
+   streams which should look the same give the same image. The screen is
+   cut into 32x32 tiles and each tile gets the triangles whose bounding box
+   touches it, per list, in the order they were sent. A tile resolves its
+   opaque triangles to one per pixel before anything is shaded, like the
+   ISP does, and sorts the translucent ones per pixel, far to near, when
+   the stream was recorded with autosort on. Tiles are independent, so
+   pvrraster_render() hands them out to threads.
+
+   Covered: the OP, PT and TR lists; polygons with packed, floating or
+   intensity colour and 32 or 16 bit UVs, and sprites; flat and Gouraud
+   shading; culling; every depth compare; ARGB1555, RGB565 and ARGB4444,
+   PAL4, PAL8 and VQ textures, twiddled or not, with mipmaps; point and
+   bilinear filtering; wrap, clamp and flip; the four texture shading
+   modes and the offset (specular) colour; all blend factors.
+
+   Punch-through triangles are drawn after the opaque ones in the order
+   sent, a pixel whose shaded alpha is under the frame's PVR_PT_ALPHA_REF
+   left as it was.
+
+   Binned but not drawn: modifier volumes.
+   Also left out: user clipping, fog, YUV and bump textures, trilinear
+   filtering (drawn bilinear) and the secondary accumulation buffer. */
+#ifndef HOST_PVRRASTER_H
+#define HOST_PVRRASTER_H
+
+#include <stdint.h>
+#include "pvrstream.h"
+
+#define PVRRASTER_W    640
+#define PVRRASTER_H    480
+#define PVRRASTER_TILE 32
+
+/* A header as the tiles need it, decoded once */
+typedef struct {
+  uint32_t cmd, mode1, mode2, mode3;
+  uint8_t list;
+  uint8_t compare, zwrite, cull;
+  uint8_t src, dst;                /* blend factors */
+  uint8_t use_alpha, txr_alpha;    /* vertex alpha used, texture alpha used */
+  uint8_t textured, offset, env;   /* env: PVR_TXRENV_* */
+  uint8_t filter;                  /* 0 point, else bilinear */
+  uint8_t clamp_u, clamp_v, flip_u, flip_v;
+  uint8_t format, vq, twiddled, mipmap;
+  uint16_t w, h;
+  float bias;                      /* mipmap level bias */
+  uint32_t addr;                   /* texture offset in texture memory */
+  uint32_t pal;                    /* first palette entry, PAL4 and PAL8 */
+} pvrraster_hdr_t;
+
+typedef struct {
+  float x, y, z;                   /* z is 1/w, larger is nearer */
+  float u, v;
+  float base[4], offset[4];        /* a, r, g, b, 0 to 1 */
+} pvrraster_vert_t;
+
+/* z, then u, v, base and offset, each times z: value at 0,0 and steps in x and y */
+#define PVRRASTER_PLANES 11
+
+typedef struct {
+  double ex[3], ey[3];             /* edge start */
+  double ea[3], eb[3];             /* inside where ea * (x - ex) + eb * (y - ey) > 0 */
+  uint8_t tie[3];                  /* edge owns the pixels exactly on it */
+  uint8_t list;
+  uint8_t index;                   /* triangle number within its strip, 0 for sprites */
+  int16_t x0, y0, x1, y1;          /* pixel bounds, inclusive */
+  uint32_t hdr;
+  uint32_t object;                 /* strip or sprite it came from, numbered per frame */
+  float plane[PVRRASTER_PLANES][3];
+} pvrraster_tri_t;
+
+typedef struct {
+  uint32_t *tri;
+  uint32_t count, cap;
+} pvrraster_bin_t;
+
+typedef struct {
+  int width, height;               /* 1280 x 480 with FSAA */
+  int tiles_x, tiles_y;
+  int autosort;
+  uint8_t *vram;                   /* PVRSTREAM_VRAM bytes */
+  uint32_t pal[1024];
+  uint32_t pal_format;
+  // The frame set up by pvrraster_frame()
+  uint32_t frame, bg_argb, pt_alpha_ref;
+  pvrraster_hdr_t *hdr;
+  uint32_t hdr_count, hdr_cap;
+  pvrraster_tri_t *tri;
+  uint32_t tri_count, tri_cap;
+  uint32_t objects;
+  pvrraster_bin_t *bins;           /* per tile, then per list */
+  uint32_t culled;                 /* backfaces and degenerate triangles */
+  uint32_t skipped;                /* modifier volume triangles */
+} pvrraster_t;
+
+/**
+ * @brief Set up for the frames of one stream
+ *
+ * @param init The stream's INIT chunk, for FSAA and autosort
+ * @return int 1, 0 when out of memory
+ */
+int pvrraster_init(pvrraster_t *r, const pvrstream_init_t *init);
+void pvrraster_free(pvrraster_t *r);
+
+/* Apply a VRAM or PAL chunk, anything else is ignored */
+void pvrraster_apply(pvrraster_t *r, const pvrstream_chunk_t *chunk, const void *data);
+
+/**
+ * @brief Turn a FRAM chunk into binned triangles
+ *
+ * @param f The chunk, its blocks right after it
+ * @return int 1, 0 when out of memory
+ */
+int pvrraster_frame(pvrraster_t *r, const pvrstream_frame_t *f);
+
+/* The bin of one tile and list */
+static inline const pvrraster_bin_t *pvrraster_bin(const pvrraster_t *r, int tx, int ty,
+                                                   int list) {
+  return &r->bins[(ty * r->tiles_x + tx) * PVRSTREAM_LISTS + list];
+}
+
+/**
+ * @brief Draw the frame set up last
+ *
+ * @param threads Threads to share the tiles between
+ * @param rgb PVRRASTER_W x PVRRASTER_H x 3 bytes out, FSAA is filtered down
+ */
+void pvrraster_render(const pvrraster_t *r, int threads, uint8_t *rgb);
+
+/**
+ * @brief Draw the frame set up last as an overdraw heatmap
+ *
+ * Renders as pvrraster_render() does but swaps every triangle's colour for
+ * one more layer, counting per pixel the triangles the ISP depth tested and
+ * the ones the TSP went on to shade: for the opaque list only the one in
+ * front, for the translucent list every one not hidden. rgb gets the shaded
+ * layers, dark blue for one through red for seven, white past that.
+ *
+ * @param layers r->width x r->height pairs out, tested then shaded
+ * @param rgb As for pvrraster_render()
+ */
+void pvrraster_overdraw(const pvrraster_t *r, int threads, uint16_t *layers, uint8_t *rgb);
+
+#endif
@@ -0,0 +1,306 @@
+/* Recorded PVR streams: the file host/pvr.c writes and the tools that read it.
+
+   A stream is everything a frame needs besides the CPU: the 32 byte blocks
+   handed to the TA, in the order they were sent, and the texture memory
+   and palette they refer to. The file is a 32 byte header and then chunks,
+   each an 8 byte id and size followed by the payload:
+
+     INIT  pvr_init() parameters, once at the start
+     MEM   a pvr_mem_malloc() or pvr_mem_free()
+     VRAM  bytes written to texture memory at an offset, pvr_txr_load()
+     PAL   the palette format and all 1024 entries, when changed
+     FRAM  one frame: header and the blocks of all its lists
+
+   A reader keeps an 8MB texture memory image and a palette, applies the
+   chunks in order and has what every frame drew with when it gets to it.
+
+   pvrstream_feed() sorts the blocks out the way the TA does: the top bits
+   of the first word give the parameter type, the last header says how
+   long the vertices after it are. */
+#ifndef HOST_PVRSTREAM_H
+#define HOST_PVRSTREAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PVRSTREAM_FOURCC  "DCTA"
+#define PVRSTREAM_VERSION 1
+#define PVRSTREAM_LISTS   5        /* OP, OP_MOD, TR, TR_MOD, PT */
+#define PVRSTREAM_VRAM    (8 << 20)
+
+typedef struct {
+  char fourcc[4];
+  uint32_t version;
+  uint32_t pad[6];
+} pvrstream_hdr_t;
+
+typedef struct {
+  char id[4];
+  uint32_t size;                   /* payload bytes after this */
+} pvrstream_chunk_t;
+
+/* INIT */
+typedef struct {
+  uint32_t opb_sizes[PVRSTREAM_LISTS]; /* PVR_BINSIZE_* */
+  uint32_t vertex_buf_size;
+  uint32_t dma_enabled;
+  uint32_t fsaa_enabled;
+  uint32_t autosort_disabled;
+  uint32_t opb_overflow_count;
+} pvrstream_init_t;
+
+/* MEM */
+typedef struct {
+  uint32_t offset, size;
+  uint32_t alloc;                  /* 1 pvr_mem_malloc(), 0 pvr_mem_free() */
+} pvrstream_mem_t;
+
+/* VRAM: this, then size - 4 bytes to copy to offset */
+typedef struct {
+  uint32_t offset;
+} pvrstream_vram_t;
+
+/* PAL: this, then 1024 entries */
+typedef struct {
+  uint32_t format;                 /* PVR_PAL_* */
+} pvrstream_pal_t;
+
+/* FRAM: this, then blocks * 32 bytes */
+typedef struct {
+  uint32_t frame;
+  uint32_t bg_argb;
+  uint32_t blocks;
+  uint32_t pt_alpha_ref;           /* PVR_PT_ALPHA_REF, 0 lets every texel through */
+} pvrstream_frame_t;
+
+/* Parameter types, the top three bits of a block's first word */
+#define PVRSTREAM_PARA_END    0
+#define PVRSTREAM_PARA_CLIP   1
+#define PVRSTREAM_PARA_POLY   4    /* or a modifier volume */
+#define PVRSTREAM_PARA_SPRITE 5
+#define PVRSTREAM_PARA_VERTEX 7
+#define PVRSTREAM_EOL         (1u << 28)
+
+typedef struct {
+  uint64_t blocks;                 /* 32 bytes each */
+  uint64_t headers;                /* polygon, sprite and modifier headers */
+  uint64_t strips;                 /* polygon strips, one per end of strip */
+  uint64_t verts;                  /* polygon vertices */
+  uint64_t tris;                   /* polygon triangles */
+  uint64_t sprites;
+  uint64_t mod_tris;               /* modifier volume triangles */
+} pvrstream_list_t;
+
+typedef struct {
+  uint32_t frames;
+  pvrstream_list_t list[PVRSTREAM_LISTS];
+  uint64_t loose;                  /* blocks outside any list */
+  uint32_t allocs, frees;
+  uint32_t vram_used, vram_peak;   /* bytes allocated */
+  uint64_t uploaded;               /* bytes written to texture memory */
+} pvrstream_stats_t;
+
+typedef enum {
+  PVRSTREAM_NONE,                  /* no header since the end of a list */
+  PVRSTREAM_POLY,
+  PVRSTREAM_SPRITE,
+  PVRSTREAM_MOD
+} pvrstream_kind_t;
+
+typedef struct {
+  int list;                        /* of the last header, -1 for none */
+  pvrstream_kind_t kind;
+  int vert_blocks;                 /* per vertex after the last header */
+  int skip;                        /* blocks left of the parameter being read */
+  uint32_t strip_len;
+} pvrstream_parser_t;
+
+static inline void pvrstream_parser_init(pvrstream_parser_t *p) {
+  memset(p, 0, sizeof(*p));
+  p->list = -1;
+}
+
+/* Polygon header words, cmd */
+static inline int pvrstream_textured(uint32_t cmd) { return (cmd >> 3) & 1; }
+static inline int pvrstream_col_type(uint32_t cmd) { return (cmd >> 4) & 3; }
+static inline int pvrstream_two_volume(uint32_t cmd) { return (cmd >> 6) & 1; }
+
+/* A polygon header is 64 bytes for the intensity formats with an offset
+   colour, and the vertices are 64 bytes for floating colour or two
+   volumes with a texture */
+static inline int pvrstream_hdr_blocks(uint32_t cmd) {
+  if (pvrstream_col_type(cmd) == 2 && pvrstream_textured(cmd) &&
+      ((cmd >> 2) & 1 || pvrstream_two_volume(cmd)))
+    return 2;
+  return 1;
+}
+
+static inline int pvrstream_vert_blocks(uint32_t cmd) {
+  if (!pvrstream_textured(cmd))
+    return 1;
+  return pvrstream_col_type(cmd) == 1 || pvrstream_two_volume(cmd) ? 2 : 1;
+}
+
+/**
+ * @brief Count one 32 byte block
+ *
+ * @return int What the block starts: PVRSTREAM_PARA_*, or -1 for the
+ *             second half of a 64 byte parameter
+ */
+static inline int pvrstream_feed(pvrstream_parser_t *p, const void *blk,
+                                 pvrstream_stats_t *st) {
+  uint32_t cmd = *(const uint32_t *)blk;
+  pvrstream_list_t *l = p->list >= 0 ? &st->list[p->list] : NULL;
+  int para;
+
+  if (p->skip) {
+    p->skip--;
+    if (l)
+      l->blocks++;
+    else
+      st->loose++;
+    return -1;
+  }
+  para = cmd >> 29;
+  switch (para) {
+  case PVRSTREAM_PARA_POLY:
+  case PVRSTREAM_PARA_SPRITE:
+    p->list = (cmd >> 24) & 7;
+    if (p->list >= PVRSTREAM_LISTS)
+      p->list = PVRSTREAM_LISTS - 1;
+    l = &st->list[p->list];
+    l->headers++;
+    p->strip_len = 0;
+    if (para == PVRSTREAM_PARA_SPRITE) {
+      p->kind = PVRSTREAM_SPRITE;
+      p->vert_blocks = 2;
+    } else if (p->list == 1 || p->list == 3) {
+      p->kind = PVRSTREAM_MOD;
+      p->vert_blocks = 2;
+    } else {
+      p->kind = PVRSTREAM_POLY;
+      p->vert_blocks = pvrstream_vert_blocks(cmd);
+      p->skip = pvrstream_hdr_blocks(cmd) - 1;
+    }
+    break;
+  case PVRSTREAM_PARA_VERTEX:
+    p->skip = p->vert_blocks - 1;
+    if (l == NULL)
+      break;
+    if (p->kind == PVRSTREAM_SPRITE) {
+      l->sprites++;
+    } else if (p->kind == PVRSTREAM_MOD) {
+      l->mod_tris++;
+    } else if (p->kind == PVRSTREAM_POLY) {
+      l->verts++;
+      p->strip_len++;
+      if (cmd & PVRSTREAM_EOL) {
+        l->strips++;
+        if (p->strip_len >= 3)
+          l->tris += p->strip_len - 2;
+        p->strip_len = 0;
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  if (l)
+    l->blocks++;
+  else
+    st->loose++;
+  if (para == PVRSTREAM_PARA_END) {
+    p->list = -1;
+    p->kind = PVRSTREAM_NONE;
+  }
+  return para;
+}
+
+/* Totals and per frame averages, what the host backend prints at shutdown */
+static inline void pvrstream_print_stats(FILE *out, const pvrstream_stats_t *st) {
+  static const char *names[PVRSTREAM_LISTS] = {"OP", "OP_MOD", "TR", "TR_MOD", "PT"};
+  uint32_t n = st->frames ? st->frames : 1;
+
+  fprintf(out, "%u frames, per frame:\n", (unsigned)st->frames);
+  fprintf(out, "  list      bytes  headers   strips    verts     tris  sprites  mod_tris\n");
+  for (int i = 0; i < PVRSTREAM_LISTS; i++) {
+    const pvrstream_list_t *l = &st->list[i];
+    if (l->blocks == 0)
+      continue;
+    fprintf(out, "  %-6s %8llu %8llu %8llu %8llu %8llu %8llu %9llu\n", names[i],
+            (unsigned long long)(l->blocks * 32 / n), (unsigned long long)(l->headers / n),
+            (unsigned long long)(l->strips / n), (unsigned long long)(l->verts / n),
+            (unsigned long long)(l->tris / n), (unsigned long long)(l->sprites / n),
+            (unsigned long long)(l->mod_tris / n));
+  }
+  if (st->loose)
+    fprintf(out, "  %llu blocks outside any list\n", (unsigned long long)st->loose);
+  fprintf(out, "VRAM: %u allocations, %u freed, %u bytes in use, peak %u, %llu bytes loaded\n",
+          (unsigned)st->allocs, (unsigned)st->frees, (unsigned)st->vram_used,
+          (unsigned)st->vram_peak, (unsigned long long)st->uploaded);
+}
+
+/**
+ * @brief Open a stream and check its header
+ *
+ * @return FILE* At the first chunk, NULL on a missing or bad file
+ */
+static inline FILE *pvrstream_open(const char *filename) {
+  FILE *fp = fopen(filename, "rb");
+  pvrstream_hdr_t hdr;
+
+  if (fp == NULL) {
+    perror(filename);
+    return NULL;
+  }
+  if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || memcmp(hdr.fourcc, PVRSTREAM_FOURCC, 4) != 0 ||
+      hdr.version != PVRSTREAM_VERSION) {
+    fprintf(stderr, "%s: not a PVR stream\n", filename);
+    fclose(fp);
+    return NULL;
+  }
+  return fp;
+}
+
+/**
+ * @brief Read the next chunk
+ *
+ * @param fp Stream from pvrstream_open()
+ * @param chunk Id and size out
+ * @param data Payload out, malloc()ed, the caller frees it
+ * @return int 1, or 0 at the end of the file or on a truncated chunk
+ */
+static inline int pvrstream_next(FILE *fp, pvrstream_chunk_t *chunk, void **data) {
+  *data = NULL;
+  if (fread(chunk, sizeof(*chunk), 1, fp) != 1)
+    return 0;
+  *data = malloc(chunk->size ? chunk->size : 1);
+  if (*data == NULL || fread(*data, 1, chunk->size, fp) != chunk->size) {
+    fprintf(stderr, "truncated %.4s chunk\n", chunk->id);
+    free(*data);
+    *data = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+static inline int pvrstream_is(const pvrstream_chunk_t *chunk, const char *id) {
+  return memcmp(chunk->id, id, 4) == 0;
+}
+
+/* The allocation counters, for a MEM chunk */
+static inline void pvrstream_count_mem(pvrstream_stats_t *st, const pvrstream_mem_t *m) {
+  if (m->alloc) {
+    st->allocs++;
+    st->vram_used += m->size;
+    if (st->vram_used > st->vram_peak)
+      st->vram_peak = st->vram_used;
+  } else {
+    st->frees++;
+    st->vram_used -= m->size;
+  }
+}
+
+#endif
@@ -0,0 +1,135 @@
+/********************************************************************************************/
+/* Host tool support: emulated SH4 matrix unit                                              */
+/********************************************************************************************/
+/* Enough of the KOS matrix API for the maths headers and the examples' scene set up to     */
+/* run on the development machine.                                                          */
+/* XMTRX is a plain global, so a tool can check what a function left in it.                 */
+/********************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "dc/matrix.h"
+#include "dc/matrix3d.h"
+
+matrix_t host_xmtrx;
+
+void mat_store(matrix_t *out) {
+  memcpy(out, &host_xmtrx, sizeof(matrix_t));
+}
+
+void mat_load(const matrix_t *in) {
+  memcpy(&host_xmtrx, in, sizeof(matrix_t));
+}
+
+void mat_identity(void) {
+  memset(&host_xmtrx, 0, sizeof(matrix_t));
+  host_xmtrx[0][0] = host_xmtrx[1][1] = host_xmtrx[2][2] = host_xmtrx[3][3] = 1.0f;
+}
+
+/* XMTRX = XMTRX * src */
+void mat_apply(const matrix_t *src) {
+  matrix_t r;
+  for (int c = 0; c < 4; c++)
+    for (int row = 0; row < 4; row++)
+      r[c][row] = host_xmtrx[0][row] * (*src)[c][0] + host_xmtrx[1][row] * (*src)[c][1] +
+                  host_xmtrx[2][row] * (*src)[c][2] + host_xmtrx[3][row] * (*src)[c][3];
+  mat_load(&r);
+}
+
+void host_ftrv(float *x, float *y, float *z, float *w) {
+  const float v[4] = {*x, *y, *z, *w};
+  float r[4];
+  for (int row = 0; row < 4; row++)
+    r[row] = host_xmtrx[0][row] * v[0] + host_xmtrx[1][row] * v[1] +
+             host_xmtrx[2][row] * v[2] + host_xmtrx[3][row] * v[3];
+  *x = r[0];
+  *y = r[1];
+  *z = r[2];
+  *w = r[3];
+}
+
+void mat_transform(vector_t *invecs, vector_t *outvecs, int veccnt, int vecskip) {
+  for (int i = 0; i < veccnt; i++) {
+    const float *in = (const float *)((const char *)invecs + i * vecskip);
+    float *out = (float *)((char *)outvecs + i * vecskip);
+    float x = in[0], y = in[1], z = in[2], w = 1.0f;
+    host_ftrv(&x, &y, &z, &w);
+    w = 1.0f / w;
+    out[0] = x * w;
+    out[1] = y * w;
+    out[2] = w;
+  }
+}
+
+static void apply_identity_with(int c0, int r0, float v0, int c1, int r1, float v1, int c2,
+                                int r2, float v2, int c3, int r3, float v3) {
+  matrix_t m = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+  m[c0][r0] = v0;
+  m[c1][r1] = v1;
+  m[c2][r2] = v2;
+  m[c3][r3] = v3;
+  mat_apply(&m);
+}
+
+void mat_rotate_x(float r) {
+  apply_identity_with(1, 1, cosf(r), 2, 2, cosf(r), 1, 2, sinf(r), 2, 1, -sinf(r));
+}
+
+void mat_rotate_y(float r) {
+  apply_identity_with(0, 0, cosf(r), 2, 2, cosf(r), 0, 2, -sinf(r), 2, 0, sinf(r));
+}
+
+void mat_rotate_z(float r) {
+  apply_identity_with(0, 0, cosf(r), 1, 1, cosf(r), 0, 1, sinf(r), 1, 0, -sinf(r));
+}
+
+void mat_rotate(float xr, float yr, float zr) {
+  mat_rotate_x(xr);
+  mat_rotate_y(yr);
+  mat_rotate_z(zr);
+}
+
+void mat_translate(float x, float y, float z) {
+  apply_identity_with(3, 0, x, 3, 1, y, 3, 2, z, 3, 3, 1.0f);
+}
+
+void mat_scale(float x, float y, float z) {
+  apply_identity_with(0, 0, x, 1, 1, y, 2, 2, z, 3, 3, 1.0f);
+}
+
+/* Projection, then clip space to screen pixels with y down */
+void mat_perspective(float xcenter, float ycenter, float cot_fovy_2, float znear, float zfar) {
+  matrix_t screen = {{xcenter, 0, 0, 0}, {0, -ycenter, 0, 0}, {0, 0, 1, 0},
+                     {xcenter, ycenter, 0, 1}};
+  matrix_t proj = {{cot_fovy_2, 0, 0, 0}, {0, cot_fovy_2, 0, 0},
+                   {0, 0, (zfar + znear) / (znear - zfar), -1},
+                   {0, 0, 2 * zfar * znear / (znear - zfar), 0}};
+  mat_apply(&screen);
+  mat_apply(&proj);
+}
+
+static void normalize(float *v) {
+  float l = 1.0f / sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  v[0] *= l;
+  v[1] *= l;
+  v[2] *= l;
+}
+
+static void cross(const float *a, const float *b, float *out) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void mat_lookat(const point_t *eye, const point_t *center, const vector_t *up) {
+  float f[3] = {center->x - eye->x, center->y - eye->y, center->z - eye->z};
+  float u[3] = {up->x, up->y, up->z}, s[3];
+  normalize(f);
+  cross(f, u, s);
+  normalize(s);
+  cross(s, f, u);
+  matrix_t m = {{s[0], u[0], -f[0], 0}, {s[1], u[1], -f[1], 0}, {s[2], u[2], -f[2], 0},
+                {0, 0, 0, 1}};
+  mat_apply(&m);
+  mat_translate(-eye->x, -eye->y, -eye->z);
+}
@@ -0,0 +1,326 @@
+/********************************************************************************************/
+/* Host tool: ADX read-ahead starvation simulator                                           */
+/********************************************************************************************/
+/* Name:     iosim.c                                                                        */
+/* Title:    Drives cubemappedadx/iosched.c against a simulated slow GD-ROM                 */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   The drive is a virtual clock: every read costs a seek when the head has to move plus   */
+/*   len / rate, and while a read is "spinning" the audio consumer keeps draining the ring  */
+/*   at the ADX byte rate. A burst of texture loads is queued a little after the music      */
+/*   starts.                                                                                */
+/*                                                                                          */
+/*   Two runs are made with the same workload:                                             */
+/*     naive  - whole-file bulk reads, no low watermark, like calling fs_read directly      */
+/*     sched  - the configured chunk size and watermarks                                    */
+/*   The naive run is expected to underrun and the scheduled one not to, the exit status    */
+/*   is non-zero if either expectation fails. -c writes the fill level every 10 ms.         */
+/*                                                                                          */
+/* Usage:    iosim [-r KB/s] [-k seek_ms] [-a audio_KB/s] [-n textures] [-t texture_KB]     */
+/*                 [-R ring_KB] [-L low_KB] [-H high_KB] [-C chunk_KB] [-c fill.csv]        */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cubemappedadx/iosched.h"
+
+#define SIM_TICK_US 1000     // consumer granularity
+#define SIM_LOG_US  10000    // fill log interval
+#define SIM_MAX_FILES 64
+
+typedef struct {
+  int id;
+  off_t size;
+  off_t pos;
+} sim_file_t;
+
+typedef struct {
+  // drive
+  double rate;          // bytes per second
+  uint64_t seek_us;
+  int head_file;
+  off_t head_pos;
+  sim_file_t files[SIM_MAX_FILES];
+  int nfiles;
+  // clock and consumer
+  uint64_t now_us;
+  uint64_t next_tick;
+  uint64_t next_log;
+  double audio_rate;    // bytes per second
+  double owed;          // bytes the decoder wants but has not taken yet
+  int playing;
+  iosched_stream_t *music;
+  iosched_t *s;
+  FILE *csv;
+  const char *label;
+} sim_t;
+
+static sim_t sim;
+
+static void consume(void) {
+  static uint8_t scratch[4096];
+  iosched_stats_t st;
+
+  if (sim.music == NULL)
+    return;
+  iosched_get_stats(sim.s, &st);
+  if (!sim.playing) {
+    // Prebuffer like the decoder does before it starts the AICA
+    if (st.fill < st.size / 4)
+      return;
+    sim.playing = 1;
+  }
+  sim.owed += sim.audio_rate * SIM_TICK_US / 1e6;
+  while (sim.owed >= 1.0) {
+    size_t want = sim.owed > sizeof(scratch) ? sizeof(scratch) : (size_t)sim.owed;
+    ssize_t n = iosched_stream_read(sim.music, scratch, want, 0);
+    if (n == 0 && iosched_stream_tell(sim.music) >= iosched_stream_total(sim.music)) {
+      iosched_stream_seek(sim.music, 0);  // loop like adx_dec(.., 1)
+      continue;
+    }
+    sim.owed -= n;
+    if ((size_t)n < want) {
+      // Short: that audio is lost, the stats already counted the underrun
+      sim.owed = 0;
+      break;
+    }
+  }
+}
+
+/* Let simulated time pass, running the consumer on every tick */
+static void advance(uint64_t us) {
+  uint64_t end = sim.now_us + us;
+
+  while (sim.next_tick <= end) {
+    sim.now_us = sim.next_tick;
+    sim.next_tick += SIM_TICK_US;
+    consume();
+    if (sim.csv && sim.now_us >= sim.next_log) {
+      iosched_stats_t st;
+      iosched_get_stats(sim.s, &st);
+      fprintf(sim.csv, "%s,%.3f,%d,%u\n", sim.label, sim.now_us / 1e6, st.fill,
+              (unsigned)st.underruns);
+      sim.next_log += SIM_LOG_US;
+    }
+  }
+  sim.now_us = end;
+}
+
+/* Slow drive backend ------------------------------------------------------- */
+
+static void *sim_open(void *ctx, const char *path) {
+  sim_file_t *f = &sim.files[sim.nfiles];
+  (void)ctx;
+  if (sim.nfiles == SIM_MAX_FILES)
+    return NULL;
+  f->id = sim.nfiles++;
+  f->size = atol(path);  // the "path" is just the size in bytes
+  f->pos = 0;
+  return f;
+}
+
+static ssize_t sim_read(void *ctx, void *fh, void *buf, size_t len) {
+  sim_file_t *f = (sim_file_t *)fh;
+  (void)ctx;
+  if (f->pos >= f->size)
+    return 0;
+  if ((off_t)len > f->size - f->pos)
+    len = f->size - f->pos;
+  if (sim.head_file != f->id || sim.head_pos != f->pos)
+    advance(sim.seek_us);
+  advance((uint64_t)(len * 1e6 / sim.rate));
+  memset(buf, 0x80, len);
+  f->pos += len;
+  sim.head_file = f->id;
+  sim.head_pos = f->pos;
+  return len;
+}
+
+static off_t sim_seek(void *ctx, void *fh, off_t offset) {
+  (void)ctx;
+  ((sim_file_t *)fh)->pos = offset;
+  return offset;
+}
+
+static off_t sim_total(void *ctx, void *fh) {
+  (void)ctx;
+  return ((sim_file_t *)fh)->size;
+}
+
+static void sim_close(void *ctx, void *fh) {
+  (void)ctx;
+  (void)fh;
+}
+
+static const iosched_backend_t sim_backend = {
+  sim_open, sim_read, sim_seek, sim_total, sim_close, NULL
+};
+
+/* Scenario ----------------------------------------------------------------- */
+
+typedef struct {
+  double rate, seek_ms, audio_rate;
+  int textures, texture_size;
+  double duration;
+} workload_t;
+
+static void run(const char *label, const workload_t *w, const iosched_config_t *cfg,
+                iosched_stats_t *out, double *bulk_secs) {
+  iosched_req_t *reqs;
+  uint8_t *dst;
+  char path[32];
+  uint64_t bulk_start = 0, bulk_end = 0;
+  int i, submitted = 0;
+
+  FILE *csv = sim.csv;
+  memset(&sim, 0, sizeof(sim));
+  sim.csv = csv;
+  sim.rate = w->rate;
+  sim.seek_us = (uint64_t)(w->seek_ms * 1000.0);
+  sim.audio_rate = w->audio_rate;
+  sim.head_file = -1;
+  sim.label = label;
+  sim.next_tick = SIM_TICK_US;
+  sim.s = iosched_create(&sim_backend, cfg);
+
+  // Five minutes of music so the run never reaches the loop point by accident
+  snprintf(path, sizeof(path), "%ld", (long)(w->audio_rate * 300));
+  sim.music = iosched_stream_open(sim.s, path);
+
+  reqs = calloc(w->textures, sizeof(iosched_req_t));
+  dst = malloc(w->texture_size);
+  for (i = 0; i < w->textures; i++) {
+    snprintf(path, sizeof(path), "%d", w->texture_size);
+    reqs[i].fh = sim_open(NULL, path);
+    reqs[i].dst = dst;
+    reqs[i].len = w->texture_size;
+  }
+
+  // Run until two seconds after the load finished, or give up at duration
+  while (sim.now_us < w->duration * 1e6 && !(bulk_end && sim.now_us > bulk_end + 2000000)) {
+    // The level load starts once the music has been playing for a second
+    if (!submitted && sim.playing && sim.now_us > 1000000) {
+      for (i = 0; i < w->textures; i++)
+        iosched_submit(sim.s, &reqs[i]);
+      bulk_start = sim.now_us;
+      submitted = 1;
+    }
+    if (submitted && !bulk_end && reqs[w->textures - 1].status != IOSCHED_REQ_PENDING)
+      bulk_end = sim.now_us;
+    if (!iosched_pump(sim.s))
+      advance(SIM_TICK_US);
+  }
+
+  iosched_get_stats(sim.s, out);
+  *bulk_secs = bulk_end ? (bulk_end - bulk_start) / 1e6 : -1.0;
+  iosched_destroy(sim.s);
+  free(dst);
+  free(reqs);
+}
+
+static void report(const char *label, const iosched_stats_t *st, double bulk_secs) {
+  printf("%-6s underruns %5u (%7u bytes short)  fill min %6d/%d  "
+         "audio %4u reads  bulk %4u reads, %4u preempted, done in %.2fs\n",
+         label, (unsigned)st->underruns, (unsigned)st->underrun_bytes, st->fill_min,
+         st->size, (unsigned)st->audio_reads, (unsigned)st->bulk_reads,
+         (unsigned)st->bulk_preempted, bulk_secs);
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: iosim [-r KB/s] [-k seek_ms] [-a audio_KB/s] [-n textures] "
+          "[-t texture_KB]\n"
+          "             [-R ring_KB] [-L low_KB] [-H high_KB] [-C chunk_KB] "
+          "[-c fill.csv]\n");
+}
+
+int main(int argc, char *argv[]) {
+  // GD-ROM inner tracks, 44.1kHz stereo ADX, a level's worth of textures
+  workload_t w = { 600 * 1024, 120.0, 50 * 1024, 40, 128 * 1024, 120.0 };
+  iosched_config_t cfg = { IOSCHED_DEFAULT_RING, IOSCHED_DEFAULT_LOW_WM,
+                           IOSCHED_DEFAULT_HIGH_WM, IOSCHED_DEFAULT_CHUNK };
+  iosched_config_t naive;
+  iosched_stats_t st_naive, st_sched;
+  double t_naive, t_sched;
+  const char *csv = NULL;
+  int ok = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    if (!strcmp(argv[i], "-r"))
+      w.rate = atof(argv[++i]) * 1024;
+    else if (!strcmp(argv[i], "-k"))
+      w.seek_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-a"))
+      w.audio_rate = atof(argv[++i]) * 1024;
+    else if (!strcmp(argv[i], "-n"))
+      w.textures = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t"))
+      w.texture_size = atoi(argv[++i]) * 1024;
+    else if (!strcmp(argv[i], "-R"))
+      cfg.ring_size = atoi(argv[++i]) * 1024;
+    else if (!strcmp(argv[i], "-L"))
+      cfg.low_wm = atoi(argv[++i]) * 1024;
+    else if (!strcmp(argv[i], "-H"))
+      cfg.high_wm = atoi(argv[++i]) * 1024;
+    else if (!strcmp(argv[i], "-C"))
+      cfg.chunk = atoi(argv[++i]) * 1024;
+    else if (!strcmp(argv[i], "-c"))
+      csv = argv[++i];
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (w.textures < 1 || w.textures >= SIM_MAX_FILES || w.texture_size < 1 || w.rate <= w.audio_rate) {
+    usage();
+    return 1;
+  }
+
+  if (csv) {
+    sim.csv = fopen(csv, "w");
+    if (sim.csv == NULL) {
+      perror(csv);
+      return 1;
+    }
+    fprintf(sim.csv, "run,time,fill,underruns\n");
+  }
+
+  printf("drive %.0f KB/s, seek %.0f ms, audio %.0f KB/s, %d x %d KB bulk\n",
+         w.rate / 1024, w.seek_ms, w.audio_rate / 1024, w.textures,
+         w.texture_size / 1024);
+  printf("ring %d KB, low %d KB, high %d KB, chunk %d KB\n", cfg.ring_size / 1024,
+         cfg.low_wm / 1024, cfg.high_wm / 1024, cfg.chunk / 1024);
+
+  naive = cfg;
+  naive.low_wm = 0;
+  naive.chunk = w.texture_size;
+  run("naive", &w, &naive, &st_naive, &t_naive);
+  run("sched", &w, &cfg, &st_sched, &t_sched);
+  report("naive", &st_naive, t_naive);
+  report("sched", &st_sched, t_sched);
+
+  if (st_naive.underruns == 0) {
+    printf("FAIL: naive run did not starve, workload too light to show anything\n");
+    ok = 0;
+  }
+  if (st_sched.underruns != 0) {
+    printf("FAIL: scheduled run starved\n");
+    ok = 0;
+  }
+  if (t_sched < 0) {
+    printf("FAIL: bulk reads never finished\n");
+    ok = 0;
+  }
+  if (ok)
+    printf("PASS\n");
+  if (sim.csv)
+    fclose(sim.csv);
+  return ok ? 0 : 1;
+}
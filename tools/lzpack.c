@@ -0,0 +1,488 @@
+/********************************************************************************************/
+/* Host tool: compressed asset pack builder                                                 */
+/********************************************************************************************/
+/* Name:     lzpack.c                                                                       */
+/* Title:    A romdisk directory to an LZ4 pack, against the romfs image it replaces        */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Packs every file under a directory into the format in ../lzpack.h, each compressed on  */
+/*   its own as an LZ4 block so any one decodes without the others. The compressor looks    */
+/*   down a hash chain for the longest match, which costs time here and none on the         */
+/*   Dreamcast: the decoder does the same work whatever the matches are. Files that don't   */
+/*   get smaller are stored.                                                                */
+/*                                                                                          */
+/*   -g names the prefetch groups, the files each scene loads, one line per file:           */
+/*                                                                                          */
+/*     <group> <path in the directory>                                                      */
+/*                                                                                          */
+/*   in any order, a file in one group at most. Each group's files go back to back, so      */
+/*   lzpack_prefetch() reads a scene in one go.                                             */
+/*                                                                                          */
+/*   Every file is decoded again and compared before the pack is written. For each it       */
+/*   prints the size, the packed size and the time the decode took on this machine, then    */
+/*   the pack against the romfs image KOS_GENROMFS would make of the same directory, which  */
+/*   is how much smaller the ELF gets. tools/packbench times loading the groups off a       */
+/*   simulated GD-ROM.                                                                      */
+/*                                                                                          */
+/* Usage:    lzpack -d romdisk -o romdisk.lzp [-g groups.txt]                               */
+/********************************************************************************************/
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../lzpack.h"
+
+#define FILES_MAX 4096
+#define GROUPS_MAX 64
+#define HASH_BITS 16
+#define CHAIN_DEPTH 64      // candidates tried per position
+#define WINDOW 65535        // furthest a match may be, the offset is 16 bits
+#define MIN_MATCH 4
+#define LAST_LITERALS 5     // the LZ4 block rules: the last 5 bytes are literals
+#define MATCH_LIMIT 12      // and no match starts in the last 12
+
+typedef struct {
+  char path[1024]; // from the directory, "/texture/dc.dt"
+  uint8_t *data, *packed;
+  uint32_t size, packed_size, offset, hash;
+  int group;       // -1 for none
+  double decode_ms;
+} pack_file_t;
+
+static pack_file_t files[FILES_MAX];
+static int file_count;
+static char group_names[GROUPS_MAX][64];
+static int group_count;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static uint32_t hash4(const uint8_t *p) {
+  uint32_t v = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static uint8_t *put_length(uint8_t *op, size_t len) {
+  for (; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = (uint8_t)len;
+  return op;
+}
+
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *lit, size_t lit_len, size_t off,
+                             size_t match_len) {
+  uint8_t *token = op++;
+  *token = (uint8_t)((lit_len < 15 ? lit_len : 15) << 4);
+  if (lit_len >= 15)
+    op = put_length(op, lit_len - 15);
+  memcpy(op, lit, lit_len);
+  op += lit_len;
+  if (match_len == 0)
+    return op;
+  *op++ = off & 0xff;
+  *op++ = off >> 8;
+  match_len -= MIN_MATCH;
+  *token |= match_len < 15 ? match_len : 15;
+  if (match_len >= 15)
+    op = put_length(op, match_len - 15);
+  return op;
+}
+
+/**
+ * @brief Compress to one LZ4 block
+ *
+ * @param out Room for n + n / 255 + 16 bytes
+ * @return size_t The block's size, 0 when out of memory
+ */
+static size_t compress(const uint8_t *in, size_t n, uint8_t *out) {
+  int32_t *head = malloc(sizeof(int32_t) << HASH_BITS), *prev = malloc(sizeof(int32_t) * (n + 1));
+  size_t i = 0, anchor = 0, limit = n > MATCH_LIMIT ? n - MATCH_LIMIT : 0;
+  uint8_t *op = out;
+
+  if (head == NULL || prev == NULL) {
+    free(head);
+    free(prev);
+    return 0;
+  }
+  memset(head, 0xff, sizeof(int32_t) << HASH_BITS);
+
+  while (i < limit) {
+    uint32_t h = hash4(in + i);
+    size_t best_len = 0, best_off = 0;
+    int32_t c = head[h];
+
+    for (int depth = 0; c >= 0 && i - c <= WINDOW && depth < CHAIN_DEPTH; depth++, c = prev[c]) {
+      size_t len = 0, max = n - LAST_LITERALS - i;
+      while (len < max && in[c + len] == in[i + len])
+        len++;
+      if (len > best_len) {
+        best_len = len;
+        best_off = i - c;
+      }
+    }
+    prev[i] = head[h];
+    head[h] = (int32_t)i;
+
+    if (best_len < MIN_MATCH) {
+      i++;
+      continue;
+    }
+    op = put_sequence(op, in + anchor, i - anchor, best_off, best_len);
+    for (size_t k = i + 1; k < i + best_len && k < limit; k++) {
+      h = hash4(in + k);
+      prev[k] = head[h];
+      head[h] = (int32_t)k;
+    }
+    i += best_len;
+    anchor = i;
+  }
+  op = put_sequence(op, in + anchor, n - anchor, 0, 0);
+  free(head);
+  free(prev);
+  return op - out;
+}
+
+static int add_dir(const char *root, const char *rel) {
+  char path[2048];
+  struct dirent *de;
+  DIR *dir;
+
+  snprintf(path, sizeof(path), "%s%s", root, rel);
+  if ((dir = opendir(path)) == NULL) {
+    fprintf(stderr, "Error: can't open %s\n", path);
+    return 0;
+  }
+  while ((de = readdir(dir)) != NULL) {
+    char sub[1024];
+    struct stat st;
+    if (de->d_name[0] == '.')
+      continue;
+    snprintf(sub, sizeof(sub), "%s/%s", rel, de->d_name);
+    snprintf(path, sizeof(path), "%s%s", root, sub);
+    if (stat(path, &st) != 0)
+      continue;
+    if (S_ISDIR(st.st_mode)) {
+      if (!add_dir(root, sub)) {
+        closedir(dir);
+        return 0;
+      }
+    } else if (S_ISREG(st.st_mode)) {
+      if (file_count == FILES_MAX) {
+        fprintf(stderr, "Error: more than %d files\n", FILES_MAX);
+        closedir(dir);
+        return 0;
+      }
+      snprintf(files[file_count++].path, sizeof(files[0].path), "%s", sub);
+    }
+  }
+  closedir(dir);
+  return 1;
+}
+
+static int by_path(const void *a, const void *b) {
+  return strcmp(((const pack_file_t *)a)->path, ((const pack_file_t *)b)->path);
+}
+
+/* The index order, lzpack_find() searches it */
+static int by_hash(const void *a, const void *b) {
+  const pack_file_t *fa = *(const pack_file_t *const *)a, *fb = *(const pack_file_t *const *)b;
+  if (fa->hash != fb->hash)
+    return fa->hash < fb->hash ? -1 : 1;
+  return strcmp(fa->path, fb->path);
+}
+
+static int read_groups(const char *filename) {
+  char line[1200], group[64], path[1024];
+  FILE *fp = fopen(filename, "r");
+  int n = 0;
+
+  if (fp == NULL) {
+    fprintf(stderr, "Error: can't read %s\n", filename);
+    return 0;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    pack_file_t key, *f;
+    int g;
+    n++;
+    if (line[0] == '#' || sscanf(line, "%63s %1023s", group, path) != 2)
+      continue;
+    snprintf(key.path, sizeof(key.path), "%s", path);
+    if ((f = bsearch(&key, files, file_count, sizeof(files[0]), by_path)) == NULL) {
+      fprintf(stderr, "Error: %s:%d: no %s in the directory\n", filename, n, path);
+      fclose(fp);
+      return 0;
+    }
+    for (g = 0; g < group_count && strcmp(group_names[g], group); g++)
+      ;
+    if (g == group_count) {
+      if (group_count == GROUPS_MAX) {
+        fprintf(stderr, "Error: more than %d groups\n", GROUPS_MAX);
+        fclose(fp);
+        return 0;
+      }
+      snprintf(group_names[group_count++], sizeof(group_names[0]), "%s", group);
+    }
+    if (f->group >= 0 && f->group != g) {
+      fprintf(stderr, "Error: %s:%d: %s is in %s already\n", filename, n, path,
+              group_names[f->group]);
+      fclose(fp);
+      return 0;
+    }
+    f->group = g;
+  }
+  fclose(fp);
+  return 1;
+}
+
+static uint32_t align16(uint32_t n) {
+  return (n + 15) & ~15u;
+}
+
+/* What genromfs writes for the same tree: a header and a name per file and
+   directory, "." and ".." in each directory, all in 16 byte steps, the
+   image padded to 1 KB */
+static uint32_t romfs_size(void) {
+  uint32_t size = 16 + 16 + 2 * 32; // superblock, volume name, the root's . and ..
+  char seen[FILES_MAX][256];
+  int dirs = 0;
+
+  for (int i = 0; i < file_count; i++) {
+    const char *p = files[i].path, *slash;
+    // Directories, once each
+    for (slash = strchr(p + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+      int len = slash - p, known = 0;
+      for (int d = 0; d < dirs && !known; d++)
+        known = (int)strlen(seen[d]) == len && !strncmp(seen[d], p, len);
+      if (!known && dirs < FILES_MAX && len < 256) {
+        const char *name = p;
+        for (const char *q = p; q < slash; q++)
+          if (*q == '/')
+            name = q + 1;
+        snprintf(seen[dirs++], sizeof(seen[0]), "%.*s", len, p);
+        size += 16 + align16(slash - name + 1) + 2 * 32;
+      }
+    }
+    size += 16 + align16(strlen(strrchr(p, '/') + 1) + 1) + align16(files[i].size);
+  }
+  return (size + 1023) & ~1023u;
+}
+
+static int read_file(const char *root, pack_file_t *f) {
+  char path[2048];
+  FILE *fp;
+  long size;
+
+  snprintf(path, sizeof(path), "%s%s", root, f->path);
+  if ((fp = fopen(path, "rb")) == NULL || fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0) {
+    fprintf(stderr, "Error: can't read %s\n", path);
+    if (fp != NULL)
+      fclose(fp);
+    return 0;
+  }
+  fseek(fp, 0, SEEK_SET);
+  f->size = (uint32_t)size;
+  f->data = malloc(size ? size : 1);
+  if (f->data == NULL || fread(f->data, 1, size, fp) != (size_t)size) {
+    fprintf(stderr, "Error: can't read %s\n", path);
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+  return 1;
+}
+
+/* Compress a file, or keep it as it is, and check that it comes back */
+static int pack_file(pack_file_t *f) {
+  uint8_t *check;
+  double t0;
+  int ok;
+
+  f->packed = malloc(f->size + f->size / 255 + 16);
+  if (f->packed == NULL || (f->packed_size = compress(f->data, f->size, f->packed)) == 0) {
+    fprintf(stderr, "Error: out of memory\n");
+    return 0;
+  }
+  if (f->packed_size >= f->size) {
+    memcpy(f->packed, f->data, f->size);
+    f->packed_size = f->size;
+    return 1;
+  }
+  if ((check = malloc(f->size)) == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    return 0;
+  }
+  t0 = now_ms();
+  ok = lzpack_decode(f->packed, f->packed_size, check, f->size);
+  f->decode_ms = now_ms() - t0;
+  ok = ok && !memcmp(check, f->data, f->size);
+  free(check);
+  if (!ok)
+    fprintf(stderr, "Error: %s does not decode to what went in\n", f->path);
+  return ok;
+}
+
+static int write_pack(const char *out) {
+  lzpack_hdr_t hdr;
+  lzpack_group_t groups[GROUPS_MAX];
+  pack_file_t *index[FILES_MAX];
+  uint32_t names = 0, name_at[FILES_MAX], group_name_at[GROUPS_MAX], data_at, offset;
+  uint8_t *pack;
+  FILE *fp;
+  int ok;
+
+  for (int i = 0; i < file_count; i++) {
+    name_at[i] = names;
+    names += strlen(files[i].path) + 1;
+    files[i].hash = lzpack_hash(files[i].path);
+  }
+  for (int g = 0; g < group_count; g++) {
+    group_name_at[g] = names;
+    names += strlen(group_names[g]) + 1;
+  }
+  data_at = LZPACK_ALIGN_UP(sizeof(hdr) + file_count * sizeof(lzpack_entry_t) +
+                            group_count * sizeof(lzpack_group_t) + names);
+
+  // Data: group by group, each group's files back to back, then the rest
+  offset = data_at;
+  for (int g = -1; g < group_count; g++) {
+    int want = g + 1 < group_count ? g + 1 : -1, first = 1;
+    if (want >= 0)
+      memset(&groups[want], 0, sizeof(groups[want]));
+    for (int i = 0; i < file_count; i++) {
+      if (files[i].group != want)
+        continue;
+      files[i].offset = offset;
+      if (want >= 0) {
+        if (first)
+          groups[want].offset = offset;
+        groups[want].bytes = offset + files[i].packed_size - groups[want].offset;
+        groups[want].files++;
+        first = 0;
+      }
+      offset = LZPACK_ALIGN_UP(offset + files[i].packed_size);
+    }
+  }
+
+  if ((pack = calloc(1, offset)) == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    return 0;
+  }
+  memcpy(hdr.fourcc, LZPACK_FOURCC, 4);
+  hdr.files = file_count;
+  hdr.groups = group_count;
+  hdr.names = names;
+  memcpy(pack, &hdr, sizeof(hdr));
+
+  for (int i = 0; i < file_count; i++)
+    index[i] = &files[i];
+  qsort(index, file_count, sizeof(index[0]), by_hash);
+  for (int i = 0; i < file_count; i++) {
+    const pack_file_t *f = index[i];
+    lzpack_entry_t e = {f->hash, name_at[f - files], f->offset, f->packed_size, f->size,
+                        f->group < 0 ? LZPACK_NO_GROUP : (uint16_t)f->group, 0};
+    memcpy(pack + sizeof(hdr) + i * sizeof(e), &e, sizeof(e));
+  }
+  for (int g = 0; g < group_count; g++) {
+    groups[g].name = group_name_at[g];
+    memcpy(pack + sizeof(hdr) + file_count * sizeof(lzpack_entry_t) + g * sizeof(groups[g]),
+           &groups[g], sizeof(groups[g]));
+  }
+  names = sizeof(hdr) + file_count * sizeof(lzpack_entry_t) + group_count * sizeof(lzpack_group_t);
+  for (int i = 0; i < file_count; i++)
+    memcpy(pack + names + name_at[i], files[i].path, strlen(files[i].path) + 1);
+  for (int g = 0; g < group_count; g++)
+    memcpy(pack + names + group_name_at[g], group_names[g], strlen(group_names[g]) + 1);
+  for (int i = 0; i < file_count; i++)
+    memcpy(pack + files[i].offset, files[i].packed, files[i].packed_size);
+
+  ok = (fp = fopen(out, "wb")) != NULL && fwrite(pack, 1, offset, fp) == offset;
+  if (fp != NULL)
+    ok &= fclose(fp) == 0;
+  free(pack);
+  if (!ok) {
+    fprintf(stderr, "Error: can't write %s\n", out);
+    remove(out);
+    return 0;
+  }
+  for (int g = 0; g < group_count; g++)
+    printf("group %-16s %3u files, %8u bytes in one read\n", group_names[g],
+           (unsigned)groups[g].files, (unsigned)groups[g].bytes);
+  return 1;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: lzpack -d romdisk -o romdisk.lzp [-g groups.txt]\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *dir = NULL, *out = NULL, *groups = NULL;
+  uint64_t size = 0, packed = 0;
+  double decode_ms = 0.0;
+  long pack_size;
+  uint32_t romfs;
+  FILE *fp;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "-d"))
+      dir = argv[i + 1];
+    else if (!strcmp(argv[i], "-o"))
+      out = argv[i + 1];
+    else if (!strcmp(argv[i], "-g"))
+      groups = argv[i + 1];
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (dir == NULL || out == NULL || argc % 2 == 0) {
+    usage();
+    return 1;
+  }
+  if (!add_dir(dir, ""))
+    return 1;
+  qsort(files, file_count, sizeof(files[0]), by_path);
+  for (int i = 0; i < file_count; i++)
+    files[i].group = -1;
+  if (groups != NULL && !read_groups(groups))
+    return 1;
+
+  printf("%-40s %9s %9s %6s %9s  %s\n", "file", "size", "packed", "", "decode", "group");
+  for (int i = 0; i < file_count; i++) {
+    pack_file_t *f = &files[i];
+    if (!read_file(dir, f) || !pack_file(f))
+      return 1;
+    printf("%-40s %9u %9u %5.1f%% %6.3f ms  %s%s\n", f->path, (unsigned)f->size,
+           (unsigned)f->packed_size, f->size ? 100.0 * f->packed_size / f->size : 100.0,
+           f->decode_ms, f->group < 0 ? "-" : group_names[f->group],
+           f->packed_size == f->size ? ", stored" : "");
+    size += f->size;
+    packed += f->packed_size;
+    decode_ms += f->decode_ms;
+  }
+  if (!write_pack(out))
+    return 1;
+
+  fp = fopen(out, "rb");
+  fseek(fp, 0, SEEK_END);
+  pack_size = ftell(fp);
+  fclose(fp);
+  romfs = romfs_size();
+  printf("%d files, %llu bytes packed to %llu, decoded in %.2f ms on this machine\n", file_count,
+         (unsigned long long)size, (unsigned long long)packed, decode_ms);
+  printf("%s %ld KB against a %u KB romfs image, the ELF %ld KB smaller\n", out,
+         (pack_size + 1023) / 1024, (unsigned)(romfs + 1023) / 1024,
+         ((long)romfs - pack_size) / 1024);
+  for (int i = 0; i < file_count; i++) {
+    free(files[i].data);
+    free(files[i].packed);
+  }
+  return 0;
+}
@@ -0,0 +1,553 @@
+/********************************************************************************************/
+/* Host tool: OBJ to indexed strip mesh converter                                           */
+/********************************************************************************************/
+/* Name:     meshconv.c                                                                     */
+/* Title:    Wavefront OBJ to the DCM1 mesh format in ../mesh.h                             */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Reads positions, texture coordinates and faces (any polygon, fanned into triangles),  */
+/*   merges corners that share both position and UV into one vertex, and groups the       */
+/*   triangles by usemtl in order of first use. Each group is cut into triangle strips:    */
+/*   greedily, starting from the triangle with the fewest free neighbours and taking the   */
+/*   longest of its three orientations, so few vertices are sent twice.                    */
+/*   The result is written with every section 32 byte aligned, ready to map and use.       */
+/*                                                                                          */
+/*   -s then joins each group's strips into one through degenerate triangles, one EOL and  */
+/*   one TA strip start per group; tools/stripcheck weighs that up for a given mesh.       */
+/*                                                                                          */
+/*   Prints vertex counts against a plain triangle list. -t also times parsing the OBJ     */
+/*   against mesh_load() of the output, the two ways a demo could get the geometry.        */
+/*                                                                                          */
+/* Usage:    meshconv -i mesh.obj -o mesh.msh [-s] [-t] [-q]                                */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../mesh.h"
+
+#define MAX_NAME 64
+
+typedef struct {
+  int *data;
+  int len, cap;
+} ivec_t;
+
+static void ivec_push(ivec_t *v, int x) {
+  if (v->len == v->cap) {
+    v->cap = v->cap ? v->cap * 2 : 64;
+    v->data = realloc(v->data, v->cap * sizeof(int));
+  }
+  v->data[v->len++] = x;
+}
+
+typedef struct {
+  // OBJ pools
+  float *pos, *tex;
+  int npos, ntex, cap_pos, cap_tex;
+  // Merged vertices: (position, texcoord) pairs
+  int *vpos, *vtex;
+  int nverts, cap_verts;
+  int *hash;                  // (pos, tex) -> vertex, open addressing
+  int hash_size;
+  // Triangles, three vertex numbers each, and their group
+  ivec_t tris, tri_group;
+  char (*groups)[MAX_NAME];
+  int ngroups;
+} obj_t;
+
+typedef struct {
+  ivec_t index;               // strip vertices, all strips back to back
+  ivec_t strip_first;         // strip s is index[strip_first[s] .. strip_first[s + 1])
+  ivec_t group_first;         // group g is strips group_first[g] .. group_first[g + 1]
+} strips_t;
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void obj_free(obj_t *o) {
+  free(o->pos);
+  free(o->tex);
+  free(o->vpos);
+  free(o->vtex);
+  free(o->hash);
+  free(o->tris.data);
+  free(o->tri_group.data);
+  free(o->groups);
+  memset(o, 0, sizeof(*o));
+}
+
+static void strips_free(strips_t *s) {
+  free(s->index.data);
+  free(s->strip_first.data);
+  free(s->group_first.data);
+  memset(s, 0, sizeof(*s));
+}
+
+static unsigned pair_hash(unsigned a, unsigned b) {
+  return (a * 2654435761u) ^ (b * 40503u + 0x9e3779b9u);
+}
+
+static void vert_rehash(obj_t *o);
+
+/* Vertex for a position/texcoord pair, made on first use */
+static int vert_for(obj_t *o, int p, int t) {
+  unsigned h;
+
+  if (o->nverts * 2 >= o->hash_size)
+    vert_rehash(o);
+  h = pair_hash(p, t) & (o->hash_size - 1);
+  while (o->hash[h] >= 0) {
+    int v = o->hash[h];
+    if (o->vpos[v] == p && o->vtex[v] == t)
+      return v;
+    h = (h + 1) & (o->hash_size - 1);
+  }
+  if (o->nverts == o->cap_verts) {
+    o->cap_verts = o->cap_verts ? o->cap_verts * 2 : 256;
+    o->vpos = realloc(o->vpos, o->cap_verts * sizeof(int));
+    o->vtex = realloc(o->vtex, o->cap_verts * sizeof(int));
+  }
+  o->vpos[o->nverts] = p;
+  o->vtex[o->nverts] = t;
+  o->hash[h] = o->nverts;
+  return o->nverts++;
+}
+
+static void vert_rehash(obj_t *o) {
+  int size = o->hash_size ? o->hash_size * 2 : 1024;
+  free(o->hash);
+  o->hash = malloc(size * sizeof(int));
+  o->hash_size = size;
+  memset(o->hash, 0xff, size * sizeof(int));
+  for (int v = 0; v < o->nverts; v++) {
+    unsigned h = pair_hash(o->vpos[v], o->vtex[v]) & (size - 1);
+    while (o->hash[h] >= 0)
+      h = (h + 1) & (size - 1);
+    o->hash[h] = v;
+  }
+}
+
+static int group_for(obj_t *o, const char *name) {
+  for (int g = 0; g < o->ngroups; g++)
+    if (!strcmp(o->groups[g], name))
+      return g;
+  o->groups = realloc(o->groups, (o->ngroups + 1) * sizeof(*o->groups));
+  snprintf(o->groups[o->ngroups], MAX_NAME, "%s", name);
+  return o->ngroups++;
+}
+
+/* OBJ index to 0 based, negative counts back from the end */
+static int obj_index(int i, int n) {
+  return i < 0 ? n + i : i - 1;
+}
+
+static int load_obj(const char *filename, obj_t *o) {
+  FILE *fp = fopen(filename, "r");
+  char line[1024];
+  int group = -1, lineno = 0;
+
+  memset(o, 0, sizeof(*o));
+  if (fp == NULL) {
+    perror(filename);
+    return 0;
+  }
+  vert_rehash(o);
+  while (fgets(line, sizeof(line), fp)) {
+    char *p = line;
+    lineno++;
+    while (*p == ' ' || *p == '\t')
+      p++;
+    if (p[0] == 'v' && p[1] == ' ') {
+      if (o->npos == o->cap_pos) {
+        o->cap_pos = o->cap_pos ? o->cap_pos * 2 : 256;
+        o->pos = realloc(o->pos, o->cap_pos * 3 * sizeof(float));
+      }
+      float *d = o->pos + o->npos * 3;
+      if (sscanf(p + 2, "%f %f %f", &d[0], &d[1], &d[2]) == 3)
+        o->npos++;
+    } else if (p[0] == 'v' && p[1] == 't' && p[2] == ' ') {
+      if (o->ntex == o->cap_tex) {
+        o->cap_tex = o->cap_tex ? o->cap_tex * 2 : 256;
+        o->tex = realloc(o->tex, o->cap_tex * 2 * sizeof(float));
+      }
+      float *d = o->tex + o->ntex * 2;
+      d[1] = 0.0f;
+      if (sscanf(p + 3, "%f %f", &d[0], &d[1]) >= 1)
+        o->ntex++;
+    } else if (!strncmp(p, "usemtl", 6) && (p[6] == ' ' || p[6] == '\t')) {
+      char name[MAX_NAME];
+      if (sscanf(p + 7, "%63s", name) == 1)
+        group = group_for(o, name);
+    } else if (p[0] == 'f' && p[1] == ' ') {
+      int corner[64], n = 0;
+      char *tok = strtok(p + 2, " \t\r\n");
+      for (; tok && n < 64; tok = strtok(NULL, " \t\r\n")) {
+        int vi = 0, ti = 0;
+        // v, v/vt, v/vt/vn or v//vn
+        if (sscanf(tok, "%d/%d", &vi, &ti) < 1)
+          break;
+        if (strstr(tok, "//"))
+          ti = 0;
+        vi = obj_index(vi, o->npos);
+        ti = ti ? obj_index(ti, o->ntex) : -1;
+        if (vi < 0 || vi >= o->npos || ti >= o->ntex) {
+          fprintf(stderr, "%s:%d: face index out of range\n", filename, lineno);
+          fclose(fp);
+          return 0;
+        }
+        corner[n++] = vert_for(o, vi, ti);
+      }
+      if (group < 0)
+        group = group_for(o, "default");
+      for (int i = 1; i + 1 < n; i++) {
+        int a = corner[0], b = corner[i], c = corner[i + 1];
+        if (a == b || b == c || a == c)
+          continue;
+        ivec_push(&o->tris, a);
+        ivec_push(&o->tris, b);
+        ivec_push(&o->tris, c);
+        ivec_push(&o->tri_group, group);
+      }
+    }
+  }
+  fclose(fp);
+  if (o->nverts > 65535) {
+    fprintf(stderr, "%s: %d vertices, the format holds 65535\n", filename, o->nverts);
+    return 0;
+  }
+  return 1;
+}
+
+/* Directed edge a->b to the triangle that has it */
+typedef struct {
+  unsigned *key;
+  int *tri;
+  int size;
+} edges_t;
+
+static void edges_build(edges_t *e, const int *tri, const int *list, int n) {
+  e->size = 1;
+  while (e->size < n * 6)
+    e->size <<= 1;
+  e->key = malloc(e->size * sizeof(unsigned));
+  e->tri = malloc(e->size * sizeof(int));
+  memset(e->tri, 0xff, e->size * sizeof(int));
+  for (int i = 0; i < n; i++) {
+    const int *t = tri + list[i] * 3;
+    for (int k = 0; k < 3; k++) {
+      unsigned key = (unsigned)t[k] << 16 | t[(k + 1) % 3];
+      unsigned h = pair_hash(t[k], t[(k + 1) % 3]) & (e->size - 1);
+      while (e->tri[h] >= 0 && e->key[h] != key)
+        h = (h + 1) & (e->size - 1);
+      if (e->tri[h] < 0) {     // first owner wins on non-manifold edges
+        e->key[h] = key;
+        e->tri[h] = list[i];
+      }
+    }
+  }
+}
+
+static int edges_find(const edges_t *e, int a, int b) {
+  unsigned key = (unsigned)a << 16 | b;
+  unsigned h = pair_hash(a, b) & (e->size - 1);
+  while (e->tri[h] >= 0) {
+    if (e->key[h] == key)
+      return e->tri[h];
+    h = (h + 1) & (e->size - 1);
+  }
+  return -1;
+}
+
+static int third(const int *t, int a, int b) {
+  for (int k = 0; k < 3; k++)
+    if (t[k] != a && t[k] != b)
+      return t[k];
+  return -1;
+}
+
+/* Walk a strip forward from triangle t rotated by rot, over free (stamp 0)
+   triangles only. Triangles taken get mark; with out == NULL it only counts. */
+static int walk(const int *tri, const edges_t *e, int *stamp, int mark, int t, int rot,
+                ivec_t *out) {
+  const int *v = tri + t * 3;
+  int p = v[(rot + 1) % 3], q = v[(rot + 2) % 3];
+  int n = 1;
+
+  stamp[t] = mark;
+  if (out) {
+    ivec_push(out, v[rot]);
+    ivec_push(out, p);
+    ivec_push(out, q);
+  }
+  for (;;) {
+    // Triangle k of a strip is (p, q, r) for even k, (q, p, r) for odd
+    int nt = n & 1 ? edges_find(e, q, p) : edges_find(e, p, q);
+    int r;
+    if (nt < 0 || stamp[nt] != 0)
+      break;
+    r = third(tri + nt * 3, p, q);
+    stamp[nt] = mark;
+    if (out)
+      ivec_push(out, r);
+    p = q;
+    q = r;
+    n++;
+  }
+  return n;
+}
+
+/* Cut one group's triangles into strips */
+static void stripify_group(const obj_t *o, const int *list, int n, strips_t *s) {
+  const int *tri = o->tris.data;
+  int ntris = o->tris.len / 3;
+  int *stamp = malloc(ntris * sizeof(int));
+  int *free_nb = calloc(ntris, sizeof(int));
+  int left = n;
+  edges_t e;
+
+  edges_build(&e, tri, list, n);
+  // Only this group's triangles are candidates, everything else counts as used
+  for (int i = 0; i < ntris; i++)
+    stamp[i] = -1;
+  for (int i = 0; i < n; i++)
+    stamp[list[i]] = 0;
+  for (int i = 0; i < n; i++) {
+    const int *t = tri + list[i] * 3;
+    for (int k = 0; k < 3; k++)
+      if (edges_find(&e, t[(k + 1) % 3], t[k]) >= 0)
+        free_nb[list[i]]++;
+  }
+
+  while (left > 0) {
+    int start = -1, best_rot = 0, best_len = 0;
+    // Fewest free neighbours first: corners and edges of the mesh, which
+    // would otherwise end up as strips of one
+    for (int i = 0; i < n; i++) {
+      int t = list[i];
+      if (stamp[t] == 0 && (start < 0 || free_nb[t] < free_nb[start]))
+        start = t;
+    }
+    for (int rot = 0; rot < 3; rot++) {
+      // Trial runs stamp 2, then give the triangles back
+      int len = walk(tri, &e, stamp, 2, start, rot, NULL);
+      for (int i = 0; i < n; i++)
+        if (stamp[list[i]] == 2)
+          stamp[list[i]] = 0;
+      if (len > best_len) {
+        best_len = len;
+        best_rot = rot;
+      }
+    }
+    ivec_push(&s->strip_first, s->index.len);
+    walk(tri, &e, stamp, 1, start, best_rot, &s->index);
+    left -= best_len;
+    // Keep the neighbour counts honest for the next start
+    for (int i = 0; i < n; i++) {
+      int t = list[i];
+      if (stamp[t] != 0)
+        continue;
+      free_nb[t] = 0;
+      for (int k = 0; k < 3; k++) {
+        int nb = edges_find(&e, tri[t * 3 + (k + 1) % 3], tri[t * 3 + k]);
+        if (nb >= 0 && stamp[nb] == 0)
+          free_nb[t]++;
+      }
+    }
+  }
+  free(e.key);
+  free(e.tri);
+  free(stamp);
+  free(free_nb);
+}
+
+static void stripify(const obj_t *o, strips_t *s) {
+  ivec_t list = {0};
+
+  memset(s, 0, sizeof(*s));
+  for (int g = 0; g < o->ngroups; g++) {
+    list.len = 0;
+    for (int t = 0; t < o->tri_group.len; t++)
+      if (o->tri_group.data[t] == g)
+        ivec_push(&list, t);
+    ivec_push(&s->group_first, s->strip_first.len);
+    if (list.len)
+      stripify_group(o, list.data, list.len, s);
+  }
+  ivec_push(&s->group_first, s->strip_first.len);
+  ivec_push(&s->strip_first, s->index.len);
+  free(list.data);
+}
+
+/* Join the strips of each group into one, through degenerate triangles:
+   A ... a, b, B ... with one more b when A is odd, so B keeps its winding.
+   Costs two or three vertices a join and saves an EOL and a TA strip start. */
+static void stitch(strips_t *s) {
+  strips_t out;
+  int groups = s->group_first.len - 1;
+
+  memset(&out, 0, sizeof(out));
+  for (int g = 0; g < groups; g++) {
+    int s0 = s->group_first.data[g], s1 = s->group_first.data[g + 1];
+    ivec_push(&out.group_first, out.strip_first.len);
+    if (s0 == s1)
+      continue;
+    ivec_push(&out.strip_first, out.index.len);
+    for (int k = s0; k < s1; k++) {
+      int first = s->strip_first.data[k], end = s->strip_first.data[k + 1];
+      if (k > s0) {
+        int len = out.index.len - out.strip_first.data[out.strip_first.len - 1];
+        ivec_push(&out.index, out.index.data[out.index.len - 1]);
+        ivec_push(&out.index, s->index.data[first]);
+        if (len & 1)
+          ivec_push(&out.index, s->index.data[first]);
+      }
+      for (int i = first; i < end; i++)
+        ivec_push(&out.index, s->index.data[i]);
+    }
+  }
+  ivec_push(&out.group_first, out.strip_first.len);
+  ivec_push(&out.strip_first, out.index.len);
+  strips_free(s);
+  *s = out;
+}
+
+static int write_mesh(const char *filename, const obj_t *o, const strips_t *s) {
+  int strips = s->strip_first.len - 1;
+  mesh_layout_t l;
+  mesh_hdr_t *h;
+  uint8_t *buf;
+  FILE *fp;
+
+  mesh_layout(o->nverts, o->ngroups, strips, s->index.len, &l);
+  buf = calloc(1, l.end);
+  h = (mesh_hdr_t *)buf;
+  memcpy(h->fourcc, MESH_FOURCC, 4);
+  h->vert_count = o->nverts;
+  h->group_count = o->ngroups;
+  h->strip_count = strips;
+  h->index_count = s->index.len;
+  h->file_size = l.end;
+  for (int v = 0; v < o->nverts; v++) {
+    const float *p = o->pos + o->vpos[v] * 3;
+    const float *t = o->vtex[v] >= 0 ? o->tex + o->vtex[v] * 2 : NULL;
+    ((float *)(buf + l.x))[v] = p[0];
+    ((float *)(buf + l.y))[v] = p[1];
+    ((float *)(buf + l.z))[v] = p[2];
+    // OBJ puts v = 0 at the bottom of the image, the PVR at the top
+    ((float *)(buf + l.u))[v] = t ? t[0] : 0.0f;
+    ((float *)(buf + l.v))[v] = t ? 1.0f - t[1] : 0.0f;
+  }
+  for (int g = 0; g <= o->ngroups; g++)
+    ((uint32_t *)(buf + l.group_first))[g] = s->group_first.data[g];
+  for (int i = 0; i <= strips; i++)
+    ((uint32_t *)(buf + l.strip_first))[i] = s->strip_first.data[i];
+  for (int i = 0; i < s->index.len; i++)
+    ((uint16_t *)(buf + l.index))[i] = s->index.data[i];
+
+  fp = fopen(filename, "wb");
+  if (fp == NULL || fwrite(buf, 1, l.end, fp) != l.end) {
+    perror(filename);
+    free(buf);
+    if (fp)
+      fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+  free(buf);
+  return 1;
+}
+
+static void report_strips(const char *what, const obj_t *o, const strips_t *s) {
+  int tris = o->tris.len / 3, strips = s->strip_first.len - 1;
+  printf("  %-22s %6d in %d strips, %.2f per triangle (list 3.00)\n", what,
+         s->index.len, strips, tris ? (double)s->index.len / tris : 0.0);
+}
+
+static void report(const char *in, const obj_t *o) {
+  int tris = o->tris.len / 3;
+  printf("%s: %d triangles in %d groups\n", in, tris, o->ngroups);
+  printf("  vertices transformed   %6d unique (triangle list %d, OBJ positions %d)\n",
+         o->nverts, tris * 3, o->npos);
+}
+
+static void time_loads(const char *in, const char *out) {
+  int runs = 0;
+  double t0 = now_s(), obj_us, msh_us;
+  mesh_t m;
+
+  do {
+    obj_t o;
+    strips_t s;
+    load_obj(in, &o);
+    stripify(&o, &s);
+    strips_free(&s);
+    obj_free(&o);
+    runs++;
+  } while (now_s() - t0 < 0.5);
+  obj_us = (now_s() - t0) * 1e6 / runs;
+
+  runs = 0;
+  t0 = now_s();
+  do {
+    mesh_load(out, &m);
+    mesh_unload(&m);
+    runs++;
+  } while (now_s() - t0 < 0.5);
+  msh_us = (now_s() - t0) * 1e6 / runs;
+
+  printf("  load time (host)       OBJ parse and strip %.1f us, mesh_load %.1f us, %.0fx\n",
+         obj_us, msh_us, obj_us / msh_us);
+}
+
+int main(int argc, char *argv[]) {
+  const char *in = NULL, *out = NULL;
+  int timing = 0, quiet = 0, stitched = 0;
+  obj_t o;
+  strips_t s;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-i") && i + 1 < argc)
+      in = argv[++i];
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      out = argv[++i];
+    else if (!strcmp(argv[i], "-t"))
+      timing = 1;
+    else if (!strcmp(argv[i], "-q"))
+      quiet = 1;
+    else if (!strcmp(argv[i], "-s"))
+      stitched = 1;
+    else
+      in = NULL, i = argc;
+  }
+  if (in == NULL || out == NULL) {
+    fprintf(stderr, "usage: meshconv -i mesh.obj -o mesh.msh [-s] [-t] [-q]\n");
+    return 1;
+  }
+
+  if (!load_obj(in, &o))
+    return 1;
+  stripify(&o, &s);
+  if (!quiet) {
+    report(in, &o);
+    report_strips("vertices submitted", &o, &s);
+  }
+  if (stitched) {
+    stitch(&s);
+    if (!quiet)
+      report_strips("stitched", &o, &s);
+  }
+  if (!write_mesh(out, &o, &s))
+    return 1;
+  if (timing)
+    time_loads(in, out);
+  strips_free(&s);
+  obj_free(&o);
+  return 0;
+}
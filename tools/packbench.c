@@ -0,0 +1,267 @@
+/********************************************************************************************/
+/* Host tool: asset pack loader benchmark                                                   */
+/********************************************************************************************/
+/* Name:     packbench.c                                                                    */
+/* Title:    Loading each prefetch group of a pack off a simulated GD-ROM                   */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   The drive is a virtual clock, as in iosim: every read costs a command, a seek when     */
+/*   the head has to move and len / rate. Each group of the pack is loaded three ways:      */
+/*                                                                                          */
+/*     loose     - the same files on an ISO9660 disc in path order, each open a lookup in   */
+/*                 the directory, one sector, then a read of the file                       */
+/*     pack      - through lzpack_read(), a read of each file's packed bytes                */
+/*     prefetch  - lzpack_prefetch() then lzpack_read(), one read for the group             */
+/*                                                                                          */
+/*   Both pack runs go through ../lzpack.h as the demos do and compare every file with      */
+/*   the pack decoded from memory. Reading the index is once per boot and shown on its      */
+/*   own. The exit status is non-zero if a file differs or a prefetched group took more     */
+/*   than one read.                                                                         */
+/*                                                                                          */
+/* Usage:    packbench -p romdisk.lzp [-g group] [-r KB/s] [-k seek_ms] [-c command_ms]     */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lzpack.h"
+
+#define SECTOR 2048
+#define LOOSE_DIR 0x8000     // where the directory is, the files follow it
+
+typedef struct {
+  double rate;          // bytes per second
+  uint64_t seek_us, command_us;
+  uint32_t head;
+  uint64_t now_us;
+  uint32_t reads, seeks;
+  uint64_t bytes;
+  const uint8_t *image; // the pack, the loose run only counts
+  size_t size;
+} drive_t;
+
+static drive_t drive;
+
+static void drive_reset(void) {
+  drive.head = 0;
+  drive.now_us = 0;
+  drive.reads = drive.seeks = 0;
+  drive.bytes = 0;
+}
+
+static void drive_account(uint32_t offset, uint32_t len) {
+  drive.now_us += drive.command_us;
+  if (offset != drive.head) {
+    drive.now_us += drive.seek_us;
+    drive.seeks++;
+  }
+  drive.now_us += (uint64_t)(len * 1e6 / drive.rate);
+  drive.head = offset + len;
+  drive.reads++;
+  drive.bytes += len;
+}
+
+/* lzpack_io_t.read */
+static int drive_read(void *ctx, uint32_t offset, void *buf, uint32_t len) {
+  (void)ctx;
+  if ((uint64_t)offset + len > drive.size)
+    return 0;
+  drive_account(offset, len);
+  memcpy(buf, drive.image + offset, len);
+  return 1;
+}
+
+static void report(const char *label, uint32_t files, uint64_t us) {
+  printf("  %-10s %3u files %4u reads %4u seeks %8.1f KB %9.1f ms\n", label, (unsigned)files,
+         (unsigned)drive.reads, (unsigned)drive.seeks, drive.bytes / 1024.0, us / 1000.0);
+}
+
+static const char *sort_names;
+
+static int by_name(const void *a, const void *b) {
+  return strcmp(sort_names + (*(const lzpack_entry_t *const *)a)->name,
+                sort_names + (*(const lzpack_entry_t *const *)b)->name);
+}
+
+/* Where each file would be on an ISO9660 disc, path order from LOOSE_DIR + a sector */
+static uint32_t loose_offset(const lzpack_entry_t **sorted, const lzpack_entry_t *e) {
+  uint32_t offset = LOOSE_DIR + SECTOR;
+  for (const lzpack_entry_t **s = sorted; *s != e; s++)
+    offset += ((*s)->size + SECTOR - 1) & ~(SECTOR - 1);
+  return offset;
+}
+
+/* Load one group three ways, 0 if anything went wrong */
+static int bench_group(lzpack_t *ram, const lzpack_entry_t **sorted, const lzpack_group_t *g,
+                       double *saved_ms) {
+  const char *name = ram->names + g->name;
+  const lzpack_entry_t *files[ram->files];
+  uint32_t nfiles = 0, g_index = g - ram->group;
+  uint64_t loose_us, pack_us = 0, prefetch_us = 0;
+  lzpack_io_t io = {drive_read, NULL};
+  lzpack_t lz;
+  int ok = 1;
+
+  for (uint32_t i = 0; i < ram->files; i++)
+    if (sorted[i]->group == g_index)
+      files[nfiles++] = sorted[i];
+  printf("%s: %u files, %u bytes packed\n", name, (unsigned)nfiles, (unsigned)g->bytes);
+
+  // Loose files, two reads an open
+  drive_reset();
+  for (uint32_t i = 0; i < nfiles; i++) {
+    drive_account(LOOSE_DIR, SECTOR);
+    drive_account(loose_offset(sorted, files[i]), files[i]->size);
+  }
+  loose_us = drive.now_us;
+  report("loose", nfiles, loose_us);
+
+  // The pack, with and without the prefetch
+  for (int prefetch = 0; prefetch < 2; prefetch++) {
+    uint64_t t0;
+
+    drive_reset();
+    if (!lzpack_open_io(&lz, &io))
+      return 0;
+    // From the index on, the head where reading it left it
+    t0 = drive.now_us;
+    drive.reads = drive.seeks = 0;
+    drive.bytes = 0;
+    if (prefetch && !lzpack_prefetch(&lz, name)) {
+      lzpack_close(&lz);
+      return 0;
+    }
+    for (uint32_t i = 0; i < nfiles; i++) {
+      const lzpack_entry_t *e = lzpack_find(&lz, ram->names + files[i]->name);
+      uint8_t *got = malloc(files[i]->size + 1), *want = malloc(files[i]->size + 1);
+      if (e == NULL || got == NULL || want == NULL || !lzpack_read(&lz, e, got) ||
+          !lzpack_read(ram, files[i], want) || memcmp(got, want, files[i]->size)) {
+        printf("Error: %s differs from the pack in memory\n", ram->names + files[i]->name);
+        ok = 0;
+      }
+      free(got);
+      free(want);
+    }
+    if (prefetch && drive.reads > 1) {
+      printf("Error: prefetching %s took %u reads\n", name, (unsigned)drive.reads);
+      ok = 0;
+    }
+    if (prefetch)
+      prefetch_us = drive.now_us - t0;
+    else
+      pack_us = drive.now_us - t0;
+    report(prefetch ? "prefetch" : "pack", nfiles, drive.now_us - t0);
+    lzpack_close(&lz);
+  }
+  printf("  prefetch %.1fx faster than loose, %.1fx than the pack file by file\n",
+         prefetch_us ? (double)loose_us / prefetch_us : 0.0,
+         prefetch_us ? (double)pack_us / prefetch_us : 0.0);
+  *saved_ms += (loose_us - (double)prefetch_us) / 1000.0;
+  return ok;
+}
+
+static uint8_t *read_file(const char *filename, size_t *size) {
+  FILE *fp = fopen(filename, "rb");
+  uint8_t *data = NULL;
+  long len;
+
+  if (fp == NULL || fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < 0 ||
+      fseek(fp, 0, SEEK_SET) != 0 || (data = malloc(len ? len : 1)) == NULL ||
+      fread(data, 1, len, fp) != (size_t)len) {
+    fprintf(stderr, "Error: can't read %s\n", filename);
+    free(data);
+    data = NULL;
+  } else {
+    *size = len;
+  }
+  if (fp != NULL)
+    fclose(fp);
+  return data;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: packbench -p romdisk.lzp [-g group] [-r KB/s] [-k seek_ms] [-c command_ms]\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *pack = NULL, *group = NULL;
+  double rate = 600, seek_ms = 120, command_ms = 1, saved_ms = 0;
+  lzpack_io_t io = {drive_read, NULL};
+  lzpack_t ram, lz;
+  const lzpack_entry_t **sorted;
+  uint8_t *image;
+  size_t size;
+  int ok = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 == argc) {
+      usage();
+      return 1;
+    }
+    if (!strcmp(argv[i], "-p"))
+      pack = argv[++i];
+    else if (!strcmp(argv[i], "-g"))
+      group = argv[++i];
+    else if (!strcmp(argv[i], "-r"))
+      rate = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-k"))
+      seek_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-c"))
+      command_ms = atof(argv[++i]);
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (pack == NULL || rate <= 0 || seek_ms < 0 || command_ms < 0) {
+    usage();
+    return 1;
+  }
+  if ((image = read_file(pack, &size)) == NULL)
+    return 1;
+  if (!lzpack_open(&ram, image, size)) {
+    fprintf(stderr, "Error: %s is not an " LZPACK_FOURCC " pack\n", pack);
+    return 1;
+  }
+  if (ram.groups == 0) {
+    fprintf(stderr, "Error: %s has no groups, pack it with lzpack -g\n", pack);
+    return 1;
+  }
+  if (group != NULL && lzpack_find_group(&ram, group) == NULL) {
+    fprintf(stderr, "Error: no group %s in %s\n", group, pack);
+    return 1;
+  }
+  drive.rate = rate * 1024;
+  drive.seek_us = (uint64_t)(seek_ms * 1000.0);
+  drive.command_us = (uint64_t)(command_ms * 1000.0);
+  drive.image = image;
+  drive.size = size;
+
+  if ((sorted = malloc(ram.files * sizeof(*sorted) + 1)) == NULL)
+    return 1;
+  for (uint32_t i = 0; i < ram.files; i++)
+    sorted[i] = &ram.entry[i];
+  sort_names = ram.names;
+  qsort(sorted, ram.files, sizeof(*sorted), by_name);
+
+  printf("drive %.0f KB/s, seek %.0f ms, %.1f ms a command\n", rate, seek_ms, command_ms);
+  drive_reset();
+  if (!lzpack_open_io(&lz, &io))
+    return 1;
+  printf("index: %u reads, %u bytes, %.1f ms once at boot\n", (unsigned)drive.reads,
+         (unsigned)drive.bytes, drive.now_us / 1000.0);
+  lzpack_close(&lz);
+
+  for (uint32_t g = 0; g < ram.groups; g++) {
+    if (group != NULL && strcmp(group, ram.names + ram.group[g].name))
+      continue;
+    ok &= bench_group(&ram, sorted, &ram.group[g], &saved_ms);
+  }
+  printf("prefetching saves %.1f ms of loading against loose files\n", saved_ms);
+  free(sorted);
+  free(image);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+/********************************************************************************************/
+/* Host tool: input service check                                                           */
+/********************************************************************************************/
+/* Name:     padcheck.c                                                                     */
+/* Title:    Edge events and the lock-free snapshot of padinput.h                           */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Scripted polls on a virtual clock check the press, release and repeat events a reader  */
+/*   gets: one read per poll, several polls per read, taps shorter than a frame, an even    */
+/*   number of taps cancelling, two pads merged. Then a poller thread publishes as fast as  */
+/*   it can while a reader thread reads, every snapshot carrying values derived from its    */
+/*   sequence number; a read that mixes two snapshots is torn. Exits non-zero on any wrong  */
+/*   event or torn read.                                                                    */
+/*                                                                                          */
+/* Usage:    padcheck [-n stress_reads]                                                     */
+/********************************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../padinput.h"
+
+/* The controller bits the script uses, as in KOS */
+#define BTN_A     (1 << 2)
+#define BTN_RIGHT (1 << 7)
+
+static int failures;
+
+static void expect(const char *what, unsigned got, unsigned want) {
+  if (got != want) {
+    printf("FAIL: %s: got 0x%04x, want 0x%04x\n", what, got, want);
+    failures++;
+  }
+}
+
+static void poll_at(padinput_t *p, uint32_t pad0, uint32_t pad1, int ports, uint64_t t) {
+  padinput_raw_t raw[PADINPUT_PORTS];
+  memset(raw, 0, sizeof(raw));
+  raw[0].buttons = pad0;
+  raw[1].buttons = pad1;
+  raw[0].joyx = 100;
+  raw[1].joyx = 100;
+  padinput_update(p, raw, ports, t);
+}
+
+static void check_events(void) {
+  static const padinput_backend_t none = { NULL, NULL, NULL };
+  padinput_t p;
+  padinput_view_t v;
+  uint64_t t = 1000;
+
+  padinput_init(&p, &none, 4000);
+  memset(&v, 0, sizeof(v));
+
+  // Press, hold, release, one read per poll
+  poll_at(&p, BTN_A, 0, 1, t);
+  padinput_read(&p, &v);
+  expect("press", v.pressed, BTN_A);
+  expect("held", v.snap.buttons, BTN_A);
+  poll_at(&p, BTN_A, 0, 1, t += 4000);
+  padinput_read(&p, &v);
+  expect("no second press while held", v.pressed, 0);
+  poll_at(&p, 0, 0, 1, t += 4000);
+  padinput_read(&p, &v);
+  expect("release", v.released, BTN_A);
+  expect("nothing held", v.snap.buttons, 0);
+
+  // A tap between two reads still shows, four polls a frame
+  poll_at(&p, 0, 0, 1, t += 4000);
+  poll_at(&p, BTN_RIGHT, 0, 1, t += 4000);
+  poll_at(&p, 0, 0, 1, t += 4000);
+  poll_at(&p, 0, 0, 1, t += 4000);
+  padinput_read(&p, &v);
+  expect("tap press", v.pressed, BTN_RIGHT);
+  expect("tap release", v.released, BTN_RIGHT);
+  expect("tap not held", v.snap.buttons, 0);
+  padinput_read(&p, &v);
+  expect("events only once", v.pressed | v.released, 0);
+
+  // Events are parity: two taps between reads cancel, a third shows again
+  for (int taps = 1; taps <= 3; taps++) {
+    for (int i = 0; i < taps; i++) {
+      poll_at(&p, BTN_A, 0, 1, t += 4000);
+      poll_at(&p, 0, 0, 1, t += 4000);
+    }
+    padinput_read(&p, &v);
+    expect(taps == 2 ? "two taps cancel" : "odd taps show", v.pressed, taps & 1 ? BTN_A : 0);
+  }
+
+  // Repeat after the delay, then at the rate
+  {
+    int repeats = 0;
+    uint64_t start = t += 4000;
+    poll_at(&p, BTN_RIGHT, 0, 1, t);
+    padinput_read(&p, &v);
+    // Polls up to half a period past the fifth repeat
+    while (t < start + PADINPUT_REPEAT_DELAY_US + 4 * PADINPUT_REPEAT_RATE_US +
+                   PADINPUT_REPEAT_RATE_US / 2) {
+      poll_at(&p, BTN_RIGHT, 0, 1, t += 4000);
+      padinput_read(&p, &v);
+      if (v.repeat & BTN_RIGHT) {
+        if (repeats == 0)
+          expect("first repeat after the delay", t - start >= PADINPUT_REPEAT_DELAY_US, 1);
+        repeats++;
+      }
+    }
+    expect("repeats in delay + 5 periods", repeats, 5);
+    poll_at(&p, 0, 0, 1, t += 4000);
+    padinput_read(&p, &v);
+  }
+
+  // Two pads: buttons merged, a press on the second pad while the first
+  // holds it is no new press, sticks summed and clamped
+  poll_at(&p, BTN_A, 0, 3, t += 4000);
+  padinput_read(&p, &v);
+  expect("pad 1 press", v.pressed, BTN_A);
+  expect("sticks clamped", (uint16_t)v.snap.joyx, 127);
+  poll_at(&p, BTN_A, BTN_A, 3, t += 4000);
+  padinput_read(&p, &v);
+  expect("pad 2 joins the hold", v.pressed, 0);
+  poll_at(&p, 0, BTN_A, 3, t += 4000);
+  padinput_read(&p, &v);
+  expect("still held on pad 2", v.released, 0);
+  expect("ports", v.snap.ports, 3);
+  poll_at(&p, 0, 0, 1, t += 4000);
+  padinput_read(&p, &v);
+  expect("pad 2 gone, released", v.released, BTN_A);
+}
+
+/* Stress: every snapshot's fields are a function of its seq */
+static padinput_t stress;
+static volatile int stress_done;
+
+static void *poller(void *arg) {
+  padinput_raw_t raw[PADINPUT_PORTS];
+  (void)arg;
+  memset(raw, 0, sizeof(raw));
+  while (!stress_done) {
+    // published + 1 is the seq this update gets
+    uint32_t seq = stress.published + 1;
+    raw[0].buttons = seq & 0xffff;
+    raw[0].joyx = (int)(seq % 200) - 100;
+    raw[0].ltrig = seq % 251;
+    padinput_update(&stress, raw, 1, seq);
+  }
+  return NULL;
+}
+
+static int check_stress(long reads) {
+  static const padinput_backend_t none = { NULL, NULL, NULL };
+  padinput_view_t v;
+  pthread_t th;
+  long torn = 0, stale = 0;
+  uint32_t last = 0, seen = 0;
+
+  padinput_init(&stress, &none, 0);
+  memset(&v, 0, sizeof(v));
+  pthread_create(&th, NULL, poller, NULL);
+  for (long i = 0; i < reads; i++) {
+    uint32_t s;
+    padinput_read(&stress, &v);
+    s = v.snap.seq;
+    if (s == 0)
+      continue;
+    if (v.snap.buttons != (s & 0xffff) || v.snap.joyx != (int)(s % 200) - 100 ||
+        v.snap.ltrig != s % 251 || v.snap.time_us != s)
+      torn++;
+    if (s < last)
+      stale++;
+    if (s != last)
+      seen++;
+    last = s;
+  }
+  stress_done = 1;
+  pthread_join(th, NULL);
+
+  printf("stress: %ld reads, %u snapshots published, %u distinct seen, %u retries, "
+         "%ld torn, %ld went backwards\n",
+         reads, (unsigned)stress.published, (unsigned)seen, (unsigned)v.retries, torn, stale);
+  if (torn || stale) {
+    printf("FAIL: reader saw a mixed or older snapshot\n");
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  long reads = 20000000;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      reads = atol(argv[++i]);
+    else {
+      fprintf(stderr, "usage: padcheck [-n stress_reads]\n");
+      return 1;
+    }
+  }
+
+  check_events();
+  printf("events: %s\n", failures ? "FAIL" : "ok");
+  printf("snapshot: %u bytes, %u aligned\n", (unsigned)sizeof(padinput_snap_t),
+         (unsigned)__alignof__(padinput_snap_t));
+  if (sizeof(padinput_snap_t) != 32) {
+    printf("FAIL: snapshot is not one cache line\n");
+    failures++;
+  }
+  if (!check_stress(reads))
+    failures++;
+  if (failures == 0)
+    printf("PASS\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+/********************************************************************************************/
+/* Host tool: pad recording compiler and dumper                                             */
+/********************************************************************************************/
+/* Name:     padrec.c                                                                       */
+/* Title:    Text scripts to padrec.h recordings and back                                   */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Benchmark scenarios are written as text, one line per stretch of steps:               */
+/*                                                                                          */
+/*     hz 60                       steps per second, before the first step line             */
+/*     120                         120 steps, nothing held                                  */
+/*     1 RIGHT                     one step holding the D-pad right: a press                */
+/*     300 A X joyx=-40 rtrig=255  300 steps; the buttons let go of are released            */
+/*                                                                                          */
+/*   Buttons: A B C D X Y Z START UP DOWN LEFT RIGHT. Keys: joyx joyy (-128 to 127), ltrig  */
+/*   rtrig (0 to 255), pressed released (hex masks, when they are not just the difference  */
+/*   from the line before, like a tap within one step). # starts a comment.                */
+/*                                                                                          */
+/*   -d prints a recording in the same syntax, so a session recorded on the Dreamcast can   */
+/*   be edited and compiled again.                                                          */
+/*                                                                                          */
+/* Usage:    padrec -i script.txt -o out.pad                                                */
+/*           padrec -d in.pad                                                               */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../padrec.h"
+
+/* KOS cont_state_t button bits */
+static const struct {
+  const char *name;
+  uint16_t bit;
+} buttons[] = {
+  { "C", 1 << 0 },     { "B", 1 << 1 },    { "A", 1 << 2 },     { "START", 1 << 3 },
+  { "UP", 1 << 4 },    { "DOWN", 1 << 5 }, { "LEFT", 1 << 6 },  { "RIGHT", 1 << 7 },
+  { "Z", 1 << 8 },     { "Y", 1 << 9 },    { "X", 1 << 10 },    { "D", 1 << 11 },
+};
+#define NUM_BUTTONS (int)(sizeof(buttons) / sizeof(buttons[0]))
+
+static int compile(const char *in, const char *out) {
+  FILE *fp = fopen(in, "r");
+  char line[512];
+  int lineno = 0;
+  uint16_t held = 0;
+  padrec_t r;
+
+  if (fp == NULL) {
+    perror(in);
+    return 1;
+  }
+  padrec_init(&r, 60);
+  while (fgets(line, sizeof(line), fp)) {
+    char *tok, *save;
+    padrec_rec_t rec;
+    long steps;
+    int explicit_pressed = 0, explicit_released = 0;
+
+    lineno++;
+    if ((tok = strchr(line, '#')) != NULL)
+      *tok = '\0';
+    tok = strtok_r(line, " \t\r\n", &save);
+    if (tok == NULL)
+      continue;
+    if (!strcmp(tok, "hz")) {
+      tok = strtok_r(NULL, " \t\r\n", &save);
+      if (tok == NULL || r.hdr.steps || atoi(tok) <= 0) {
+        fprintf(stderr, "%s:%d: hz needs a rate, before the first step\n", in, lineno);
+        return 1;
+      }
+      r.hdr.hz = (uint16_t)atoi(tok);
+      continue;
+    }
+    steps = strtol(tok, NULL, 10);
+    if (steps <= 0) {
+      fprintf(stderr, "%s:%d: expected a step count, got '%s'\n", in, lineno, tok);
+      return 1;
+    }
+    memset(&rec, 0, sizeof(rec));
+    while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+      char *eq = strchr(tok, '=');
+      int b;
+      if (eq) {
+        long v;
+        *eq++ = '\0';
+        v = strtol(eq, NULL, 0);
+        if (!strcmp(tok, "joyx") && v >= -128 && v <= 127)
+          rec.joyx = (int8_t)v;
+        else if (!strcmp(tok, "joyy") && v >= -128 && v <= 127)
+          rec.joyy = (int8_t)v;
+        else if (!strcmp(tok, "ltrig") && v >= 0 && v <= 255)
+          rec.ltrig = (uint8_t)v;
+        else if (!strcmp(tok, "rtrig") && v >= 0 && v <= 255)
+          rec.rtrig = (uint8_t)v;
+        else if (!strcmp(tok, "pressed") && v >= 0 && v <= 0xffff) {
+          rec.pressed = (uint16_t)v;
+          explicit_pressed = 1;
+        } else if (!strcmp(tok, "released") && v >= 0 && v <= 0xffff) {
+          rec.released = (uint16_t)v;
+          explicit_released = 1;
+        } else {
+          fprintf(stderr, "%s:%d: bad %s=%s\n", in, lineno, tok, eq);
+          return 1;
+        }
+        continue;
+      }
+      for (b = 0; b < NUM_BUTTONS; b++) {
+        if (!strcasecmp(tok, buttons[b].name)) {
+          rec.buttons |= buttons[b].bit;
+          break;
+        }
+      }
+      if (b == NUM_BUTTONS) {
+        fprintf(stderr, "%s:%d: unknown button '%s'\n", in, lineno, tok);
+        return 1;
+      }
+    }
+    if (!explicit_pressed)
+      rec.pressed = rec.buttons & ~held;
+    if (!explicit_released)
+      rec.released = held & ~rec.buttons;
+    held = rec.buttons;
+    for (long s = 0; s < steps; s++) {
+      if (!padrec_add(&r, &rec))
+        return 1;
+      rec.pressed = rec.released = 0;
+    }
+  }
+  fclose(fp);
+
+  if (!padrec_save(out, &r))
+    return 1;
+  printf("%s: %u steps (%.1f s at %u Hz) in %u records, %u bytes\n", out,
+         (unsigned)r.hdr.steps, (double)r.hdr.steps / r.hdr.hz, (unsigned)r.hdr.hz,
+         (unsigned)r.hdr.rec_count,
+         (unsigned)(sizeof(padrec_hdr_t) + r.hdr.rec_count * sizeof(padrec_rec_t)));
+  padrec_free(&r);
+  return 0;
+}
+
+static int dump(const char *in) {
+  uint16_t held = 0;
+  padrec_t r;
+
+  if (!padrec_load(in, &r))
+    return 1;
+  printf("# %s: %u steps in %u records\nhz %u\n", in, (unsigned)r.hdr.steps,
+         (unsigned)r.hdr.rec_count, (unsigned)r.hdr.hz);
+  for (uint32_t i = 0; i < r.hdr.rec_count; i++) {
+    const padrec_rec_t *rec = &r.recs[i];
+    printf("%u", (unsigned)rec->repeat);
+    for (int b = 0; b < NUM_BUTTONS; b++) {
+      if (rec->buttons & buttons[b].bit)
+        printf(" %s", buttons[b].name);
+    }
+    if (rec->joyx)
+      printf(" joyx=%d", rec->joyx);
+    if (rec->joyy)
+      printf(" joyy=%d", rec->joyy);
+    if (rec->ltrig)
+      printf(" ltrig=%u", rec->ltrig);
+    if (rec->rtrig)
+      printf(" rtrig=%u", rec->rtrig);
+    if (rec->pressed != (rec->buttons & ~held))
+      printf(" pressed=0x%04x", rec->pressed);
+    if (rec->released != (held & ~rec->buttons))
+      printf(" released=0x%04x", rec->released);
+    printf("\n");
+    held = rec->buttons;
+  }
+  padrec_free(&r);
+  return 0;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: padrec -i script.txt -o out.pad\n"
+                  "       padrec -d in.pad\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *in = NULL, *out = NULL, *dumpfile = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    if (!strcmp(argv[i], "-i"))
+      in = argv[++i];
+    else if (!strcmp(argv[i], "-o"))
+      out = argv[++i];
+    else if (!strcmp(argv[i], "-d"))
+      dumpfile = argv[++i];
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (dumpfile)
+    return dump(dumpfile);
+  if (in == NULL || out == NULL) {
+    usage();
+    return 1;
+  }
+  return compile(in, out);
+}
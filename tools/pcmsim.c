@@ -0,0 +1,163 @@
+/********************************************************************************************/
+/* Host tool: PCM ring sizing simulator                                                     */
+/********************************************************************************************/
+/* Name:     pcmsim.c                                                                       */
+/* Title:    Underruns against capacity for cubemappedadx/pcmring.c                         */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Models one SH4 core on a 100 us clock. The main loop starts a frame at every vblank    */
+/*   and keeps the CPU for busy_ms, plus now and then a spike (texture regeneration, a      */
+/*   load). The decoder thread runs below it and fills the ring at decode_x times real      */
+/*   time whenever the main loop is idle. The AICA takes one chunk every chunk period no    */
+/*   matter what.                                                                           */
+/*                                                                                          */
+/*   Every capacity in the list is run with the same random seed and the smallest one       */
+/*   without an underrun is reported next to the 320KB snddrv pcm_buffer.                 */
+/*                                                                                          */
+/* Usage:    pcmsim [-r rate] [-c channels] [-k chunk_frames] [-s seconds] [-b busy_ms]     */
+/*                  [-S spike_max_ms] [-p spike_percent] [-x decode_x] [-m ms,ms,...]       */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cubemappedadx/pcmring.h"
+
+#define SIM_STEP_US   100
+#define SIM_VBLANK_US 16667
+#define SNDDRV_PCM_BYTES ((65536 + 16384) * 4)  // unsigned int pcm_buffer[] in snddrv.h
+
+typedef struct {
+  int rate, channels, chunk;
+  double seconds, busy_ms, spike_max_ms, spike_pct, decode_x;
+} params_t;
+
+static uint32_t lcg;
+
+static double frand(void) {
+  lcg = lcg * 1664525u + 1013904223u;
+  return (lcg >> 8) / 16777216.0;
+}
+
+static void simulate(const params_t *p, pcmring_t *r) {
+  uint64_t t, end = (uint64_t)(p->seconds * 1e6);
+  uint64_t busy_until = 0, next_vblank = 0;
+  double chunk_us = r->chunk_frames * 1e6 / p->rate;
+  double next_chunk = chunk_us;
+  double credit = 0.0;
+  double per_step = p->decode_x * p->rate * SIM_STEP_US / 1e6;
+
+  lcg = 12345;
+
+  // The decoder prebuffers a full ring before the stream starts
+  pcmring_commit(r, r->frames);
+  pcmring_reset_stats(r);
+
+  for (t = 0; t < end; t += SIM_STEP_US) {
+    if (t >= busy_until && t >= next_vblank) {
+      double work = p->busy_ms;
+      if (frand() * 100.0 < p->spike_pct)
+        work += frand() * p->spike_max_ms;
+      busy_until = t + (uint64_t)(work * 1000.0);
+      // pvr_wait_ready: the next frame can't start before the next vblank
+      while (next_vblank <= t)
+        next_vblank += SIM_VBLANK_US;
+    }
+    if (t >= busy_until) {
+      int n;
+      credit += per_step;
+      n = (int)credit;
+      if (n > pcmring_space(r))
+        n = pcmring_space(r);
+      pcmring_commit(r, n);
+      credit -= n;
+      if (pcmring_space(r) == 0)
+        credit = 0.0;  // a full ring puts the decoder to sleep
+    }
+    while (t >= next_chunk) {
+      int16_t scratch[4096];
+      pcmring_read(r, scratch, r->chunk_frames);
+      next_chunk += chunk_us;
+    }
+  }
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: pcmsim [-r rate] [-c channels] [-k chunk_frames] [-s seconds] "
+          "[-b busy_ms]\n"
+          "              [-S spike_max_ms] [-p spike_percent] [-x decode_x] "
+          "[-m ms,ms,...]\n");
+}
+
+int main(int argc, char *argv[]) {
+  params_t p = { 44100, 2, PCMRING_DEFAULT_CHUNK, 120.0, 12.0, 120.0, 2.0, 8.0 };
+  char list[256] = "25,50,75,100,125,150,200,250,300,400,500";
+  int safe_ms = -1, safe_bytes = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    if (!strcmp(argv[i], "-r"))
+      p.rate = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-c"))
+      p.channels = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-k"))
+      p.chunk = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s"))
+      p.seconds = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-b"))
+      p.busy_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-S"))
+      p.spike_max_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-p"))
+      p.spike_pct = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-x"))
+      p.decode_x = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-m"))
+      snprintf(list, sizeof(list), "%s", argv[++i]);
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (p.rate <= 0 || p.channels < 1 || p.channels > 2 || p.chunk <= 0 ||
+      p.chunk * p.channels > 4096) {
+    usage();
+    return 1;
+  }
+
+  printf("%d Hz x %d, chunk %d frames, %.0f s, main loop %.1f ms/frame, "
+         "%.1f%% spikes up to %.0f ms, decode %.1fx\n",
+         p.rate, p.channels, p.chunk, p.seconds, p.busy_ms, p.spike_pct,
+         p.spike_max_ms, p.decode_x);
+  printf("snddrv pcm_buffer: %d bytes\n\n", SNDDRV_PCM_BYTES);
+  printf("  ms   frames    bytes  underruns  silent frames  fill min\n");
+
+  for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+    pcmring_t r;
+    int ms = atoi(tok);
+    if (!pcmring_init(&r, p.rate, p.channels, ms, p.chunk))
+      return 1;
+    simulate(&p, &r);
+    printf("%4d  %7d  %7d  %9u  %13u  %8d\n", ms, r.frames, pcmring_bytes(&r),
+           (unsigned)r.underruns, (unsigned)r.underrun_frames, r.fill_min);
+    if (safe_ms < 0 && r.underruns == 0) {
+      safe_ms = ms;
+      safe_bytes = pcmring_bytes(&r);
+    }
+    pcmring_free(&r);
+  }
+
+  if (safe_ms < 0) {
+    printf("\nno capacity in the list ran without underruns\n");
+    return 1;
+  }
+  printf("\nsmallest safe: %d ms, %d bytes (%.1f%% of the snddrv buffer)\n", safe_ms,
+         safe_bytes, 100.0 * safe_bytes / SNDDRV_PCM_BYTES);
+  return 0;
+}
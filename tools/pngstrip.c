@@ -0,0 +1,172 @@
+/********************************************************************************************/
+/* Host tool: background strip cutter                                                       */
+/********************************************************************************************/
+/* Name:     pngstrip.c                                                                     */
+/* Title:    Full screen images to power of two texture strips, without resampling          */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   The PVR only takes power of two texture sizes, so a 640x480 background either gets     */
+/*   resampled into 512x512 or wastes most of a 1024x512. Cut into strips as wide as the    */
+/*   powers of two it is made of, 512 and 128, each as tall as the next power of two, it    */
+/*   fits in 640x512 texels and shows pixel for pixel. An image that is a power of two      */
+/*   wide already comes out as one strip.                                                   */
+/*                                                                                          */
+/*   Writes <prefix>_0.png, <prefix>_1.png, ... left to right, opaque RGB, padded by        */
+/*   repeating the last column and row so bilinear filtering has nothing dark to pull in    */
+/*   at the edges, and an index for the loader (pngzoom.c back_load()), little endian:      */
+/*                                                                                          */
+/*     char     magic[4]   "BGS1"                                                           */
+/*     uint16_t width      image width, the strips add up to at least this                  */
+/*     uint16_t height     image height, rows below it are padding                          */
+/*     uint16_t strips                                                                      */
+/*     uint16_t pad                                                                         */
+/*                                                                                          */
+/*   The strips go through pvrtex like any other texture, for VQ: pvrtex -f RGB565 -c.      */
+/*                                                                                          */
+/* Usage:    pngstrip -i image.png -o prefix -b index.bgs                                   */
+/********************************************************************************************/
+
+#include <png.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRIP_MIN 8    // smallest texture side
+#define STRIP_MAX 1024 // largest
+#define STRIPS_MAX 8   // what the loader has room for
+
+/* Largest power of two in n, STRIP_MIN for anything less */
+static int strip_width(int n) {
+  int w = STRIP_MAX;
+  while (w > STRIP_MIN && w > n)
+    w >>= 1;
+  return w;
+}
+
+static int pow2_above(int n) {
+  int p = STRIP_MIN;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+static int write_strip(const char *filename, const uint8_t *rgb, int width, int height, int x0,
+                       int w, int h) {
+  png_image img;
+  uint8_t *out = malloc((size_t)w * h * 3);
+  int ok;
+
+  if (out == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    return 0;
+  }
+  for (int y = 0; y < h; y++) {
+    int sy = y < height ? y : height - 1;
+    for (int x = 0; x < w; x++) {
+      int sx = x0 + x < width ? x0 + x : width - 1;
+      memcpy(&out[(y * w + x) * 3], &rgb[(sy * width + sx) * 3], 3);
+    }
+  }
+  memset(&img, 0, sizeof(img));
+  img.version = PNG_IMAGE_VERSION;
+  img.width = w;
+  img.height = h;
+  img.format = PNG_FORMAT_RGB;
+  ok = png_image_write_to_file(&img, filename, 0, out, 0, NULL);
+  if (!ok)
+    fprintf(stderr, "Error: %s: %s\n", filename, img.message);
+  free(out);
+  return ok;
+}
+
+static void put16(uint8_t *p, int v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: pngstrip -i image.png -o prefix -b index.bgs\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *in = NULL, *prefix = NULL, *index = NULL;
+  png_color black = {0, 0, 0};
+  png_image img;
+  uint8_t *rgb, hdr[12];
+  int width, height, tex_h, strips = 0;
+  FILE *fp;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "-i"))
+      in = argv[i + 1];
+    else if (!strcmp(argv[i], "-o"))
+      prefix = argv[i + 1];
+    else if (!strcmp(argv[i], "-b"))
+      index = argv[i + 1];
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (in == NULL || prefix == NULL || index == NULL || argc % 2 == 0) {
+    usage();
+    return 1;
+  }
+
+  memset(&img, 0, sizeof(img));
+  img.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(&img, in)) {
+    fprintf(stderr, "Error: %s: %s\n", in, img.message);
+    return 1;
+  }
+  // Backgrounds are opaque, anything see-through ends up on black
+  img.format = PNG_FORMAT_RGB;
+  rgb = malloc(PNG_IMAGE_SIZE(img));
+  if (rgb == NULL || !png_image_finish_read(&img, &black, rgb, 0, NULL)) {
+    fprintf(stderr, "Error: %s: %s\n", in, rgb ? img.message : "out of memory");
+    free(rgb);
+    return 1;
+  }
+  width = img.width;
+  height = img.height;
+  tex_h = pow2_above(height);
+  if (tex_h > STRIP_MAX) {
+    fprintf(stderr, "Error: %s is %d high, textures go up to %d\n", in, height, STRIP_MAX);
+    free(rgb);
+    return 1;
+  }
+
+  for (int x = 0; x < width; x += strip_width(width - x)) {
+    char name[1024];
+    int w = strip_width(width - x);
+    if (strips == STRIPS_MAX) {
+      fprintf(stderr, "Error: %s needs more than %d strips\n", in, STRIPS_MAX);
+      free(rgb);
+      return 1;
+    }
+    snprintf(name, sizeof(name), "%s_%d.png", prefix, strips);
+    if (!write_strip(name, rgb, width, height, x, w, tex_h)) {
+      free(rgb);
+      return 1;
+    }
+    printf("%s: %dx%d from x %d\n", name, w, tex_h, x);
+    strips++;
+  }
+  free(rgb);
+
+  memcpy(hdr, "BGS1", 4);
+  put16(hdr + 4, width);
+  put16(hdr + 6, height);
+  put16(hdr + 8, strips);
+  put16(hdr + 10, 0);
+  if ((fp = fopen(index, "wb")) == NULL || fwrite(hdr, sizeof(hdr), 1, fp) != 1) {
+    fprintf(stderr, "Error: can't write %s\n", index);
+    if (fp != NULL)
+      fclose(fp);
+    return 1;
+  }
+  fclose(fp);
+  printf("%s: %dx%d in %d strips\n", index, width, height, strips);
+  return 0;
+}
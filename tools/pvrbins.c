@@ -0,0 +1,380 @@
+/********************************************************************************************/
+/* Host tool: tile bin pressure of a recorded PVR stream                                    */
+/********************************************************************************************/
+/* Name:     pvrbins.c                                                                      */
+/* Title:    The smallest pvr_init_params_t bins and vertex buffer a run fits in            */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Bins every frame of a stream recorded with PVR_STREAM=<file> (see host/pvr.c) into     */
+/*   32x32 tiles with host/pvrraster.c and counts the object pointers the TA writes for     */
+/*   each tile and list: one per run of up to six triangles of a strip, one per array of    */
+/*   up to sixteen sprites sent back to back, one per modifier volume triangle. From those  */
+/*   it works out how many object pointer blocks (OPBs) every tile needs at 8, 16 and 32    */
+/*   words a block, how many spill into the overflow OPBs, and what the TA writes to the    */
+/*   vertex buffer. It then prints the opb_sizes, opb_overflow_count and vertex_buf_size    */
+/*   that hold the busiest frame with the least texture memory given up, next to what the   */
+/*   stream was recorded with. -m adds headroom in percent to the pointer counts and the    */
+/*   vertex buffer, -t prints the pointers per tile of the busiest frame of each list.      */
+/*                                                                                          */
+/*   The vertex buffer figure is worked out from the parameter formats rather than read     */
+/*   off a TA; check it against vtx_buffer_used_max from pvr_get_stats() on the hardware.   */
+/*                                                                                          */
+/* Usage:    pvrbins [-f first[-last]] [-m percent] [-t] stream.dcta                        */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host/pvrraster.h"
+
+#define SIZES  3                   /* PVR_BINSIZE_8, _16 and _32 */
+#define COMBOS 243                 /* SIZES to the power of PVRSTREAM_LISTS */
+
+static const char *names[PVRSTREAM_LISTS] = {"OP", "OP_MOD", "TR", "TR_MOD", "PT"};
+static const uint32_t sizes[SIZES] = {8, 16, 32};
+
+/* What one frame needs */
+typedef struct {
+  uint32_t frame;
+  uint32_t overflow[PVRSTREAM_LISTS][SIZES]; /* words past the first OPB of every tile */
+  uint32_t params;                 /* vertex buffer bytes */
+} frame_use_t;
+
+/* The worst of a list over all frames */
+typedef struct {
+  uint32_t pointers;               /* most in one tile */
+  uint32_t frame, tx, ty;          /* where */
+  uint32_t total;                  /* most in one frame */
+  uint32_t *map;                   /* per tile, the frame with the busiest tile */
+} list_use_t;
+
+/* Object pointers the TA writes for one tile and list. The triangles of a
+   bin are in the order they were sent. */
+static uint32_t tile_pointers(const pvrraster_t *r, const pvrraster_bin_t *bin) {
+  uint32_t pointers = 0, quads = 0, last_hdr = 0;
+  int64_t last_object = -1;
+  int last_run = -1;
+
+  for (uint32_t i = 0; i < bin->count; i++) {
+    const pvrraster_tri_t *t = &r->tri[bin->tri[i]];
+    if ((r->hdr[t->hdr].cmd >> 29) == PVRSTREAM_PARA_SPRITE) {
+      if (t->object == last_object)
+        continue;                  // the other half of the sprite
+      if (quads && quads < 16 && t->object == last_object + 1 && t->hdr == last_hdr) {
+        quads++;
+      } else {
+        pointers++;
+        quads = 1;
+      }
+      last_run = -1;
+    } else {
+      // A strip pointer has a mask of six triangles
+      int run = t->index / 6;
+      if (quads || t->object != last_object || run != last_run)
+        pointers++;
+      quads = 0;
+      last_run = run;
+    }
+    last_object = t->object;
+    last_hdr = t->hdr;
+  }
+  return pointers;
+}
+
+/* A block keeps its last word for the link to the next one, or the end of the list */
+static inline uint32_t opb_blocks(uint32_t pointers, uint32_t size) {
+  return pointers ? (pointers + size - 2) / (size - 1) : 1;
+}
+
+/* Bytes the TA writes to the vertex buffer for a frame: the ISP/TSP, TSP
+   and texture words for every strip, sprite and volume triangle, then the
+   vertices with the colours packed into a word each */
+static uint32_t param_bytes(const pvrstream_frame_t *f) {
+  const uint32_t *blk = (const uint32_t *)(f + 1);
+  pvrstream_kind_t kind = PVRSTREAM_NONE;
+  uint32_t words = 0, vert_words = 0, cmd = 0;
+  int vert_blocks = 1, in_strip = 0;
+
+  for (uint32_t b = 0; b < f->blocks;) {
+    const uint32_t *w = blk + b * 8;
+    uint32_t para = w[0] >> 29, list = (w[0] >> 24) & 7;
+
+    if (para == PVRSTREAM_PARA_POLY || para == PVRSTREAM_PARA_SPRITE) {
+      cmd = w[0];
+      in_strip = 0;
+      if (para == PVRSTREAM_PARA_SPRITE) {
+        kind = PVRSTREAM_SPRITE;
+        vert_blocks = 2;
+        b++;
+      } else if (list == 1 || list == 3) {
+        kind = PVRSTREAM_MOD;
+        vert_blocks = 2;
+        b++;
+      } else {
+        kind = PVRSTREAM_POLY;
+        vert_blocks = pvrstream_vert_blocks(cmd);
+        vert_words = 3 + 1 + ((cmd >> 2) & 1);
+        if (pvrstream_textured(cmd))
+          vert_words += cmd & 1 ? 1 : 2;
+        b += pvrstream_hdr_blocks(cmd);
+      }
+    } else if (para == PVRSTREAM_PARA_VERTEX) {
+      if (kind == PVRSTREAM_SPRITE) {
+        // Colours, A, B and C in full, D without z, the UVs of A, B and C
+        words += 3 + 2 + 11 + (pvrstream_textured(cmd) ? 3 : 0);
+      } else if (kind == PVRSTREAM_MOD) {
+        words += 3 + 9;
+      } else if (kind == PVRSTREAM_POLY) {
+        if (!in_strip)
+          words += 3;
+        words += vert_words;
+        in_strip = !(w[0] & PVRSTREAM_EOL);
+      }
+      b += vert_blocks;
+    } else {
+      if (para == PVRSTREAM_PARA_END)
+        kind = PVRSTREAM_NONE;
+      b++;
+    }
+  }
+  return words * 4;
+}
+
+/* Per list and tile: size words, once for each of the two buffers and once
+   more for every overflow set, and the vertex buffer twice */
+static uint32_t buffer_bytes(const uint32_t opb_sizes[PVRSTREAM_LISTS], uint32_t overflow,
+                             uint32_t vertex_buf_size, int tiles) {
+  uint32_t words = 0;
+  for (int l = 0; l < PVRSTREAM_LISTS; l++)
+    words += opb_sizes[l];
+  return 2 * (words * 4 * (uint32_t)tiles * (1 + overflow) + vertex_buf_size);
+}
+
+static int usage(void) {
+  fprintf(stderr, "usage: pvrbins [-f first[-last]] [-m percent] [-t] stream.dcta\n");
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  const char *in = NULL;
+  unsigned first = 0, last = 0xffffffffu;
+  int margin = 0, print_maps = 0, inited = 0, tiles = 0;
+  pvrstream_init_t init;
+  pvrstream_chunk_t chunk;
+  frame_use_t *frames = NULL;
+  uint32_t frame_count = 0, frame_cap = 0, *counts = NULL;
+  list_use_t use[PVRSTREAM_LISTS];
+  uint32_t best[PVRSTREAM_LISTS], best_overflow = 0, best_bytes = 0xffffffffu;
+  uint32_t max_params = 0, vertex_buf_size;
+  pvrraster_t r;
+  void *data;
+  FILE *fp;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+      if (sscanf(argv[++i], "%u-%u", &first, &last) == 1)
+        last = first;
+    } else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+      margin = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t"))
+      print_maps = 1;
+    else if (in == NULL && argv[i][0] != '-')
+      in = argv[i];
+    else
+      return usage();
+  }
+  if (in == NULL || margin < 0)
+    return usage();
+  if ((fp = pvrstream_open(in)) == NULL)
+    return 1;
+  memset(use, 0, sizeof(use));
+
+  while (pvrstream_next(fp, &chunk, &data)) {
+    if (pvrstream_is(&chunk, "INIT") && chunk.size >= sizeof(pvrstream_init_t)) {
+      if (inited) {
+        fprintf(stderr, "%s: pvr_init() twice, only the first run is looked at\n", in);
+        free(data);
+        break;
+      }
+      memcpy(&init, data, sizeof(init));
+      if (!(inited = pvrraster_init(&r, &init))) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(data);
+        fclose(fp);
+        return 1;
+      }
+      tiles = r.tiles_x * r.tiles_y;
+      counts = calloc((size_t)tiles * PVRSTREAM_LISTS, sizeof(*counts));
+      for (int l = 0; l < PVRSTREAM_LISTS; l++)
+        use[l].map = calloc(tiles, sizeof(*use[l].map));
+    } else if (inited && pvrstream_is(&chunk, "FRAM") && chunk.size >= sizeof(pvrstream_frame_t)) {
+      const pvrstream_frame_t *f = data;
+      if (chunk.size >= sizeof(*f) + f->blocks * 32u && f->frame >= first && f->frame <= last) {
+        uint32_t total[PVRSTREAM_LISTS] = {0};
+        frame_use_t *fu;
+
+        if (frame_count == frame_cap) {
+          uint32_t cap = frame_cap ? frame_cap * 2 : 256;
+          if ((fu = realloc(frames, cap * sizeof(*frames))) == NULL) {
+            fprintf(stderr, "Error: out of memory\n");
+            free(data);
+            break;
+          }
+          frames = fu;
+          frame_cap = cap;
+        }
+        if (!pvrraster_frame(&r, f)) {
+          fprintf(stderr, "Error: out of memory\n");
+          free(data);
+          break;
+        }
+        fu = &frames[frame_count++];
+        memset(fu, 0, sizeof(*fu));
+        fu->frame = f->frame;
+        fu->params = param_bytes(f);
+        if (fu->params > max_params)
+          max_params = fu->params;
+
+        for (int ty = 0; ty < r.tiles_y; ty++) {
+          for (int tx = 0; tx < r.tiles_x; tx++) {
+            for (int l = 0; l < PVRSTREAM_LISTS; l++) {
+              uint32_t n = tile_pointers(&r, pvrraster_bin(&r, tx, ty, l));
+              counts[l * tiles + ty * r.tiles_x + tx] = n;
+              total[l] += n;
+              if (n > use[l].pointers) {
+                use[l].pointers = n;
+                use[l].frame = f->frame;
+                use[l].tx = tx;
+                use[l].ty = ty;
+              }
+              n += (uint32_t)(((uint64_t)n * margin + 99) / 100);
+              for (int k = 0; k < SIZES; k++)
+                fu->overflow[l][k] += (opb_blocks(n, sizes[k]) - 1) * sizes[k];
+            }
+          }
+        }
+        for (int l = 0; l < PVRSTREAM_LISTS; l++) {
+          if (total[l] > use[l].total)
+            use[l].total = total[l];
+          if (use[l].pointers && use[l].frame == f->frame && use[l].map)
+            memcpy(use[l].map, &counts[l * tiles], tiles * sizeof(*counts));
+        }
+      }
+    } else if (inited) {
+      pvrraster_apply(&r, &chunk, data);
+    }
+    free(data);
+  }
+  fclose(fp);
+  if (!inited || frame_count == 0) {
+    fprintf(stderr, "%s: no frames\n", in);
+    if (inited)
+      pvrraster_free(&r);
+    return 1;
+  }
+
+  printf("%s: %u frames, %dx%d tiles%s\n", in, (unsigned)frame_count, r.tiles_x, r.tiles_y,
+         init.fsaa_enabled ? " (FSAA)" : "");
+  printf("  list    busiest tile          most a frame   overflow words at 8 / 16 / 32\n");
+  for (int l = 0; l < PVRSTREAM_LISTS; l++) {
+    uint32_t worst[SIZES] = {0};
+    if (use[l].total == 0)
+      continue;
+    for (uint32_t f = 0; f < frame_count; f++)
+      for (int k = 0; k < SIZES; k++)
+        if (frames[f].overflow[l][k] > worst[k])
+          worst[k] = frames[f].overflow[l][k];
+    printf("  %-6s %5u  (frame %u, %2u,%2u) %8u    %8u %8u %8u\n", names[l],
+           (unsigned)use[l].pointers, (unsigned)use[l].frame, (unsigned)use[l].tx,
+           (unsigned)use[l].ty, (unsigned)use[l].total, (unsigned)worst[0], (unsigned)worst[1],
+           (unsigned)worst[2]);
+  }
+
+  // Every size for every list in use, the overflow the busiest frame needs
+  // for each, and the lot that leaves the most texture memory
+  vertex_buf_size = max_params + (uint32_t)(((uint64_t)max_params * margin + 99) / 100);
+  vertex_buf_size = (vertex_buf_size + 0x7fff) & ~0x7fffu;
+  for (int combo = 0; combo < COMBOS; combo++) {
+    uint32_t opb[PVRSTREAM_LISTS], k[PVRSTREAM_LISTS], set = 0, need = 0, overflow, bytes;
+    int c = combo, valid = 1;
+    for (int l = 0; l < PVRSTREAM_LISTS; l++, c /= SIZES) {
+      k[l] = c % SIZES;
+      if (use[l].total == 0) {
+        opb[l] = 0;
+        valid &= k[l] == 0;
+      } else {
+        opb[l] = sizes[k[l]];
+      }
+      set += opb[l] * tiles;
+    }
+    if (!valid || set == 0)
+      continue;
+    for (uint32_t f = 0; f < frame_count; f++) {
+      uint32_t words = 0;
+      for (int l = 0; l < PVRSTREAM_LISTS; l++)
+        if (opb[l])
+          words += frames[f].overflow[l][k[l]];
+      if (words > need)
+        need = words;
+    }
+    overflow = (need + set - 1) / set;
+    bytes = buffer_bytes(opb, overflow, vertex_buf_size, tiles);
+    if (bytes < best_bytes || (bytes == best_bytes && overflow < best_overflow)) {
+      best_bytes = bytes;
+      best_overflow = overflow;
+      memcpy(best, opb, sizeof(best));
+    }
+  }
+
+  printf("vertex buffer: at most %u bytes a frame, recorded with %u\n", (unsigned)max_params,
+         (unsigned)init.vertex_buf_size);
+  if (best_bytes == 0xffffffffu) {
+    printf("nothing binned, no lists to size\n");
+  } else {
+    uint32_t now = buffer_bytes(init.opb_sizes, init.opb_overflow_count, init.vertex_buf_size,
+                                tiles);
+    printf("recommended%s:\n", margin ? "" : ", no headroom (-m)");
+    if (margin)
+      printf("  with %d%% headroom\n", margin);
+    printf("  opb_sizes          {PVR_BINSIZE_%u, PVR_BINSIZE_%u, PVR_BINSIZE_%u, "
+           "PVR_BINSIZE_%u, PVR_BINSIZE_%u}\n",
+           (unsigned)best[0], (unsigned)best[1], (unsigned)best[2], (unsigned)best[3],
+           (unsigned)best[4]);
+    printf("  vertex_buf_size    %u\n", (unsigned)vertex_buf_size);
+    printf("  opb_overflow_count %u\n", (unsigned)best_overflow);
+    printf("OPBs and vertex buffers, both buffers: %u bytes now, %u recommended, ", (unsigned)now,
+           (unsigned)best_bytes);
+    if (best_bytes <= now)
+      printf("%u back to textures\n", (unsigned)(now - best_bytes));
+    else
+      printf("%u short now: the recorded run overflows\n", (unsigned)(best_bytes - now));
+    for (int l = 0; l < PVRSTREAM_LISTS; l++) {
+      if (init.opb_sizes[l] == 0 && use[l].total)
+        printf("%s is in use but its bin size is 0\n", names[l]);
+      else if (init.opb_sizes[l] && use[l].total == 0)
+        printf("%s has nothing in it: size 0 only if it is never begun\n", names[l]);
+    }
+  }
+
+  if (print_maps) {
+    for (int l = 0; l < PVRSTREAM_LISTS; l++) {
+      if (use[l].total == 0)
+        continue;
+      printf("\n%s pointers per tile, frame %u:\n", names[l], (unsigned)use[l].frame);
+      for (int ty = 0; ty < r.tiles_y; ty++) {
+        for (int tx = 0; tx < r.tiles_x; tx++)
+          printf("%4u", (unsigned)use[l].map[ty * r.tiles_x + tx]);
+        printf("\n");
+      }
+    }
+  }
+
+  for (int l = 0; l < PVRSTREAM_LISTS; l++)
+    free(use[l].map);
+  free(counts);
+  free(frames);
+  pvrraster_free(&r);
+  return 0;
+}
@@ -0,0 +1,253 @@
+/********************************************************************************************/
+/* Host tool: reference renderer for recorded PVR streams                                   */
+/********************************************************************************************/
+/* Name:     pvrrender.c                                                                    */
+/* Title:    Recorded frames to PNG, and checked against known good images                  */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Draws the frames of a stream recorded with PVR_STREAM=<file> (see host/pvr.c) with     */
+/*   the tile rasterizer in host/pvrraster.c, 32x32 tiles shared between threads. -o        */
+/*   writes each frame as a PNG, the name a printf pattern given the frame number. -c       */
+/*   compares each frame with the PNG of the same number instead and prints PASS or FAIL,   */
+/*   so a change to the render code can be checked against images rendered before it from   */
+/*   a run replayed off the same pad recording. -t is how far a channel may be off before   */
+/*   a pixel counts as different, for changes that are meant to round differently.          */
+/*                                                                                          */
+/*   -d draws overdraw heatmaps instead (pvrraster_overdraw()): every triangle adds a       */
+/*   layer, and the colour says how many the TSP shaded. For each frame it also prints how  */
+/*   many pixels were shaded how many times, the layers depth tested and shaded per pixel,  */
+/*   and a map of the layers shaded per pixel in each tile, which is where translucent      */
+/*   fill is spent.                                                                         */
+/*                                                                                          */
+/* Usage:    pvrrender [-f first[-last]] [-j threads] [-d] [-o frame%04u.png]               */
+/*                     [-c golden%04u.png [-t tolerance]] stream.dcta                       */
+/********************************************************************************************/
+
+#include <png.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host/pvrraster.h"
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int write_png(const char *filename, const uint8_t *rgb) {
+  png_image img;
+  memset(&img, 0, sizeof(img));
+  img.version = PNG_IMAGE_VERSION;
+  img.width = PVRRASTER_W;
+  img.height = PVRRASTER_H;
+  img.format = PNG_FORMAT_RGB;
+  if (!png_image_write_to_file(&img, filename, 0, rgb, 0, NULL)) {
+    fprintf(stderr, "Error: %s: %s\n", filename, img.message);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Compare a frame with a PNG
+ *
+ * @param over Pixels with a channel more than tolerance off, out
+ * @return int The largest difference in any channel, -1 when the PNG can't be read
+ */
+static int compare_png(const char *filename, const uint8_t *rgb, int tolerance, int *over) {
+  png_image img;
+  uint8_t *ref;
+  int max = 0;
+
+  memset(&img, 0, sizeof(img));
+  img.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(&img, filename)) {
+    fprintf(stderr, "Error: %s: %s\n", filename, img.message);
+    return -1;
+  }
+  if (img.width != PVRRASTER_W || img.height != PVRRASTER_H) {
+    fprintf(stderr, "Error: %s is %ux%u, not %dx%d\n", filename, (unsigned)img.width,
+            (unsigned)img.height, PVRRASTER_W, PVRRASTER_H);
+    png_image_free(&img);
+    return -1;
+  }
+  img.format = PNG_FORMAT_RGB;
+  ref = malloc(PNG_IMAGE_SIZE(img));
+  if (ref == NULL || !png_image_finish_read(&img, NULL, ref, 0, NULL)) {
+    fprintf(stderr, "Error: %s: %s\n", filename, img.message);
+    free(ref);
+    return -1;
+  }
+  *over = 0;
+  for (int p = 0; p < PVRRASTER_W * PVRRASTER_H; p++) {
+    int worst = 0;
+    for (int k = 0; k < 3; k++) {
+      int d = abs(rgb[p * 3 + k] - ref[p * 3 + k]);
+      if (d > worst)
+        worst = d;
+    }
+    if (worst > tolerance)
+      (*over)++;
+    if (worst > max)
+      max = worst;
+  }
+  free(ref);
+  return max;
+}
+
+/* Layer counts of a frame from pvrraster_overdraw(), tiles left to right */
+static void print_overdraw(const pvrraster_t *r, const uint16_t *layers) {
+  uint64_t isp = 0, tsp = 0, hist[9] = {0};
+  int pixels = r->width * r->height;
+
+  for (int p = 0; p < pixels; p++) {
+    isp += layers[p * 2];
+    tsp += layers[p * 2 + 1];
+    hist[layers[p * 2 + 1] < 8 ? layers[p * 2 + 1] : 8]++;
+  }
+  printf("  per pixel %.2f layers tested, %.2f shaded; pixels shaded 0..8+ times:",
+         (double)isp / pixels, (double)tsp / pixels);
+  for (int n = 0; n < 9; n++)
+    printf(" %llu", (unsigned long long)hist[n]);
+  printf("\n  layers shaded per pixel, by tile:\n");
+  for (int ty = 0; ty < r->tiles_y; ty++) {
+    printf("  ");
+    for (int tx = 0; tx < r->tiles_x; tx++) {
+      uint32_t sum = 0;
+      for (int y = ty * PVRRASTER_TILE; y < (ty + 1) * PVRRASTER_TILE; y++)
+        for (int x = tx * PVRRASTER_TILE; x < (tx + 1) * PVRRASTER_TILE; x++)
+          sum += layers[(y * r->width + x) * 2 + 1];
+      printf("%4.1f", (double)sum / (PVRRASTER_TILE * PVRRASTER_TILE));
+    }
+    printf("\n");
+  }
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: pvrrender [-f first[-last]] [-j threads] [-d] [-o frame%%04u.png]\n"
+                  "                 [-c golden%%04u.png [-t tolerance]] stream.dcta\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *in = NULL, *out = NULL, *golden = NULL;
+  unsigned first = 0, last = 0xffffffffu;
+  int threads = (int)sysconf(_SC_NPROCESSORS_ONLN), tolerance = 0;
+  int rendered = 0, failed = 0, inited = 0, overdraw = 0;
+  double total_ms = 0.0;
+  pvrstream_chunk_t chunk;
+  pvrraster_t r;
+  uint16_t *layers = NULL;
+  uint8_t *rgb;
+  void *data;
+  FILE *fp;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+      if (sscanf(argv[++i], "%u-%u", &first, &last) == 1)
+        last = first;
+    } else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-d"))
+      overdraw = 1;
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      out = argv[++i];
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      golden = argv[++i];
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      tolerance = atoi(argv[++i]);
+    else if (in == NULL && argv[i][0] != '-')
+      in = argv[i];
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (in == NULL) {
+    usage();
+    return 1;
+  }
+  if (threads < 1)
+    threads = 1;
+  if ((fp = pvrstream_open(in)) == NULL)
+    return 1;
+  rgb = malloc(PVRRASTER_W * PVRRASTER_H * 3);
+  // Room for FSAA
+  if (overdraw && (layers = malloc(PVRRASTER_W * 2 * PVRRASTER_H * 2 * sizeof(*layers))) == NULL) {
+    free(rgb);
+    rgb = NULL;
+  }
+
+  while (rgb && pvrstream_next(fp, &chunk, &data)) {
+    if (pvrstream_is(&chunk, "INIT") && chunk.size >= sizeof(pvrstream_init_t)) {
+      if (inited)
+        pvrraster_free(&r);
+      if (!(inited = pvrraster_init(&r, data))) {
+        fprintf(stderr, "Error: out of memory\n");
+        failed++;
+      }
+    } else if (inited && pvrstream_is(&chunk, "FRAM") && chunk.size >= sizeof(pvrstream_frame_t)) {
+      const pvrstream_frame_t *f = data;
+      if (chunk.size >= sizeof(*f) + f->blocks * 32u && f->frame >= first && f->frame <= last) {
+        char name[1024];
+        double t0 = now_ms(), ms;
+        if (!pvrraster_frame(&r, f)) {
+          fprintf(stderr, "Error: out of memory\n");
+          failed++;
+          free(data);
+          break;
+        }
+        if (overdraw)
+          pvrraster_overdraw(&r, threads, layers, rgb);
+        else
+          pvrraster_render(&r, threads, rgb);
+        ms = now_ms() - t0;
+        total_ms += ms;
+        rendered++;
+        printf("frame %5u %7u triangles %6u culled %6.1f ms", (unsigned)f->frame,
+               (unsigned)r.tri_count, (unsigned)r.culled, ms);
+        if (r.skipped)
+          printf(", %u modifier volume not drawn", (unsigned)r.skipped);
+        if (out) {
+          snprintf(name, sizeof(name), out, (unsigned)f->frame);
+          if (!write_png(name, rgb))
+            failed++;
+        }
+        if (golden) {
+          int over = 0, max;
+          snprintf(name, sizeof(name), golden, (unsigned)f->frame);
+          max = compare_png(name, rgb, tolerance, &over);
+          if (max < 0 || over) {
+            printf("  FAIL");
+            failed++;
+          } else {
+            printf("  PASS");
+          }
+          if (max >= 0)
+            printf(" (max diff %d, %d pixels over %d)", max, over, tolerance);
+        }
+        printf("\n");
+        if (overdraw)
+          print_overdraw(&r, layers);
+      }
+    } else if (inited) {
+      pvrraster_apply(&r, &chunk, data);
+    }
+    free(data);
+  }
+  fclose(fp);
+  if (inited)
+    pvrraster_free(&r);
+  free(rgb);
+  free(layers);
+
+  printf("%d frames in %.1f ms on %d threads, %.2f ms a frame\n", rendered, total_ms, threads,
+         rendered ? total_ms / rendered : 0.0);
+  if (golden)
+    printf("%s\n", failed ? "FAIL" : "PASS");
+  return failed || rendered == 0 ? 1 : 0;
+}
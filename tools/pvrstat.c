@@ -0,0 +1,115 @@
+/********************************************************************************************/
+/* Host tool: submission statistics of a recorded PVR stream                                */
+/********************************************************************************************/
+/* Name:     pvrstat.c                                                                      */
+/* Title:    What a run sent to the TA, per list and per frame                              */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Reads a stream recorded by an example built against tools/host (PVR_STREAM=<file>)     */
+/*   and counts, per list, the bytes, headers, strips, vertices, triangles and sprites      */
+/*   the frames sent, and the texture memory allocated and loaded. -f also prints one line  */
+/*   per frame. Runs replayed from the same pad recording give the same counts, so the      */
+/*   output can be kept and compared after every change to the render code.                 */
+/*                                                                                          */
+/* Usage:    pvrstat [-f] stream.dcta                                                       */
+/********************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host/pvrstream.h"
+
+static void print_frame(const pvrstream_frame_t *f, const pvrstream_stats_t *st) {
+  static const char *names[PVRSTREAM_LISTS] = {"OP", "OM", "TR", "TM", "PT"};
+
+  printf("frame %5u", (unsigned)f->frame);
+  for (int i = 0; i < PVRSTREAM_LISTS; i++) {
+    const pvrstream_list_t *l = &st->list[i];
+    if (l->blocks == 0)
+      continue;
+    printf("  %s %8llu B %5llu hdr %6llu strips %7llu tris %6llu sprites", names[i],
+           (unsigned long long)l->blocks * 32, (unsigned long long)l->headers,
+           (unsigned long long)l->strips, (unsigned long long)l->tris,
+           (unsigned long long)l->sprites);
+  }
+  printf("\n");
+}
+
+static int usage(void) {
+  fprintf(stderr, "usage: pvrstat [-f] stream.dcta\n");
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  const char *in = NULL;
+  int per_frame = 0;
+  pvrstream_stats_t total;
+  pvrstream_chunk_t chunk;
+  void *data;
+  FILE *fp;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-f"))
+      per_frame = 1;
+    else if (in == NULL && argv[i][0] != '-')
+      in = argv[i];
+    else
+      return usage();
+  }
+  if (in == NULL)
+    return usage();
+  if ((fp = pvrstream_open(in)) == NULL)
+    return 1;
+
+  memset(&total, 0, sizeof(total));
+  while (pvrstream_next(fp, &chunk, &data)) {
+    if (pvrstream_is(&chunk, "INIT") && chunk.size >= sizeof(pvrstream_init_t)) {
+      const pvrstream_init_t *init = data;
+      printf("bins OP %u OM %u TR %u TM %u PT %u, vertex buffer %u, overflow OPBs %u%s%s\n",
+             (unsigned)init->opb_sizes[0], (unsigned)init->opb_sizes[1],
+             (unsigned)init->opb_sizes[2], (unsigned)init->opb_sizes[3],
+             (unsigned)init->opb_sizes[4], (unsigned)init->vertex_buf_size,
+             (unsigned)init->opb_overflow_count, init->dma_enabled ? ", DMA" : "",
+             init->fsaa_enabled ? ", FSAA" : "");
+    } else if (pvrstream_is(&chunk, "MEM ") && chunk.size >= sizeof(pvrstream_mem_t)) {
+      pvrstream_count_mem(&total, data);
+    } else if (pvrstream_is(&chunk, "VRAM") && chunk.size >= sizeof(pvrstream_vram_t)) {
+      total.uploaded += chunk.size - sizeof(pvrstream_vram_t);
+    } else if (pvrstream_is(&chunk, "FRAM") && chunk.size >= sizeof(pvrstream_frame_t)) {
+      const pvrstream_frame_t *f = data;
+      const uint8_t *blk = (const uint8_t *)(f + 1);
+      pvrstream_parser_t parser;
+      pvrstream_stats_t frame;
+
+      if (chunk.size < sizeof(*f) + f->blocks * 32u) {
+        fprintf(stderr, "%s: frame %u is short\n", in, (unsigned)f->frame);
+        free(data);
+        fclose(fp);
+        return 1;
+      }
+      memset(&frame, 0, sizeof(frame));
+      pvrstream_parser_init(&parser);
+      for (uint32_t b = 0; b < f->blocks; b++)
+        pvrstream_feed(&parser, blk + b * 32, &frame);
+      if (per_frame)
+        print_frame(f, &frame);
+      for (int i = 0; i < PVRSTREAM_LISTS; i++) {
+        total.list[i].blocks += frame.list[i].blocks;
+        total.list[i].headers += frame.list[i].headers;
+        total.list[i].strips += frame.list[i].strips;
+        total.list[i].verts += frame.list[i].verts;
+        total.list[i].tris += frame.list[i].tris;
+        total.list[i].sprites += frame.list[i].sprites;
+        total.list[i].mod_tris += frame.list[i].mod_tris;
+      }
+      total.loose += frame.loose;
+      total.frames++;
+    }
+    free(data);
+  }
+  fclose(fp);
+  pvrstream_print_stats(stdout, &total);
+  return 0;
+}
@@ -0,0 +1,71 @@
+/********************************************************************************************/
+/* Host tool: SDF HUD text golden image frames                                              */
+/********************************************************************************************/
+/* Name:     sdfcheck.c                                                                     */
+/* Title:    Draws pvr2dperlin's SDF text at several sizes for tools/pvrrender -c           */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Builds ../pvr2dperlin/fontnew.c against host/ and draws one frame per mode with        */
+/*   draw_sdf_strf(), the same lines at sizes from half the atlas cell to three times it,   */
+/*   so every ramp bucket is used:                                                          */
+/*                                                                                          */
+/*     frame 0  SDF_MODE_RAMP, TR list, a palette ramp per bucket                           */
+/*     frame 1  SDF_MODE_ALPHA_TEST, PT list, identity palette and PVR_PT_ALPHA_REF         */
+/*                                                                                          */
+/*   Run with PVR_STREAM=<file> to record them, then pvrrender -c compares the frames       */
+/*   with the images rendered before a change; pvr2dperlin's make sdf-check does both.      */
+/*                                                                                          */
+/* Usage:    PVR_STREAM=sdfcheck.dcta sdfcheck -f hud.sdf                                   */
+/********************************************************************************************/
+
+#include <kos.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../pvr2dperlin/fontnew.h"
+
+static const float sizes[] = {16.0f, 24.0f, 32.0f, 48.0f, 64.0f, 96.0f};
+
+static int draw_frame(const char *font, int mode) {
+  float y = 8.0f;
+
+  if (!setup_sdf_texture(font, mode))
+    return 0;
+  pvr_scene_begin();
+  pvr_list_begin(mode == SDF_MODE_ALPHA_TEST ? PVR_LIST_PT_POLY : PVR_LIST_TR_POLY);
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    // Alternate white and amber to check the vertex colour gets through
+    float g = i & 1 ? 0.75f : 1.0f, b = i & 1 ? 0.25f : 1.0f;
+    draw_sdf_strf(12.0f, y, 10.0f, sizes[i], 1.0f, 1.0f, g, b, "%.0fpx Perlin gjy", sizes[i]);
+    y += sizes[i] + 4.0f;
+  }
+  pvr_list_finish();
+  pvr_scene_finish();
+  free_sdf_texture();
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  pvr_init_params_t params = {
+      {PVR_BINSIZE_16, PVR_BINSIZE_0, PVR_BINSIZE_16, PVR_BINSIZE_0, PVR_BINSIZE_16},
+      512 * 1024, 0, 0, 0, 0};
+  const char *font = NULL;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "-f"))
+      font = argv[i + 1];
+  }
+  if (font == NULL) {
+    fprintf(stderr, "usage: PVR_STREAM=sdfcheck.dcta sdfcheck -f hud.sdf\n");
+    return 1;
+  }
+  if (pvr_init(&params) < 0)
+    return 1;
+  pvr_set_bg_color(0.0f, 0.0f, 24.0f / 255.0f);
+  if (!draw_frame(font, SDF_MODE_RAMP) || !draw_frame(font, SDF_MODE_ALPHA_TEST)) {
+    pvr_shutdown();
+    return 1;
+  }
+  pvr_shutdown();
+  return 0;
+}
@@ -0,0 +1,308 @@
+/********************************************************************************************/
+/* Host tool: signed distance field font generator                                          */
+/********************************************************************************************/
+/* Name:     sdffont.c                                                                      */
+/* Title:    Builds a PAL8 SDF glyph atlas for the PVR HUD text renderer                    */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Reads a glyph sheet PNG laid out as a 16x8 grid of ASCII cells (any cell size,         */
+/*   white glyphs on black or on transparent), computes a signed distance field and         */
+/*   writes a small atlas in the format described in ../sdffont.h.                         */
+/*   The same atlas is drawn at any size at runtime, so one 64KB texture replaces the       */
+/*   set of size specific ARGB4444 bitmaps we used to need.                                 */
+/*                                                                                          */
+/*   -p renders a string with the runtime threshold math into a PGM so the look at a        */
+/*   given scale can be checked on the host and diffed against a known good image.          */
+/*                                                                                          */
+/* Usage:    sdffont -i glyphs.png -o font.sdf [-c 16x32] [-s 4] [-a 12]                    */
+/*                   [-p "text" -S 2.0 -P preview.pgm [-t]]                                 */
+/********************************************************************************************/
+
+#include <math.h>
+#include <png.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../sdffont.h"
+
+typedef struct {
+  int w, h;
+  uint8_t *cov; // coverage 0..255, one byte per pixel
+} sheet_t;
+
+static int load_sheet(const char *filename, sheet_t *sheet) {
+  png_image img;
+  memset(&img, 0, sizeof(img));
+  img.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(&img, filename)) {
+    fprintf(stderr, "Error: %s: %s\n", filename, img.message);
+    return 0;
+  }
+  int has_alpha = (img.format & PNG_FORMAT_FLAG_ALPHA) != 0;
+  img.format = PNG_FORMAT_GA;
+  uint8_t *ga = malloc(PNG_IMAGE_SIZE(img));
+  if (ga == NULL || !png_image_finish_read(&img, NULL, ga, 0, NULL)) {
+    fprintf(stderr, "Error: %s: %s\n", filename, img.message);
+    free(ga);
+    return 0;
+  }
+  sheet->w = img.width;
+  sheet->h = img.height;
+  sheet->cov = malloc(sheet->w * sheet->h);
+  /* Opaque sheets carry the glyph in the grey level, transparent sheets in
+   * the alpha channel. Taking whichever says less handles both. */
+  for (int i = 0; i < sheet->w * sheet->h; i++) {
+    uint8_t g = ga[i * 2 + 0];
+    uint8_t a = ga[i * 2 + 1];
+    sheet->cov[i] = has_alpha && a < g ? a : g;
+  }
+  free(ga);
+  return 1;
+}
+
+static inline int inside(const sheet_t *s, int x, int y) {
+  if (x < 0 || y < 0 || x >= s->w || y >= s->h)
+    return 0;
+  return s->cov[y * s->w + x] >= 128;
+}
+
+/**
+ * @brief Compute one atlas cell from one sheet cell
+ *
+ * Brute force nearest opposite pixel search inside the spread radius. Cells
+ * are small and this runs once at build time, so clarity wins over speed.
+ */
+static void build_cell(const sheet_t *s, int gx, int gy, int cell_w, int cell_h,
+                       int spread, uint8_t *atlas, int atlas_w) {
+  int src_cw = s->w / SDF_GRID_COLS;
+  int src_ch = s->h / SDF_GRID_ROWS;
+  float rx = (float)src_cw / cell_w;
+  float ry = (float)src_ch / cell_h;
+  float ratio = rx > ry ? rx : ry;
+  int radius = (int)ceilf(spread * ratio);
+
+  for (int oy = 0; oy < cell_h; oy++) {
+    for (int ox = 0; ox < cell_w; ox++) {
+      int sx = gx * src_cw + (int)((ox + 0.5f) * rx);
+      int sy = gy * src_ch + (int)((oy + 0.5f) * ry);
+      int in = inside(s, sx, sy);
+      float best = (float)(radius * radius);
+      for (int dy = -radius; dy <= radius; dy++) {
+        int py = sy + dy;
+        /* never look into the neighbouring cell, it has its own glyph */
+        if (py < gy * src_ch || py >= (gy + 1) * src_ch)
+          continue;
+        for (int dx = -radius; dx <= radius; dx++) {
+          int px = sx + dx;
+          if (px < gx * src_cw || px >= (gx + 1) * src_cw)
+            continue;
+          if (inside(s, px, py) != in) {
+            float d2 = (float)(dx * dx + dy * dy);
+            if (d2 < best)
+              best = d2;
+          }
+        }
+      }
+      float dist = sqrtf(best) / ratio; // in atlas texels
+      if (!in)
+        dist = -dist;
+      int v = (int)lroundf(SDF_EDGE_VALUE + dist * (127.0f / spread));
+      if (v < 0)
+        v = 0;
+      if (v > 255)
+        v = 255;
+      atlas[(gy * cell_h + oy) * atlas_w + gx * cell_w + ox] = (uint8_t)v;
+    }
+  }
+}
+
+static inline int next_pow2(int v) {
+  int p = 8;
+  while (p < v)
+    p <<= 1;
+  return p;
+}
+
+/**
+ * @brief Bilinear filter of a per texel value, the way the PVR filters
+ *
+ * The PVR looks the palette up before it filters, so the ramp (or identity
+ * palette) is applied to each of the four texels and the result is blended.
+ */
+static float sample(const sdf_font_hdr_t *hdr, const uint8_t *atlas,
+                    const uint8_t *lut, float u, float v) {
+  float x = u - 0.5f, y = v - 0.5f;
+  int x0 = (int)floorf(x), y0 = (int)floorf(y);
+  float fx = x - x0, fy = y - y0;
+  float t[4];
+  for (int i = 0; i < 4; i++) {
+    int xi = x0 + (i & 1), yi = y0 + (i >> 1);
+    if (xi < 0) xi = 0;
+    if (yi < 0) yi = 0;
+    if (xi >= hdr->width) xi = hdr->width - 1;
+    if (yi >= hdr->height) yi = hdr->height - 1;
+    t[i] = lut[atlas[yi * hdr->width + xi]];
+  }
+  return (t[0] * (1 - fx) + t[1] * fx) * (1 - fy) +
+         (t[2] * (1 - fx) + t[3] * fx) * fy;
+}
+
+/**
+ * @brief Render a string the way fontnew.c does and save it as a PGM
+ *
+ * @param alpha_test 0 for the palette ramp path, 1 for the punch-through
+ *                   alpha test path (identity palette, reference at the edge)
+ */
+static int write_preview(const char *filename, const sdf_font_hdr_t *hdr,
+                         const uint8_t *atlas, const char *text, float scale,
+                         int alpha_test) {
+  int len = (int)strlen(text);
+  int w = (int)ceilf((len * hdr->advance + (hdr->cell_w - hdr->advance)) * scale);
+  int h = (int)ceilf(hdr->cell_h * scale);
+  uint8_t *img = calloc(w * h, 1);
+  uint8_t lut[256];
+  float ramp_px = sdf_ramp_texel_px(sdf_ramp_bucket(scale));
+  for (int i = 0; i < 256; i++)
+    lut[i] = alpha_test ? i : sdf_ramp_alpha(i, hdr->spread, ramp_px);
+
+  for (int i = 0; i < len; i++) {
+    int c = (unsigned char)text[i] & 0x7f;
+    float pen = i * hdr->advance * scale;
+    float u0 = (c % SDF_GRID_COLS) * hdr->cell_w;
+    float v0 = (c / SDF_GRID_COLS) * hdr->cell_h;
+    for (int y = 0; y < h; y++) {
+      for (int x = (int)pen; x < (int)(pen + hdr->cell_w * scale) && x < w; x++) {
+        float u = u0 + (x + 0.5f - pen) / scale;
+        float v = v0 + (y + 0.5f) / scale;
+        float a = sample(hdr, atlas, lut, u, v);
+        if (alpha_test)
+          a = a >= SDF_EDGE_VALUE ? 255.0f : 0.0f;
+        if (a > img[y * w + x])
+          img[y * w + x] = (uint8_t)(a + 0.5f);
+      }
+    }
+  }
+
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL) {
+    perror(filename);
+    free(img);
+    return 0;
+  }
+  fprintf(fp, "P5\n%d %d\n255\n", w, h);
+  fwrite(img, 1, w * h, fp);
+  fclose(fp);
+  free(img);
+  return 1;
+}
+
+/**
+ * @brief Print the VRAM cost of the atlas next to the bitmap atlases it replaces
+ *
+ * The bitmap path is what setup_util_texture() does: 16x8 cells, ARGB4444,
+ * rounded up to power of two texture sizes, one texture per text size.
+ */
+static void print_vram_report(const sdf_font_hdr_t *hdr) {
+  static const int sizes[] = {12, 24, 36, 48};
+  int sdf_bytes = hdr->width * hdr->height;
+  int bitmap_total = 0;
+  printf("VRAM footprint, bfont-style ARGB4444 bitmaps vs one PAL8 SDF atlas\n");
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    int line = sizes[i];
+    int cw = next_pow2(line * 16 / 24); // bfont glyphs sit on a 16x24 pitch
+    int tw = next_pow2(cw * SDF_GRID_COLS);
+    int th = next_pow2(line * SDF_GRID_ROWS);
+    int bytes = tw * th * 2;
+    bitmap_total += bytes;
+    printf("  %2dpx bitmap atlas  %4dx%-4d %8d bytes\n", line, tw, th, bytes);
+  }
+  printf("  all sizes, bitmaps          %8d bytes\n", bitmap_total);
+  printf("  any size, SDF     %4dx%-4d %8d bytes (palette RAM not counted)\n",
+         hdr->width, hdr->height, sdf_bytes);
+  printf("  saved                       %8d bytes\n", bitmap_total - sdf_bytes);
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: sdffont -i glyphs.png -o font.sdf [-c WxH] [-s spread] "
+          "[-a advance]\n"
+          "               [-p text -S scale -P preview.pgm [-t]]\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *in = NULL, *out = NULL, *ptext = NULL, *pout = NULL;
+  int cell_w = 16, cell_h = 32, spread = 4, advance = 12, alpha_test = 0;
+  float pscale = 1.0f;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-i") && i + 1 < argc)
+      in = argv[++i];
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      out = argv[++i];
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      sscanf(argv[++i], "%dx%d", &cell_w, &cell_h);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      spread = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-a") && i + 1 < argc)
+      advance = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      ptext = argv[++i];
+    else if (!strcmp(argv[i], "-S") && i + 1 < argc)
+      pscale = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "-P") && i + 1 < argc)
+      pout = argv[++i];
+    else if (!strcmp(argv[i], "-t"))
+      alpha_test = 1;
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (in == NULL || out == NULL || spread < 1 || spread > 127) {
+    usage();
+    return 1;
+  }
+
+  sheet_t sheet;
+  if (!load_sheet(in, &sheet))
+    return 1;
+
+  sdf_font_hdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.fourcc, SDF_FOURCC, 4);
+  hdr.cell_w = cell_w;
+  hdr.cell_h = cell_h;
+  hdr.width = next_pow2(cell_w * SDF_GRID_COLS);
+  hdr.height = next_pow2(cell_h * SDF_GRID_ROWS);
+  hdr.advance = advance;
+  hdr.spread = spread;
+  hdr.first_char = 0;
+  hdr.num_chars = SDF_GRID_COLS * SDF_GRID_ROWS;
+
+  uint8_t *atlas = calloc(hdr.width * hdr.height, 1);
+  for (int gy = 0; gy < SDF_GRID_ROWS; gy++)
+    for (int gx = 0; gx < SDF_GRID_COLS; gx++)
+      build_cell(&sheet, gx, gy, cell_w, cell_h, spread, atlas, hdr.width);
+
+  FILE *fp = fopen(out, "wb");
+  if (fp == NULL) {
+    perror(out);
+    return 1;
+  }
+  fwrite(&hdr, sizeof(hdr), 1, fp);
+  fwrite(atlas, 1, hdr.width * hdr.height, fp);
+  fclose(fp);
+  printf("%s: %dx%d atlas, %dx%d cells, spread %d\n", out, hdr.width,
+         hdr.height, cell_w, cell_h, spread);
+  print_vram_report(&hdr);
+
+  int ok = 1;
+  if (ptext != NULL && pout != NULL)
+    ok = write_preview(pout, &hdr, atlas, ptext, pscale, alpha_test);
+
+  free(atlas);
+  free(sheet.cov);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+/********************************************************************************************/
+/* Host tool: strip topology check and TA bin estimate                                      */
+/********************************************************************************************/
+/* Name:     stripcheck.c                                                                   */
+/* Title:    Separate against stitched strips for a ../mesh.h mesh                          */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Emits a mesh through cubemappedadx/vertpipe.c both ways a renderer can send it:       */
+/*     separate   every strip on its own, vertpipe_emit_indexed()                           */
+/*     stitched   every strip under one header as one, vertpipe_emit_strips()               */
+/*   and rebuilds the triangles from what was committed. Both must give exactly the         */
+/*   triangles of the strip table, each once and wound the same way, with the degenerate   */
+/*   joins dropped. A second file, say the same OBJ through meshconv -s, must hold the      */
+/*   same triangles too.                                                                    */
+/*                                                                                          */
+/*   Then, over eight views of the mesh filling the middle of a 640x480 screen, counts      */
+/*   what the TA sees: vertices, strips (EOLs) and object list entries. The TA cuts a       */
+/*   strip into runs of up to six triangles and writes one entry for each run into every   */
+/*   32x32 tile it touches; touching is taken as the triangle bounding box here, which     */
+/*   is what the TA tests against when a triangle is small, so the count is an upper       */
+/*   bound for large ones. Degenerate joins take a slot in a run but touch no tile.        */
+/*                                                                                          */
+/* Usage:    stripcheck mesh.msh [other.msh]                                                */
+/********************************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cubemappedadx/vertpipe.h"
+#include "../mesh.h"
+
+#define TILES_X 20
+#define TILES_Y 15
+#define VIEWS   8
+
+enum { SEPARATE, STITCHED };
+
+typedef struct {
+  int a, b, c;
+} tri_t;
+
+typedef struct {
+  long verts, strips, entries, tiles;
+} ta_stats_t;
+
+static int tri_cmp(const void *pa, const void *pb) {
+  const tri_t *a = pa, *b = pb;
+  if (a->a != b->a)
+    return a->a - b->a;
+  if (a->b != b->b)
+    return a->b - b->b;
+  return a->c - b->c;
+}
+
+/* Same triangle, same winding: rotate the smallest vertex to the front */
+static tri_t tri_make(int a, int b, int c) {
+  tri_t t;
+  if (a < b && a < c)
+    t = (tri_t){a, b, c};
+  else if (b < c)
+    t = (tri_t){b, c, a};
+  else
+    t = (tri_t){c, a, b};
+  return t;
+}
+
+/* Triangle k of a strip is (k, k+1, k+2), with the first two swapped for odd k */
+static int strip_tris(const int *s, int len, tri_t *out) {
+  int n = 0;
+  for (int k = 0; k + 2 < len; k++) {
+    int a = s[k], b = s[k + 1], c = s[k + 2];
+    if (a == b || b == c || a == c)
+      continue;
+    out[n++] = k & 1 ? tri_make(b, a, c) : tri_make(a, b, c);
+  }
+  return n;
+}
+
+/* Triangles straight from the strip table */
+static int table_tris(const mesh_t *m, tri_t *out) {
+  int n = 0, *s = malloc((m->index_count + 1) * sizeof(int));
+  for (int k = 0; k < m->strip_count; k++) {
+    int first = m->strip_first[k], len = m->strip_first[k + 1] - first;
+    for (int i = 0; i < len; i++)
+      s[i] = m->index[first + i];
+    n += strip_tris(s, len, out + n);
+  }
+  free(s);
+  qsort(out, n, sizeof(tri_t), tri_cmp);
+  return n;
+}
+
+static int emit(const vertpipe_t *p, const mesh_t *m, int mode, pvr_vertex_t *buf, int cap) {
+  pvr_dr_state_t dr;
+
+  host_pvr_capture(buf, cap);
+  pvr_dr_init(&dr);
+  if (mode == STITCHED) {
+    vertpipe_emit_strips(p, &dr, m->index, m->strip_first, 0, m->strip_count, NULL, NULL,
+                         0xffffffffu);
+  } else {
+    for (int k = 0; k < m->strip_count; k++)
+      vertpipe_emit_indexed(p, &dr, m->index + m->strip_first[k],
+                            m->strip_first[k + 1] - m->strip_first[k], NULL, NULL,
+                            0xffffffffu);
+  }
+  return (int)host_pvr_committed();
+}
+
+/* Triangles back out of committed vertices whose x holds the vertex number */
+static int stream_tris(const pvr_vertex_t *v, int n, tri_t *out, int *strips) {
+  int *s = malloc(n * sizeof(int)), len = 0, count = 0;
+  *strips = 0;
+  for (int i = 0; i < n; i++) {
+    s[len++] = (int)v[i].x;
+    if (v[i].flags == PVR_CMD_VERTEX_EOL) {
+      count += strip_tris(s, len, out + count);
+      len = 0;
+      (*strips)++;
+    }
+  }
+  free(s);
+  qsort(out, count, sizeof(tri_t), tri_cmp);
+  return len == 0 ? count : -1;          // -1: the last strip never ended
+}
+
+static int check_topology(const char *name, const mesh_t *m, vertpipe_t *p,
+                          pvr_vertex_t *buf, int cap, tri_t *ref, int nref) {
+  tri_t *got = malloc((cap + 1) * sizeof(tri_t));
+  int ok = 1;
+
+  for (int i = 1; i < nref; i++) {
+    if (!tri_cmp(&ref[i - 1], &ref[i])) {
+      printf("%s: FAIL, triangle %d %d %d is in the strips twice\n", name, ref[i].a,
+             ref[i].b, ref[i].c);
+      ok = 0;
+      break;
+    }
+  }
+
+  // Vertex numbers for positions, so the committed stream names its vertices
+  for (int i = 0; i < m->vert_count; i++) {
+    p->x[i] = (float)i;
+    p->y[i] = p->z[i] = p->w[i] = 0.0f;
+  }
+  p->count = m->vert_count;
+  for (int mode = SEPARATE; mode <= STITCHED && ok; mode++) {
+    int strips, n = emit(p, m, mode, buf, cap);
+    int ngot = stream_tris(buf, n, got, &strips);
+    const char *what = mode == STITCHED ? "stitched" : "separate";
+    if (ngot != nref || memcmp(got, ref, nref * sizeof(tri_t))) {
+      printf("%s: FAIL, %s strips give %d triangles, the table %d\n", name, what, ngot, nref);
+      ok = 0;
+    } else if (mode == STITCHED && m->strip_count > 0 && strips != 1) {
+      printf("%s: FAIL, stitched strips end %d times\n", name, strips);
+      ok = 0;
+    }
+  }
+  free(got);
+  return ok;
+}
+
+/* Projection times a model-view that centres the mesh, scales it to a unit
+   radius and turns it by view k */
+static void load_view(const mesh_t *m, int k) {
+  float lo[3] = {1e30f, 1e30f, 1e30f}, hi[3] = {-1e30f, -1e30f, -1e30f}, c[3], r = 0.0f;
+  float ay = k * 2.0f * 3.14159265f / VIEWS, ax = 0.3f + 0.2f * k;
+  float f = 1.0f / tanf(22.5f * 3.14159265f / 180.0f), zn = 0.1f, zf = 100.0f;
+  float R[3][3], s;
+  matrix_t proj = {
+    {f * 0.75f, 0.0f, 0.0f, 0.0f},
+    {0.0f, f, 0.0f, 0.0f},
+    {0.0f, 0.0f, (zf + zn) / (zn - zf), -1.0f},
+    {0.0f, 0.0f, (2.0f * zf * zn) / (zn - zf), 0.0f}
+  };
+  matrix_t mv;
+
+  for (int i = 0; i < m->vert_count; i++) {
+    float v[3] = {m->x[i], m->y[i], m->z[i]};
+    for (int j = 0; j < 3; j++) {
+      lo[j] = fminf(lo[j], v[j]);
+      hi[j] = fmaxf(hi[j], v[j]);
+    }
+  }
+  for (int j = 0; j < 3; j++) {
+    c[j] = (lo[j] + hi[j]) * 0.5f;
+    r += (hi[j] - c[j]) * (hi[j] - c[j]);
+  }
+  s = r > 0.0f ? 1.0f / sqrtf(r) : 1.0f;
+
+  // Ry * Rx
+  R[0][0] = cosf(ay);  R[0][1] = sinf(ay) * sinf(ax); R[0][2] = sinf(ay) * cosf(ax);
+  R[1][0] = 0.0f;      R[1][1] = cosf(ax);            R[1][2] = -sinf(ax);
+  R[2][0] = -sinf(ay); R[2][1] = cosf(ay) * sinf(ax); R[2][2] = cosf(ay) * cosf(ax);
+  for (int col = 0; col < 3; col++) {
+    for (int row = 0; row < 3; row++)
+      mv[col][row] = R[row][col] * s;
+    mv[col][3] = 0.0f;
+  }
+  for (int row = 0; row < 3; row++)
+    mv[3][row] = -(R[row][0] * c[0] + R[row][1] * c[1] + R[row][2] * c[2]) * s;
+  mv[3][2] -= 3.0f;
+  mv[3][3] = 1.0f;
+
+  mat_load(&proj);
+  mat_apply(&mv);
+}
+
+static void tiles_of(const pvr_vertex_t *a, const pvr_vertex_t *b, const pvr_vertex_t *c,
+                     uint8_t *touched) {
+  float x0 = fminf(a->x, fminf(b->x, c->x)), x1 = fmaxf(a->x, fmaxf(b->x, c->x));
+  float y0 = fminf(a->y, fminf(b->y, c->y)), y1 = fmaxf(a->y, fmaxf(b->y, c->y));
+  int tx0, tx1, ty0, ty1;
+
+  if (x1 < 0.0f || y1 < 0.0f || x0 >= TILES_X * 32 || y0 >= TILES_Y * 32)
+    return;
+  tx0 = x0 < 0.0f ? 0 : (int)x0 / 32;
+  ty0 = y0 < 0.0f ? 0 : (int)y0 / 32;
+  tx1 = x1 >= TILES_X * 32 ? TILES_X - 1 : (int)x1 / 32;
+  ty1 = y1 >= TILES_Y * 32 ? TILES_Y - 1 : (int)y1 / 32;
+  for (int ty = ty0; ty <= ty1; ty++)
+    for (int tx = tx0; tx <= tx1; tx++)
+      touched[ty * TILES_X + tx] = 1;
+}
+
+/* Object list entries for a committed stream: one per six triangle run per tile */
+static void ta_count(const pvr_vertex_t *v, int n, ta_stats_t *st) {
+  uint8_t run[TILES_X * TILES_Y], any[TILES_X * TILES_Y];
+  int start = 0;
+
+  memset(any, 0, sizeof(any));
+  st->verts += n;
+  for (int i = 0; i < n; i++) {
+    if (v[i].flags != PVR_CMD_VERTEX_EOL)
+      continue;
+    st->strips++;
+    for (int t = 0; start + t + 2 <= i; t += 6) {
+      memset(run, 0, sizeof(run));
+      for (int k = t; k < t + 6 && start + k + 2 <= i; k++) {
+        const pvr_vertex_t *a = &v[start + k], *b = a + 1, *c = a + 2;
+        float area = (b->x - a->x) * (c->y - a->y) - (c->x - a->x) * (b->y - a->y);
+        if (area != 0.0f)
+          tiles_of(a, b, c, run);
+      }
+      for (int j = 0; j < TILES_X * TILES_Y; j++) {
+        st->entries += run[j];
+        any[j] |= run[j];
+      }
+    }
+    start = i + 1;
+  }
+  for (int j = 0; j < TILES_X * TILES_Y; j++)
+    st->tiles += any[j];
+}
+
+static void report(const mesh_t *m, vertpipe_t *p, pvr_vertex_t *buf, int cap, int ntris) {
+  ta_stats_t st[2];
+  vecsoa3_t pos = {m->x, m->y, m->z};
+
+  memset(st, 0, sizeof(st));
+  for (int k = 0; k < VIEWS; k++) {
+    load_view(m, k);
+    vertpipe_transform(p, &pos, m->vert_count);
+    for (int mode = SEPARATE; mode <= STITCHED; mode++)
+      ta_count(buf, emit(p, m, mode, buf, cap), &st[mode]);
+  }
+  printf("                          separate    stitched\n");
+  printf("  vertices sent         %10ld  %10ld\n", st[0].verts / VIEWS, st[1].verts / VIEWS);
+  printf("  vertices per triangle %10.2f  %10.2f\n", (double)st[0].verts / VIEWS / ntris,
+         (double)st[1].verts / VIEWS / ntris);
+  printf("  strips (EOLs)         %10ld  %10ld\n", st[0].strips / VIEWS, st[1].strips / VIEWS);
+  printf("  TA bin entries        %10.1f  %10.1f   mean of %d views\n",
+         (double)st[0].entries / VIEWS, (double)st[1].entries / VIEWS, VIEWS);
+  printf("  tiles touched         %10.1f  %10.1f\n", (double)st[0].tiles / VIEWS,
+         (double)st[1].tiles / VIEWS);
+}
+
+int main(int argc, char *argv[]) {
+  mesh_t m[2];
+  tri_t *ref[2] = {NULL, NULL};
+  int nref[2], files = argc - 1, ok = 1;
+
+  if (files < 1 || files > 2) {
+    fprintf(stderr, "usage: stripcheck mesh.msh [other.msh]\n");
+    return 1;
+  }
+  for (int f = 0; f < files; f++) {
+    vertpipe_t p;
+    pvr_vertex_t *buf;
+    int cap;
+
+    if (!mesh_load(argv[f + 1], &m[f]))
+      return 1;
+    // Worst case stitched: three extra vertices per join
+    cap = m[f].index_count + 3 * m[f].strip_count + 1;
+    buf = malloc(cap * sizeof(pvr_vertex_t));
+    ref[f] = malloc((m[f].index_count + 1) * sizeof(tri_t));
+    nref[f] = table_tris(&m[f], ref[f]);
+    vertpipe_init(&p, m[f].vert_count);
+
+    printf("%s: %d vertices, %d triangles in %d strips, %d groups\n", argv[f + 1],
+           m[f].vert_count, nref[f], m[f].strip_count, m[f].group_count);
+    if (check_topology(argv[f + 1], &m[f], &p, buf, cap, ref[f], nref[f])) {
+      printf("  topology OK, separate and stitched give the table's triangles\n");
+      report(&m[f], &p, buf, cap, nref[f]);
+    } else {
+      ok = 0;
+    }
+    printf("\n");
+    vertpipe_free(&p);
+    free(buf);
+  }
+
+  if (files == 2 && ok) {
+    if (nref[0] != nref[1] || memcmp(ref[0], ref[1], nref[0] * sizeof(tri_t)) ||
+        m[0].vert_count != m[1].vert_count) {
+      printf("FAIL, %s and %s hold different triangles\n", argv[1], argv[2]);
+      ok = 0;
+    } else {
+      printf("%s and %s hold the same %d triangles\n", argv[1], argv[2], nref[0]);
+    }
+  }
+  for (int f = 0; f < files; f++) {
+    free(ref[f]);
+    mesh_unload(&m[f]);
+  }
+  return ok ? 0 : 1;
+}
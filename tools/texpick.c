@@ -0,0 +1,210 @@
+/********************************************************************************************/
+/* Host tool: texture format picker and manifest writer                                     */
+/********************************************************************************************/
+/* Name:     texpick.c                                                                      */
+/* Title:    The native format for each PNG, for pvrtex, and the list the loader reads      */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Given a PNG, prints the pvrtex options for the smallest format that holds it without   */
+/*   losing anything the PVR could show, so a Makefile rule can convert every texture       */
+/*   with the same line:                                                                    */
+/*                                                                                          */
+/*     opaque, up to 16 colours      PAL4BPP, VQ                                            */
+/*     opaque, up to 256 colours     PAL8BPP, VQ                                            */
+/*     opaque, more                  RGB565, VQ                                             */
+/*     alpha only 0 or 255           ARGB1555                                               */
+/*     any other alpha               ARGB4444                                               */
+/*                                                                                          */
+/*   Palettes are RGB565, as pvrtex_load_named() loads them, so a texture with alpha is     */
+/*   never palettised.                                                                      */
+/*                                                                                          */
+/*   -m writes the manifest for pvrtex_load_named() in ../pvrtex.h once the .dt files are   */
+/*   in the directory given by -d, one line per texture:                                    */
+/*                                                                                          */
+/*     <name> <format> <width> <height> <bytes>                                             */
+/*                                                                                          */
+/*   and prints what each takes in texture memory against the 16 bits a texel that loading  */
+/*   the PNG at startup took, and the romdisk bytes against the PNG's.                      */
+/*                                                                                          */
+/* Usage:    texpick image.png                                                              */
+/*           texpick -m textures.txt -d romdisk/texture image.png ...                       */
+/********************************************************************************************/
+
+#include <png.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum { PAL4, PAL8, RGB565_VQ, ARGB1555, ARGB4444 } texfmt_t;
+
+static const char *fmt_names[] = {"PAL4", "PAL8", "RGB565_VQ", "ARGB1555", "ARGB4444"};
+static const char *fmt_options[] = {"-f PAL4BPP -c --max-color 16", "-f PAL8BPP -c --max-color 256",
+                                    "-f RGB565 -c", "-f ARGB1555", "-f ARGB4444"};
+
+static int pow2(unsigned n) {
+  return n >= 8 && n <= 1024 && (n & (n - 1)) == 0;
+}
+
+/* Pick the format for a PNG, -1 when it can't be a texture */
+static int pick(const char *filename, unsigned *width, unsigned *height) {
+  png_image img;
+  uint32_t *px, colors[257];
+  int ncolors = 0, opaque = 1, onebit = 1;
+
+  memset(&img, 0, sizeof(img));
+  img.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(&img, filename)) {
+    fprintf(stderr, "Error: %s: %s\n", filename, img.message);
+    return -1;
+  }
+  if (!pow2(img.width) || !pow2(img.height)) {
+    fprintf(stderr, "Error: %s is %ux%u, textures are 8 to 1024 a side in powers of two\n",
+            filename, (unsigned)img.width, (unsigned)img.height);
+    png_image_free(&img);
+    return -1;
+  }
+  *width = img.width;
+  *height = img.height;
+  img.format = PNG_FORMAT_RGBA;
+  px = malloc(PNG_IMAGE_SIZE(img));
+  if (px == NULL || !png_image_finish_read(&img, NULL, px, 0, NULL)) {
+    fprintf(stderr, "Error: %s: %s\n", filename, px ? img.message : "out of memory");
+    free(px);
+    return -1;
+  }
+
+  for (unsigned i = 0; i < *width * *height; i++) {
+    const uint8_t *p = (const uint8_t *)&px[i];
+    int k;
+    if (p[3] != 255)
+      opaque = 0;
+    if (p[3] != 0 && p[3] != 255)
+      onebit = 0;
+    if (ncolors > 256)
+      continue;
+    for (k = 0; k < ncolors && colors[k] != px[i]; k++)
+      ;
+    if (k == ncolors)
+      colors[ncolors++] = px[i];
+  }
+  free(px);
+
+  if (!opaque)
+    return onebit ? ARGB1555 : ARGB4444;
+  return ncolors <= 16 ? PAL4 : ncolors <= 256 ? PAL8 : RGB565_VQ;
+}
+
+static long file_size(const char *filename) {
+  FILE *fp = fopen(filename, "rb");
+  long size = -1;
+  if (fp != NULL && fseek(fp, 0, SEEK_END) == 0)
+    size = ftell(fp);
+  if (fp != NULL)
+    fclose(fp);
+  return size;
+}
+
+/* Texture data bytes in a .dt, what pvrtex_load() allocates */
+static long dt_bytes(const char *filename) {
+  uint8_t hdr[32];
+  FILE *fp = fopen(filename, "rb");
+  long size = -1;
+  if (fp == NULL)
+    return -1;
+  if (fread(hdr, sizeof(hdr), 1, fp) == 1 && !memcmp(hdr, "DcTx", 4))
+    size = (long)(hdr[4] | hdr[5] << 8 | hdr[6] << 16 | (uint32_t)hdr[7] << 24) -
+           ((1 + hdr[9]) << 5);
+  fclose(fp);
+  return size;
+}
+
+/* The file name without its directory and extension */
+static void base_name(const char *path, char *out, size_t size) {
+  const char *slash = strrchr(path, '/'), *dot;
+  path = slash ? slash + 1 : path;
+  dot = strrchr(path, '.');
+  snprintf(out, size, "%.*s", dot ? (int)(dot - path) : (int)strlen(path), path);
+}
+
+static int write_manifest(const char *manifest, const char *dir, int count, char **pngs) {
+  long vram_png = 0, vram_dt = 0, rd_png = 0, rd_dt = 0;
+  FILE *fp = fopen(manifest, "w");
+
+  if (fp == NULL) {
+    fprintf(stderr, "Error: can't write %s\n", manifest);
+    return 0;
+  }
+  fprintf(fp, "# tools/texpick: name format width height bytes\n");
+  printf("%-20s %-10s %9s %16s %16s\n", "texture", "format", "size", "texture memory",
+         "romdisk");
+  for (int i = 0; i < count; i++) {
+    char name[256], dt[1024], pal[1100];
+    unsigned w, h;
+    long bytes, png, file, palsize;
+    int fmt = pick(pngs[i], &w, &h);
+    if (fmt < 0)
+      goto fail;
+    base_name(pngs[i], name, sizeof(name));
+    snprintf(dt, sizeof(dt), "%s/%s.dt", dir, name);
+    snprintf(pal, sizeof(pal), "%s.pal", dt);
+    if ((bytes = dt_bytes(dt)) < 0) {
+      fprintf(stderr, "Error: %s is missing or not a .dt\n", dt);
+      goto fail;
+    }
+    png = file_size(pngs[i]);
+    file = file_size(dt);
+    palsize = file_size(pal);
+    if (palsize > 0)
+      file += palsize;
+    fprintf(fp, "%s %s %u %u %ld\n", name, fmt_names[fmt], w, h, bytes);
+    printf("%-20s %-10s %4ux%-4u %7ld -> %6ld %7ld -> %6ld\n", name, fmt_names[fmt], w, h,
+           (long)w * h * 2, bytes, png, file);
+    vram_png += (long)w * h * 2;
+    vram_dt += bytes;
+    rd_png += png;
+    rd_dt += file;
+  }
+  fclose(fp);
+  printf("%d textures: texture memory %ld KB -> %ld KB, romdisk %ld KB -> %ld KB\n", count,
+         vram_png / 1024, vram_dt / 1024, rd_png / 1024, rd_dt / 1024);
+  return 1;
+fail:
+  fclose(fp);
+  remove(manifest);
+  return 0;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: texpick image.png\n"
+                  "       texpick -m textures.txt -d romdisk/texture image.png ...\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *manifest = NULL, *dir = ".";
+  unsigned w, h;
+  int i, fmt;
+
+  for (i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+    if (!strcmp(argv[i], "-m"))
+      manifest = argv[i + 1];
+    else if (!strcmp(argv[i], "-d"))
+      dir = argv[i + 1];
+    else {
+      usage();
+      return 1;
+    }
+  }
+  // A manifest may list nothing, for a demo with no textures yet
+  if (manifest == NULL && argc - i != 1) {
+    usage();
+    return 1;
+  }
+  if (manifest != NULL)
+    return write_manifest(manifest, dir, argc - i, argv + i) ? 0 : 1;
+
+  if ((fmt = pick(argv[i], &w, &h)) < 0)
+    return 1;
+  printf("%s\n", fmt_options[fmt]);
+  return 0;
+}
@@ -0,0 +1,211 @@
+/********************************************************************************************/
+/* Host tool: vector maths check                                                            */
+/********************************************************************************************/
+/* Name:     vecsoacheck.c                                                                  */
+/* Title:    cubemappedadx/vecsoa.h and vec_cross() against double precision, XMTRX kept    */
+/*                                                                                          */
+/* Description:                                                                             */
+/*   Loads a random "model-view" into the emulated XMTRX (tools/host), then runs every      */
+/*   batched function, both sides of the vecsoa_transform() size cutoff and in place, and   */
+/*   checks each result against a double precision reference and that XMTRX still holds    */
+/*   the model-view afterwards.                                                             */
+/*                                                                                          */
+/*   Built twice: vecsoacheck with the DC_FAST_MATHS paths the console uses, and            */
+/*   vecsoacheck_c with -DDC_NO_FAST_MATHS for the plain C fallback.                        */
+/*                                                                                          */
+/* Usage:    vecsoacheck                                                                    */
+/********************************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cubemappedadx/vecsoa.h"
+
+#define BIG   1000
+#define SMALL (VECSOA_XMTRX_MIN - 1)
+
+static matrix_t modelview __attribute__((aligned(32)));
+static int failures;
+
+static float frand(void) {
+  return (float)rand() / RAND_MAX * 4.0f - 2.0f;
+}
+
+static void check_xmtrx(const char *what) {
+  if (memcmp(&host_xmtrx, &modelview, sizeof(matrix_t))) {
+    printf("%-36s XMTRX CHANGED\n", what);
+    failures++;
+  }
+}
+
+static void check(const char *what, const float *got, const double *want, int n) {
+  double worst = 0.0;
+  for (int i = 0; i < n; i++) {
+    double err = fabs(got[i] - want[i]) / (fabs(want[i]) > 1.0 ? fabs(want[i]) : 1.0);
+    if (err > worst)
+      worst = err;
+  }
+  if (worst > 1e-5) {
+    printf("%-36s error %g\n", what, worst);
+    failures++;
+  } else {
+    printf("%-36s ok   (max rel error %.1e)\n", what, worst);
+  }
+  check_xmtrx(what);
+}
+
+static void fill(vecsoa3_t *v, int n) {
+  v->x = malloc(n * sizeof(float));
+  v->y = malloc(n * sizeof(float));
+  v->z = malloc(n * sizeof(float));
+  for (int i = 0; i < n; i++) {
+    v->x[i] = frand();
+    v->y[i] = frand();
+    v->z[i] = frand();
+  }
+}
+
+static void copy(vecsoa3_t *dst, const vecsoa3_t *src, int n) {
+  fill(dst, n);
+  memcpy(dst->x, src->x, n * sizeof(float));
+  memcpy(dst->y, src->y, n * sizeof(float));
+  memcpy(dst->z, src->z, n * sizeof(float));
+}
+
+/* Flatten x, y, z (and w) for check() */
+static float *flat(const vecsoa3_t *v, const float *w, int n) {
+  float *f = malloc(n * 4 * sizeof(float));
+  for (int i = 0; i < n; i++) {
+    f[i * 4] = v->x[i];
+    f[i * 4 + 1] = v->y[i];
+    f[i * 4 + 2] = v->z[i];
+    f[i * 4 + 3] = w ? w[i] : 0.0f;
+  }
+  return f;
+}
+
+static void ref_transform(double *out, const matrix_t *m, const vecsoa3_t *v, int with_w, int n) {
+  for (int i = 0; i < n; i++) {
+    for (int r = 0; r < 4; r++) {
+      out[i * 4 + r] = r == 3 && !with_w ? 0.0 :
+                       (double)(*m)[0][r] * v->x[i] + (double)(*m)[1][r] * v->y[i] +
+                       (double)(*m)[2][r] * v->z[i] + (*m)[3][r];
+    }
+  }
+}
+
+static void test_transform(const char *what, const matrix_t *m, int n, int with_w, int in_place) {
+  vecsoa3_t src, dst;
+  float *w = with_w ? malloc(n * sizeof(float)) : NULL;
+  double *want = malloc(n * 4 * sizeof(double));
+  float *got;
+
+  fill(&src, n);
+  ref_transform(want, m, &src, with_w, n);
+  if (in_place)
+    dst = src;
+  else
+    fill(&dst, n);
+  vecsoa_transform(&dst, w, m, &src, n);
+  got = flat(&dst, w, n);
+  check(what, got, want, n * 4);
+  free(got);
+  free(want);
+  free(w);
+}
+
+int main(void) {
+  matrix_t m __attribute__((aligned(32)));
+  vecsoa3_t a, b, d;
+  double *want = malloc(BIG * 4 * sizeof(double));
+  float *got, *dots = malloc(BIG * sizeof(float));
+
+  srand(1);
+  for (int c = 0; c < 4; c++)
+    for (int r = 0; r < 4; r++) {
+      modelview[c][r] = frand();
+      m[c][r] = frand();
+    }
+  mat_load(&modelview);
+
+#ifdef DC_FAST_MATHS
+  printf("DC_FAST_MATHS paths, emulated XMTRX\n\n");
+#else
+  printf("plain C paths\n\n");
+#endif
+
+  fill(&a, BIG);
+  fill(&b, BIG);
+  fill(&d, BIG);
+
+  // One at a time, the function that used to load XMTRX
+  for (int i = 0; i < BIG; i++) {
+    float va[3] = {a.x[i], a.y[i], a.z[i]}, vb[3] = {b.x[i], b.y[i], b.z[i]};
+    vec_cross(va, va, vb);                     // dst aliasing a
+    d.x[i] = va[0];
+    d.y[i] = va[1];
+    d.z[i] = va[2];
+    want[i * 4] = (double)a.y[i] * b.z[i] - (double)a.z[i] * b.y[i];
+    want[i * 4 + 1] = (double)a.z[i] * b.x[i] - (double)a.x[i] * b.z[i];
+    want[i * 4 + 2] = (double)a.x[i] * b.y[i] - (double)a.y[i] * b.x[i];
+    want[i * 4 + 3] = 0.0;
+  }
+  got = flat(&d, NULL, BIG);
+  check("vec_cross", got, want, BIG * 4);
+  free(got);
+
+  vecsoa_cross(&d, &a, &b, BIG);
+  got = flat(&d, NULL, BIG);
+  check("vecsoa_cross", got, want, BIG * 4);
+  free(got);
+
+  vecsoa_dot(dots, &a, &b, BIG);
+  for (int i = 0; i < BIG; i++)
+    want[i] = (double)a.x[i] * b.x[i] + (double)a.y[i] * b.y[i] + (double)a.z[i] * b.z[i];
+  check("vecsoa_dot", dots, want, BIG);
+
+  // In place, with a zero vector that has to stay zero
+  {
+    vecsoa3_t n;
+    copy(&n, &a, BIG);
+    n.x[7] = n.y[7] = n.z[7] = 0.0f;
+    for (int i = 0; i < BIG; i++) {
+      double l = sqrt((double)n.x[i] * n.x[i] + (double)n.y[i] * n.y[i] + (double)n.z[i] * n.z[i]);
+      l = l > 0.0 ? 1.0 / l : 0.0;
+      want[i * 4] = n.x[i] * l;
+      want[i * 4 + 1] = n.y[i] * l;
+      want[i * 4 + 2] = n.z[i] * l;
+      want[i * 4 + 3] = 0.0;
+    }
+    vecsoa_normalize(&n, &n, BIG);
+    got = flat(&n, NULL, BIG);
+    check("vecsoa_normalize in place", got, want, BIG * 4);
+    free(got);
+  }
+
+  test_transform("vecsoa_transform small", &m, SMALL, 0, 0);
+  test_transform("vecsoa_transform small with w", &m, SMALL, 1, 0);
+  test_transform("vecsoa_transform large", &m, BIG, 0, 0);
+  test_transform("vecsoa_transform large with w", &m, BIG, 1, 0);
+  test_transform("vecsoa_transform large in place", &m, BIG, 1, 1);
+
+  // The caller's own matrix, which stays loaded
+  {
+    float *w = malloc(BIG * sizeof(float));
+    ref_transform(want, &modelview, &a, 1, BIG);
+    vecsoa_transform_loaded(&d, w, &a, BIG);
+    got = flat(&d, w, BIG);
+    check("vecsoa_transform_loaded", got, want, BIG * 4);
+    free(got);
+    free(w);
+  }
+
+  if (failures) {
+    printf("\nFAIL: %d\n", failures);
+    return 1;
+  }
+  printf("\nPASS\n");
+  return 0;
+}
@@ -0,0 +1,245 @@
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include <dc/pvr.h>
+#include <kos/thread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**  Screen transitions through a snapshot of the outgoing scene.
+
+     transition_begin() renders the outgoing scene once more, with
+     pvr_scene_begin_txr(), into a 1024x512 RGB565 texture. From then on
+     the old scene's own textures are no longer needed and can be freed
+     before the next scene's are loaded, so only one scene's assets are in
+     texture memory at a time plus the snapshot, which goes again with
+     transition_end(). Any two scenes can be joined this way, and the cost
+     while it plays is one textured quad over the incoming scene:
+
+       pvr_wait_ready();
+       transition_begin(&tr, TRANSITION_ZOOM, 30, draw_old_scene, &old);
+       pvr_mem_free(old_tex);
+       transition_load(&tr, load_new_scene, &new);
+       ...
+       // each simulation step
+       transition_step(&tr);
+       // each frame, after pvr_wait_ready()
+       if (transition_done(&tr))
+         transition_end(&tr);
+       // in the translucent list
+       if (transition_loaded(&tr))
+         draw_new_scene();
+       transition_draw(&tr, fixedstep_alpha(&clock));
+
+     transition_load() streams the incoming scene's textures in on a thread
+     below the main one's priority, so it gets the time the main thread
+     spends waiting for the PVR and the vblank. The transition holds on its
+     first frame until the load is done, then fades the snapshot out, or
+     with TRANSITION_ZOOM also blows it up around the centre.               */
+
+#define TRANSITION_TXR_W 1024
+#define TRANSITION_TXR_H 512
+#define TRANSITION_ZOOM_MAX 3.0f    // snapshot scale at the end of a zoom
+#define TRANSITION_RENDER_WAIT_MS 100 // two vblanks are enough, this is a backstop
+
+typedef enum {
+  TRANSITION_CROSSFADE,
+  TRANSITION_ZOOM
+} transition_kind_t;
+
+/* Load status */
+#define TRANSITION_LOAD_NONE    0  // nothing to wait for
+#define TRANSITION_LOAD_PENDING 1
+#define TRANSITION_LOAD_DONE    2
+#define TRANSITION_LOAD_ERROR   3
+
+typedef struct {
+  transition_kind_t kind;
+  pvr_ptr_t snap;                  // the outgoing scene, NULL when not running
+  pvr_poly_hdr_t hdr;
+  uint32_t steps, step, prev_step; // length and progress in simulation steps
+  // The incoming scene
+  kthread_t *loader;
+  int (*load_fn)(void *arg);
+  void *load_arg;
+  volatile int load;               // TRANSITION_LOAD_*
+} transition_t;
+
+/**
+ * @brief Wait until the scene pvr_wait_ready() last returned for is rendered
+ *
+ * pvr_wait_ready() returns once the TA has the scene and its render has
+ * started, which KOS only does after the render before it has finished and
+ * been flipped in at a vblank. The frame count pvr_get_stats() keeps, which
+ * framesched uses as its fence too, moves on at the next flip, once this
+ * render is done as well.
+ */
+static inline void transition_wait_render(void) {
+  pvr_stats_t st;
+  uint32_t started;
+
+  pvr_get_stats(&st);
+  started = st.frame_count;
+  for (int ms = 0; ms < TRANSITION_RENDER_WAIT_MS; ms++) {
+    thd_sleep(1);
+    pvr_get_stats(&st);
+    if (st.frame_count != started)
+      return;
+  }
+  printf("Warning: transition gave up waiting for a render after %d ms\n",
+         TRANSITION_RENDER_WAIT_MS);
+}
+
+/**
+ * @brief Snapshot the outgoing scene and start a transition
+ *
+ * Call it where a scene would begin, after pvr_wait_ready(). It renders
+ * draw into the snapshot and waits for that render to finish, not just for
+ * the TA, so textures only the outgoing scene used may be freed and
+ * overwritten as soon as this returns, and the next scene begins as usual.
+ *
+ * @param tr Transition state
+ * @param kind How the snapshot leaves
+ * @param steps How many simulation steps it takes, once the load is done
+ * @param draw Draws the whole outgoing scene: pvr_list_begin() to
+ *             pvr_list_finish() for each list it uses
+ * @param arg For draw
+ * @return int 1, 0 when there is no texture memory for the snapshot
+ */
+static inline int transition_begin(transition_t *tr, transition_kind_t kind, uint32_t steps,
+                                   void (*draw)(void *arg), void *arg) {
+  pvr_poly_cxt_t cxt;
+  uint32_t w = TRANSITION_TXR_W, h = TRANSITION_TXR_H;
+
+  tr->snap = pvr_mem_malloc(TRANSITION_TXR_W * TRANSITION_TXR_H * 2);
+  if (tr->snap == NULL) {
+    printf("Error: no texture memory for a transition\n");
+    return 0;
+  }
+  tr->kind = kind;
+  tr->steps = steps ? steps : 1;
+  tr->step = tr->prev_step = 0;
+  tr->loader = NULL;
+  tr->load = TRANSITION_LOAD_NONE;
+
+  pvr_scene_begin_txr(tr->snap, &w, &h);
+  draw(arg);
+  pvr_scene_finish();
+  pvr_wait_ready();
+  transition_wait_render();
+
+  pvr_poly_cxt_txr(&cxt, PVR_LIST_TR_POLY, PVR_TXRFMT_RGB565 | PVR_TXRFMT_NONTWIDDLED,
+                   TRANSITION_TXR_W, TRANSITION_TXR_H, tr->snap, PVR_FILTER_BILINEAR);
+  // The snapshot has no alpha of its own, the vertex alpha fades it
+  cxt.txr.env = PVR_TXRENV_MODULATEALPHA;
+  pvr_poly_compile(&tr->hdr, &cxt);
+  return 1;
+}
+
+static inline void *transition_loader(void *arg) {
+  transition_t *tr = (transition_t *)arg;
+  tr->load = tr->load_fn(tr->load_arg) ? TRANSITION_LOAD_DONE : TRANSITION_LOAD_ERROR;
+  return NULL;
+}
+
+/**
+ * @brief Load the incoming scene's textures while the transition plays
+ *
+ * @param load Loads them, 1 on success, 0 on failure. Runs on its own
+ *             thread: the main thread must leave what it fills alone until
+ *             transition_loaded().
+ * @param arg For load
+ * @return int 1, 0 when the thread could not be started and it was loaded here
+ */
+static inline int transition_load(transition_t *tr, int (*load)(void *arg), void *arg) {
+  tr->load_fn = load;
+  tr->load_arg = arg;
+  tr->load = TRANSITION_LOAD_PENDING;
+  tr->loader = thd_create(0, transition_loader, tr);
+  if (tr->loader == NULL) {
+    transition_loader(tr);
+    return 0;
+  }
+  // Lower than the render loop, it waits for the PVR often enough
+  thd_set_prio(tr->loader, PRIO_DEFAULT + 1);
+  return 1;
+}
+
+/* The incoming scene can be drawn */
+static inline int transition_loaded(const transition_t *tr) {
+  return tr->load != TRANSITION_LOAD_PENDING;
+}
+
+/* One simulation step. Holds until the incoming scene is loaded. */
+static inline void transition_step(transition_t *tr) {
+  tr->prev_step = tr->step;
+  if (tr->snap != NULL && transition_loaded(tr) && tr->step < tr->steps)
+    tr->step++;
+}
+
+/* Nothing left of the snapshot on screen */
+static inline int transition_done(const transition_t *tr) {
+  return tr->snap != NULL && tr->prev_step >= tr->steps;
+}
+
+/**
+ * @brief Draw the snapshot, in the translucent list after the incoming scene
+ *
+ * @param alpha Where between the last two steps, from fixedstep_alpha()
+ */
+static inline void transition_draw(const transition_t *tr, float alpha) {
+  pvr_vertex_t vert;
+  float t, scale, w, h;
+
+  if (tr->snap == NULL)
+    return;
+  t = (tr->prev_step + (float)(tr->step - tr->prev_step) * alpha) / tr->steps;
+  scale = tr->kind == TRANSITION_ZOOM ? 1.0f + (TRANSITION_ZOOM_MAX - 1.0f) * t * t : 1.0f;
+  w = 640.0f * scale;
+  h = 480.0f * scale;
+
+  pvr_prim((void *)&tr->hdr, sizeof(tr->hdr));
+  vert.flags = PVR_CMD_VERTEX;
+  vert.z = 2.0f; // In front of the incoming scene
+  vert.argb = PVR_PACK_COLOR(1.0f - t, 1.0f, 1.0f, 1.0f);
+  vert.oargb = 0;
+  vert.x = 320.0f - w / 2;
+  vert.y = 240.0f - h / 2;
+  vert.u = 0.0f;
+  vert.v = 0.0f;
+  pvr_prim(&vert, sizeof(vert));
+  vert.x = 320.0f + w / 2;
+  vert.u = 640.0f / TRANSITION_TXR_W;
+  pvr_prim(&vert, sizeof(vert));
+  vert.x = 320.0f - w / 2;
+  vert.y = 240.0f + h / 2;
+  vert.u = 0.0f;
+  vert.v = 480.0f / TRANSITION_TXR_H;
+  pvr_prim(&vert, sizeof(vert));
+  vert.flags = PVR_CMD_VERTEX_EOL;
+  vert.x = 320.0f + w / 2;
+  vert.u = 640.0f / TRANSITION_TXR_W;
+  pvr_prim(&vert, sizeof(vert));
+}
+
+/**
+ * @brief Free the snapshot
+ *
+ * Call after pvr_wait_ready(). Waits for the render of the scene that
+ * returned for, the last that may have drawn the snapshot, before freeing
+ * it, and for a load still going, for when the program quits mid
+ * transition.
+ */
+static inline void transition_end(transition_t *tr) {
+  if (tr->loader != NULL) {
+    thd_join(tr->loader, NULL);
+    tr->loader = NULL;
+  }
+  if (tr->snap != NULL) {
+    transition_wait_render();
+    pvr_mem_free(tr->snap);
+    tr->snap = NULL;
+  }
+}
+
+#endif // TRANSITION_H